@@ -1,6 +1,9 @@
 import os
+import json
+import time
 import unittest
 import logging
+import collections
 import vtk, qt, ctk, slicer
 from slicer.ScriptedLoadableModule import *
 from slicer.util import VTKObservationMixin
@@ -14,11 +17,11 @@ class Chat(ScriptedLoadableModule):
     ScriptedLoadableModule.__init__(self, parent)
     self.parent.title = "Chat"  # TODO: make this more human readable by adding spaces
     self.parent.categories = ["SlicerCollaboration"]  # TODO: set categories (folders where the module shows up in the module selector)
-    self.parent.dependencies = []  # TODO: add here list of module names that this module requires
+    self.parent.dependencies = ["Collaboration"]
     self.parent.contributors = ["David Garcia-Mato (Ebatinca S.L."]  # TODO: replace with "Firstname Lastname (Organization)"
     # TODO: update with short description of the module and a link to online module documentation
     self.parent.helpText = """
-    Text messages using OpenIGTLink communication protocol.
+    Text messages sent through the connection of a collaboration session.
     """
     # TODO: replace with organization, grant and thanks
     self.parent.acknowledgementText = """
@@ -76,6 +79,9 @@ def registerSampleData():
     nodeNames='Chat2'
   )
 
+# Name of the channel of the collaboration connection carrying the chat messages
+CHAT_CHANNEL_NAME = 'Chat'
+
 #
 # ChatWidget
 #
@@ -91,9 +97,6 @@ class ChatWidget(ScriptedLoadableModuleWidget, VTKObservationMixin):
     self._parameterNode = None
     self._updatingGUIFromParameterNode = False
 
-    # Variables
-    self.connect = True
-
   def setup(self):
     """
     Called when the user opens the module the first time and the widget is initialized.
@@ -116,70 +119,32 @@ class ChatWidget(ScriptedLoadableModuleWidget, VTKObservationMixin):
     self.logic = ChatLogic()
 
     self.logic.chat_content = self.ui.ChatEdit
+    self.logic.older_messages_button = self.ui.LoadOlderMessagesButton
 
     # Connections
-    self.ui.ServerRadioButton.connect('clicked(bool)', self.onTypeRadioButtonChecked)
-    self.ui.ClientRadioButton.connect('clicked(bool)', self.onTypeRadioButtonChecked)
-    self.ui.ConnectButton.connect('clicked(bool)', self.onConnectButtonClicked)
+    self.ui.ConnectorNodeComboBox.connect('currentNodeChanged(vtkMRMLNode*)', self.onConnectorNodeChanged)
     self.ui.SendButton.connect('clicked(bool)', self.onSendButtonClicked)
+    self.ui.LoadOlderMessagesButton.connect('clicked(bool)', self.onLoadOlderMessagesButtonClicked)
 
-  def onTypeRadioButtonChecked(self):
+    self.onConnectorNodeChanged(self.ui.ConnectorNodeComboBox.currentNode())
 
-    if self.ui.ServerRadioButton.isChecked():
-      self.ui.Hostname_input.enabled = False
-    elif self.ui.ClientRadioButton.isChecked():
-      self.ui.Hostname_input.enabled = True
+  def cleanup(self):
+    """
+    Called when the application closes and the module widget is destroyed.
+    """
+    if self.logic:
+      self.logic.setConnectorNode(None)
 
-  def onConnectButtonClicked(self):
+  def onConnectorNodeChanged(self, connectorNode):
     """
-    Update connection through OpenIGTLink
+    Send and receive the messages through the connection of the selected collaboration connector
     """
-    
-    # Get parameters
-    hostname = self.ui.Hostname_input.text
-    port = int(self.ui.Port_input.text)
-    if self.ui.ServerRadioButton.isChecked():
-      typeConnection = 'Server'
-    elif self.ui.ClientRadioButton.isChecked():      
-      typeConnection = 'Client'
-    print('Hostname: ', hostname)
-    print('Port: ', port)
-    print('Type: ', typeConnection)
-
-    # Update button state
-    self.ui.ConnectButton.enabled = False
-
-    # Update connection 
-    if self.connect:
-      status = self.logic.startConnection(port, hostname, typeConnection) # Start connection
-      if status == 1:
-        self.connect = False
-        self.ui.ConnectButton.setText('DISCONNECT')
-        self.ui.ServerRadioButton.enabled = False
-        self.ui.ClientRadioButton.enabled = False
-        self.ui.Hostname_input.enabled = False
-        self.ui.Port_input.enabled = False
-      # Prepare text message
-      self.logic.setupOIGTLconnection(typeConnection)
-      # Status
-      print('Status: ', self.logic.checkStatusConnection())
-    else:
-      self.logic.stopConnection() # Stop connection
-      self.connect = True
-      self.ui.ConnectButton.setText('CONNECT')
-      self.ui.ServerRadioButton.enabled = True
-      self.ui.ClientRadioButton.enabled = True
-      self.ui.Hostname_input.enabled = True
-      self.ui.Port_input.enabled = True
-      # Status
-      print('Status: ', self.logic.checkStatusConnection())
-
-    # Update button state
-    self.ui.ConnectButton.enabled = True
+    self.logic.setConnectorNode(connectorNode)
+    self.ui.SendButton.enabled = connectorNode is not None
 
   def onSendButtonClicked(self):
     """
-    Send messages through OpenIGTLink
+    Send messages through the collaboration connection
     """
     
     # Get input text
@@ -192,9 +157,72 @@ class ChatWidget(ScriptedLoadableModuleWidget, VTKObservationMixin):
     # Add message to chat
     self.logic.AddSentMessageToChat(messageText)
 
-    # Send message through OpenIGTLink
+    # Send message through the collaboration connection
     self.logic.SendMessageThroughOIGTL(messageText)
 
+  def onLoadOlderMessagesButtonClicked(self):
+    """
+    Show the previous page of the chat history
+    """
+    self.logic.ShowOlderMessages()
+
+#
+# ChatMessageStore
+#
+class ChatMessageStore(object):
+  """
+  Store of the chat message records. The most recent messages are kept in a bounded
+  ring buffer, older messages are moved to an archive file and read back page by page.
+  """
+
+  def __init__(self, maximumLength=500, archiveFilePath=None):
+    self.messages = collections.deque()
+    self.maximumLength = maximumLength
+    self.archiveFilePath = archiveFilePath
+    # Position of each archived record in the archive file, oldest first
+    self.archiveOffsets = []
+
+  def append(self, direction, text):
+    """
+    Add a message record and return it.
+    """
+    record = {'direction': direction, 'text': text, 'time': time.time()}
+    self.messages.append(record)
+    if len(self.messages) > self.maximumLength:
+      self._archive(self.messages.popleft())
+    return record
+
+  def _archive(self, record):
+    if not self.archiveFilePath:
+      return
+    with open(self.archiveFilePath, 'a', encoding='utf-8') as archiveFile:
+      archiveFile.seek(0, os.SEEK_END)
+      self.archiveOffsets.append(archiveFile.tell())
+      archiveFile.write(json.dumps(record) + '\n')
+
+  def numberOfArchivedMessages(self):
+    return len(self.archiveOffsets)
+
+  def getArchivedMessages(self, end, count):
+    """
+    Read up to count archived records before the index end, oldest first.
+    """
+    start = max(0, end - count)
+    if start >= end:
+      return []
+    records = []
+    with open(self.archiveFilePath, 'r', encoding='utf-8') as archiveFile:
+      archiveFile.seek(self.archiveOffsets[start])
+      for index in range(start, end):
+        records.append(json.loads(archiveFile.readline()))
+    return records
+
+  def clear(self):
+    self.messages.clear()
+    self.archiveOffsets = []
+    if self.archiveFilePath and os.path.exists(self.archiveFilePath):
+      os.remove(self.archiveFilePath)
+
 #
 # ChatLogic
 #
@@ -207,57 +235,40 @@ class ChatLogic(ScriptedLoadableModuleLogic):
     ScriptedLoadableModuleLogic.__init__(self)
 
     # Chat history
-    self.chat_history = ''
+    archiveDirectory = os.path.join(slicer.app.temporaryPath, 'Chat')
+    if not os.path.exists(archiveDirectory):
+      os.makedirs(archiveDirectory)
+    archiveFilePath = os.path.join(archiveDirectory, 'ChatHistory-{0}.jsonl'.format(os.getpid()))
+    self.chat_history = ChatMessageStore(archiveFilePath=archiveFilePath)
+    self.chat_history.clear()
     self.chat_content = None
-
-    # OpenIGTLink connector
+    self.older_messages_button = None
+    # Number of text blocks of each message shown in the chat view, a multi-line message spans several blocks,
+    # and number of archived messages already shown
+    self.chat_page_size = 100
+    self.displayedMessageBlockCounts = collections.deque()
+    self.displayedArchiveStart = 0
+
+    # Collaboration connector carrying the chat channel
     self.cnode = None
-    self.typeConnection = 'Server'
-
-    # vtkMRMLTextNode
-    try:
-      self.OIGTL_Chat_Server = slicer.util.getNode('OIGTL_Chat_Server')
-    except:
-      self.OIGTL_Chat_Server = slicer.vtkMRMLTextNode()
-      self.OIGTL_Chat_Server.SetName('OIGTL_Chat_Server')
-      slicer.mrmlScene.AddNode(self.OIGTL_Chat_Server)
-    try:
-      self.OIGTL_Chat_Client = slicer.util.getNode('OIGTL_Chat_Client')
-    except:
-      self.OIGTL_Chat_Client = slicer.vtkMRMLTextNode()
-      self.OIGTL_Chat_Client.SetName('OIGTL_Chat_Client')
-      slicer.mrmlScene.AddNode(self.OIGTL_Chat_Client)
-
-  def startConnection(self, port, hostname, typeConnection):
-    
-    # Open connection
-    try:
-        self.cnode = slicer.util.getNode('IGTLConnector_Chat')
-    except:
-        self.cnode = slicer.vtkMRMLIGTLConnectorNode()
-        slicer.mrmlScene.AddNode(self.cnode)
-        self.cnode.SetName('IGTLConnector_Chat')
-    self.typeConnection = typeConnection
-    if typeConnection == 'Server':
-      status = self.cnode.SetTypeServer(port)
-    elif typeConnection == 'Client':
-      status = self.cnode.SetTypeClient(hostname, port)
-    else:
-      return False
-    
-    # Check connection status
-    if status == 1:
-      self.cnode.Start()
-      logging.debug('Connection Successful')
-      
-    else:
-      print('ERROR: Unable to connect')
-      logging.debug('ERROR: Unable to connect')
+    self.cnodeObserverTag = None
 
-    return status
+  def setConnectorNode(self, connectorNode):
+    """
+    Use the connection of a collaboration connector node for the chat.
+    """
+    if self.cnode and self.cnodeObserverTag:
+      self.cnode.RemoveObserver(self.cnodeObserverTag)
+    self.cnode = connectorNode
+    self.cnodeObserverTag = None
+    if self.cnode:
+      self.cnodeObserverTag = self.cnode.AddObserver(
+        slicer.vtkMRMLCollaborationConnectorNode.ChannelMessageReceivedEvent, self.ReceiveMessageThroughOIGTL)
 
   def checkStatusConnection(self):
 
+    if not self.cnode:
+      return 'OFF'
     output = self.cnode.GetState()
     if output == 2:
       state = 'ON'
@@ -269,70 +280,90 @@ class ChatLogic(ScriptedLoadableModuleLogic):
       state = 'UNKNOWN'
     return state
 
-  def stopConnection(self):
-
-    self.cnode.Stop()
-
-  def setupOIGTLconnection(self, typeConnection):
-
-    if typeConnection == 'Server':
-      self.cnode.RegisterOutgoingMRMLNode(self.OIGTL_Chat_Server)
-      self.cnode.PushNode(self.OIGTL_Chat_Server)
-      device = self.cnode.CreateDeviceForOutgoingMRMLNode(self.OIGTL_Chat_Server)
-      self.cnode.RegisterIncomingMRMLNode(self.OIGTL_Chat_Client, device)
-      self.OIGTL_Chat_Client.RemoveAllObservers()
-      self.OIGTL_Chat_Client.AddObserver(slicer.vtkMRMLTextNode.TextModifiedEvent, self.ReceiveMessageThroughOIGTL)
-    elif typeConnection == 'Client':
-      self.cnode.RegisterOutgoingMRMLNode(self.OIGTL_Chat_Client)
-      self.cnode.PushNode(self.OIGTL_Chat_Client)
-      device = self.cnode.CreateDeviceForOutgoingMRMLNode(self.OIGTL_Chat_Client)
-      self.cnode.RegisterIncomingMRMLNode(self.OIGTL_Chat_Server, device)      
-      self.OIGTL_Chat_Server.RemoveAllObservers()
-      self.OIGTL_Chat_Server.AddObserver(slicer.vtkMRMLTextNode.TextModifiedEvent, self.ReceiveMessageThroughOIGTL)
-    else:
-      return False
-
   def AddSentMessageToChat(self, messageText):
     """
     Add message to chat.
     """
-    self.chat_history = self.chat_history + '\n' + '[SENT] ' + messageText
-    self.chat_content.setPlainText(self.chat_history)
-    return (self.chat_history)
+    return self.AddMessageToChat('SENT', messageText)
 
   def AddReceivedMessageToChat(self, messageText):
     """
     Add message to chat.
     """
-    self.chat_history = self.chat_history + '\n' + '[RECEIVED] ' + messageText
-    self.chat_content.setPlainText(self.chat_history)
-    return (self.chat_history)
+    return self.AddMessageToChat('RECEIVED', messageText)
+
+  def AddMessageToChat(self, direction, messageText):
+    """
+    Store the message and append it to the chat view, without redrawing the previous messages.
+    """
+    # Messages moved from the ring buffer to the archive stay in the view
+    record = self.chat_history.append(direction, messageText)
+    if self.chat_content:
+      # Inserted as plain text, the messages of the peer are not interpreted as HTML
+      document = self.chat_content.document()
+      cursor = self.chat_content.textCursor()
+      cursor.movePosition(qt.QTextCursor.End)
+      # An empty document already has the block of its first line
+      blockCount = 0 if document.isEmpty() else document.blockCount()
+      if blockCount:
+        cursor.insertBlock()
+      cursor.insertText(self.formatMessage(record))
+      self.displayedMessageBlockCounts.append(document.blockCount() - blockCount)
+      self.chat_content.verticalScrollBar().setValue(self.chat_content.verticalScrollBar().maximum)
+      # Keep the view bounded, older messages can be paged in again
+      if len(self.displayedMessageBlockCounts) > self.chat_history.maximumLength + self.chat_page_size:
+        self.removeFirstDisplayedMessage()
+    self.updateOlderMessagesButton()
+    return record
+
+  def formatMessage(self, record):
+    return '[' + record['direction'] + '] ' + record['text']
+
+  def removeFirstDisplayedMessage(self):
+    cursor = self.chat_content.textCursor()
+    cursor.movePosition(qt.QTextCursor.Start)
+    cursor.movePosition(qt.QTextCursor.NextBlock, qt.QTextCursor.KeepAnchor, self.displayedMessageBlockCounts.popleft())
+    cursor.removeSelectedText()
+    self.displayedArchiveStart += 1
+
+  def ShowOlderMessages(self):
+    """
+    Insert the previous page of archived messages at the top of the chat view.
+    """
+    records = self.chat_history.getArchivedMessages(self.displayedArchiveStart, self.chat_page_size)
+    if not records or not self.chat_content:
+      return
+    self.displayedArchiveStart -= len(records)
+    document = self.chat_content.document()
+    cursor = self.chat_content.textCursor()
+    cursor.movePosition(qt.QTextCursor.Start)
+    blockCounts = []
+    for record in records:
+      blockCount = document.blockCount()
+      cursor.insertText(self.formatMessage(record))
+      cursor.insertBlock()
+      blockCounts.append(document.blockCount() - blockCount)
+    self.displayedMessageBlockCounts.extendleft(reversed(blockCounts))
+    self.updateOlderMessagesButton()
+
+  def updateOlderMessagesButton(self):
+    if self.older_messages_button:
+      self.older_messages_button.enabled = self.displayedArchiveStart > 0
 
   def SendMessageThroughOIGTL(self, messageText):
 
-    if self.typeConnection == 'Server':
-      self.OIGTL_Chat_Server.SetText(messageText)
-      self.cnode.PushNode(self.OIGTL_Chat_Server)
-    elif self.typeConnection == 'Client':
-      self.OIGTL_Chat_Client.SetText(messageText)
-      self.cnode.PushNode(self.OIGTL_Chat_Client)
-    else:
+    if not self.cnode:
       return False
+    self.cnode.SendChannelMessage(CHAT_CHANNEL_NAME, messageText)
+    return True
 
-  def ReceiveMessageThroughOIGTL(self, unused1=None, unused2=None):
-
-    # info
-    print('Receiving...')
+  @vtk.calldata_type(vtk.VTK_OBJECT)
+  def ReceiveMessageThroughOIGTL(self, caller, event, channelMessage):
 
-    # Get message
-    if self.typeConnection == 'Server':
-      messageText = self.OIGTL_Chat_Client.GetText()
-    elif self.typeConnection == 'Client':
-      messageText = self.OIGTL_Chat_Server.GetText()
-    else:
+    # Only the messages of the chat channel
+    if channelMessage is None or channelMessage.GetValue(0) != CHAT_CHANNEL_NAME:
       return False
+    messageText = channelMessage.GetValue(1)
 
     # Add message to chat
     self.AddReceivedMessageToChat(messageText)
-
-  
\ No newline at end of file
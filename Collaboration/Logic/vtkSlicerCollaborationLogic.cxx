@@ -24,24 +24,31 @@
 
 // MRML includes
 #include <vtkMRMLScene.h>
+#include "vtkMRMLDisplayableNode.h"
+#include "vtkMRMLDisplayNode.h"
 #include "vtkMRMLModelNode.h"
 
 // VTK includes
+#include <vtkCollection.h>
 #include <vtkIntArray.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
 #include <vtkSmartPointer.h>
+#include <vtkSTLReader.h>
+#include <vtkStringArray.h>
 
 // STD includes
+#include <algorithm>
 #include <cassert>
+#include <functional>
+#include <set>
+#include <sstream>
 
 // Collaboration module includes
 #include "vtkMRMLCollaborationNode.h"
 #include "vtkMRMLCollaborationConnectorNode.h"
+#include "vtkCollaborationNodeCodec.h"
 #include <vtkMRMLLinearTransformNode.h>
-#include <vtkMRMLTextNode.h>
-#include <vtkXMLUtilities.h>
-#include "vtkSlicerModelsLogic.h"
 #include <vtkMRMLModelHierarchyNode.h>
 
 //----------------------------------------------------------------------------
@@ -49,6 +56,33 @@
 const char* vtkSlicerCollaborationLogic::AVATAR_HEAD_MODEL_NAME = "head";
 const char* vtkSlicerCollaborationLogic::AVATAR_HANDPOINTL_MODEL_NAME = "handPoint_L";
 const char* vtkSlicerCollaborationLogic::AVATAR_HANDPOINTR_MODEL_NAME = "handPoint_R";
+const int vtkSlicerCollaborationLogic::BatchProcessMinimumNumberOfNodes = 100;
+const char* vtkSlicerCollaborationLogic::AVATAR_PARTICIPANT_ATTRIBUTE_NAME = "Collaboration.AvatarParticipant";
+const char* vtkSlicerCollaborationLogic::AVATAR_LOCAL_PARTICIPANT_NAME = "VirtualReality";
+
+namespace
+{
+/// Suffixes of the names of the head and hand transforms of a participant, in the order of the avatar components
+const char* AVATAR_TRANSFORM_NAME_SUFFIXES[3] = { ".HMD", ".LeftController", ".RightController" };
+
+//----------------------------------------------------------------------------
+/// Name of the participant of a head or hand transform, and index of the avatar component it moves.
+/// Return an empty name if the transform is not one of them.
+std::string GetAvatarParticipantName(const char* transformName, int& componentIndex)
+{
+  std::string name = transformName ? transformName : "";
+  for (componentIndex = 0; componentIndex < 3; componentIndex++)
+  {
+    size_t suffixLength = strlen(AVATAR_TRANSFORM_NAME_SUFFIXES[componentIndex]);
+    if (name.size() > suffixLength
+      && name.compare(name.size() - suffixLength, suffixLength, AVATAR_TRANSFORM_NAME_SUFFIXES[componentIndex]) == 0)
+    {
+      return name.substr(0, name.size() - suffixLength);
+    }
+  }
+  return std::string();
+}
+}
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSlicerCollaborationLogic);
@@ -58,11 +92,30 @@ vtkSlicerCollaborationLogic::vtkSlicerCollaborationLogic()
 {
   vtkSmartPointer<vtkMRMLCollaborationNode> collaborationNode;
   this->collaborationNodeSelected = nullptr;
+  this->BulkSynchronizationLevel = 0;
+  this->BulkSynchronizationWasModifying = 0;
+  this->BulkSynchronizationBatchProcessScene = false;
+  this->ConnectorWakeUpCallback = nullptr;
+  this->ConnectorWakeUpClientData = nullptr;
+
+  // create callback to update the synchronization metadata when markups or display nodes are updated
+  this->UpdateTextCallback = vtkCallbackCommand::New();
+  this->UpdateTextCallback->SetClientData(reinterpret_cast<void*>(this));
+  this->UpdateTextCallback->SetCallback(vtkSlicerCollaborationLogic::nodeUpdated);
+
+  this->ConnectorConnectedCallback = vtkCallbackCommand::New();
+  this->ConnectorConnectedCallback->SetClientData(reinterpret_cast<void*>(this));
+  this->ConnectorConnectedCallback->SetCallback(vtkSlicerCollaborationLogic::connectorConnected);
 }
 
 //----------------------------------------------------------------------------
 vtkSlicerCollaborationLogic::~vtkSlicerCollaborationLogic()
 {
+  this->UpdateTextCallback->SetClientData(nullptr);
+  this->UpdateTextCallback->Delete();
+  this->ConnectorConnectedCallback->SetClientData(nullptr);
+  this->ConnectorConnectedCallback->Delete();
+  this->SetConnectorWakeUpCallback(nullptr, nullptr);
 }
 
 //----------------------------------------------------------------------------
@@ -115,6 +168,11 @@ void vtkSlicerCollaborationLogic
     vtkErrorMacro("OnMRMLSceneNodeAdded: Invalid MRML scene or input node!");
     return;
   }
+  // the first pose received from a participant that joined the session shows its avatar
+  if (node->IsA("vtkMRMLLinearTransformNode"))
+  {
+    this->updateParticipantAvatar(node);
+  }
   if (node->IsA("vtkMRMLCollaborationNode"))
   {
     // Check if a ConnectorNode for the new CollaborationNode exists
@@ -138,10 +196,11 @@ void vtkSlicerCollaborationLogic
       //collaborationNode->connectorNodeID = connectorNodeID;
       collaborationNode->SetCollaborationConnectorNodeID(connectorNodeID);
       connectorNode->SetType(0);
+      connectorNode->SetContentCacheDirectory(this->DefaultContentCacheDirectory.c_str());
     }
     this->Modified();
   }
-  else if (node->IsA("vtkMRMLModelNode") || node->IsA("vtkMRMLLinearTransformNode") || node->IsA("vtkMRMLMarkupsNode") || node->IsA("vtkMRMLTextNode") || node->IsA("vtkMRMLScalarVolumeNode"))
+  else if (vtkCollaborationNodeCodec::GetCodecOfNode(node) && vtkCollaborationNodeCodec::GetCodecOfNode(node)->IsSelectable())
   {
     // fiducials do not include the description of "Received by OpenIGTLink"
     if (node->IsA("vtkMRMLMarkupsFiducialNode") && this->collaborationNodeSelected)
@@ -149,9 +208,8 @@ void vtkSlicerCollaborationLogic
       const char* connectorNodeID = this->collaborationNodeSelected->GetCollaborationConnectorNodeID();
       vtkMRMLCollaborationConnectorNode* connectorNode =
         vtkMRMLCollaborationConnectorNode::SafeDownCast(this->GetMRMLScene()->GetNodeByID(connectorNodeID));
-      int state = connectorNode->GetState();
       // if connection is active, we are assuming it was received through OpenIGTLink
-      if (state == 2)
+      if (connectorNode->IsSessionConnected())
       {
         node->SetDescription("Received by OpenIGTLink");
       }
@@ -169,75 +227,107 @@ void vtkSlicerCollaborationLogic
         {
           this->collaborationNodeSelected->AddCollaborationSynchronizedNodeID(node->GetID());
         }
-        // update transforms
-        // get transformed nodes
-        vtkStringArray* collection = this->collaborationNodeSelected->GetCollaborationSynchronizedNodeIDs();
-        std::string transformedNodesText = "";
-        for (int i = 0; i < collection->GetNumberOfTuples(); i++)
+        // the new node may be transformed by one of the received transforms
+        vtkMRMLCollaborationConnectorNode* connectorNode =
+          this->collaborationNodeSelected ? this->collaborationNodeSelected->GetCollaborationConnectorNode() : nullptr;
+        if (connectorNode)
         {
-          std::string ID = collection->GetValue(i);
-          vtkMRMLNode* node = vtkMRMLNode::SafeDownCast(this->GetMRMLScene()->GetNodeByID(ID));
-          if (node->IsA("vtkMRMLLinearTransformNode"))
-          {
-            const char* textNodeReferenceID = node->GetNthNodeReferenceID("TextNode", 0);
-            vtkMRMLTextNode* transformTextNode =
-              vtkMRMLTextNode::SafeDownCast(this->GetMRMLScene()->GetNodeByID(textNodeReferenceID));
-            if (transformTextNode)
-            {
-              std::stringstream ss;
-              ss << transformTextNode->GetText();
-              vtkXMLDataElement* res =
-                vtkXMLUtilities::ReadElementFromStream(ss);
-              this->orderTransforms(res);
-            }
-          }
+          connectorNode->UpdateReceivedTransforms();
         }
       }
     }
   }
+  else if (node->IsA("vtkMRMLCollaborationConnectorNode"))
+  {
+    // send the synchronization metadata when the connection is established, and to the participants joining a relay hub
+    node->AddObserver(vtkMRMLIGTLConnectorNode::ConnectedEvent, this->ConnectorConnectedCallback);
+    node->AddObserver(vtkMRMLCollaborationConnectorNode::ParticipantJoinedEvent, this->ConnectorConnectedCallback);
+    vtkMRMLCollaborationConnectorNode::SafeDownCast(node)->SetWakeUpCallback(
+      this->ConnectorWakeUpCallback, this->ConnectorWakeUpClientData);
+  }
 }
 
-//----------------------------------------------------------------------------
-void vtkSlicerCollaborationLogic::orderTransforms(vtkXMLDataElement* res)
+//---------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::CallConnectorTimerHandler()
 {
-  // read attributes
-  int numberOfAttributes = res->GetNumberOfAttributes();
-  std::vector<const char*> atts_v;
-  for (int attributeIndex = 0; attributeIndex < numberOfAttributes; attributeIndex++)
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene)
   {
-    const char* attName = res->GetAttributeName(attributeIndex);
-    const char* attValue = res->GetAttribute(attName);
-    atts_v.push_back(attName);
-    atts_v.push_back(attValue);
+    return;
   }
-  atts_v.push_back(nullptr);
-  const char** atts = (atts_v.data());
+  std::vector<vtkMRMLNode*> connectorNodes;
+  scene->GetNodesByClass("vtkMRMLCollaborationConnectorNode", connectorNodes);
+  for (vtkMRMLNode* node : connectorNodes)
+  {
+    vtkMRMLCollaborationConnectorNode* connectorNode = vtkMRMLCollaborationConnectorNode::SafeDownCast(node);
+    if (connectorNode)
+    {
+      connectorNode->ProcessPendingTasks();
+    }
+  }
+}
 
-  // get transform node
-  std::string transformName = res->GetAttribute("TransformName");
-  vtkMRMLLinearTransformNode* transformNode =
-    vtkMRMLLinearTransformNode::SafeDownCast(this->GetMRMLScene()->GetFirstNodeByName(transformName.c_str()));
+//---------------------------------------------------------------------------
+bool vtkSlicerCollaborationLogic::IsConnectorProcessingNeeded()
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene)
+  {
+    return false;
+  }
+  std::vector<vtkMRMLNode*> connectorNodes;
+  scene->GetNodesByClass("vtkMRMLCollaborationConnectorNode", connectorNodes);
+  for (vtkMRMLNode* node : connectorNodes)
+  {
+    vtkMRMLCollaborationConnectorNode* connectorNode = vtkMRMLCollaborationConnectorNode::SafeDownCast(node);
+    if (connectorNode && connectorNode->IsProcessingNeeded())
+    {
+      return true;
+    }
+  }
+  return false;
+}
 
-  // get transformed nodes attribute
-  std::string transformedNodesStr = res->GetAttribute("TransformedNodes");
+//---------------------------------------------------------------------------
+double vtkSlicerCollaborationLogic::GetConnectorProcessingInterval()
+{
+  double interval = VTK_DOUBLE_MAX;
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene)
+  {
+    return interval;
+  }
+  std::vector<vtkMRMLNode*> connectorNodes;
+  scene->GetNodesByClass("vtkMRMLCollaborationConnectorNode", connectorNodes);
+  for (vtkMRMLNode* node : connectorNodes)
+  {
+    vtkMRMLCollaborationConnectorNode* connectorNode = vtkMRMLCollaborationConnectorNode::SafeDownCast(node);
+    if (connectorNode && connectorNode->IsProcessingNeeded())
+    {
+      interval = std::min(interval, connectorNode->GetProcessingInterval());
+    }
+  }
+  return interval;
+}
 
-  // get every coordinate
-  std::stringstream ss(transformedNodesStr);
-  std::vector<std::string> vect;
-  while (ss.good())
+//---------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::SetConnectorWakeUpCallback(void (*callback)(void* clientData), void* clientData)
+{
+  this->ConnectorWakeUpCallback = callback;
+  this->ConnectorWakeUpClientData = clientData;
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene)
   {
-    std::string substr;
-    getline(ss, substr, ',');
-    vect.push_back(substr);
+    return;
   }
-  int numberOfTransformedNodes = vect.size();
-  for (int i = 0; i < numberOfTransformedNodes; i++)
+  std::vector<vtkMRMLNode*> connectorNodes;
+  scene->GetNodesByClass("vtkMRMLCollaborationConnectorNode", connectorNodes);
+  for (vtkMRMLNode* node : connectorNodes)
   {
-    vtkMRMLTransformableNode* node =
-      vtkMRMLTransformableNode::SafeDownCast(this->GetMRMLScene()->GetFirstNodeByName(vect[i].c_str()));
-    if (node)
+    vtkMRMLCollaborationConnectorNode* connectorNode = vtkMRMLCollaborationConnectorNode::SafeDownCast(node);
+    if (connectorNode)
     {
-      node->SetAndObserveTransformNodeID(transformNode->GetID());
+      connectorNode->SetWakeUpCallback(callback, clientData);
     }
   }
 }
@@ -260,39 +350,739 @@ void vtkSlicerCollaborationLogic
       vtkMRMLCollaborationConnectorNode::SafeDownCast(this->GetMRMLScene()->GetNodeByID(connectorNodeID));
     this->GetMRMLScene()->RemoveNode(connectorNode);
     collaborationNode->SetCollaborationConnectorNodeID(nullptr);
+    // the codecs forget what they sent to the peers of the collaboration node
+    auto storeIt = this->SynchronizationMetadata.find(collaborationNode->GetID());
+    if (storeIt != this->SynchronizationMetadata.end())
+    {
+      for (const std::pair<const std::string, SynchronizationMetadataItem>& metadata : storeIt->second)
+      {
+        vtkMRMLNode* synchronizedNode = this->GetMRMLScene()->GetNodeByID(metadata.second.NodeID);
+        vtkCollaborationNodeCodec* codec = vtkCollaborationNodeCodec::GetCodecOfNode(synchronizedNode);
+        if (codec)
+        {
+          codec->ResetNode(synchronizedNode, collaborationNode);
+        }
+      }
+      this->SynchronizationMetadata.erase(storeIt);
+    }
     this->Modified();
   }
+  else if (node->IsA("vtkMRMLCollaborationConnectorNode"))
+  {
+    node->RemoveObserver(this->ConnectorConnectedCallback);
+    vtkMRMLCollaborationConnectorNode::SafeDownCast(node)->SetWakeUpCallback(nullptr, nullptr);
+  }
+  else
+  {
+    // the relay hubs forget the removed synchronized node
+    std::vector<vtkMRMLNode*> collaborationNodes;
+    this->GetMRMLScene()->GetNodesByClass("vtkMRMLCollaborationNode", collaborationNodes);
+    for (vtkMRMLNode* collaborationNode : collaborationNodes)
+    {
+      vtkMRMLCollaborationConnectorNode* connectorNode =
+        vtkMRMLCollaborationNode::SafeDownCast(collaborationNode)->GetCollaborationConnectorNode();
+      if (connectorNode && collaborationNode->GetID() && node->GetAttribute(collaborationNode->GetID()))
+      {
+        connectorNode->NotifyNodeRemoved(node);
+      }
+    }
+  }
 }
 
 //----------------------------------------------------------------------------
 void vtkSlicerCollaborationLogic::loadAvatars()
 {
-  // get directory
-  std::string moduleShareDirectory = this->GetModuleShareDirectory();
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene)
+  {
+    vtkErrorMacro("loadAvatars: Invalid MRML scene!");
+    return;
+  }
+
+  // Bind the avatar to the transforms of the VR hardware
+  vtkMRMLNode* transformHeadNode = scene->GetFirstNodeByName("VirtualReality.HMD");
+  vtkMRMLNode* transformHandLNode = scene->GetFirstNodeByName("VirtualReality.LeftController");
+  vtkMRMLNode* transformHandRNode = scene->GetFirstNodeByName("VirtualReality.RightController");
+  double color[3] = { 1.0, 1.0, 1.0 };
+  this->AddParticipantAvatar(AVATAR_LOCAL_PARTICIPANT_NAME,
+    transformHeadNode ? transformHeadNode->GetID() : nullptr,
+    transformHandLNode ? transformHandLNode->GetID() : nullptr,
+    transformHandRNode ? transformHandRNode->GetID() : nullptr,
+    color);
+}
+
+//----------------------------------------------------------------------------
+vtkPolyData* vtkSlicerCollaborationLogic::GetAvatarMesh(const char* avatarModelName)
+{
+  if (!avatarModelName)
+  {
+    return nullptr;
+  }
+  auto meshIt = this->AvatarMeshes.find(avatarModelName);
+  if (meshIt != this->AvatarMeshes.end())
+  {
+    return meshIt->second;
+  }
+
+  // Read the mesh only once, the models of all participants share it
+  std::string modelFilePath = this->GetModuleShareDirectory() + "/" + avatarModelName + ".stl";
+  vtkNew<vtkSTLReader> reader;
+  reader->SetFileName(modelFilePath.c_str());
+  reader->Update();
+  if (reader->GetErrorCode() != 0 || !reader->GetOutput() || reader->GetOutput()->GetNumberOfPoints() == 0)
+  {
+    vtkErrorMacro("GetAvatarMesh: Failed to read avatar model " << modelFilePath);
+    return nullptr;
+  }
+  vtkSmartPointer<vtkPolyData> mesh = reader->GetOutput();
+  this->AvatarMeshes[avatarModelName] = mesh;
+  return mesh;
+}
+
+//----------------------------------------------------------------------------
+bool vtkSlicerCollaborationLogic::AddParticipantAvatar(const char* participantName, const char* headTransformNodeID,
+  const char* leftHandTransformNodeID, const char* rightHandTransformNodeID, double color[3])
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene || !participantName)
+  {
+    vtkErrorMacro("AddParticipantAvatar: Invalid MRML scene or participant name!");
+    return false;
+  }
+  // Replace the previous avatar of the participant
+  this->RemoveParticipantAvatar(participantName);
+
+  const char* avatarModelNames[3] = { AVATAR_HEAD_MODEL_NAME, AVATAR_HANDPOINTL_MODEL_NAME, AVATAR_HANDPOINTR_MODEL_NAME };
+  const char* transformNodeIDs[3] = { headTransformNodeID, leftHandTransformNodeID, rightHandTransformNodeID };
+  bool success = true;
+  for (int componentIndex = 0; componentIndex < 3; componentIndex++)
+  {
+    vtkPolyData* mesh = this->GetAvatarMesh(avatarModelNames[componentIndex]);
+    if (!mesh)
+    {
+      success = false;
+      continue;
+    }
+    vtkSmartPointer<vtkMRMLModelNode> modelNode = vtkSmartPointer<vtkMRMLModelNode>::Take(
+      vtkMRMLModelNode::SafeDownCast(scene->CreateNodeByClass("vtkMRMLModelNode")));
+    // the models of the local participant keep the names they had before the avatars of several participants
+    std::string modelName = (strcmp(participantName, AVATAR_LOCAL_PARTICIPANT_NAME) == 0) ? std::string(avatarModelNames[componentIndex])
+      : std::string(participantName) + "_" + avatarModelNames[componentIndex];
+    modelNode->SetName(modelName.c_str());
+    modelNode->SetAttribute(AVATAR_PARTICIPANT_ATTRIBUTE_NAME, participantName);
+    modelNode->SetSaveWithScene(false);
+    // each model gets its own polydata sharing the points, cells and arrays of the mesh read once. Hardening the
+    // transform of a model replaces the data of its own polydata, not of the shared mesh.
+    vtkNew<vtkPolyData> modelMesh;
+    modelMesh->ShallowCopy(mesh);
+    modelNode->SetAndObservePolyData(modelMesh);
+    scene->AddNode(modelNode);
+    modelNode->CreateDefaultDisplayNodes();
+    vtkMRMLDisplayNode* displayNode = modelNode->GetDisplayNode();
+    if (displayNode)
+    {
+      displayNode->SetColor(color);
+      displayNode->SetSaveWithScene(false);
+    }
+    if (transformNodeIDs[componentIndex] && scene->GetNodeByID(transformNodeIDs[componentIndex]))
+    {
+      modelNode->SetAndObserveTransformNodeID(transformNodeIDs[componentIndex]);
+    }
+  }
+  return success;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::updateParticipantAvatar(vtkMRMLNode* transformNode)
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  int componentIndex = -1;
+  std::string participantName = GetAvatarParticipantName(transformNode ? transformNode->GetName() : nullptr, componentIndex);
+  // only the pose nodes received from the peers, named after their participant ID, are avatars. The avatar of the
+  // local headset is loaded on request, and its pose nodes sent to the peers have none.
+  std::string posePrefix = vtkMRMLCollaborationConnectorNode::ParticipantPoseNamePrefix;
+  if (!scene || participantName.size() <= posePrefix.size() || participantName.compare(0, posePrefix.size(), posePrefix) != 0
+    || transformNode->GetAttribute(vtkMRMLCollaborationConnectorNode::ParticipantPoseAttributeName))
+  {
+    return;
+  }
 
-  // Create a models logic for convenient loading of components
-  vtkSlicerModelsLogic* modelsLogic = vtkSlicerModelsLogic::New();
-  modelsLogic->SetMRMLScene(this->GetMRMLScene());
+  // a participant that already has an avatar only binds the model of the transform
+  const char* avatarModelNames[3] = { AVATAR_HEAD_MODEL_NAME, AVATAR_HANDPOINTL_MODEL_NAME, AVATAR_HANDPOINTR_MODEL_NAME };
+  std::string modelName = participantName + "_" + avatarModelNames[componentIndex];
+  bool hasAvatar = false;
+  std::vector<vtkMRMLNode*> modelNodes;
+  scene->GetNodesByClass("vtkMRMLModelNode", modelNodes);
+  for (vtkMRMLNode* node : modelNodes)
+  {
+    const char* avatarParticipant = node->GetAttribute(AVATAR_PARTICIPANT_ATTRIBUTE_NAME);
+    if (!avatarParticipant || participantName != avatarParticipant)
+    {
+      continue;
+    }
+    hasAvatar = true;
+    vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(node);
+    if (modelNode && modelNode->GetName() && modelName == modelNode->GetName())
+    {
+      modelNode->SetAndObserveTransformNodeID(transformNode->GetID());
+    }
+  }
+  if (hasAvatar)
+  {
+    return;
+  }
 
-  // Load basic additional device models
+  // each participant gets a color of the palette
+  const double participantColors[6][3] = { { 0.9, 0.3, 0.3 }, { 0.3, 0.6, 0.9 }, { 0.4, 0.8, 0.4 },
+    { 0.9, 0.7, 0.2 }, { 0.7, 0.4, 0.9 }, { 0.9, 0.5, 0.7 } };
+  size_t colorIndex = std::hash<std::string>()(participantName) % 6;
+  double color[3] = { participantColors[colorIndex][0], participantColors[colorIndex][1], participantColors[colorIndex][2] };
+  std::string transformNodeIDs[3];
+  for (int index = 0; index < 3; index++)
+  {
+    vtkMRMLNode* participantTransformNode = scene->GetFirstNodeByName(
+      (participantName + AVATAR_TRANSFORM_NAME_SUFFIXES[index]).c_str());
+    if (participantTransformNode && participantTransformNode->GetID())
+    {
+      transformNodeIDs[index] = participantTransformNode->GetID();
+    }
+  }
+  this->AddParticipantAvatar(participantName.c_str(),
+    transformNodeIDs[0].empty() ? nullptr : transformNodeIDs[0].c_str(),
+    transformNodeIDs[1].empty() ? nullptr : transformNodeIDs[1].c_str(),
+    transformNodeIDs[2].empty() ? nullptr : transformNodeIDs[2].c_str(),
+    color);
+}
 
-  // Head
-  std::string headModelFilePath = moduleShareDirectory + "/" + AVATAR_HEAD_MODEL_NAME + ".stl";
-  vtkMRMLModelNode* headModelNode = modelsLogic->AddModel(headModelFilePath.c_str());
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::addParticipantAvatars()
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene)
+  {
+    return;
+  }
+  std::vector<vtkMRMLNode*> transformNodes;
+  scene->GetNodesByClass("vtkMRMLLinearTransformNode", transformNodes);
+  for (vtkMRMLNode* transformNode : transformNodes)
+  {
+    this->updateParticipantAvatar(transformNode);
+  }
+}
 
-  // Left hand
-  std::string handPointLModelFilePath = moduleShareDirectory + "/" + AVATAR_HANDPOINTL_MODEL_NAME + ".stl";
-  vtkMRMLModelNode* handPointLModelNode = modelsLogic->AddModel(handPointLModelFilePath.c_str());
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::RemoveParticipantAvatar(const char* participantName)
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!scene || !participantName)
+  {
+    return;
+  }
+  std::vector<vtkMRMLNode*> modelNodes;
+  scene->GetNodesByClass("vtkMRMLModelNode", modelNodes);
+  for (vtkMRMLNode* modelNode : modelNodes)
+  {
+    const char* avatarParticipant = modelNode->GetAttribute(AVATAR_PARTICIPANT_ATTRIBUTE_NAME);
+    if (avatarParticipant && strcmp(avatarParticipant, participantName) == 0)
+    {
+      scene->RemoveNode(modelNode);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// Synchronization engine
+
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::SynchronizeNodes(vtkMRMLCollaborationNode* collabNode, vtkStringArray* nodeIDs)
+{
+  if (!collabNode || !nodeIDs || !this->GetMRMLScene())
+  {
+    vtkErrorMacro("SynchronizeNodes: Invalid collaboration node, node IDs or MRML scene!");
+    return;
+  }
+  vtkIdType numberOfNodes = nodeIDs->GetNumberOfValues();
+  this->StartBulkSynchronization(collabNode, numberOfNodes >= BatchProcessMinimumNumberOfNodes);
+  for (vtkIdType nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
+  {
+    this->SynchronizeNode(collabNode, this->GetMRMLScene()->GetNodeByID(nodeIDs->GetValue(nodeIndex)));
+    this->updateBulkSynchronizationProgress(nodeIndex + 1, numberOfNodes);
+  }
+  this->EndBulkSynchronization(collabNode);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::UnsynchronizeNodes(vtkMRMLCollaborationNode* collabNode, vtkStringArray* nodeIDs)
+{
+  if (!collabNode || !nodeIDs || !this->GetMRMLScene())
+  {
+    vtkErrorMacro("UnsynchronizeNodes: Invalid collaboration node, node IDs or MRML scene!");
+    return;
+  }
+  vtkIdType numberOfNodes = nodeIDs->GetNumberOfValues();
+  this->StartBulkSynchronization(collabNode, numberOfNodes >= BatchProcessMinimumNumberOfNodes);
+  for (vtkIdType nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
+  {
+    this->UnsynchronizeNode(collabNode, this->GetMRMLScene()->GetNodeByID(nodeIDs->GetValue(nodeIndex)));
+    this->updateBulkSynchronizationProgress(nodeIndex + 1, numberOfNodes);
+  }
+  this->EndBulkSynchronization(collabNode);
+}
 
-  // Right hand
-  std::string handPointRModelFilePath = moduleShareDirectory + "/" + AVATAR_HANDPOINTR_MODEL_NAME + ".stl";
-  vtkMRMLModelNode* handPointRModelNode = modelsLogic->AddModel(handPointRModelFilePath.c_str());
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::StartBulkSynchronization(vtkMRMLCollaborationNode* collabNode, bool batchProcessScene)
+{
+  if (this->BulkSynchronizationLevel++ > 0)
+  {
+    return;
+  }
+  // the scene and the collaboration node notify their observers once at the end
+  this->BulkSynchronizationBatchProcessScene = batchProcessScene;
+  if (batchProcessScene)
+  {
+    this->GetMRMLScene()->StartState(vtkMRMLScene::BatchProcessState);
+  }
+  this->BulkSynchronizationWasModifying = collabNode->StartModify();
+}
 
-  // Apply transforms
-  vtkMRMLLinearTransformNode* transformHeadNode = vtkMRMLLinearTransformNode::SafeDownCast(this->GetMRMLScene()->GetFirstNodeByName("VirtualReality.HMD"));
-  headModelNode->SetAndObserveTransformNodeID(transformHeadNode->GetID());
-  vtkMRMLLinearTransformNode* transformHandLNode = vtkMRMLLinearTransformNode::SafeDownCast(this->GetMRMLScene()->GetFirstNodeByName("VirtualReality.LeftController"));
-  handPointLModelNode->SetAndObserveTransformNodeID(transformHandLNode->GetID());
-  vtkMRMLLinearTransformNode* transformHandRNode = vtkMRMLLinearTransformNode::SafeDownCast(this->GetMRMLScene()->GetFirstNodeByName("VirtualReality.RightController"));
-  handPointRModelNode->SetAndObserveTransformNodeID(transformHandRNode->GetID());
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::EndBulkSynchronization(vtkMRMLCollaborationNode* collabNode)
+{
+  if (this->BulkSynchronizationLevel == 0 || --this->BulkSynchronizationLevel > 0)
+  {
+    return;
+  }
+  // update the metadata once, now that all the synchronized nodes are known
+  std::set<std::string> nodeIDs;
+  nodeIDs.swap(this->DeferredMetadataUpdates);
+  for (const std::string& nodeID : nodeIDs)
+  {
+    vtkMRMLNode* node = this->GetMRMLScene()->GetNodeByID(nodeID);
+    if (node)
+    {
+      this->updateNodeMetadata(collabNode, node);
+    }
+  }
+  collabNode->EndModify(this->BulkSynchronizationWasModifying);
+  if (this->BulkSynchronizationBatchProcessScene)
+  {
+    this->GetMRMLScene()->EndState(vtkMRMLScene::BatchProcessState);
+  }
+
+  // initial push of all the synchronized nodes in one go, in the priority order of their codecs
+  std::vector<std::pair<std::string, bool> > deferredPushes;
+  deferredPushes.swap(this->DeferredPushes);
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  auto pushPriority = [scene](const std::pair<std::string, bool>& deferredPush)
+  {
+    vtkCollaborationNodeCodec* codec = vtkCollaborationNodeCodec::GetCodecOfNode(scene->GetNodeByID(deferredPush.first));
+    return codec ? codec->GetPriority() : 0;
+  };
+  std::stable_sort(deferredPushes.begin(), deferredPushes.end(),
+    [&pushPriority](const std::pair<std::string, bool>& push1, const std::pair<std::string, bool>& push2)
+    { return pushPriority(push1) > pushPriority(push2); });
+  vtkMRMLCollaborationConnectorNode* connectorNode = collabNode->GetCollaborationConnectorNode();
+  for (const std::pair<std::string, bool>& deferredPush : deferredPushes)
+  {
+    this->pushNode(connectorNode, this->GetMRMLScene()->GetNodeByID(deferredPush.first), deferredPush.second);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::updateBulkSynchronizationProgress(vtkIdType processedNodes, vtkIdType numberOfNodes)
+{
+  // report progress in 1% steps
+  if (numberOfNodes <= 0 || (processedNodes * 100 / numberOfNodes) == ((processedNodes - 1) * 100 / numberOfNodes))
+  {
+    return;
+  }
+  double progress = static_cast<double>(processedNodes) / numberOfNodes;
+  this->InvokeEvent(vtkCommand::ProgressEvent, &progress);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::pushNode(vtkMRMLCollaborationConnectorNode* connectorNode, vtkMRMLNode* node, bool offer)
+{
+  if (!connectorNode || !node)
+  {
+    return;
+  }
+  if (this->BulkSynchronizationLevel > 0)
+  {
+    this->DeferredPushes.push_back(std::make_pair(std::string(node->GetID()), offer));
+    return;
+  }
+  if (offer)
+  {
+    connectorNode->OfferNode(node);
+  }
+  else
+  {
+    connectorNode->SendNode(node);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::SynchronizeNode(vtkMRMLCollaborationNode* collabNode, vtkMRMLNode* selectedNode)
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!collabNode || !selectedNode || !scene)
+  {
+    vtkErrorMacro("SynchronizeNode: Invalid collaboration node, node or MRML scene!");
+    return;
+  }
+  // Get the connector node associated to the collaboration node
+  vtkMRMLCollaborationConnectorNode* connectorNode = collabNode->GetCollaborationConnectorNode();
+  if (!connectorNode)
+  {
+    vtkErrorMacro("SynchronizeNode: Failed to find connector node for collaboration node " << collabNode->GetName());
+    return;
+  }
+  vtkCollaborationNodeCodec* codec = vtkCollaborationNodeCodec::GetCodecOfNode(selectedNode);
+  if (!codec)
+  {
+    vtkErrorMacro("SynchronizeNode: Nodes of class " << selectedNode->GetClassName() << " cannot be synchronized");
+    return;
+  }
+  const char* selectedCollaborationNode = collabNode->GetID();
+  MRMLNodeModifyBlocker blocker(selectedNode);
+
+  // set attribute of the collaboration node to the selected node
+  selectedNode->SetAttribute(selectedCollaborationNode, "true");
+  // add node reference to the collaboration node
+  collabNode->AddCollaborationSynchronizedNodeID(selectedNode->GetID());
+  // content that may be in the cache of the peer is offered instead of pushed on connect, and large volumes are streamed.
+  // The local VR transforms are offered as the pose nodes of the participant.
+  if (connectorNode->IsNodeContentOffered(selectedNode) || connectorNode->IsVolumeStreamed(selectedNode)
+    || vtkMRMLCollaborationConnectorNode::IsLocalPoseNode(selectedNode))
+  {
+    selectedNode->SetAttribute(vtkMRMLCollaborationConnectorNode::OfferOnConnectAttributeName, "true");
+  }
+  else
+  {
+    selectedNode->SetAttribute("OpenIGTLinkIF.pushOnConnect", "true");
+  }
+  if (codec->IsPushed())
+  {
+    // add as output node of the connector node
+    connectorNode->RegisterOutgoingMRMLNode(selectedNode);
+    this->pushNode(connectorNode, selectedNode, true);
+  }
+  // check if it observes a transform node and update it
+  vtkMRMLNode* observedTransformNode = vtkMRMLNode::SafeDownCast(selectedNode->GetNodeReference("transform"));
+  if (observedTransformNode)
+  {
+    this->updateNodeMetadata(collabNode, observedTransformNode);
+    selectedNode->AddObserver(vtkMRMLTransformableNode::TransformModifiedEvent, this->UpdateTextCallback);
+  }
+
+  // keep the metadata describing the node and its display, updated when they are modified
+  if (codec->GetMetadataType() && codec->GetModifiedEvent() != vtkCommand::NoEvent)
+  {
+    selectedNode->AddObserver(codec->GetModifiedEvent(), this->UpdateTextCallback);
+  }
+  vtkMRMLDisplayableNode* displayableNode = vtkMRMLDisplayableNode::SafeDownCast(selectedNode);
+  vtkMRMLDisplayNode* displayNode = displayableNode ? displayableNode->GetDisplayNode() : nullptr;
+  vtkCollaborationNodeCodec* displayCodec = vtkCollaborationNodeCodec::GetCodecOfNode(displayNode);
+  if (displayCodec && displayCodec->GetMetadataType() && displayCodec->GetModifiedEvent() != vtkCommand::NoEvent)
+  {
+    displayNode->AddObserver(displayCodec->GetModifiedEvent(), this->UpdateTextCallback);
+  }
+  this->updateNodeMetadata(collabNode, selectedNode);
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::UnsynchronizeNode(vtkMRMLCollaborationNode* collabNode, vtkMRMLNode* selectedNode)
+{
+  vtkMRMLScene* scene = this->GetMRMLScene();
+  if (!collabNode || !selectedNode || !scene)
+  {
+    vtkErrorMacro("UnsynchronizeNode: Invalid collaboration node, node or MRML scene!");
+    return;
+  }
+  // Get the connector node associated to the collaboration node
+  vtkMRMLCollaborationConnectorNode* connectorNode = collabNode->GetCollaborationConnectorNode();
+  if (!connectorNode)
+  {
+    vtkErrorMacro("UnsynchronizeNode: Failed to find connector node for collaboration node " << collabNode->GetName());
+    return;
+  }
+  const char* selectedCollaborationNode = collabNode->GetID();
+  MRMLNodeModifyBlocker blocker(selectedNode);
+
+  // remove the attribute of the collaboration node from the selected node
+  selectedNode->RemoveAttribute(selectedCollaborationNode);
+  // remove node reference from the collaboration node
+  collabNode->RemoveCollaborationSynchronizedNodeID(selectedNode->GetID());
+  // remove as output node of the connector node
+  connectorNode->UnregisterOutgoingMRMLNode(selectedNode);
+  connectorNode->NotifyNodeRemoved(selectedNode);
+  // remove observer to transforms
+  selectedNode->RemoveObserver(this->UpdateTextCallback);
+  selectedNode->RemoveAttribute("OpenIGTLinkIF.pushOnConnect");
+  selectedNode->RemoveAttribute(vtkMRMLCollaborationConnectorNode::OfferOnConnectAttributeName);
+  // check if it observes a synched transform node and update it
+  vtkMRMLNode* observedTransformNode = vtkMRMLNode::SafeDownCast(selectedNode->GetNodeReference("transform"));
+  if (observedTransformNode && observedTransformNode->GetAttribute(selectedCollaborationNode))
+  {
+    this->updateNodeMetadata(collabNode, observedTransformNode);
+  }
+  // forget the synchronization metadata of the node
+  vtkMRMLDisplayableNode* displayableNode = vtkMRMLDisplayableNode::SafeDownCast(selectedNode);
+  if (displayableNode && displayableNode->GetDisplayNode())
+  {
+    displayableNode->GetDisplayNode()->RemoveObserver(this->UpdateTextCallback);
+  }
+  this->removeSynchronizationMetadata(collabNode, selectedNode);
+  vtkCollaborationNodeCodec* codec = vtkCollaborationNodeCodec::GetCodecOfNode(selectedNode);
+  if (codec)
+  {
+    codec->ResetNode(selectedNode, collabNode);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::SendSynchronizedNodes(vtkMRMLCollaborationNode* collabNode)
+{
+  if (!collabNode)
+  {
+    return;
+  }
+  // Get the connector node associated to the collaboration node
+  vtkMRMLCollaborationConnectorNode* connectorNode = collabNode->GetCollaborationConnectorNode();
+  if (!connectorNode)
+  {
+    vtkErrorMacro("SendSynchronizedNodes: Failed to find connector node for collaboration node " << collabNode->GetName());
+    return;
+  }
+  vtkSmartPointer<vtkCollection> syncNodes = vtkSmartPointer<vtkCollection>::Take(collabNode->GetCollaborationSynchronizedNodes());
+  int numNodes = syncNodes->GetNumberOfItems();
+  for (int nodeIndex = numNodes - 1; nodeIndex >= 0; nodeIndex--)
+  {
+    vtkMRMLNode* syncNode = vtkMRMLNode::SafeDownCast(syncNodes->GetItemAsObject(nodeIndex));
+    connectorNode->OfferNode(syncNode);
+  }
+}
+
+//----------------------------------------------------------------------------
+std::string vtkSlicerCollaborationLogic::getSynchronizationMetadataKey(vtkMRMLNode* node, const char* metadataType)
+{
+  return std::string(node->GetID()) + "/" + metadataType;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::setSynchronizationMetadata(vtkMRMLCollaborationNode* collabNode, const std::string& key,
+  vtkCollaborationNodeCodec* codec, vtkMRMLNode* node, const std::string& text)
+{
+  SynchronizationMetadataItem& item = this->SynchronizationMetadata[collabNode->GetID()][key];
+  std::string delta;
+  bool changed = codec->ComputeDelta(node, collabNode, item.Text, text, delta);
+  item.Text = text;
+  item.NodeID = node->GetID() ? node->GetID() : "";
+  item.Priority = codec->GetPriority();
+  // while disconnected, the metadata is only stored and it is sent when the connection is established
+  vtkMRMLCollaborationConnectorNode* connectorNode = collabNode->GetCollaborationConnectorNode();
+  if (changed && connectorNode && connectorNode->IsSessionConnected())
+  {
+    // a newer state of the node replaces the one that is still waiting to be delivered
+    connectorNode->SendChannelMessage(vtkMRMLCollaborationConnectorNode::SynchronizationChannelName, delta.c_str(),
+      codec->IsDeltaLatestValueWins() ? key.c_str() : nullptr);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::removeSynchronizationMetadata(vtkMRMLCollaborationNode* collabNode, vtkMRMLNode* node)
+{
+  auto storeIt = this->SynchronizationMetadata.find(collabNode->GetID());
+  if (storeIt == this->SynchronizationMetadata.end())
+  {
+    return;
+  }
+  // all the metadata keys of the node start with its ID
+  std::string prefix = std::string(node->GetID()) + "/";
+  std::map<std::string, SynchronizationMetadataItem>& store = storeIt->second;
+  auto metadataIt = store.lower_bound(prefix);
+  while (metadataIt != store.end() && metadataIt->first.compare(0, prefix.size(), prefix) == 0)
+  {
+    metadataIt = store.erase(metadataIt);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::sendSynchronizationMetadata(vtkMRMLCollaborationNode* collabNode)
+{
+  vtkMRMLCollaborationConnectorNode* connectorNode = collabNode->GetCollaborationConnectorNode();
+  auto storeIt = this->SynchronizationMetadata.find(collabNode->GetID());
+  if (!connectorNode || storeIt == this->SynchronizationMetadata.end())
+  {
+    return;
+  }
+  // in the priority order of the codecs, so that the receiver can apply the metadata as soon as possible
+  typedef std::pair<const std::string, SynchronizationMetadataItem> MetadataEntry;
+  std::vector<MetadataEntry*> entries;
+  for (MetadataEntry& metadata : storeIt->second)
+  {
+    entries.push_back(&metadata);
+  }
+  std::stable_sort(entries.begin(), entries.end(),
+    [](const MetadataEntry* entry1, const MetadataEntry* entry2) { return entry1->second.Priority > entry2->second.Priority; });
+  // the encoding depends on the peer of this connection, which may not support binary records
+  bool binary = connectorNode->IsBinaryAttributeEncodingUsed();
+  for (MetadataEntry* entry : entries)
+  {
+    SynchronizationMetadataItem& item = entry->second;
+    vtkMRMLNode* node = this->GetMRMLScene() ? this->GetMRMLScene()->GetNodeByID(item.NodeID) : nullptr;
+    vtkCollaborationNodeCodec* codec = vtkCollaborationNodeCodec::GetCodecOfNode(node);
+    if (!codec)
+    {
+      // the node was removed from the scene
+      continue;
+    }
+    item.Text = codec->Serialize(node, collabNode, binary);
+    // the codec completes the metadata for a peer that has none of it, such as the labelmaps of segmentations
+    std::string delta;
+    if (!codec->ComputeDelta(node, collabNode, std::string(), item.Text, delta))
+    {
+      delta = item.Text;
+    }
+    connectorNode->SendChannelMessage(vtkMRMLCollaborationConnectorNode::SynchronizationChannelName, delta.c_str(),
+      codec->IsDeltaLatestValueWins() ? entry->first.c_str() : nullptr);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::connectorConnected(vtkObject* caller, unsigned long vtkNotUsed(event), void* clientData, void* vtkNotUsed(callData))
+{
+  vtkSlicerCollaborationLogic* self = reinterpret_cast<vtkSlicerCollaborationLogic*>(clientData);
+  vtkMRMLCollaborationConnectorNode* connectorNode = vtkMRMLCollaborationConnectorNode::SafeDownCast(caller);
+  if (!self || !connectorNode || !connectorNode->GetID() || !self->GetMRMLScene())
+  {
+    return;
+  }
+  // the peer may be a new session, send the metadata of all the synchronized nodes
+  std::vector<vtkMRMLNode*> collaborationNodes;
+  self->GetMRMLScene()->GetNodesByClass("vtkMRMLCollaborationNode", collaborationNodes);
+  for (vtkMRMLNode* node : collaborationNodes)
+  {
+    vtkMRMLCollaborationNode* collabNode = vtkMRMLCollaborationNode::SafeDownCast(node);
+    const char* connectorNodeID = collabNode->GetCollaborationConnectorNodeID();
+    if (connectorNodeID && strcmp(connectorNodeID, connectorNode->GetID()) == 0)
+    {
+      self->sendSynchronizationMetadata(collabNode);
+    }
+  }
+  // the participants whose transforms are already in the scene, such as after a reconnection, get their avatar
+  self->addParticipantAvatars();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::RegisterNodeCodec(std::shared_ptr<vtkCollaborationNodeCodec> codec)
+{
+  vtkCollaborationNodeCodec::RegisterCodec(codec);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+std::vector<std::string> vtkSlicerCollaborationLogic::GetSynchronizableNodeClassNames()
+{
+  return vtkCollaborationNodeCodec::GetSelectableNodeClassNames();
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::updateNodeMetadata(vtkMRMLCollaborationNode* collabNode, vtkMRMLNode* node)
+{
+  if (!node->GetID())
+  {
+    return;
+  }
+  if (this->BulkSynchronizationLevel > 0)
+  {
+    // updated once at the end of the bulk synchronization
+    this->DeferredMetadataUpdates.insert(node->GetID());
+    return;
+  }
+  // only the nodes synchronized by the collaboration node are described
+  if (!node->GetAttribute(collabNode->GetID()))
+  {
+    return;
+  }
+  vtkMRMLCollaborationConnectorNode* connectorNode = collabNode->GetCollaborationConnectorNode();
+  bool binary = connectorNode && connectorNode->IsBinaryAttributeEncodingUsed();
+  vtkCollaborationNodeCodec* codec = vtkCollaborationNodeCodec::GetCodecOfNode(node);
+  if (codec && codec->GetMetadataType())
+  {
+    this->setSynchronizationMetadata(collabNode, this->getSynchronizationMetadataKey(node, codec->GetMetadataType()),
+      codec, node, codec->Serialize(node, collabNode, binary));
+  }
+  // the display node is identified by its displayable node
+  vtkMRMLDisplayableNode* displayableNode = vtkMRMLDisplayableNode::SafeDownCast(node);
+  vtkMRMLDisplayNode* displayNode = displayableNode ? displayableNode->GetDisplayNode() : nullptr;
+  vtkCollaborationNodeCodec* displayCodec = vtkCollaborationNodeCodec::GetCodecOfNode(displayNode);
+  if (displayCodec && displayCodec->GetMetadataType())
+  {
+    this->setSynchronizationMetadata(collabNode, this->getSynchronizationMetadataKey(node, displayCodec->GetMetadataType()),
+      displayCodec, displayNode, displayCodec->Serialize(displayNode, collabNode, binary));
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLCollaborationNode* vtkSlicerCollaborationLogic::getCollaborationNodeOfSynchronizedNode(vtkMRMLNode* node)
+{
+  // display nodes are synchronized with their displayable node
+  vtkMRMLDisplayNode* displayNode = vtkMRMLDisplayNode::SafeDownCast(node);
+  if (displayNode)
+  {
+    node = displayNode->GetDisplayableNode();
+  }
+  if (!node || !this->GetMRMLScene())
+  {
+    return nullptr;
+  }
+  std::vector<vtkMRMLNode*> collaborationNodes;
+  this->GetMRMLScene()->GetNodesByClass("vtkMRMLCollaborationNode", collaborationNodes);
+  for (vtkMRMLNode* collaborationNode : collaborationNodes)
+  {
+    if (node->GetAttribute(collaborationNode->GetID()))
+    {
+      return vtkMRMLCollaborationNode::SafeDownCast(collaborationNode);
+    }
+  }
+  return nullptr;
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCollaborationLogic::nodeUpdated(vtkObject* caller, unsigned long vtkNotUsed(event), void* clientData, void* vtkNotUsed(callData))
+{
+  vtkSlicerCollaborationLogic* self = reinterpret_cast<vtkSlicerCollaborationLogic*>(clientData);
+  vtkMRMLNode* updatedNode = vtkMRMLNode::SafeDownCast(caller);
+  if (!self || !updatedNode || !self->GetMRMLScene())
+  {
+    return;
+  }
+  // Get the collaboration node synchronizing the updated node
+  vtkMRMLCollaborationNode* collabNode = self->getCollaborationNodeOfSynchronizedNode(updatedNode);
+  vtkMRMLCollaborationConnectorNode* connectorNode = collabNode ? collabNode->GetCollaborationConnectorNode() : nullptr;
+  if (!connectorNode)
+  {
+    return;
+  }
+
+  // update the transformed nodes of all the transforms
+  vtkSmartPointer<vtkStringArray> collection = vtkSmartPointer<vtkStringArray>::Take(collabNode->GetCollaborationSynchronizedNodeIDs());
+  for (int i = 0; i < collection->GetNumberOfTuples(); i++)
+  {
+    vtkMRMLNode* node = self->GetMRMLScene()->GetNodeByID(collection->GetValue(i));
+    if (node && node->IsA("vtkMRMLTransformNode"))
+    {
+      self->updateNodeMetadata(collabNode, node);
+    }
+  }
+
+  // the display node metadata is stored with its displayable node
+  vtkMRMLDisplayNode* displayNode = vtkMRMLDisplayNode::SafeDownCast(updatedNode);
+  vtkMRMLNode* synchronizedNode = displayNode ? displayNode->GetDisplayableNode() : updatedNode;
+  if (synchronizedNode)
+  {
+    self->updateNodeMetadata(collabNode, synchronizedNode);
+  }
 }
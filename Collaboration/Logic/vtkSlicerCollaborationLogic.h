@@ -30,11 +30,25 @@
 #include "vtkSlicerModuleLogic.h"
 #include "vtkXMLDataElement.h"
 
+// VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
 // MRML includes
 #include "vtkMRMLCollaborationNode.h"
 
+class vtkCollaborationNodeCodec;
+class vtkMRMLCollaborationConnectorNode;
+class vtkStringArray;
+
 // STD includes
 #include <cstdlib>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+#include <string>
 
 #include "vtkSlicerCollaborationModuleLogicExport.h"
 
@@ -48,11 +62,75 @@ public:
   vtkTypeMacro(vtkSlicerCollaborationLogic, vtkSlicerModuleLogic);
   void PrintSelf(ostream& os, vtkIndent indent);
   vtkMRMLCollaborationNode* collaborationNodeSelected;
+  /// Load the avatar of the local participant, bound to the VirtualReality.* transforms
   void loadAvatars();
 
+  /// Add the avatar of a participant. The avatar meshes are read once and copied into the
+  /// models of each participant, with its transforms and color.
+  /// Transforms that are not specified or do not exist leave the corresponding model untransformed.
+  /// Returns false if the avatar meshes could not be read.
+  bool AddParticipantAvatar(const char* participantName, const char* headTransformNodeID,
+    const char* leftHandTransformNodeID, const char* rightHandTransformNodeID, double color[3]);
+  /// Remove the avatar models of a participant
+  void RemoveParticipantAvatar(const char* participantName);
+  /// Get the mesh of an avatar component, reading it on first use
+  vtkPolyData* GetAvatarMesh(const char* avatarModelName);
+
+  /// Synchronize the nodes through the connector of the collaboration node. The nodes are registered
+  /// as outgoing nodes of the connector, and the metadata describing their display, control points
+  /// and transformed nodes is sent on the synchronization channel while they are synchronized.
+  void SynchronizeNodes(vtkMRMLCollaborationNode* collabNode, vtkStringArray* nodeIDs);
+  void SynchronizeNode(vtkMRMLCollaborationNode* collabNode, vtkMRMLNode* node);
+  /// Stop synchronizing the nodes and forget their synchronization metadata
+  void UnsynchronizeNodes(vtkMRMLCollaborationNode* collabNode, vtkStringArray* nodeIDs);
+  void UnsynchronizeNode(vtkMRMLCollaborationNode* collabNode, vtkMRMLNode* node);
+  /// Synchronize or unsynchronize many nodes in one transaction. Scene and collaboration node events
+  /// are deferred until EndBulkSynchronization, which also performs the initial push of all the nodes.
+  /// SynchronizeNodes and UnsynchronizeNodes use a bulk synchronization and invoke vtkCommand::ProgressEvent
+  /// with the fraction of processed nodes as call data.
+  /// If batchProcessScene is false, the scene notifies the changes of each node, which lets the views
+  /// update only the modified items for small selections.
+  void StartBulkSynchronization(vtkMRMLCollaborationNode* collabNode, bool batchProcessScene = true);
+  void EndBulkSynchronization(vtkMRMLCollaborationNode* collabNode);
+
+  /// Send all the synchronized nodes of the collaboration node
+  void SendSynchronizedNodes(vtkMRMLCollaborationNode* collabNode);
+
+  /// Perform the pending tasks of all collaboration connector nodes in the scene.
+  /// Called by the module when a connector node requests it, and periodically while IsConnectorProcessingNeeded
+  /// returns true.
+  void CallConnectorTimerHandler();
+  /// Return true if one of the collaboration connector nodes needs its pending tasks to be performed periodically
+  bool IsConnectorProcessingNeeded();
+  /// Return the shortest processing interval of the collaboration connector nodes that need processing, in seconds
+  /// \sa vtkMRMLCollaborationConnectorNode::GetProcessingInterval
+  double GetConnectorProcessingInterval();
+  /// Set the function scheduling a call of CallConnectorTimerHandler on the main thread. It is set as wake-up
+  /// callback of all the collaboration connector nodes, and may be called from any thread.
+  /// \sa vtkMRMLCollaborationConnectorNode::SetWakeUpCallback
+  void SetConnectorWakeUpCallback(void (*callback)(void* clientData), void* clientData);
+
+  /// Register the codec of a node class, replacing the codec registered for the same class.
+  /// The nodes of the classes with a selectable codec can be synchronized.
+  void RegisterNodeCodec(std::shared_ptr<vtkCollaborationNodeCodec> codec);
+  /// Classes of the nodes that can be selected for synchronization
+  std::vector<std::string> GetSynchronizableNodeClassNames();
+
+  /// Directory of the content cache assigned to the newly created connector nodes
+  vtkSetStdStringFromCharMacro(DefaultContentCacheDirectory);
+  vtkGetCharFromStdStringMacro(DefaultContentCacheDirectory);
+
+  /// Selections of at least this number of nodes are synchronized with the scene in batch processing state
+  static const int BatchProcessMinimumNumberOfNodes;
+
   static const char* AVATAR_HEAD_MODEL_NAME;
   static const char* AVATAR_HANDPOINTL_MODEL_NAME;
   static const char* AVATAR_HANDPOINTR_MODEL_NAME;
+  /// Attribute of the avatar models containing the name of the participant
+  static const char* AVATAR_PARTICIPANT_ATTRIBUTE_NAME;
+  /// Participant of the avatar loaded by loadAvatars. Its models are named after the avatar components, such as
+  /// "head", the models of the other participants are prefixed with the participant name, such as "Participant1a2b3c_head".
+  static const char* AVATAR_LOCAL_PARTICIPANT_NAME;
 
 protected:
   vtkSlicerCollaborationLogic();
@@ -64,7 +142,61 @@ protected:
   virtual void UpdateFromMRMLScene();
   virtual void OnMRMLSceneNodeAdded(vtkMRMLNode* node);
   virtual void OnMRMLSceneNodeRemoved(vtkMRMLNode* node);
-  void orderTransforms(vtkXMLDataElement* res);
+
+  void updateBulkSynchronizationProgress(vtkIdType processedNodes, vtkIdType numberOfNodes);
+  /// Push or offer a node, deferred to the end of the bulk synchronization if there is one
+  void pushNode(vtkMRMLCollaborationConnectorNode* connectorNode, vtkMRMLNode* node, bool offer = false);
+  std::string getSynchronizationMetadataKey(vtkMRMLNode* node, const char* metadataType);
+  /// Store the synchronization metadata of a node, and send its delta computed by the codec if the connection is active
+  void setSynchronizationMetadata(vtkMRMLCollaborationNode* collabNode, const std::string& key,
+    vtkCollaborationNodeCodec* codec, vtkMRMLNode* node, const std::string& text);
+  void removeSynchronizationMetadata(vtkMRMLCollaborationNode* collabNode, vtkMRMLNode* node);
+  /// Send all the synchronization metadata of the collaboration node
+  void sendSynchronizationMetadata(vtkMRMLCollaborationNode* collabNode);
+  static void connectorConnected(vtkObject* caller, unsigned long event, void* clientData, void* callData);
+  /// Add the avatar of the participant of a head or hand transform if it has none, or bind the model of the transform.
+  /// The pose nodes of a participant are named after its participant ID, such as "Participant1a2b3c.HMD",
+  /// "Participant1a2b3c.LeftController" and "Participant1a2b3c.RightController".
+  /// \sa vtkMRMLCollaborationConnectorNode::IsLocalPoseNode
+  void updateParticipantAvatar(vtkMRMLNode* transformNode);
+  /// Add the avatars of the participants whose head or hand transforms are in the scene
+  void addParticipantAvatars();
+  /// Serialize the metadata of a synchronized node and of its display node with their codecs.
+  /// Deferred to the end of the bulk synchronization if there is one.
+  void updateNodeMetadata(vtkMRMLCollaborationNode* collabNode, vtkMRMLNode* node);
+  vtkMRMLCollaborationNode* getCollaborationNodeOfSynchronizedNode(vtkMRMLNode* node);
+  /// Update the synchronization metadata when a synchronized node, its display node or its transform is modified
+  static void nodeUpdated(vtkObject* caller, unsigned long event, void* clientData, void* callData);
+
+  vtkCallbackCommand* UpdateTextCallback;
+  vtkCallbackCommand* ConnectorConnectedCallback;
+  void (*ConnectorWakeUpCallback)(void* clientData);
+  void* ConnectorWakeUpClientData;
+
+  int BulkSynchronizationLevel;
+  int BulkSynchronizationWasModifying;
+  bool BulkSynchronizationBatchProcessScene;
+  /// Node IDs to push at the end of the bulk synchronization, and whether they are offered
+  std::vector<std::pair<std::string, bool> > DeferredPushes;
+  std::set<std::string> DeferredMetadataUpdates;
+
+  /// Synchronization metadata (display properties, markups control points and transformed nodes) by collaboration
+  /// node ID and metadata key. It only lives for the session instead of being stored in helper nodes of the scene,
+  /// and is sent again when the connection is established.
+  struct SynchronizationMetadataItem
+  {
+    std::string Text;
+    /// Node serialized by the codec, the delta sent to new peers is computed from it
+    std::string NodeID;
+    /// Priority of the codec, the metadata of higher priority is sent first
+    int Priority{ 0 };
+  };
+  std::map<std::string, std::map<std::string, SynchronizationMetadataItem> > SynchronizationMetadata;
+
+  std::string DefaultContentCacheDirectory;
+
+  /// Avatar meshes read from the module share directory, copied into the avatars of all participants
+  std::map<std::string, vtkSmartPointer<vtkPolyData> > AvatarMeshes;
 private:
 
   vtkSlicerCollaborationLogic(const vtkSlicerCollaborationLogic&); // Not implemented
@@ -0,0 +1,483 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+#include "vtkCollaborationAttributeSchema.h"
+
+// Slicer MRML includes
+#include <vtkMRMLDisplayNode.h>
+#include <vtkMRMLMarkupsDisplayNode.h>
+#include <vtkMRMLMarkupsAngleNode.h>
+#include <vtkMRMLMarkupsNode.h>
+
+// VTK includes
+#include <vtkBase64Utilities.h>
+#include <vtkByteSwap.h>
+
+// STD includes
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+namespace
+{
+/// Version of the record layout, first byte of every record
+const unsigned char RecordFormatVersion = 2;
+/// Prefix of the records encoded as text
+const char RecordTextPrefix = '#';
+
+struct SchemaRegistry
+{
+  std::mutex Mutex;
+  std::map<unsigned short, std::shared_ptr<vtkCollaborationAttributeSchema> > SchemasByID;
+  /// Schemas in registration order, superclasses are registered before their subclasses
+  std::vector<std::shared_ptr<vtkCollaborationAttributeSchema> > Schemas;
+  /// Schema found for each node class, including the classes using the schema of a superclass
+  std::map<std::string, vtkCollaborationAttributeSchema*> SchemasByClassName;
+};
+
+SchemaRegistry& GetRegistry()
+{
+  static SchemaRegistry registry;
+  return registry;
+}
+
+//----------------------------------------------------------------------------
+void AddDisplayFields(vtkCollaborationAttributeSchema* schema)
+{
+  typedef vtkMRMLDisplayNode N;
+  schema->AddBooleanField<N>("visibility", [](N* n) { return n->GetVisibility() != 0; }, [](N* n, bool v) { n->SetVisibility(v); });
+  schema->AddBooleanField<N>("visibility2D", [](N* n) { return n->GetVisibility2D(); }, [](N* n, bool v) { n->SetVisibility2D(v); });
+  schema->AddBooleanField<N>("visibility3D", [](N* n) { return n->GetVisibility3D(); }, [](N* n, bool v) { n->SetVisibility3D(v); });
+  schema->AddVector3Field<N>("color", [](N* n, double* v) { n->GetColor(v); }, [](N* n, double* v) { n->SetColor(v); });
+  schema->AddVector3Field<N>("selectedColor", [](N* n, double* v) { n->GetSelectedColor(v); }, [](N* n, double* v) { n->SetSelectedColor(v); });
+  schema->AddVector3Field<N>("edgeColor", [](N* n, double* v) { n->GetEdgeColor(v); }, [](N* n, double* v) { n->SetEdgeColor(v); });
+  schema->AddDoubleField<N>("opacity", [](N* n) { return n->GetOpacity(); }, [](N* n, double v) { n->SetOpacity(v); });
+  schema->AddDoubleField<N>("ambient", [](N* n) { return n->GetAmbient(); }, [](N* n, double v) { n->SetAmbient(v); });
+  schema->AddDoubleField<N>("diffuse", [](N* n) { return n->GetDiffuse(); }, [](N* n, double v) { n->SetDiffuse(v); });
+  schema->AddDoubleField<N>("specular", [](N* n) { return n->GetSpecular(); }, [](N* n, double v) { n->SetSpecular(v); });
+  schema->AddDoubleField<N>("power", [](N* n) { return n->GetPower(); }, [](N* n, double v) { n->SetPower(v); });
+  schema->AddDoubleField<N>("pointSize", [](N* n) { return n->GetPointSize(); }, [](N* n, double v) { n->SetPointSize(v); });
+  schema->AddDoubleField<N>("lineWidth", [](N* n) { return n->GetLineWidth(); }, [](N* n, double v) { n->SetLineWidth(v); });
+  schema->AddIntegerField<N>("representation", [](N* n) { return n->GetRepresentation(); }, [](N* n, int v) { n->SetRepresentation(v); });
+  schema->AddIntegerField<N>("sliceIntersectionThickness", [](N* n) { return n->GetSliceIntersectionThickness(); }, [](N* n, int v) { n->SetSliceIntersectionThickness(v); });
+  schema->AddBooleanField<N>("edgeVisibility", [](N* n) { return n->GetEdgeVisibility() != 0; }, [](N* n, bool v) { n->SetEdgeVisibility(v); });
+  schema->AddBooleanField<N>("backfaceCulling", [](N* n) { return n->GetBackfaceCulling() != 0; }, [](N* n, bool v) { n->SetBackfaceCulling(v); });
+  schema->AddBooleanField<N>("scalarVisibility", [](N* n) { return n->GetScalarVisibility() != 0; }, [](N* n, bool v) { n->SetScalarVisibility(v); });
+}
+
+//----------------------------------------------------------------------------
+void AddMarkupsDisplayFields(vtkCollaborationAttributeSchema* schema)
+{
+  AddDisplayFields(schema);
+  typedef vtkMRMLMarkupsDisplayNode N;
+  schema->AddVector3Field<N>("activeColor", [](N* n, double* v) { n->GetActiveColor(v); }, [](N* n, double* v) { n->SetActiveColor(v); });
+  schema->AddDoubleField<N>("textScale", [](N* n) { return n->GetTextScale(); }, [](N* n, double v) { n->SetTextScale(v); });
+  schema->AddDoubleField<N>("glyphScale", [](N* n) { return n->GetGlyphScale(); }, [](N* n, double v) { n->SetGlyphScale(v); });
+  schema->AddDoubleField<N>("glyphSize", [](N* n) { return n->GetGlyphSize(); }, [](N* n, double v) { n->SetGlyphSize(v); });
+  schema->AddBooleanField<N>("useGlyphScale", [](N* n) { return n->GetUseGlyphScale(); }, [](N* n, bool v) { n->SetUseGlyphScale(v); });
+  schema->AddIntegerField<N>("glyphType", [](N* n) { return n->GetGlyphType(); }, [](N* n, int v) { n->SetGlyphType(v); });
+  schema->AddBooleanField<N>("pointLabelsVisibility", [](N* n) { return n->GetPointLabelsVisibility(); }, [](N* n, bool v) { n->SetPointLabelsVisibility(v); });
+  schema->AddBooleanField<N>("propertiesLabelVisibility", [](N* n) { return n->GetPropertiesLabelVisibility(); }, [](N* n, bool v) { n->SetPropertiesLabelVisibility(v); });
+  schema->AddBooleanField<N>("fillVisibility", [](N* n) { return n->GetFillVisibility(); }, [](N* n, bool v) { n->SetFillVisibility(v); });
+  schema->AddBooleanField<N>("outlineVisibility", [](N* n) { return n->GetOutlineVisibility(); }, [](N* n, bool v) { n->SetOutlineVisibility(v); });
+  schema->AddDoubleField<N>("fillOpacity", [](N* n) { return n->GetFillOpacity(); }, [](N* n, double v) { n->SetFillOpacity(v); });
+  schema->AddDoubleField<N>("outlineOpacity", [](N* n) { return n->GetOutlineOpacity(); }, [](N* n, double v) { n->SetOutlineOpacity(v); });
+}
+
+//----------------------------------------------------------------------------
+void AddMarkupsFields(vtkCollaborationAttributeSchema* schema)
+{
+  typedef vtkMRMLMarkupsNode N;
+  schema->AddBooleanField<N>("locked", [](N* n) { return n->GetLocked() != 0; }, [](N* n, bool v) { n->SetLocked(v); });
+  schema->AddStringField<N>("markupLabelFormat", [](N* n) { return n->GetMarkupLabelFormat(); }, [](N* n, const std::string& v) { n->SetMarkupLabelFormat(v); });
+  schema->AddPointListField<N>("controlPoints",
+    [](N* n, vtkPoints* points) { n->GetControlPointPositionsWorld(points); },
+    [](N* n, vtkPoints* points) { n->SetControlPointPositionsWorld(points); });
+}
+}
+
+//----------------------------------------------------------------------------
+// RecordWriter
+
+//----------------------------------------------------------------------------
+void vtkCollaborationAttributeSchema::RecordWriter::WriteBoolean(bool value)
+{
+  this->Buffer.push_back(value ? 1 : 0);
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationAttributeSchema::RecordWriter::WriteInteger(int value)
+{
+  int32_t value32 = static_cast<int32_t>(value);
+  vtkByteSwap::Swap4LE(&value32);
+  this->Buffer.append(reinterpret_cast<const char*>(&value32), sizeof(value32));
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationAttributeSchema::RecordWriter::WriteDouble(double value)
+{
+  vtkByteSwap::Swap8LE(&value);
+  this->Buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationAttributeSchema::RecordWriter::WriteVector3(const double value[3])
+{
+  double littleEndianValue[3] = { value[0], value[1], value[2] };
+  vtkByteSwap::SwapLERange(littleEndianValue, 3);
+  this->Buffer.append(reinterpret_cast<const char*>(littleEndianValue), 3 * sizeof(double));
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationAttributeSchema::RecordWriter::WriteString(const std::string& value)
+{
+  this->WriteInteger(static_cast<int>(value.size()));
+  this->Buffer.append(value);
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationAttributeSchema::RecordWriter::WriteIntegers(const int32_t* values, size_t count)
+{
+  size_t offset = this->Buffer.size();
+  this->Buffer.append(reinterpret_cast<const char*>(values), count * sizeof(int32_t));
+  if (count > 0)
+  {
+    vtkByteSwap::SwapLERange(reinterpret_cast<int32_t*>(&this->Buffer[offset]), count);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationAttributeSchema::RecordWriter::WritePoints(vtkPoints* points)
+{
+  int numberOfPoints = points ? static_cast<int>(points->GetNumberOfPoints()) : 0;
+  this->WriteInteger(numberOfPoints);
+  this->Buffer.reserve(this->Buffer.size() + numberOfPoints * 3 * sizeof(double));
+  for (int pointIndex = 0; pointIndex < numberOfPoints; pointIndex++)
+  {
+    double point[3] = { 0.0, 0.0, 0.0 };
+    points->GetPoint(pointIndex, point);
+    this->WriteVector3(point);
+  }
+}
+
+//----------------------------------------------------------------------------
+// RecordReader
+
+//----------------------------------------------------------------------------
+vtkCollaborationAttributeSchema::RecordReader::RecordReader(const std::string& buffer)
+  : Buffer(buffer)
+  , Offset(0)
+  , Valid(true)
+{
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationAttributeSchema::RecordReader::ReadBytes(void* output, size_t size)
+{
+  if (!this->Valid || this->Offset + size > this->Buffer.size())
+  {
+    this->Valid = false;
+    return false;
+  }
+  std::memcpy(output, this->Buffer.data() + this->Offset, size);
+  this->Offset += size;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationAttributeSchema::RecordReader::ReadBoolean()
+{
+  unsigned char value = 0;
+  this->ReadBytes(&value, 1);
+  return value != 0;
+}
+
+//----------------------------------------------------------------------------
+int vtkCollaborationAttributeSchema::RecordReader::ReadInteger()
+{
+  int32_t value = 0;
+  this->ReadBytes(&value, sizeof(value));
+  vtkByteSwap::Swap4LE(&value);
+  return static_cast<int>(value);
+}
+
+//----------------------------------------------------------------------------
+double vtkCollaborationAttributeSchema::RecordReader::ReadDouble()
+{
+  double value = 0.0;
+  this->ReadBytes(&value, sizeof(value));
+  vtkByteSwap::Swap8LE(&value);
+  return value;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationAttributeSchema::RecordReader::ReadVector3(double value[3])
+{
+  if (!this->ReadBytes(value, 3 * sizeof(double)))
+  {
+    value[0] = value[1] = value[2] = 0.0;
+    return;
+  }
+  vtkByteSwap::SwapLERange(value, 3);
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationAttributeSchema::RecordReader::ReadIntegers(int32_t* values, size_t count)
+{
+  if (!this->ReadBytes(values, count * sizeof(int32_t)))
+  {
+    return false;
+  }
+  vtkByteSwap::SwapLERange(values, count);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkCollaborationAttributeSchema::RecordReader::ReadString()
+{
+  int length = this->ReadInteger();
+  if (!this->Valid || length < 0 || this->Offset + length > this->Buffer.size())
+  {
+    this->Valid = false;
+    return std::string();
+  }
+  std::string value = this->Buffer.substr(this->Offset, length);
+  this->Offset += length;
+  return value;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationAttributeSchema::RecordReader::ReadPoints(vtkPoints* points)
+{
+  int numberOfPoints = this->ReadInteger();
+  if (!this->Valid || numberOfPoints < 0 || this->Offset + numberOfPoints * 3 * sizeof(double) > this->Buffer.size())
+  {
+    this->Valid = false;
+    return;
+  }
+  // the coordinates are copied in one block into the point array
+  points->SetDataTypeToDouble();
+  points->SetNumberOfPoints(numberOfPoints);
+  if (numberOfPoints > 0)
+  {
+    double* coordinates = static_cast<double*>(points->GetVoidPointer(0));
+    this->ReadBytes(coordinates, numberOfPoints * 3 * sizeof(double));
+    vtkByteSwap::SwapLERange(coordinates, numberOfPoints * 3);
+  }
+  points->Modified();
+}
+
+//----------------------------------------------------------------------------
+// Schema
+
+//----------------------------------------------------------------------------
+vtkCollaborationAttributeSchema::vtkCollaborationAttributeSchema(unsigned short id, const char* className, const char* displayableClassName)
+  : ID(id)
+  , ClassName(className ? className : "")
+  , DisplayableClassName(displayableClassName ? displayableClassName : "")
+{
+}
+
+//----------------------------------------------------------------------------
+std::string vtkCollaborationAttributeSchema::WriteRecord(vtkMRMLNode* node, const char* nodeName)
+{
+  RecordWriter writer;
+  writer.Buffer.push_back(static_cast<char>(RecordFormatVersion));
+  unsigned short id = this->ID;
+  vtkByteSwap::Swap2LE(&id);
+  writer.Buffer.append(reinterpret_cast<const char*>(&id), sizeof(id));
+  writer.WriteString(nodeName ? nodeName : "");
+  writer.Buffer.push_back(static_cast<char>(this->Fields.size()));
+  for (const Field& field : this->Fields)
+  {
+    field.Write(node, writer);
+  }
+  return writer.Buffer;
+}
+
+//----------------------------------------------------------------------------
+vtkCollaborationAttributeSchema* vtkCollaborationAttributeSchema::ReadRecordHeader(RecordReader& reader, std::string& nodeName)
+{
+  unsigned char version = 0;
+  unsigned short id = 0;
+  if (!reader.ReadBytes(&version, sizeof(version)) || version != RecordFormatVersion
+    || !reader.ReadBytes(&id, sizeof(id)))
+  {
+    return nullptr;
+  }
+  vtkByteSwap::Swap2LE(&id);
+  nodeName = reader.ReadString();
+  if (!reader.IsValid())
+  {
+    return nullptr;
+  }
+  return GetSchemaByID(id);
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationAttributeSchema::ReadFields(vtkMRMLNode* node, RecordReader& reader)
+{
+  // the peer must use the same fields, values are not tagged with their names
+  unsigned char numberOfFields = 0;
+  if (!node || !node->IsA(this->ClassName.c_str())
+    || !reader.ReadBytes(&numberOfFields, sizeof(numberOfFields)) || numberOfFields != this->Fields.size())
+  {
+    return false;
+  }
+  for (const Field& field : this->Fields)
+  {
+    field.Read(node, reader);
+    if (!reader.IsValid())
+    {
+      return false;
+    }
+  }
+  return reader.IsAtEnd();
+}
+
+//----------------------------------------------------------------------------
+// Registry
+
+//----------------------------------------------------------------------------
+void vtkCollaborationAttributeSchema::RegisterSchema(std::shared_ptr<vtkCollaborationAttributeSchema> schema)
+{
+  // the default schemas are registered first, so that they can be replaced
+  registerDefaultSchemas();
+  registerSchemaInternal(schema);
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationAttributeSchema::registerSchemaInternal(std::shared_ptr<vtkCollaborationAttributeSchema> schema)
+{
+  if (!schema)
+  {
+    return;
+  }
+  SchemaRegistry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.Mutex);
+  std::vector<std::shared_ptr<vtkCollaborationAttributeSchema> >& schemas = registry.Schemas;
+  schemas.erase(std::remove_if(schemas.begin(), schemas.end(),
+    [&schema](const std::shared_ptr<vtkCollaborationAttributeSchema>& registeredSchema)
+    { return registeredSchema->GetID() == schema->GetID() || registeredSchema->ClassName == schema->ClassName; }),
+    schemas.end());
+  schemas.push_back(schema);
+  registry.SchemasByID.clear();
+  for (const std::shared_ptr<vtkCollaborationAttributeSchema>& registeredSchema : schemas)
+  {
+    registry.SchemasByID[registeredSchema->GetID()] = registeredSchema;
+  }
+  // the classes using the schema of a superclass are looked up again
+  registry.SchemasByClassName.clear();
+}
+
+//----------------------------------------------------------------------------
+vtkCollaborationAttributeSchema* vtkCollaborationAttributeSchema::GetSchemaOfNode(vtkMRMLNode* node)
+{
+  if (!node)
+  {
+    return nullptr;
+  }
+  registerDefaultSchemas();
+  SchemaRegistry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.Mutex);
+  auto classIt = registry.SchemasByClassName.find(node->GetClassName());
+  if (classIt != registry.SchemasByClassName.end())
+  {
+    return classIt->second;
+  }
+  // the schema registered last for one of the classes of the node is the most specific one
+  vtkCollaborationAttributeSchema* nodeSchema = nullptr;
+  for (auto schemaIt = registry.Schemas.rbegin(); schemaIt != registry.Schemas.rend(); ++schemaIt)
+  {
+    if (node->IsA((*schemaIt)->GetClassName()))
+    {
+      nodeSchema = schemaIt->get();
+      break;
+    }
+  }
+  registry.SchemasByClassName[node->GetClassName()] = nodeSchema;
+  return nodeSchema;
+}
+
+//----------------------------------------------------------------------------
+vtkCollaborationAttributeSchema* vtkCollaborationAttributeSchema::GetSchemaByID(unsigned short id)
+{
+  registerDefaultSchemas();
+  SchemaRegistry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.Mutex);
+  auto schemaIt = registry.SchemasByID.find(id);
+  return schemaIt != registry.SchemasByID.end() ? schemaIt->second.get() : nullptr;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationAttributeSchema::registerDefaultSchemas()
+{
+  static std::once_flag registered;
+  std::call_once(registered, []()
+  {
+    std::shared_ptr<vtkCollaborationAttributeSchema> schema;
+    schema = std::make_shared<vtkCollaborationAttributeSchema>(1, "vtkMRMLModelDisplayNode", "vtkMRMLModelNode");
+    AddDisplayFields(schema.get());
+    registerSchemaInternal(schema);
+    schema = std::make_shared<vtkCollaborationAttributeSchema>(2, "vtkMRMLMarkupsDisplayNode", "vtkMRMLMarkupsNode");
+    AddMarkupsDisplayFields(schema.get());
+    registerSchemaInternal(schema);
+
+    // markups sent as metadata, fiducials are pushed as nodes. The planes, ROIs and curves are described in XML, their
+    // state also includes their type, size, orientation and interpolation.
+    schema = std::make_shared<vtkCollaborationAttributeSchema>(10, "vtkMRMLMarkupsLineNode");
+    AddMarkupsFields(schema.get());
+    registerSchemaInternal(schema);
+    schema = std::make_shared<vtkCollaborationAttributeSchema>(11, "vtkMRMLMarkupsAngleNode");
+    AddMarkupsFields(schema.get());
+    typedef vtkMRMLMarkupsAngleNode N;
+    schema->AddIntegerField<N>("angleMeasurementMode", [](N* n) { return n->GetAngleMeasurementMode(); }, [](N* n, int v) { n->SetAngleMeasurementMode(v); });
+    schema->AddVector3Field<N>("orientationRotationAxis", [](N* n, double* v) { n->GetOrientationRotationAxis(v); }, [](N* n, double* v) { n->SetOrientationRotationAxis(v); });
+    registerSchemaInternal(schema);
+  });
+}
+
+//----------------------------------------------------------------------------
+std::string vtkCollaborationAttributeSchema::EncodeRecordAsText(const std::string& record)
+{
+  std::string text(1 + ((record.size() + 2) / 3) * 4, '\0');
+  text[0] = RecordTextPrefix;
+  size_t length = vtkBase64Utilities::Encode(reinterpret_cast<const unsigned char*>(record.data()),
+    record.size(), reinterpret_cast<unsigned char*>(&text[1]));
+  text.resize(1 + length);
+  return text;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationAttributeSchema::DecodeRecordFromText(const std::string& text, std::string& record)
+{
+  if (text.empty() || text[0] != RecordTextPrefix)
+  {
+    return false;
+  }
+  size_t encodedLength = text.size() - 1;
+  record.resize((encodedLength / 4) * 3);
+  size_t length = vtkBase64Utilities::DecodeSafely(reinterpret_cast<const unsigned char*>(text.data() + 1),
+    encodedLength, reinterpret_cast<unsigned char*>(&record[0]), record.size());
+  record.resize(length);
+  return length > 0;
+}
@@ -0,0 +1,210 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+#ifndef __vtkCollaborationAttributeSchema_h
+#define __vtkCollaborationAttributeSchema_h
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkPoints.h>
+
+// STD includes
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Collaboration includes
+#include "vtkSlicerCollaborationModuleMRMLExport.h"
+
+class vtkMRMLNode;
+
+/// \brief Typed binary encoding of the synchronized attributes of a MRML node class.
+///
+/// A schema lists the fields of one node class, each with the accessors reading and writing it.
+/// Schemas are registered once per class. A record contains the schema ID, the name of the node
+/// and the values of the fields in schema order, so decoding looks up the schema by ID and reads
+/// the values in sequence instead of parsing XML and matching attribute names.
+/// Display node schemas identify the node by the name of their displayable node.
+///
+/// Values are stored in little-endian byte order. Records are encoded in base64 to be sent as text.
+class VTK_SLICER_COLLABORATION_MODULE_MRML_EXPORT vtkCollaborationAttributeSchema
+{
+public:
+  enum FieldType
+  {
+    FieldBoolean,
+    FieldInteger,
+    FieldDouble,
+    FieldVector3,
+    FieldString,
+    FieldPointList
+  };
+
+  /// Append typed values to a record
+  class VTK_SLICER_COLLABORATION_MODULE_MRML_EXPORT RecordWriter
+  {
+  public:
+    void WriteBoolean(bool value);
+    void WriteInteger(int value);
+    void WriteDouble(double value);
+    void WriteVector3(const double value[3]);
+    void WriteString(const std::string& value);
+    void WriteIntegers(const int32_t* values, size_t count);
+    /// Write the number of points followed by their coordinates
+    void WritePoints(vtkPoints* points);
+    std::string Buffer;
+  };
+
+  /// Read typed values from a record. Reading past the end of the record makes the reader invalid.
+  class VTK_SLICER_COLLABORATION_MODULE_MRML_EXPORT RecordReader
+  {
+  public:
+    RecordReader(const std::string& buffer);
+    bool ReadBoolean();
+    int ReadInteger();
+    double ReadDouble();
+    void ReadVector3(double value[3]);
+    std::string ReadString();
+    bool ReadIntegers(int32_t* values, size_t count);
+    void ReadPoints(vtkPoints* points);
+    /// Copy the next bytes of the record to the output
+    bool ReadBytes(void* output, size_t size);
+    bool IsValid() { return this->Valid; }
+    bool IsAtEnd() { return this->Offset == this->Buffer.size(); }
+    size_t GetNumberOfRemainingBytes() { return this->Buffer.size() - this->Offset; }
+  protected:
+    const std::string& Buffer;
+    size_t Offset;
+    bool Valid;
+  };
+
+  struct Field
+  {
+    std::string Name;
+    FieldType Type;
+    std::function<void(vtkMRMLNode*, RecordWriter&)> Write;
+    std::function<void(vtkMRMLNode*, RecordReader&)> Read;
+  };
+
+  /// Create a schema for a node class. The ID identifies the schema in the records and must be the same for all peers.
+  /// If displayableClassName is set, the schema describes the display node of the named displayable node.
+  vtkCollaborationAttributeSchema(unsigned short id, const char* className, const char* displayableClassName = nullptr);
+
+  unsigned short GetID() { return this->ID; }
+  const char* GetClassName() { return this->ClassName.c_str(); }
+  /// Class of the displayable node of display node schemas, nullptr for other schemas
+  const char* GetDisplayableClassName() { return this->DisplayableClassName.empty() ? nullptr : this->DisplayableClassName.c_str(); }
+  const std::vector<Field>& GetFields() { return this->Fields; }
+
+  /// Add a field read and written by getter and setter functions taking the node of the schema class
+  template <class NodeType, class Getter, class Setter>
+  void AddBooleanField(const char* name, Getter getter, Setter setter)
+  {
+    this->Fields.push_back({ name, FieldBoolean,
+      [getter](vtkMRMLNode* node, RecordWriter& writer) { writer.WriteBoolean(getter(static_cast<NodeType*>(node))); },
+      [setter](vtkMRMLNode* node, RecordReader& reader) { bool value = reader.ReadBoolean(); if (reader.IsValid()) { setter(static_cast<NodeType*>(node), value); } } });
+  }
+  template <class NodeType, class Getter, class Setter>
+  void AddIntegerField(const char* name, Getter getter, Setter setter)
+  {
+    this->Fields.push_back({ name, FieldInteger,
+      [getter](vtkMRMLNode* node, RecordWriter& writer) { writer.WriteInteger(getter(static_cast<NodeType*>(node))); },
+      [setter](vtkMRMLNode* node, RecordReader& reader) { int value = reader.ReadInteger(); if (reader.IsValid()) { setter(static_cast<NodeType*>(node), value); } } });
+  }
+  template <class NodeType, class Getter, class Setter>
+  void AddDoubleField(const char* name, Getter getter, Setter setter)
+  {
+    this->Fields.push_back({ name, FieldDouble,
+      [getter](vtkMRMLNode* node, RecordWriter& writer) { writer.WriteDouble(getter(static_cast<NodeType*>(node))); },
+      [setter](vtkMRMLNode* node, RecordReader& reader) { double value = reader.ReadDouble(); if (reader.IsValid()) { setter(static_cast<NodeType*>(node), value); } } });
+  }
+  /// The getter fills and the setter applies a double[3]
+  template <class NodeType, class Getter, class Setter>
+  void AddVector3Field(const char* name, Getter getter, Setter setter)
+  {
+    this->Fields.push_back({ name, FieldVector3,
+      [getter](vtkMRMLNode* node, RecordWriter& writer) { double value[3] = { 0.0, 0.0, 0.0 }; getter(static_cast<NodeType*>(node), value); writer.WriteVector3(value); },
+      [setter](vtkMRMLNode* node, RecordReader& reader) { double value[3]; reader.ReadVector3(value); if (reader.IsValid()) { setter(static_cast<NodeType*>(node), value); } } });
+  }
+  template <class NodeType, class Getter, class Setter>
+  void AddStringField(const char* name, Getter getter, Setter setter)
+  {
+    this->Fields.push_back({ name, FieldString,
+      [getter](vtkMRMLNode* node, RecordWriter& writer) { writer.WriteString(getter(static_cast<NodeType*>(node))); },
+      [setter](vtkMRMLNode* node, RecordReader& reader) { std::string value = reader.ReadString(); if (reader.IsValid()) { setter(static_cast<NodeType*>(node), value); } } });
+  }
+  /// The getter fills and the setter applies a vtkPoints
+  template <class NodeType, class Getter, class Setter>
+  void AddPointListField(const char* name, Getter getter, Setter setter);
+
+  /// Encode the fields of the node in a record, identified with the given node name
+  std::string WriteRecord(vtkMRMLNode* node, const char* nodeName);
+  /// Apply the fields of a record to the node. The reader must be positioned after the header.
+  bool ReadFields(vtkMRMLNode* node, RecordReader& reader);
+  /// Read the header of a record. Return the schema of the record, or nullptr if the record is invalid.
+  static vtkCollaborationAttributeSchema* ReadRecordHeader(RecordReader& reader, std::string& nodeName);
+
+  /// Register a schema. A schema with the same ID or class replaces the previous one.
+  static void RegisterSchema(std::shared_ptr<vtkCollaborationAttributeSchema> schema);
+  /// Get the schema of a node class, or of its closest registered superclass. Return nullptr if there is none.
+  static vtkCollaborationAttributeSchema* GetSchemaOfNode(vtkMRMLNode* node);
+  static vtkCollaborationAttributeSchema* GetSchemaByID(unsigned short id);
+
+  /// Encode a record as text and decode it. The text never starts with '<', unlike the XML messages.
+  static std::string EncodeRecordAsText(const std::string& record);
+  static bool DecodeRecordFromText(const std::string& text, std::string& record);
+
+protected:
+  /// Register the schemas of the display and markups classes synchronized by the module
+  static void registerDefaultSchemas();
+  static void registerSchemaInternal(std::shared_ptr<vtkCollaborationAttributeSchema> schema);
+
+  unsigned short ID;
+  std::string ClassName;
+  std::string DisplayableClassName;
+  std::vector<Field> Fields;
+};
+
+//----------------------------------------------------------------------------
+template <class NodeType, class Getter, class Setter>
+void vtkCollaborationAttributeSchema::AddPointListField(const char* name, Getter getter, Setter setter)
+{
+  this->Fields.push_back({ name, FieldPointList,
+    [getter](vtkMRMLNode* node, RecordWriter& writer)
+    {
+      vtkNew<vtkPoints> points;
+      getter(static_cast<NodeType*>(node), points.GetPointer());
+      writer.WritePoints(points);
+    },
+    [setter](vtkMRMLNode* node, RecordReader& reader)
+    {
+      vtkNew<vtkPoints> points;
+      reader.ReadPoints(points);
+      if (reader.IsValid())
+      {
+        setter(static_cast<NodeType*>(node), points.GetPointer());
+      }
+    } });
+}
+
+#endif
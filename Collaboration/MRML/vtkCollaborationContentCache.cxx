@@ -0,0 +1,439 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+#include "vtkCollaborationContentCache.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkXMLImageDataReader.h>
+#include <vtkXMLImageDataWriter.h>
+#include <vtkXMLPolyDataReader.h>
+#include <vtkXMLPolyDataWriter.h>
+
+// VTKsys includes
+#include <vtksys/Directory.hxx>
+#include <vtksys/MD5.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+const char* POLYDATA_EXTENSION = ".vtp";
+const char* IMAGEDATA_EXTENSION = ".vti";
+
+//----------------------------------------------------------------------------
+void AppendBytes(vtksysMD5* md5, const void* data, size_t length)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  while (length > 0)
+  {
+    int chunkLength = static_cast<int>(std::min<size_t>(length, INT_MAX));
+    vtksysMD5_Append(md5, bytes, chunkLength);
+    bytes += chunkLength;
+    length -= chunkLength;
+  }
+}
+
+//----------------------------------------------------------------------------
+void AppendArray(vtksysMD5* md5, vtkDataArray* array)
+{
+  if (!array)
+  {
+    return;
+  }
+  if (array->GetName())
+  {
+    AppendBytes(md5, array->GetName(), strlen(array->GetName()));
+  }
+  int numberOfComponents = array->GetNumberOfComponents();
+  AppendBytes(md5, &numberOfComponents, sizeof(numberOfComponents));
+  AppendBytes(md5, array->GetVoidPointer(0), array->GetNumberOfValues() * array->GetDataTypeSize());
+}
+
+//----------------------------------------------------------------------------
+void AppendCells(vtksysMD5* md5, vtkCellArray* cells)
+{
+  if (!cells)
+  {
+    return;
+  }
+  AppendArray(md5, cells->GetOffsetsArray());
+  AppendArray(md5, cells->GetConnectivityArray());
+}
+
+//----------------------------------------------------------------------------
+void AppendAttributes(vtksysMD5* md5, vtkFieldData* attributes)
+{
+  if (!attributes)
+  {
+    return;
+  }
+  for (int arrayIndex = 0; arrayIndex < attributes->GetNumberOfArrays(); ++arrayIndex)
+  {
+    AppendArray(md5, attributes->GetArray(arrayIndex));
+  }
+}
+
+//----------------------------------------------------------------------------
+std::string FinalizeHash(vtksysMD5* md5)
+{
+  char hexDigest[32];
+  vtksysMD5_FinalizeHex(md5, hexDigest);
+  vtksysMD5_Delete(md5);
+  return std::string(hexDigest, 32);
+}
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkCollaborationContentCache);
+
+//----------------------------------------------------------------------------
+vtkCollaborationContentCache::vtkCollaborationContentCache()
+  : MaximumCacheSize(2048)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkCollaborationContentCache::~vtkCollaborationContentCache() = default;
+
+//----------------------------------------------------------------------------
+void vtkCollaborationContentCache::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "CacheDirectory: " << this->GetCacheDirectory() << "\n";
+  os << indent << "MaximumCacheSize: " << this->GetMaximumCacheSize() << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationContentCache::SetCacheDirectory(const std::string& directory)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (this->CacheDirectory == directory)
+  {
+    return;
+  }
+  this->CacheDirectory = directory;
+  if (!directory.empty() && !vtksys::SystemTools::FileIsDirectory(directory))
+  {
+    vtksys::SystemTools::MakeDirectory(directory);
+  }
+}
+
+//----------------------------------------------------------------------------
+std::string vtkCollaborationContentCache::GetCacheDirectory()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->CacheDirectory;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationContentCache::SetMaximumCacheSize(int megabytes)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->MaximumCacheSize = megabytes;
+}
+
+//----------------------------------------------------------------------------
+int vtkCollaborationContentCache::GetMaximumCacheSize()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->MaximumCacheSize;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkCollaborationContentCache::ComputePolyDataHash(vtkPolyData* polyData)
+{
+  if (!polyData)
+  {
+    return "";
+  }
+  vtksysMD5* md5 = vtksysMD5_New();
+  vtksysMD5_Initialize(md5);
+  if (polyData->GetPoints())
+  {
+    AppendArray(md5, polyData->GetPoints()->GetData());
+  }
+  AppendCells(md5, polyData->GetVerts());
+  AppendCells(md5, polyData->GetLines());
+  AppendCells(md5, polyData->GetPolys());
+  AppendCells(md5, polyData->GetStrips());
+  AppendAttributes(md5, polyData->GetPointData());
+  AppendAttributes(md5, polyData->GetCellData());
+  return FinalizeHash(md5);
+}
+
+//----------------------------------------------------------------------------
+std::string vtkCollaborationContentCache::ComputeImageDataHash(vtkImageData* imageData)
+{
+  if (!imageData)
+  {
+    return "";
+  }
+  vtksysMD5* md5 = vtksysMD5_New();
+  vtksysMD5_Initialize(md5);
+  AppendBytes(md5, imageData->GetExtent(), 6 * sizeof(int));
+  AppendBytes(md5, imageData->GetSpacing(), 3 * sizeof(double));
+  AppendBytes(md5, imageData->GetOrigin(), 3 * sizeof(double));
+  AppendAttributes(md5, imageData->GetPointData());
+  return FinalizeHash(md5);
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationContentCache::IsValidHash(const std::string& hash)
+{
+  if (hash.size() != 32)
+  {
+    return false;
+  }
+  for (char character : hash)
+  {
+    if (!((character >= '0' && character <= '9') || (character >= 'a' && character <= 'f')))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkCollaborationContentCache::GetContentFilePath(const std::string& hash, const char* extension)
+{
+  return this->CacheDirectory + "/" + hash + extension;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationContentCache::HasContent(const std::string& hash)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (!IsValidHash(hash) || this->CacheDirectory.empty())
+  {
+    return false;
+  }
+  return vtksys::SystemTools::FileExists(this->GetContentFilePath(hash, POLYDATA_EXTENSION), true)
+    || vtksys::SystemTools::FileExists(this->GetContentFilePath(hash, IMAGEDATA_EXTENSION), true);
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationContentCache::ReadPolyData(const std::string& hash, vtkPolyData* output)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (!output || !IsValidHash(hash))
+  {
+    return false;
+  }
+  std::string filePath = this->GetContentFilePath(hash, POLYDATA_EXTENSION);
+  if (!vtksys::SystemTools::FileExists(filePath, true))
+  {
+    return false;
+  }
+  vtkNew<vtkXMLPolyDataReader> reader;
+  reader->SetFileName(filePath.c_str());
+  reader->Update();
+  if (reader->GetErrorCode() != 0)
+  {
+    vtkErrorMacro("ReadPolyData: Failed to read cached mesh " << filePath);
+    return false;
+  }
+  output->ShallowCopy(reader->GetOutput());
+  // keep track of the last use for the eviction
+  vtksys::SystemTools::Touch(filePath, false);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationContentCache::StorePolyData(const std::string& hash, vtkPolyData* polyData)
+{
+  if (!polyData || !IsValidHash(hash))
+  {
+    return false;
+  }
+  // the hash comes from the peer, the content is only stored under its actual hash
+  if (ComputePolyDataHash(polyData) != hash)
+  {
+    vtkWarningMacro("StorePolyData: The mesh does not match its hash " << hash << ", it is not cached");
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    if (this->CacheDirectory.empty())
+    {
+      return false;
+    }
+    std::string filePath = this->GetContentFilePath(hash, POLYDATA_EXTENSION);
+    if (vtksys::SystemTools::FileExists(filePath, true))
+    {
+      vtksys::SystemTools::Touch(filePath, false);
+      return true;
+    }
+    vtkNew<vtkXMLPolyDataWriter> writer;
+    writer->SetFileName(filePath.c_str());
+    writer->SetInputData(polyData);
+    writer->SetDataModeToAppended();
+    writer->EncodeAppendedDataOff();
+    if (!writer->Write())
+    {
+      vtkErrorMacro("StorePolyData: Failed to write cached mesh " << filePath);
+      vtksys::SystemTools::RemoveFile(filePath);
+      return false;
+    }
+  }
+  this->RemoveLeastRecentlyUsedContent();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationContentCache::ReadImageData(const std::string& hash, vtkImageData* output)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (!output || !IsValidHash(hash))
+  {
+    return false;
+  }
+  std::string filePath = this->GetContentFilePath(hash, IMAGEDATA_EXTENSION);
+  if (!vtksys::SystemTools::FileExists(filePath, true))
+  {
+    return false;
+  }
+  vtkNew<vtkXMLImageDataReader> reader;
+  reader->SetFileName(filePath.c_str());
+  reader->Update();
+  if (reader->GetErrorCode() != 0)
+  {
+    vtkErrorMacro("ReadImageData: Failed to read cached image " << filePath);
+    return false;
+  }
+  output->ShallowCopy(reader->GetOutput());
+  // keep track of the last use for the eviction
+  vtksys::SystemTools::Touch(filePath, false);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationContentCache::StoreImageData(const std::string& hash, vtkImageData* imageData)
+{
+  if (!imageData || !IsValidHash(hash))
+  {
+    return false;
+  }
+  // the hash comes from the peer, the content is only stored under its actual hash
+  if (ComputeImageDataHash(imageData) != hash)
+  {
+    vtkWarningMacro("StoreImageData: The image does not match its hash " << hash << ", it is not cached");
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    if (this->CacheDirectory.empty())
+    {
+      return false;
+    }
+    std::string filePath = this->GetContentFilePath(hash, IMAGEDATA_EXTENSION);
+    if (vtksys::SystemTools::FileExists(filePath, true))
+    {
+      vtksys::SystemTools::Touch(filePath, false);
+      return true;
+    }
+    vtkNew<vtkXMLImageDataWriter> writer;
+    writer->SetFileName(filePath.c_str());
+    writer->SetInputData(imageData);
+    writer->SetDataModeToAppended();
+    writer->EncodeAppendedDataOff();
+    if (!writer->Write())
+    {
+      vtkErrorMacro("StoreImageData: Failed to write cached image " << filePath);
+      vtksys::SystemTools::RemoveFile(filePath);
+      return false;
+    }
+  }
+  this->RemoveLeastRecentlyUsedContent();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationContentCache::RemoveLeastRecentlyUsedContent()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (this->CacheDirectory.empty())
+  {
+    return;
+  }
+  vtksys::Directory directory;
+  if (!directory.Load(this->CacheDirectory))
+  {
+    return;
+  }
+
+  struct CacheEntry
+  {
+    std::string FilePath;
+    long int LastUsed;
+    unsigned long Size;
+  };
+  std::vector<CacheEntry> entries;
+  unsigned long long totalSize = 0;
+  for (unsigned long fileIndex = 0; fileIndex < directory.GetNumberOfFiles(); ++fileIndex)
+  {
+    std::string fileName = directory.GetFile(fileIndex);
+    std::string extension = vtksys::SystemTools::GetFilenameLastExtension(fileName);
+    if (extension != POLYDATA_EXTENSION && extension != IMAGEDATA_EXTENSION)
+    {
+      continue;
+    }
+    CacheEntry entry;
+    entry.FilePath = this->CacheDirectory + "/" + fileName;
+    entry.LastUsed = vtksys::SystemTools::ModifiedTime(entry.FilePath);
+    entry.Size = vtksys::SystemTools::FileLength(entry.FilePath);
+    totalSize += entry.Size;
+    entries.push_back(entry);
+  }
+
+  unsigned long long maximumSize = static_cast<unsigned long long>(std::max(this->MaximumCacheSize, 0)) * 1024 * 1024;
+  if (totalSize <= maximumSize)
+  {
+    return;
+  }
+  std::sort(entries.begin(), entries.end(),
+    [](const CacheEntry& a, const CacheEntry& b) { return a.LastUsed < b.LastUsed; });
+  for (const CacheEntry& entry : entries)
+  {
+    if (totalSize <= maximumSize)
+    {
+      break;
+    }
+    if (vtksys::SystemTools::RemoveFile(entry.FilePath))
+    {
+      totalSize -= entry.Size;
+    }
+  }
+}
@@ -0,0 +1,100 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+#ifndef __vtkCollaborationContentCache_h
+#define __vtkCollaborationContentCache_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <mutex>
+#include <string>
+
+// Collaboration includes
+#include "vtkSlicerCollaborationModuleMRMLExport.h"
+
+class vtkImageData;
+class vtkPolyData;
+
+/// \brief Content-addressable on-disk cache of received meshes and images.
+///
+/// Every payload is stored in the cache directory under the hash of its content, so that
+/// a peer offering the same content again does not need to send it.
+/// When the total size of the cache exceeds the maximum size, the least recently used
+/// entries are removed. Storing and reading can be done from any thread.
+class VTK_SLICER_COLLABORATION_MODULE_MRML_EXPORT vtkCollaborationContentCache : public vtkObject
+{
+public:
+  static vtkCollaborationContentCache* New();
+  vtkTypeMacro(vtkCollaborationContentCache, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Directory containing the cached payloads. Created if it does not exist.
+  void SetCacheDirectory(const std::string& directory);
+  std::string GetCacheDirectory();
+
+  /// Maximum total size of the cached payloads in megabytes
+  void SetMaximumCacheSize(int megabytes);
+  int GetMaximumCacheSize();
+
+  /// Compute the hash identifying the content of a mesh (points, cells and attributes)
+  static std::string ComputePolyDataHash(vtkPolyData* polyData);
+  /// Compute the hash identifying the content of an image (geometry and voxels)
+  static std::string ComputeImageDataHash(vtkImageData* imageData);
+
+  /// Return true if the hash has the format of the computed hashes: 32 lowercase hexadecimal digits.
+  /// The hashes received from a peer must be checked, as they name the files of the cache.
+  static bool IsValidHash(const std::string& hash);
+
+  /// Return true if content with the given hash is in the cache
+  bool HasContent(const std::string& hash);
+
+  /// Read cached mesh into the output. Return false if the hash is not in the cache.
+  bool ReadPolyData(const std::string& hash, vtkPolyData* output);
+  /// Store a mesh in the cache. Return false if it could not be written, or if the hash is not the hash of the mesh.
+  bool StorePolyData(const std::string& hash, vtkPolyData* polyData);
+
+  /// Read cached image into the output. Return false if the hash is not in the cache.
+  bool ReadImageData(const std::string& hash, vtkImageData* output);
+  /// Store an image in the cache. Return false if it could not be written, or if the hash is not the hash of the image.
+  bool StoreImageData(const std::string& hash, vtkImageData* imageData);
+
+  /// Remove the least recently used entries until the cache fits in the maximum size
+  void RemoveLeastRecentlyUsedContent();
+
+protected:
+  std::string GetContentFilePath(const std::string& hash, const char* extension);
+
+protected:
+  vtkCollaborationContentCache();
+  ~vtkCollaborationContentCache() override;
+  vtkCollaborationContentCache(const vtkCollaborationContentCache&);
+  void operator=(const vtkCollaborationContentCache&);
+
+  std::string CacheDirectory;
+  int MaximumCacheSize;
+
+  /// Serializes the access to the cache directory
+  std::mutex Mutex;
+};
+
+#endif
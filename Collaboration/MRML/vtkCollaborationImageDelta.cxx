@@ -0,0 +1,247 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+#include "vtkCollaborationImageDelta.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkZLibDataCompressor.h>
+
+// STD includes
+#include <algorithm>
+#include <cstring>
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationImageDelta::HasVoxels(vtkImageData* image)
+{
+  if (!image)
+  {
+    return false;
+  }
+  int* extent = image->GetExtent();
+  return extent[0] <= extent[1] && extent[2] <= extent[3] && extent[4] <= extent[5]
+    && image->GetPointData()->GetScalars() != nullptr;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationImageDelta::HaveSameGeometry(vtkImageData* image1, vtkImageData* image2)
+{
+  if (!image1 || !image2)
+  {
+    return false;
+  }
+  int* extent1 = image1->GetExtent();
+  int* extent2 = image2->GetExtent();
+  double* origin1 = image1->GetOrigin();
+  double* origin2 = image2->GetOrigin();
+  double* spacing1 = image1->GetSpacing();
+  double* spacing2 = image2->GetSpacing();
+  return std::equal(extent1, extent1 + 6, extent2)
+    && std::equal(origin1, origin1 + 3, origin2)
+    && std::equal(spacing1, spacing1 + 3, spacing2)
+    && image1->GetScalarType() == image2->GetScalarType()
+    && image1->GetNumberOfScalarComponents() == image2->GetNumberOfScalarComponents();
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationImageDelta::GetModifiedExtent(vtkImageData* image, vtkImageData* reference, int modifiedExtent[6])
+{
+  modifiedExtent[0] = modifiedExtent[2] = modifiedExtent[4] = VTK_INT_MAX;
+  modifiedExtent[1] = modifiedExtent[3] = modifiedExtent[5] = VTK_INT_MIN;
+  if (!HasVoxels(image) || !HasVoxels(reference))
+  {
+    return false;
+  }
+  int* extent = image->GetExtent();
+  size_t voxelSize = image->GetScalarSize() * image->GetNumberOfScalarComponents();
+  size_t rowSize = (extent[1] - extent[0] + 1) * voxelSize;
+  for (int z = extent[4]; z <= extent[5]; z++)
+  {
+    for (int y = extent[2]; y <= extent[3]; y++)
+    {
+      const unsigned char* row = static_cast<const unsigned char*>(image->GetScalarPointer(extent[0], y, z));
+      const unsigned char* referenceRow = static_cast<const unsigned char*>(reference->GetScalarPointer(extent[0], y, z));
+      if (memcmp(row, referenceRow, rowSize) == 0)
+      {
+        continue;
+      }
+      size_t first = 0;
+      while (row[first] == referenceRow[first])
+      {
+        first++;
+      }
+      size_t last = rowSize - 1;
+      while (row[last] == referenceRow[last])
+      {
+        last--;
+      }
+      modifiedExtent[0] = std::min(modifiedExtent[0], extent[0] + static_cast<int>(first / voxelSize));
+      modifiedExtent[1] = std::max(modifiedExtent[1], extent[0] + static_cast<int>(last / voxelSize));
+      modifiedExtent[2] = std::min(modifiedExtent[2], y);
+      modifiedExtent[3] = std::max(modifiedExtent[3], y);
+      modifiedExtent[4] = std::min(modifiedExtent[4], z);
+      modifiedExtent[5] = std::max(modifiedExtent[5], z);
+    }
+  }
+  return modifiedExtent[0] <= modifiedExtent[1];
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationImageDelta::CopyExtent(vtkImageData* source, vtkImageData* target, const int extent[6])
+{
+  size_t rowSize = (extent[1] - extent[0] + 1) * source->GetScalarSize() * source->GetNumberOfScalarComponents();
+  for (int z = extent[4]; z <= extent[5]; z++)
+  {
+    for (int y = extent[2]; y <= extent[3]; y++)
+    {
+      memcpy(target->GetScalarPointer(extent[0], y, z), source->GetScalarPointer(extent[0], y, z), rowSize);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+size_t vtkCollaborationImageDelta::GetExtentSize(vtkImageData* image, const int extent[6])
+{
+  if (extent[0] > extent[1] || extent[2] > extent[3] || extent[4] > extent[5])
+  {
+    return 0;
+  }
+  return static_cast<size_t>(extent[1] - extent[0] + 1) * (extent[3] - extent[2] + 1) * (extent[5] - extent[4] + 1)
+    * image->GetScalarSize() * image->GetNumberOfScalarComponents();
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationImageDelta::GetSampleDimensions(const int extent[6], int step, int dimensions[3])
+{
+  for (int axis = 0; axis < 3; axis++)
+  {
+    int length = extent[2 * axis + 1] - extent[2 * axis] + 1;
+    dimensions[axis] = length > 0 ? (length + step - 1) / step : 0;
+  }
+}
+
+//----------------------------------------------------------------------------
+std::string vtkCollaborationImageDelta::EncodeExtent(vtkImageData* image, const int extent[6], bool compress, int step)
+{
+  step = std::max(step, 1);
+  int dimensions[3] = { 0, 0, 0 };
+  GetSampleDimensions(extent, step, dimensions);
+  size_t voxelSize = image->GetScalarSize() * image->GetNumberOfScalarComponents();
+  size_t size = static_cast<size_t>(dimensions[0]) * dimensions[1] * dimensions[2] * voxelSize;
+  std::string data(size, '\0');
+  char* position = size > 0 ? &data[0] : nullptr;
+  for (int z = extent[4]; z <= extent[5] && size > 0; z += step)
+  {
+    for (int y = extent[2]; y <= extent[3]; y += step)
+    {
+      const char* row = static_cast<const char*>(image->GetScalarPointer(extent[0], y, z));
+      if (step == 1)
+      {
+        memcpy(position, row, dimensions[0] * voxelSize);
+        position += dimensions[0] * voxelSize;
+        continue;
+      }
+      for (int x = 0; x < dimensions[0]; x++)
+      {
+        memcpy(position, row + x * step * voxelSize, voxelSize);
+        position += voxelSize;
+      }
+    }
+  }
+  if (!compress || size == 0)
+  {
+    return data;
+  }
+  vtkNew<vtkZLibDataCompressor> compressor;
+  std::string compressedData(compressor->GetMaximumCompressionSpace(size), '\0');
+  size_t compressedSize = compressor->Compress(reinterpret_cast<const unsigned char*>(data.data()), size,
+    reinterpret_cast<unsigned char*>(&compressedData[0]), compressedData.size());
+  compressedData.resize(compressedSize);
+  return compressedData;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationImageDelta::DecodeExtent(const std::string& data, bool compressed, vtkImageData* image, const int extent[6], int step)
+{
+  if (!HasVoxels(image) || step < 1)
+  {
+    return false;
+  }
+  int* imageExtent = image->GetExtent();
+  if (extent[0] < imageExtent[0] || extent[1] > imageExtent[1] || extent[2] < imageExtent[2]
+    || extent[3] > imageExtent[3] || extent[4] < imageExtent[4] || extent[5] > imageExtent[5])
+  {
+    return false;
+  }
+  int dimensions[3] = { 0, 0, 0 };
+  GetSampleDimensions(extent, step, dimensions);
+  size_t voxelSize = image->GetScalarSize() * image->GetNumberOfScalarComponents();
+  size_t size = static_cast<size_t>(dimensions[0]) * dimensions[1] * dimensions[2] * voxelSize;
+  std::string uncompressedData;
+  const std::string* voxels = &data;
+  if (compressed && size > 0)
+  {
+    uncompressedData.resize(size);
+    vtkNew<vtkZLibDataCompressor> compressor;
+    size_t uncompressedSize = compressor->Uncompress(reinterpret_cast<const unsigned char*>(data.data()), data.size(),
+      reinterpret_cast<unsigned char*>(&uncompressedData[0]), size);
+    if (uncompressedSize != size)
+    {
+      return false;
+    }
+    voxels = &uncompressedData;
+  }
+  if (voxels->size() != size)
+  {
+    return false;
+  }
+  // the rows are written in place, the image is not reallocated
+  size_t rowSize = (extent[1] - extent[0] + 1) * voxelSize;
+  std::string expandedRow(step > 1 ? rowSize : 0, '\0');
+  const char* position = voxels->data();
+  for (int z = extent[4]; z <= extent[5] && size > 0; z += step)
+  {
+    for (int y = extent[2]; y <= extent[3]; y += step)
+    {
+      const char* row = position;
+      if (step > 1)
+      {
+        // each voxel is repeated over the block it represents
+        for (int x = 0; x < extent[1] - extent[0] + 1; x++)
+        {
+          memcpy(&expandedRow[x * voxelSize], position + (x / step) * voxelSize, voxelSize);
+        }
+        row = expandedRow.data();
+      }
+      for (int blockZ = z; blockZ < z + step && blockZ <= extent[5]; blockZ++)
+      {
+        for (int blockY = y; blockY < y + step && blockY <= extent[3]; blockY++)
+        {
+          memcpy(image->GetScalarPointer(extent[0], blockY, blockZ), row, rowSize);
+        }
+      }
+      position += dimensions[0] * voxelSize;
+    }
+  }
+  return true;
+}
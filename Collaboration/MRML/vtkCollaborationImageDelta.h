@@ -0,0 +1,62 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+#ifndef __vtkCollaborationImageDelta_h
+#define __vtkCollaborationImageDelta_h
+
+// STD includes
+#include <string>
+
+// Collaboration includes
+#include "vtkSlicerCollaborationModuleMRMLExport.h"
+
+class vtkImageData;
+
+/// \brief Comparison and transfer of the modified region of images.
+///
+/// The images are compared with a copy of their last sent content of the same geometry.
+/// Rows are compared as blocks of memory, so only the modified rows are scanned voxel by voxel.
+class VTK_SLICER_COLLABORATION_MODULE_MRML_EXPORT vtkCollaborationImageDelta
+{
+public:
+  /// Return true if the image has an extent that is not empty and scalars
+  static bool HasVoxels(vtkImageData* image);
+  /// Return true if the images have the same extent, scalar type, number of components, origin and spacing
+  static bool HaveSameGeometry(vtkImageData* image1, vtkImageData* image2);
+  /// Get the smallest extent containing the voxels that differ between two images of the same geometry.
+  /// Return false if they are identical.
+  static bool GetModifiedExtent(vtkImageData* image, vtkImageData* reference, int modifiedExtent[6]);
+  /// Copy the voxels of an extent between two images of the same geometry
+  static void CopyExtent(vtkImageData* source, vtkImageData* target, const int extent[6]);
+  /// Size in bytes of the voxels of an extent of the image
+  static size_t GetExtentSize(vtkImageData* image, const int extent[6]);
+
+  /// Encode the voxels of an extent, row by row. If compress is true, they are compressed with zlib.
+  /// With a step larger than 1, only one voxel out of step is encoded along each axis, for a coarse preview.
+  static std::string EncodeExtent(vtkImageData* image, const int extent[6], bool compress, int step = 1);
+  /// Write encoded voxels into an extent of the image. Return false if the data does not match the extent.
+  /// With a step larger than 1, each encoded voxel fills the block of step voxels along each axis that it represents.
+  static bool DecodeExtent(const std::string& data, bool compressed, vtkImageData* image, const int extent[6], int step = 1);
+  /// Number of voxels encoded along each axis for an extent and a step
+  static void GetSampleDimensions(const int extent[6], int step, int dimensions[3]);
+};
+
+#endif
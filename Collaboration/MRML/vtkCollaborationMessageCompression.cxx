@@ -0,0 +1,212 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+#include "vtkCollaborationMessageCompression.h"
+
+// VTK includes
+#include <vtkBase64Utilities.h>
+#include <vtkLZ4DataCompressor.h>
+#include <vtkNew.h>
+#include <vtk_zlib.h>
+
+// STD includes
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+const char* vtkCollaborationMessageCompression::LZ4CodecName = "lz4";
+const char* vtkCollaborationMessageCompression::DeflateCodecName = "deflate-mrml1";
+
+namespace
+{
+/// Prefix of the compressed texts, followed by the codec identifier, the size of the text and a colon
+const char COMPRESSED_TEXT_PREFIX = '~';
+const char LZ4_CODEC_ID = 'L';
+const char DEFLATE_CODEC_ID = 'D';
+
+/// Preset dictionary of the deflate codec: the frequent parts of the channel bundles, content messages and
+/// synchronization metadata, as they appear escaped in the channel messages and as raw XML. The most frequent
+/// strings are at the end, where deflate refers to them with the shortest distances.
+const char DEFLATE_DICTIONARY[] =
+  " description=&quot;&quot; hideFromEditors=&quot;false&quot; selectable=&quot;true&quot; selected=&quot;false&quot;"
+  " attributes=&quot;&quot; references=&quot;&quot; userTags=&quot;&quot;"
+  " color=&quot; selectedColor=&quot; opacity=&quot;1&quot; ambient=&quot;0&quot; diffuse=&quot;1&quot;"
+  " specular=&quot;0&quot; power=&quot;1&quot; edgeColor=&quot; lineWidth=&quot;1&quot; pointSize=&quot;1&quot;"
+  " visibility=&quot;true&quot; visibility2D=&quot;true&quot; visibility3D=&quot;true&quot;"
+  " sliceIntersectionThickness=&quot;1&quot; sliceIntersectionOpacity=&quot;1&quot; scalarVisibility=&quot;false&quot;"
+  " glyphScale=&quot; glyphSize=&quot; textScale=&quot; pointLabelsVisibility=&quot; propertiesLabelVisibility=&quot;"
+  " locked=&quot;false&quot; controlPointLabelFormat=&quot;%N-%d&quot; markupLabelFormat=&quot;%N-%d&quot;"
+  " ROIRadius = &quot;[ ControlPoints = &quot;[ ClassName = &quot;vtkMRMLMarkupsFiducialNode&quot;"
+  " ClassName = &quot;vtkMRMLMarkupsDisplayNode&quot; ClassName = &quot;vtkMRMLModelDisplayNode&quot;"
+  "&lt;MRMLNode SuperclassName = &quot;vtkMRMLDisplayNode&quot;&lt;MRMLNode SuperclassName = &quot;vtkMRMLMarkupsNode&quot;"
+  "<MRMLNode SuperclassName = \"vtkMRMLCollaborationContent\" ClassName = \"ContentOffer\" ClassName = \"ContentRequest\""
+  " id=&quot;vtkMRML name=&quot; /&gt;\" /><CollaborationChannel Ack=\"<Message Sequence=\" Channel=\"Synchronization\" Text=\"";
+
+//----------------------------------------------------------------------------
+bool DeflateWithDictionary(const std::string& data, std::string& compressedData)
+{
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (deflateInit(&stream, Z_BEST_SPEED) != Z_OK)
+  {
+    return false;
+  }
+  bool success = deflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(DEFLATE_DICTIONARY),
+    sizeof(DEFLATE_DICTIONARY) - 1) == Z_OK;
+  if (success)
+  {
+    compressedData.resize(deflateBound(&stream, static_cast<uLong>(data.size())));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&compressedData[0]);
+    stream.avail_out = static_cast<uInt>(compressedData.size());
+    success = deflate(&stream, Z_FINISH) == Z_STREAM_END;
+    compressedData.resize(stream.total_out);
+  }
+  deflateEnd(&stream);
+  return success;
+}
+
+//----------------------------------------------------------------------------
+bool InflateWithDictionary(const std::string& compressedData, std::string& data)
+{
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (inflateInit(&stream) != Z_OK)
+  {
+    return false;
+  }
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressedData.data()));
+  stream.avail_in = static_cast<uInt>(compressedData.size());
+  stream.next_out = reinterpret_cast<Bytef*>(&data[0]);
+  stream.avail_out = static_cast<uInt>(data.size());
+  int result = inflate(&stream, Z_FINISH);
+  if (result == Z_NEED_DICT)
+  {
+    if (inflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(DEFLATE_DICTIONARY),
+      sizeof(DEFLATE_DICTIONARY) - 1) == Z_OK)
+    {
+      result = inflate(&stream, Z_FINISH);
+    }
+  }
+  bool success = (result == Z_STREAM_END && stream.total_out == data.size());
+  inflateEnd(&stream);
+  return success;
+}
+}
+
+//----------------------------------------------------------------------------
+std::vector<std::string> vtkCollaborationMessageCompression::GetSupportedCodecs()
+{
+  return { DeflateCodecName, LZ4CodecName };
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationMessageCompression::Compress(const std::string& text, const std::vector<std::string>& codecs,
+  std::string& compressedText)
+{
+  bool lz4 = std::find(codecs.begin(), codecs.end(), LZ4CodecName) != codecs.end();
+  bool deflate = std::find(codecs.begin(), codecs.end(), DeflateCodecName) != codecs.end();
+  if (text.empty() || (!lz4 && !deflate))
+  {
+    return false;
+  }
+
+  // the dictionary makes the difference on the small messages, LZ4 is faster on the large ones
+  std::string compressedData;
+  char codecID = 0;
+  if (deflate && (!lz4 || text.size() <= DictionaryCodecMaximumSize))
+  {
+    if (!DeflateWithDictionary(text, compressedData))
+    {
+      return false;
+    }
+    codecID = DEFLATE_CODEC_ID;
+  }
+  else
+  {
+    vtkNew<vtkLZ4DataCompressor> compressor;
+    compressedData.resize(compressor->GetMaximumCompressionSpace(text.size()));
+    size_t compressedSize = compressor->Compress(reinterpret_cast<const unsigned char*>(text.data()), text.size(),
+      reinterpret_cast<unsigned char*>(&compressedData[0]), compressedData.size());
+    if (compressedSize == 0)
+    {
+      return false;
+    }
+    compressedData.resize(compressedSize);
+    codecID = LZ4_CODEC_ID;
+  }
+
+  std::string header = std::string(1, COMPRESSED_TEXT_PREFIX) + codecID + std::to_string(text.size()) + ":";
+  if (header.size() + ((compressedData.size() + 2) / 3) * 4 >= text.size())
+  {
+    // not worth it
+    return false;
+  }
+  compressedText = header;
+  compressedText.resize(header.size() + ((compressedData.size() + 2) / 3) * 4);
+  size_t length = vtkBase64Utilities::Encode(reinterpret_cast<const unsigned char*>(compressedData.data()),
+    compressedData.size(), reinterpret_cast<unsigned char*>(&compressedText[header.size()]));
+  compressedText.resize(header.size() + length);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationMessageCompression::IsCompressed(const std::string& text)
+{
+  return text.size() > 2 && text[0] == COMPRESSED_TEXT_PREFIX
+    && (text[1] == LZ4_CODEC_ID || text[1] == DEFLATE_CODEC_ID);
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationMessageCompression::Decompress(const std::string& compressedText, std::string& text)
+{
+  if (!IsCompressed(compressedText))
+  {
+    return false;
+  }
+  size_t separator = compressedText.find(':', 2);
+  if (separator == std::string::npos || separator == 2)
+  {
+    return false;
+  }
+  size_t size = std::strtoull(compressedText.substr(2, separator - 2).c_str(), nullptr, 10);
+  size_t encodedLength = compressedText.size() - separator - 1;
+  std::string compressedData((encodedLength / 4) * 3, '\0');
+  size_t compressedSize = vtkBase64Utilities::DecodeSafely(
+    reinterpret_cast<const unsigned char*>(compressedText.data() + separator + 1), encodedLength,
+    reinterpret_cast<unsigned char*>(&compressedData[0]), compressedData.size());
+  compressedData.resize(compressedSize);
+  if (size == 0 || compressedSize == 0 || size > compressedSize * 1024)
+  {
+    // the size is limited by the maximum ratio of the codecs, so that an invalid message cannot allocate too much
+    return false;
+  }
+
+  text.resize(size);
+  if (compressedText[1] == DEFLATE_CODEC_ID)
+  {
+    return InflateWithDictionary(compressedData, text);
+  }
+  vtkNew<vtkLZ4DataCompressor> compressor;
+  return compressor->Uncompress(reinterpret_cast<const unsigned char*>(compressedData.data()), compressedData.size(),
+    reinterpret_cast<unsigned char*>(&text[0]), size) == size;
+}
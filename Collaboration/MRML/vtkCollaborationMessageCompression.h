@@ -0,0 +1,59 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+#ifndef __vtkCollaborationMessageCompression_h
+#define __vtkCollaborationMessageCompression_h
+
+// STD includes
+#include <string>
+#include <vector>
+
+// Collaboration includes
+#include "vtkSlicerCollaborationModuleMRMLExport.h"
+
+/// \brief Compression of the text messages of the collaboration connection.
+///
+/// Two codecs are available: LZ4 for the large messages, and deflate with a preset dictionary of the MRML attribute
+/// names for the small ones, which are mostly synchronization metadata. The compressed data is encoded in base64 after
+/// a prefix identifying the codec, so that the compressed messages remain text. The connector marks the compressed
+/// messages in their meta data, as any text may start with the prefix.
+/// A codec whose dictionary changes must get a new name, as both peers need the same one.
+class VTK_SLICER_COLLABORATION_MODULE_MRML_EXPORT vtkCollaborationMessageCompression
+{
+public:
+  /// Names of the codecs that can be decompressed, in order of preference
+  static std::vector<std::string> GetSupportedCodecs();
+
+  /// Compress a text with the most suitable of the given codecs. Return false if none of them is supported, or if
+  /// the compressed text would not be smaller than the text.
+  static bool Compress(const std::string& text, const std::vector<std::string>& codecs, std::string& compressedText);
+  /// Return true if the text was produced by Compress
+  static bool IsCompressed(const std::string& text);
+  /// Decompress a text produced by Compress. Return false if the text is invalid or its codec is not supported.
+  static bool Decompress(const std::string& compressedText, std::string& text);
+
+  static const char* LZ4CodecName;
+  static const char* DeflateCodecName;
+  /// Texts smaller than this are compressed with deflate and its dictionary, the larger ones with LZ4
+  static const size_t DictionaryCodecMaximumSize = 8192;
+};
+
+#endif
@@ -0,0 +1,570 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+#include "vtkCollaborationNodeCodec.h"
+#include "vtkCollaborationAttributeSchema.h"
+#include "vtkCollaborationSegmentationCodec.h"
+#include "vtkMRMLCollaborationNode.h"
+
+// Slicer MRML includes
+#include <vtkMRMLDisplayNode.h>
+#include <vtkMRMLDisplayableNode.h>
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLMarkupsNode.h>
+#include <vtkMRMLMarkupsROINode.h>
+#include <vtkMRMLTransformableNode.h>
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkStringArray.h>
+#include <vtkXMLDataElement.h>
+
+// STD includes
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+namespace
+{
+struct CodecRegistry
+{
+  std::mutex Mutex;
+  /// Codecs in registration order, superclasses are registered before their subclasses
+  std::vector<std::shared_ptr<vtkCollaborationNodeCodec> > Codecs;
+  /// Codec found for each node class, including the classes using the codec of a superclass
+  std::map<std::string, vtkCollaborationNodeCodec*> CodecsByClassName;
+};
+
+CodecRegistry& GetRegistry()
+{
+  static CodecRegistry registry;
+  return registry;
+}
+
+/// Get the attributes of a message in the format of vtkMRMLNode::ReadXMLAttributes
+std::vector<const char*> GetAttributes(vtkXMLDataElement* element)
+{
+  std::vector<const char*> atts;
+  for (int attributeIndex = 0; attributeIndex < element->GetNumberOfAttributes(); attributeIndex++)
+  {
+    atts.push_back(element->GetAttributeName(attributeIndex));
+    atts.push_back(element->GetAttributeValue(attributeIndex));
+  }
+  atts.push_back(nullptr);
+  return atts;
+}
+
+/// Read the points of a "[x,y,z];[x,y,z];..." list. Return false if the list is malformed.
+bool ReadPointList(const char* text, vtkPoints* points)
+{
+  points->Reset();
+  const char* position = text;
+  while (*position)
+  {
+    double point[3] = { 0.0, 0.0, 0.0 };
+    for (int i = 0; i < 3; i++)
+    {
+      // skip the brackets and separators
+      while (*position == '[' || *position == ']' || *position == ',' || *position == ';' || *position == ' ')
+      {
+        position++;
+      }
+      char* end = nullptr;
+      point[i] = std::strtod(position, &end);
+      if (end == position)
+      {
+        return false;
+      }
+      position = end;
+    }
+    points->InsertNextPoint(point);
+    while (*position == ']' || *position == ';' || *position == ' ')
+    {
+      position++;
+    }
+  }
+  return true;
+}
+
+/// Write the points as a "[x,y,z];[x,y,z];..." list
+std::string WritePointList(vtkPoints* points)
+{
+  std::string text;
+  for (vtkIdType p = 0; p < points->GetNumberOfPoints(); p++)
+  {
+    double point[3] = { 0.0, 0.0, 0.0 };
+    points->GetPoint(p, point);
+    text.append(p > 0 ? ";[" : "[");
+    text.append(std::to_string(point[0]));
+    text.append(",");
+    text.append(std::to_string(point[1]));
+    text.append(",");
+    text.append(std::to_string(point[2]));
+    text.append("]");
+  }
+  return text;
+}
+
+//----------------------------------------------------------------------------
+/// Markups other than fiducials, only sent as metadata with their control points in world coordinates
+class MarkupsCodec : public vtkCollaborationTypedNodeCodec<vtkMRMLMarkupsNode>
+{
+public:
+  MarkupsCodec() : vtkCollaborationTypedNodeCodec<vtkMRMLMarkupsNode>("vtkMRMLMarkupsNode", "Markups", 20) {}
+  bool IsPushed() override { return false; }
+  // control point events are not modified events
+  unsigned long GetModifiedEvent() override { return vtkCommand::AnyEvent; }
+
+protected:
+  std::string SerializeNode(vtkMRMLMarkupsNode* markupsNode, vtkMRMLCollaborationNode* vtkNotUsed(collabNode), bool binary) override
+  {
+    std::string text;
+    if (EncodeAttributeRecord(markupsNode, markupsNode->GetName(), binary, text))
+    {
+      return text;
+    }
+    vtkNew<vtkPoints> controlPoints;
+    markupsNode->GetControlPointPositionsWorld(controlPoints);
+
+    // write an XML text with the markups node attributes
+    std::stringstream ss;
+    ss << "<MRMLNode SuperclassName = \"vtkMRMLMarkupsNode\" ClassName = \"";
+    ss << markupsNode->GetClassName();
+    ss << "\"  ControlPoints = \"" << WritePointList(controlPoints) << "\"";
+    // check if it is a ROI markups node to get ROI radius
+    vtkMRMLMarkupsROINode* markupsROINode = vtkMRMLMarkupsROINode::SafeDownCast(markupsNode);
+    if (markupsROINode)
+    {
+      vtkNew<vtkPoints> radius;
+      radius->InsertNextPoint(markupsROINode->GetRadiusXYZ());
+      ss << " ROIRadius = \"" << WritePointList(radius) << "\"";
+    }
+    markupsNode->WriteXML(ss, 0);
+    ss << " />";
+    return ss.str();
+  }
+
+  std::string GetTargetNodeName(vtkXMLDataElement* element) override
+  {
+    const char* nodeName = element->GetAttribute("name");
+    if (!nodeName || !element->GetAttribute("ClassName") || !element->GetAttribute("ControlPoints"))
+    {
+      vtkGenericWarningMacro("vtkCollaborationNodeCodec: Invalid markups message");
+      return std::string();
+    }
+    return nodeName;
+  }
+
+  vtkMRMLMarkupsNode* GetTargetNode(vtkMRMLScene* scene, vtkXMLDataElement* element, const std::string& targetNodeName,
+    vtkSmartPointer<vtkMRMLMarkupsNode>& newNode) override
+  {
+    const char* className = element->GetAttribute("ClassName");
+    vtkMRMLMarkupsNode* markupsNode = vtkMRMLMarkupsNode::SafeDownCast(scene->GetFirstNodeByName(targetNodeName.c_str()));
+    if (markupsNode && strcmp(markupsNode->GetClassName(), className) == 0)
+    {
+      return markupsNode;
+    }
+    newNode = vtkSmartPointer<vtkMRMLMarkupsNode>::Take(vtkMRMLMarkupsNode::SafeDownCast(scene->CreateNodeByClass(className)));
+    if (!newNode)
+    {
+      vtkGenericWarningMacro("vtkCollaborationNodeCodec: Invalid markups class " << className);
+    }
+    return newNode;
+  }
+
+  bool DeserializeNode(vtkMRMLMarkupsNode* markupsNode, vtkXMLDataElement* element) override
+  {
+    // get every control point in one list of world positions
+    vtkNew<vtkPoints> controlPoints;
+    if (!ReadPointList(element->GetAttribute("ControlPoints"), controlPoints))
+    {
+      vtkGenericWarningMacro("vtkCollaborationNodeCodec: Invalid control points of markups " << element->GetAttribute("name"));
+      return false;
+    }
+    // the attributes and all the control points are applied in a single update, so that the curve is interpolated once
+    std::vector<const char*> atts = GetAttributes(element);
+    markupsNode->ReadXMLAttributes(atts.data());
+    markupsNode->SetControlPointPositionsWorld(controlPoints);
+
+    // apply ROI radius
+    vtkMRMLMarkupsROINode* roiNode = vtkMRMLMarkupsROINode::SafeDownCast(markupsNode);
+    const char* roiRadiusStr = element->GetAttribute("ROIRadius");
+    vtkNew<vtkPoints> roiRadius;
+    if (roiNode && roiRadiusStr && ReadPointList(roiRadiusStr, roiRadius) && roiRadius->GetNumberOfPoints() == 1)
+    {
+      roiNode->SetRadiusXYZ(roiRadius->GetPoint(0));
+    }
+    return true;
+  }
+};
+
+//----------------------------------------------------------------------------
+/// Display properties, identified by the name of the displayable node
+class DisplayCodec : public vtkCollaborationTypedNodeCodec<vtkMRMLDisplayNode>
+{
+public:
+  DisplayCodec(const char* nodeClassName, const char* displayableClassName, unsigned long modifiedEvent)
+    : vtkCollaborationTypedNodeCodec<vtkMRMLDisplayNode>(nodeClassName, "Display", 10)
+    , DisplayableClassName(displayableClassName)
+    , ModifiedEvent(modifiedEvent)
+  {
+  }
+  bool IsSelectable() override { return false; }
+  unsigned long GetModifiedEvent() override { return this->ModifiedEvent; }
+
+protected:
+  std::string SerializeNode(vtkMRMLDisplayNode* displayNode, vtkMRMLCollaborationNode* vtkNotUsed(collabNode), bool binary) override
+  {
+    vtkMRMLDisplayableNode* displayableNode = displayNode->GetDisplayableNode();
+    if (!displayableNode || !displayableNode->GetName())
+    {
+      return std::string();
+    }
+    std::string text;
+    if (EncodeAttributeRecord(displayNode, displayableNode->GetName(), binary, text))
+    {
+      return text;
+    }
+    // write an XML text with the display node attributes
+    std::stringstream ss;
+    ss << "<MRMLNode SuperclassName = \"vtkMRMLDisplayNode\" ClassName = \"";
+    ss << this->GetNodeClassName();
+    ss << "\" NodeName = \"";
+    ss << displayableNode->GetName();
+    ss << "\"";
+    displayNode->WriteXML(ss, 0);
+    ss << " />";
+    return ss.str();
+  }
+
+  std::string GetTargetNodeName(vtkXMLDataElement* element) override
+  {
+    const char* nodeName = element->GetAttribute("NodeName");
+    return nodeName ? nodeName : std::string();
+  }
+
+  vtkMRMLDisplayNode* GetTargetNode(vtkMRMLScene* scene, vtkXMLDataElement* vtkNotUsed(element), const std::string& targetNodeName,
+    vtkSmartPointer<vtkMRMLDisplayNode>& vtkNotUsed(newNode)) override
+  {
+    // the display node is created with the displayable node
+    vtkMRMLDisplayableNode* displayableNode = vtkMRMLDisplayableNode::SafeDownCast(
+      scene->GetFirstNode(targetNodeName.c_str(), this->DisplayableClassName.c_str()));
+    vtkMRMLDisplayNode* displayNode = displayableNode ? displayableNode->GetDisplayNode() : nullptr;
+    return (displayNode && displayNode->IsA(this->GetNodeClassName())) ? displayNode : nullptr;
+  }
+
+  bool DeserializeNode(vtkMRMLDisplayNode* displayNode, vtkXMLDataElement* element) override
+  {
+    // apply attributes and copy them to the current display node
+    vtkSmartPointer<vtkMRMLDisplayNode> receivedDisplayNode = vtkSmartPointer<vtkMRMLDisplayNode>::Take(
+      vtkMRMLDisplayNode::SafeDownCast(displayNode->GetScene()->CreateNodeByClass(this->GetNodeClassName())));
+    if (!receivedDisplayNode)
+    {
+      return false;
+    }
+    std::vector<const char*> atts = GetAttributes(element);
+    receivedDisplayNode->ReadXMLAttributes(atts.data());
+    displayNode->Copy(receivedDisplayNode);
+    std::string displayNodeName = std::string(element->GetAttribute("NodeName")) + "DisplayNode";
+    displayNode->SetName(displayNodeName.c_str());
+    displayNode->GetDisplayableNode()->Modified();
+    return true;
+  }
+
+  std::string DisplayableClassName;
+  unsigned long ModifiedEvent;
+};
+
+//----------------------------------------------------------------------------
+/// Linear transforms, pushed as nodes and described by the names of the nodes they transform
+class TransformCodec : public vtkCollaborationTypedNodeCodec<vtkMRMLLinearTransformNode>
+{
+public:
+  TransformCodec() : vtkCollaborationTypedNodeCodec<vtkMRMLLinearTransformNode>("vtkMRMLLinearTransformNode", "Transform", 20) {}
+  // the transformed nodes are observed instead, the matrix is pushed
+  unsigned long GetModifiedEvent() override { return vtkCommand::NoEvent; }
+
+protected:
+  std::string SerializeNode(vtkMRMLLinearTransformNode* transformNode, vtkMRMLCollaborationNode* collabNode, bool vtkNotUsed(binary)) override
+  {
+    vtkMRMLScene* scene = transformNode->GetScene();
+    if (!collabNode || !scene || !transformNode->GetID())
+    {
+      return std::string();
+    }
+    // get transformed nodes
+    std::string transformNodeID = transformNode->GetID();
+    vtkSmartPointer<vtkStringArray> synchronizedNodeIDs =
+      vtkSmartPointer<vtkStringArray>::Take(collabNode->GetCollaborationSynchronizedNodeIDs());
+    std::string transformedNodesText;
+    for (int i = 0; i < synchronizedNodeIDs->GetNumberOfTuples(); i++)
+    {
+      vtkMRMLNode* node = scene->GetNodeByID(synchronizedNodeIDs->GetValue(i));
+      vtkMRMLNode* nodeTransformNode = node ? node->GetNodeReference("transform") : nullptr;
+      if (nodeTransformNode && transformNodeID == nodeTransformNode->GetID())
+      {
+        transformedNodesText.append(transformedNodesText.empty() ? "" : ",");
+        transformedNodesText.append(node->GetName());
+      }
+    }
+    // write an XML text with the transform node attributes
+    std::stringstream ss;
+    ss << "<MRMLNode SuperclassName = \"vtkMRMLTransformNode\" ClassName = \"vtkMRMLLinearTransformNode\" TransformName = \"";
+    ss << transformNode->GetName();
+    ss << "\" TransformedNodes = \"";
+    ss << transformedNodesText;
+    ss << "\"";
+    ss << " />";
+    return ss.str();
+  }
+
+  std::string GetTargetNodeName(vtkXMLDataElement* element) override
+  {
+    const char* transformName = element->GetAttribute("TransformName");
+    return (transformName && element->GetAttribute("TransformedNodes")) ? transformName : std::string();
+  }
+
+  vtkMRMLLinearTransformNode* GetTargetNode(vtkMRMLScene* scene, vtkXMLDataElement* vtkNotUsed(element),
+    const std::string& targetNodeName, vtkSmartPointer<vtkMRMLLinearTransformNode>& vtkNotUsed(newNode)) override
+  {
+    // the transform node is created when its matrix is received
+    return vtkMRMLLinearTransformNode::SafeDownCast(scene->GetFirstNode(targetNodeName.c_str(), "vtkMRMLLinearTransformNode"));
+  }
+
+  bool DeserializeNode(vtkMRMLLinearTransformNode* transformNode, vtkXMLDataElement* element) override
+  {
+    // get every transformed node
+    std::stringstream ss(element->GetAttribute("TransformedNodes"));
+    std::string transformedNodeName;
+    while (std::getline(ss, transformedNodeName, ','))
+    {
+      vtkMRMLTransformableNode* node = vtkMRMLTransformableNode::SafeDownCast(
+        transformNode->GetScene()->GetFirstNodeByName(transformedNodeName.c_str()));
+      if (node)
+      {
+        node->SetAndObserveTransformNodeID(transformNode->GetID());
+      }
+    }
+    return true;
+  }
+
+  // the transformed nodes may be received later
+  bool IsKeptForNewNodes() override { return true; }
+};
+}
+
+//----------------------------------------------------------------------------
+vtkCollaborationNodeCodec::vtkCollaborationNodeCodec(const char* nodeClassName, const char* metadataType, int priority)
+  : NodeClassName(nodeClassName ? nodeClassName : "")
+  , MetadataType(metadataType ? metadataType : "")
+  , Priority(priority)
+{
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationNodeCodec::ComputeDelta(vtkMRMLNode* vtkNotUsed(node), vtkMRMLCollaborationNode* vtkNotUsed(collabNode),
+  const std::string& previousText, const std::string& text, std::string& delta)
+{
+  if (text == previousText)
+  {
+    // nothing changed, for example a display node event not related to the synchronized properties
+    return false;
+  }
+  delta = text;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationNodeCodec::EncodeAttributeRecord(vtkMRMLNode* node, const char* nodeName, bool binary, std::string& text)
+{
+  vtkCollaborationAttributeSchema* schema = binary ? vtkCollaborationAttributeSchema::GetSchemaOfNode(node) : nullptr;
+  if (!schema || !nodeName)
+  {
+    // classes without schema are described in XML
+    return false;
+  }
+  text = vtkCollaborationAttributeSchema::EncodeRecordAsText(schema->WriteRecord(node, nodeName));
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Registry
+
+//----------------------------------------------------------------------------
+void vtkCollaborationNodeCodec::RegisterCodec(std::shared_ptr<vtkCollaborationNodeCodec> codec)
+{
+  // the default codecs are registered first, so that they can be replaced
+  registerDefaultCodecs();
+  registerCodecInternal(codec);
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationNodeCodec::registerCodecInternal(std::shared_ptr<vtkCollaborationNodeCodec> codec)
+{
+  if (!codec)
+  {
+    return;
+  }
+  CodecRegistry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.Mutex);
+  std::vector<std::shared_ptr<vtkCollaborationNodeCodec> >& codecs = registry.Codecs;
+  codecs.erase(std::remove_if(codecs.begin(), codecs.end(),
+    [&codec](const std::shared_ptr<vtkCollaborationNodeCodec>& registeredCodec)
+    { return registeredCodec->NodeClassName == codec->NodeClassName; }),
+    codecs.end());
+  codecs.push_back(codec);
+  // the classes using the codec of a superclass are looked up again
+  registry.CodecsByClassName.clear();
+}
+
+//----------------------------------------------------------------------------
+vtkCollaborationNodeCodec* vtkCollaborationNodeCodec::GetCodecOfNode(vtkMRMLNode* node)
+{
+  if (!node)
+  {
+    return nullptr;
+  }
+  registerDefaultCodecs();
+  CodecRegistry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.Mutex);
+  auto classIt = registry.CodecsByClassName.find(node->GetClassName());
+  if (classIt != registry.CodecsByClassName.end())
+  {
+    return classIt->second;
+  }
+  // the codec of the closest class in the hierarchy of the node, whatever the order the codecs were registered in
+  vtkCollaborationNodeCodec* nodeCodec = nullptr;
+  vtkIdType nodeCodecGenerations = -1;
+  for (const std::shared_ptr<vtkCollaborationNodeCodec>& codec : registry.Codecs)
+  {
+    vtkIdType generations = node->GetNumberOfGenerationsFromBase(codec->GetNodeClassName());
+    if (generations >= 0 && (!nodeCodec || generations < nodeCodecGenerations))
+    {
+      nodeCodec = codec.get();
+      nodeCodecGenerations = generations;
+    }
+  }
+  registry.CodecsByClassName[node->GetClassName()] = nodeCodec;
+  return nodeCodec;
+}
+
+//----------------------------------------------------------------------------
+vtkCollaborationNodeCodec* vtkCollaborationNodeCodec::GetCodecOfClass(const char* className, vtkMRMLScene* scene)
+{
+  if (!className)
+  {
+    return nullptr;
+  }
+  registerDefaultCodecs();
+  {
+    CodecRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.Mutex);
+    auto classIt = registry.CodecsByClassName.find(className);
+    if (classIt != registry.CodecsByClassName.end())
+    {
+      return classIt->second;
+    }
+    for (const std::shared_ptr<vtkCollaborationNodeCodec>& codec : registry.Codecs)
+    {
+      if (codec->NodeClassName == className)
+      {
+        registry.CodecsByClassName[className] = codec.get();
+        return codec.get();
+      }
+    }
+  }
+  // the class hierarchy is only known by an instance
+  vtkSmartPointer<vtkMRMLNode> node = scene ? vtkSmartPointer<vtkMRMLNode>::Take(scene->CreateNodeByClass(className)) : nullptr;
+  return node ? GetCodecOfNode(node) : nullptr;
+}
+
+//----------------------------------------------------------------------------
+std::vector<std::string> vtkCollaborationNodeCodec::GetSelectableNodeClassNames()
+{
+  registerDefaultCodecs();
+  CodecRegistry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.Mutex);
+  std::vector<std::string> classNames;
+  for (const std::shared_ptr<vtkCollaborationNodeCodec>& codec : registry.Codecs)
+  {
+    if (codec->IsSelectable())
+    {
+      classNames.push_back(codec->NodeClassName);
+    }
+  }
+  return classNames;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationNodeCodec::ProcessPendingCodecTasks()
+{
+  registerDefaultCodecs();
+  std::vector<std::shared_ptr<vtkCollaborationNodeCodec> > codecs;
+  {
+    CodecRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.Mutex);
+    codecs = registry.Codecs;
+  }
+  // the tasks may modify the scene, which may look up codecs
+  for (const std::shared_ptr<vtkCollaborationNodeCodec>& codec : codecs)
+  {
+    codec->ProcessPendingTasks();
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationNodeCodec::HasPendingCodecTasks()
+{
+  CodecRegistry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.Mutex);
+  for (const std::shared_ptr<vtkCollaborationNodeCodec>& codec : registry.Codecs)
+  {
+    if (codec->HasPendingTasks())
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationNodeCodec::registerDefaultCodecs()
+{
+  static std::once_flag registered;
+  std::call_once(registered, []()
+  {
+    // small nodes are pushed before the large models and volumes
+    registerCodecInternal(std::make_shared<vtkCollaborationNodeCodec>("vtkMRMLModelNode"));
+    registerCodecInternal(std::make_shared<vtkCollaborationNodeCodec>("vtkMRMLScalarVolumeNode"));
+    registerCodecInternal(std::make_shared<vtkCollaborationNodeCodec>("vtkMRMLTextNode", nullptr, 20));
+    registerCodecInternal(std::make_shared<TransformCodec>());
+    registerCodecInternal(std::make_shared<MarkupsCodec>());
+    registerCodecInternal(std::make_shared<vtkCollaborationNodeCodec>("vtkMRMLMarkupsFiducialNode", nullptr, 20));
+    registerCodecInternal(std::make_shared<vtkCollaborationSegmentationCodec>());
+    // the markups are sent before their display, so that it does not wait for them on the receiver
+    registerCodecInternal(std::make_shared<DisplayCodec>("vtkMRMLModelDisplayNode", "vtkMRMLModelNode", vtkCommand::AnyEvent));
+    registerCodecInternal(std::make_shared<DisplayCodec>("vtkMRMLMarkupsDisplayNode", "vtkMRMLMarkupsNode", vtkCommand::ModifiedEvent));
+  });
+}
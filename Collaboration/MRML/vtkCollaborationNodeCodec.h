@@ -0,0 +1,201 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+#ifndef __vtkCollaborationNodeCodec_h
+#define __vtkCollaborationNodeCodec_h
+
+// MRML includes
+#include <vtkMRMLNode.h>
+#include <vtkMRMLScene.h>
+
+// VTK includes
+#include <vtkCommand.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <memory>
+#include <string>
+#include <vector>
+
+// Collaboration includes
+#include "vtkSlicerCollaborationModuleMRMLExport.h"
+
+class vtkMRMLCollaborationNode;
+class vtkXMLDataElement;
+
+/// \brief Synchronization of the nodes of one MRML class.
+///
+/// A codec tells how the nodes of its class are synchronized: whether their content is pushed
+/// through OpenIGTLink, how their synchronization metadata is serialized and applied on the receiver,
+/// which part of it needs to be sent after a change, and in which order it is sent.
+/// Codecs are registered once per class, and the nodes use the codec of their closest registered class.
+///
+/// The base class pushes the nodes without metadata. Codecs with metadata derive from vtkCollaborationTypedNodeCodec.
+class VTK_SLICER_COLLABORATION_MODULE_MRML_EXPORT vtkCollaborationNodeCodec
+{
+public:
+  enum DeserializeResult
+  {
+    /// The message could not be applied
+    DeserializeFailed,
+    /// The message was applied to its target node
+    DeserializeApplied,
+    /// The target node does not exist yet, the message is applied when a node with the target name is added
+    DeserializeDeferred,
+    /// The message is applied again each time a node is added, as it may refer to the new node
+    DeserializeKept
+  };
+
+  /// Create a codec for a node class. If metadataType is set, the nodes are described by synchronization metadata
+  /// of this type. Metadata and pushes of higher priority are sent first.
+  vtkCollaborationNodeCodec(const char* nodeClassName, const char* metadataType = nullptr, int priority = 0);
+  virtual ~vtkCollaborationNodeCodec() = default;
+
+  const char* GetNodeClassName() { return this->NodeClassName.c_str(); }
+  /// Type of the synchronization metadata of the nodes, nullptr if they have none
+  const char* GetMetadataType() { return this->MetadataType.empty() ? nullptr : this->MetadataType.c_str(); }
+  virtual int GetPriority() { return this->Priority; }
+
+  /// Whether the content of the nodes is pushed through OpenIGTLink. Otherwise they are only described by metadata.
+  virtual bool IsPushed() { return true; }
+  /// Whether the nodes can be selected for synchronization. Display nodes are synchronized with their displayable node.
+  virtual bool IsSelectable() { return true; }
+  /// Event of the nodes after which their metadata is serialized again, vtkCommand::NoEvent if it does not depend on the node
+  virtual unsigned long GetModifiedEvent() { return vtkCommand::ModifiedEvent; }
+
+  /// Serializer: synchronization metadata of the node, empty if there is none.
+  /// If binary is true, the attributes may be encoded with their vtkCollaborationAttributeSchema.
+  virtual std::string Serialize(vtkMRMLNode* vtkNotUsed(node), vtkMRMLCollaborationNode* vtkNotUsed(collabNode), bool vtkNotUsed(binary))
+  {
+    return std::string();
+  }
+  /// Deserializer: apply a received metadata message. Returns a DeserializeResult, the name of the node
+  /// the message refers to and the node it was applied to.
+  virtual int Deserialize(vtkMRMLScene* vtkNotUsed(scene), vtkXMLDataElement* vtkNotUsed(element),
+    std::string& vtkNotUsed(targetNodeName), vtkMRMLNode*& updatedNode)
+  {
+    updatedNode = nullptr;
+    return DeserializeFailed;
+  }
+  /// Delta: message to send to the peers of the collaboration node after the metadata of a node changed from
+  /// previousText to text. Returns false if nothing needs to be sent. By default the full metadata is sent when it
+  /// has changed. An empty previousText means that the peer has none of the metadata of the node, for example after
+  /// connecting.
+  virtual bool ComputeDelta(vtkMRMLNode* node, vtkMRMLCollaborationNode* collabNode, const std::string& previousText,
+    const std::string& text, std::string& delta);
+  /// Whether each delta describes the whole metadata of the node. A delta that the peer has not received yet is then
+  /// replaced by the next one of the same node. Codecs sending only the changes since the previous delta return false.
+  virtual bool IsDeltaLatestValueWins() { return true; }
+  /// Forget the state kept for a node that is not synchronized anymore by the collaboration node
+  virtual void ResetNode(vtkMRMLNode* vtkNotUsed(node), vtkMRMLCollaborationNode* vtkNotUsed(collabNode)) {}
+  /// Apply the results of the work done in the background for the received messages. Called periodically by the connectors.
+  virtual void ProcessPendingTasks() {}
+  /// Whether work is still in progress in the background for the received messages
+  virtual bool HasPendingTasks() { return false; }
+
+  /// Register a codec. A codec of the same class replaces the previous one.
+  static void RegisterCodec(std::shared_ptr<vtkCollaborationNodeCodec> codec);
+  /// Get the codec of a node class, or of its closest registered superclass. Return nullptr if there is none.
+  static vtkCollaborationNodeCodec* GetCodecOfNode(vtkMRMLNode* node);
+  /// Get the codec of a node class by name. Classes without their own codec are instantiated once in the scene
+  /// to find the codec of their superclasses.
+  static vtkCollaborationNodeCodec* GetCodecOfClass(const char* className, vtkMRMLScene* scene);
+  /// Classes of the registered codecs of selectable nodes
+  static std::vector<std::string> GetSelectableNodeClassNames();
+  /// Call ProcessPendingTasks of all the registered codecs
+  static void ProcessPendingCodecTasks();
+  /// Return true if one of the registered codecs has work in progress
+  static bool HasPendingCodecTasks();
+
+protected:
+  /// Encode the attributes with the schema of the node class, if binary is requested and there is one
+  static bool EncodeAttributeRecord(vtkMRMLNode* node, const char* nodeName, bool binary, std::string& text);
+
+  /// Register the codecs of the node classes synchronized by the module
+  static void registerDefaultCodecs();
+  static void registerCodecInternal(std::shared_ptr<vtkCollaborationNodeCodec> codec);
+
+  std::string NodeClassName;
+  std::string MetadataType;
+  int Priority;
+};
+
+/// \brief Base of the codecs with synchronization metadata.
+///
+/// The hooks receive the nodes already cast to the codec class. Deserialize finds the target node of the message,
+/// or creates it, and applies the message in a single node modification.
+template <class NodeType>
+class vtkCollaborationTypedNodeCodec : public vtkCollaborationNodeCodec
+{
+public:
+  using vtkCollaborationNodeCodec::vtkCollaborationNodeCodec;
+
+  std::string Serialize(vtkMRMLNode* node, vtkMRMLCollaborationNode* collabNode, bool binary) override
+  {
+    NodeType* typedNode = NodeType::SafeDownCast(node);
+    return typedNode ? this->SerializeNode(typedNode, collabNode, binary) : std::string();
+  }
+
+  int Deserialize(vtkMRMLScene* scene, vtkXMLDataElement* element, std::string& targetNodeName, vtkMRMLNode*& updatedNode) override
+  {
+    updatedNode = nullptr;
+    targetNodeName = this->GetTargetNodeName(element);
+    if (!scene || !element || targetNodeName.empty())
+    {
+      return DeserializeFailed;
+    }
+    vtkSmartPointer<NodeType> newNode;
+    NodeType* node = this->GetTargetNode(scene, element, targetNodeName, newNode);
+    if (!node)
+    {
+      return this->IsKeptForNewNodes() ? DeserializeKept : DeserializeDeferred;
+    }
+    bool success = false;
+    {
+      MRMLNodeModifyBlocker blocker(node);
+      success = this->DeserializeNode(node, element);
+    }
+    if (newNode)
+    {
+      scene->AddNode(newNode);
+    }
+    updatedNode = node;
+    if (!success)
+    {
+      return DeserializeFailed;
+    }
+    return this->IsKeptForNewNodes() ? DeserializeKept : DeserializeApplied;
+  }
+
+protected:
+  virtual std::string SerializeNode(NodeType* node, vtkMRMLCollaborationNode* collabNode, bool binary) = 0;
+  /// Name of the node the message refers to
+  virtual std::string GetTargetNodeName(vtkXMLDataElement* element) = 0;
+  /// Find the node the message applies to. If it is created, it is returned in newNode and added to the scene
+  /// after the message is applied. Returns nullptr if the node cannot be found nor created yet.
+  virtual NodeType* GetTargetNode(vtkMRMLScene* scene, vtkXMLDataElement* element, const std::string& targetNodeName,
+    vtkSmartPointer<NodeType>& newNode) = 0;
+  virtual bool DeserializeNode(NodeType* node, vtkXMLDataElement* element) = 0;
+  /// Whether the received messages are applied again when nodes are added
+  virtual bool IsKeptForNewNodes() { return false; }
+};
+
+#endif
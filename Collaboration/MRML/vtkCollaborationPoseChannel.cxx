@@ -0,0 +1,632 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+#include "vtkCollaborationPoseChannel.h"
+
+// VTK includes
+#include <vtkSetGet.h>
+
+// STD includes
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+# ifndef NOMINMAX
+#  define NOMINMAX
+# endif
+# include <winsock2.h>
+# include <ws2tcpip.h>
+# include <mstcpip.h>
+typedef SOCKET SocketType;
+typedef int SocketLength;
+#else
+# include <arpa/inet.h>
+# include <fcntl.h>
+# include <netdb.h>
+# include <netinet/in.h>
+# include <sys/select.h>
+# include <sys/socket.h>
+# include <unistd.h>
+typedef int SocketType;
+typedef socklen_t SocketLength;
+#endif
+
+namespace
+{
+const uint32_t DATAGRAM_MAGIC = 0x53435044;
+/// Incremented when the layout of the datagrams changes
+const uint8_t DATAGRAM_VERSION = 1;
+enum DatagramType : uint8_t
+{
+  DatagramHeartbeat = 1,
+  DatagramPose = 2
+};
+/// Set by the sender if it receives the datagrams of the receiver
+const uint8_t FLAG_PEER_HEARD = 1;
+/// Magic, version, type, flags, name length, token of the receiver and sequence number
+const size_t DATAGRAM_HEADER_SIZE = 24;
+const size_t MAXIMUM_DATAGRAM_SIZE = DATAGRAM_HEADER_SIZE + vtkCollaborationPoseChannel::MaximumNameLength + 16 * 8;
+/// Time in milliseconds the receiving thread waits for datagrams before sending the heartbeats and the repeats
+const int POLLING_TIMEOUT = 20;
+const int HEARTBEAT_INTERVAL = 200;
+/// Time in milliseconds without datagrams after which a direction of the channel is considered blocked
+const int REACHABILITY_TIMEOUT = 1000;
+/// The last pose of a transform that stopped moving is sent again, in case its datagram was lost
+const int REPEAT_INTERVAL = 50;
+const int NUMBER_OF_REPEATS = 3;
+
+#ifdef _WIN32
+const SocketType INVALID_SOCKET_VALUE = INVALID_SOCKET;
+#else
+const SocketType INVALID_SOCKET_VALUE = -1;
+#endif
+
+//----------------------------------------------------------------------------
+void CloseSocket(SocketType socket)
+{
+#ifdef _WIN32
+  closesocket(socket);
+#else
+  close(socket);
+#endif
+}
+
+//----------------------------------------------------------------------------
+/// Integers in network byte order
+void WriteUInt32(char* data, uint32_t value)
+{
+  for (int byteIndex = 0; byteIndex < 4; byteIndex++)
+  {
+    data[byteIndex] = static_cast<char>((value >> (24 - 8 * byteIndex)) & 0xff);
+  }
+}
+
+//----------------------------------------------------------------------------
+uint32_t ReadUInt32(const char* data)
+{
+  uint32_t value = 0;
+  for (int byteIndex = 0; byteIndex < 4; byteIndex++)
+  {
+    value = (value << 8) | static_cast<unsigned char>(data[byteIndex]);
+  }
+  return value;
+}
+
+//----------------------------------------------------------------------------
+void WriteUInt64(char* data, uint64_t value)
+{
+  WriteUInt32(data, static_cast<uint32_t>(value >> 32));
+  WriteUInt32(data + 4, static_cast<uint32_t>(value & 0xffffffff));
+}
+
+//----------------------------------------------------------------------------
+uint64_t ReadUInt64(const char* data)
+{
+  return (static_cast<uint64_t>(ReadUInt32(data)) << 32) | ReadUInt32(data + 4);
+}
+}
+
+//----------------------------------------------------------------------------
+class vtkCollaborationPoseChannel::vtkInternal
+{
+public:
+  typedef std::chrono::steady_clock::time_point TimePoint;
+
+  struct SentPose
+  {
+    Pose Value;
+    TimePoint SendTime;
+    int Repeats{ 0 };
+  };
+
+  /// Functions called with the mutex locked
+  bool IsPeerReachable(TimePoint now);
+  void SendDatagram(uint8_t type, const Pose* pose, TimePoint now);
+  void ResetPeer();
+
+  /// Read a datagram. Return true if it is a pose to be read.
+  bool ProcessDatagram(const char* data, size_t size, const sockaddr_in& senderAddress);
+  void ReceiveLoop();
+
+  SocketType Socket{ INVALID_SOCKET_VALUE };
+  std::function<void()> NotificationCallback;
+  std::thread ReceiveThread;
+  std::atomic<bool> StopRequested{ false };
+  bool Opened{ false };
+  int LocalPort{ 0 };
+  uint64_t LocalToken{ 0 };
+
+  /// Guards the peer and the poses, accessed by the caller and by the receiving thread
+  std::mutex Mutex;
+  uint64_t PeerToken{ 0 };
+  bool PeerSet{ false };
+  sockaddr_in PeerAddress;
+  bool PeerAddressKnown{ false };
+  /// The address of the peer was given, it is not learned from its datagrams
+  bool PeerAddressFixed{ false };
+  /// Last datagram received from the peer, and last one telling that the peer receives ours
+  TimePoint LastReceivedTime;
+  TimePoint LastHeardTime;
+  bool Received{ false };
+  bool Heard{ false };
+  /// Reachability last notified to the caller
+  bool Reachable{ false };
+  TimePoint LastHeartbeatTime;
+  uint64_t NextSequenceNumber{ 1 };
+  std::map<std::string, SentPose> SentPoses;
+  std::map<std::string, uint64_t> ReceivedSequenceNumbers;
+  /// Latest received poses that have not been read, by name
+  std::map<std::string, Pose> ReceivedPoses;
+
+  std::atomic<uint64_t> NumberOfSentPoses{ 0 };
+  std::atomic<uint64_t> NumberOfReceivedPoses{ 0 };
+  std::atomic<uint64_t> NumberOfDroppedPoses{ 0 };
+  std::atomic<uint64_t> NumberOfRepeatedPoses{ 0 };
+};
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationPoseChannel::vtkInternal::IsPeerReachable(TimePoint now)
+{
+  const std::chrono::milliseconds timeout(REACHABILITY_TIMEOUT);
+  return this->PeerSet && this->PeerAddressKnown
+    && this->Received && now - this->LastReceivedTime < timeout
+    && this->Heard && now - this->LastHeardTime < timeout;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationPoseChannel::vtkInternal::SendDatagram(uint8_t type, const Pose* pose, TimePoint now)
+{
+  if (!this->PeerSet || !this->PeerAddressKnown)
+  {
+    return;
+  }
+  char datagram[MAXIMUM_DATAGRAM_SIZE];
+  size_t nameLength = pose ? pose->Name.size() : 0;
+  WriteUInt32(datagram, DATAGRAM_MAGIC);
+  datagram[4] = static_cast<char>(DATAGRAM_VERSION);
+  datagram[5] = static_cast<char>(type);
+  // tells the peer whether its datagrams arrive
+  bool peerHeard = this->Received && now - this->LastReceivedTime < std::chrono::milliseconds(REACHABILITY_TIMEOUT);
+  datagram[6] = static_cast<char>(peerHeard ? FLAG_PEER_HEARD : 0);
+  datagram[7] = static_cast<char>(nameLength);
+  WriteUInt64(datagram + 8, this->PeerToken);
+  WriteUInt64(datagram + 16, pose ? pose->SequenceNumber : 0);
+  size_t size = DATAGRAM_HEADER_SIZE;
+  if (pose)
+  {
+    memcpy(datagram + size, pose->Name.data(), nameLength);
+    size += nameLength;
+    for (int elementIndex = 0; elementIndex < 16; elementIndex++)
+    {
+      uint64_t bits = 0;
+      memcpy(&bits, &pose->Matrix[elementIndex], sizeof(double));
+      WriteUInt64(datagram + size, bits);
+      size += 8;
+    }
+  }
+  // a failure is a lost datagram, detected by the heartbeats if it lasts
+  sendto(this->Socket, datagram, static_cast<int>(size), 0,
+    reinterpret_cast<const sockaddr*>(&this->PeerAddress), sizeof(this->PeerAddress));
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationPoseChannel::vtkInternal::ResetPeer()
+{
+  this->PeerToken = 0;
+  this->PeerSet = false;
+  this->PeerAddressKnown = false;
+  this->PeerAddressFixed = false;
+  this->Received = false;
+  this->Heard = false;
+  this->SentPoses.clear();
+  this->ReceivedSequenceNumbers.clear();
+  this->ReceivedPoses.clear();
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationPoseChannel::vtkInternal::ProcessDatagram(const char* data, size_t size, const sockaddr_in& senderAddress)
+{
+  if (size < DATAGRAM_HEADER_SIZE || ReadUInt32(data) != DATAGRAM_MAGIC
+    || static_cast<uint8_t>(data[4]) != DATAGRAM_VERSION || ReadUInt64(data + 8) != this->LocalToken)
+  {
+    // not sent by the peer of this session
+    return false;
+  }
+  uint8_t type = static_cast<uint8_t>(data[5]);
+  uint8_t flags = static_cast<uint8_t>(data[6]);
+  size_t nameLength = static_cast<uint8_t>(data[7]);
+  if ((type == DatagramPose && size != DATAGRAM_HEADER_SIZE + nameLength + 16 * 8)
+    || (type == DatagramHeartbeat && size != DATAGRAM_HEADER_SIZE))
+  {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (!this->PeerSet)
+  {
+    return false;
+  }
+  TimePoint now = std::chrono::steady_clock::now();
+  if (!this->PeerAddressFixed)
+  {
+    // the address of the client as seen by the server, it may change while the session goes on
+    this->PeerAddress = senderAddress;
+    this->PeerAddressKnown = true;
+  }
+  this->Received = true;
+  this->LastReceivedTime = now;
+  if (flags & FLAG_PEER_HEARD)
+  {
+    this->Heard = true;
+    this->LastHeardTime = now;
+  }
+  if (type != DatagramPose)
+  {
+    return false;
+  }
+
+  Pose pose;
+  pose.Name.assign(data + DATAGRAM_HEADER_SIZE, nameLength);
+  pose.SequenceNumber = ReadUInt64(data + 16);
+  uint64_t& lastSequenceNumber = this->ReceivedSequenceNumbers[pose.Name];
+  if (pose.SequenceNumber == lastSequenceNumber)
+  {
+    // the repeats of the latest pose are expected, they are not lost nor reordered
+    this->NumberOfRepeatedPoses++;
+    return false;
+  }
+  if (pose.SequenceNumber < lastSequenceNumber)
+  {
+    // arrived after a newer pose
+    this->NumberOfDroppedPoses++;
+    return false;
+  }
+  lastSequenceNumber = pose.SequenceNumber;
+  const char* matrixData = data + DATAGRAM_HEADER_SIZE + nameLength;
+  for (int elementIndex = 0; elementIndex < 16; elementIndex++)
+  {
+    uint64_t bits = ReadUInt64(matrixData + 8 * elementIndex);
+    memcpy(&pose.Matrix[elementIndex], &bits, sizeof(double));
+  }
+  // replaces the pose of the same name that has not been read yet
+  this->ReceivedPoses[pose.Name] = pose;
+  this->NumberOfReceivedPoses++;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationPoseChannel::vtkInternal::ReceiveLoop()
+{
+  char datagram[MAXIMUM_DATAGRAM_SIZE + 1];
+  while (!this->StopRequested)
+  {
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(this->Socket, &readSet);
+    timeval timeout = { 0, POLLING_TIMEOUT * 1000 };
+    bool notify = false;
+    if (select(static_cast<int>(this->Socket) + 1, &readSet, nullptr, nullptr, &timeout) > 0)
+    {
+      // the socket does not block, read all the datagrams that arrived
+      while (true)
+      {
+        sockaddr_in senderAddress;
+        SocketLength senderAddressLength = sizeof(senderAddress);
+        int size = static_cast<int>(recvfrom(this->Socket, datagram, sizeof(datagram), 0,
+          reinterpret_cast<sockaddr*>(&senderAddress), &senderAddressLength));
+        if (size < 0)
+        {
+          break;
+        }
+        notify = this->ProcessDatagram(datagram, static_cast<size_t>(size), senderAddress) || notify;
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      TimePoint now = std::chrono::steady_clock::now();
+      if (now - this->LastHeartbeatTime >= std::chrono::milliseconds(HEARTBEAT_INTERVAL))
+      {
+        this->SendDatagram(DatagramHeartbeat, nullptr, now);
+        this->LastHeartbeatTime = now;
+      }
+      bool reachable = this->IsPeerReachable(now);
+      for (auto sentPoseIt = this->SentPoses.begin(); sentPoseIt != this->SentPoses.end();)
+      {
+        SentPose& sentPose = sentPoseIt->second;
+        if (now - sentPose.SendTime < std::chrono::milliseconds(REPEAT_INTERVAL))
+        {
+          ++sentPoseIt;
+          continue;
+        }
+        if (reachable)
+        {
+          this->SendDatagram(DatagramPose, &sentPose.Value, now);
+        }
+        sentPose.SendTime = now;
+        if (++sentPose.Repeats >= NUMBER_OF_REPEATS)
+        {
+          sentPoseIt = this->SentPoses.erase(sentPoseIt);
+        }
+        else
+        {
+          ++sentPoseIt;
+        }
+      }
+      if (reachable != this->Reachable)
+      {
+        this->Reachable = reachable;
+        notify = true;
+      }
+    }
+    if (notify && this->NotificationCallback)
+    {
+      this->NotificationCallback();
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkCollaborationPoseChannel::vtkCollaborationPoseChannel()
+  : Internal(new vtkInternal)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkCollaborationPoseChannel::~vtkCollaborationPoseChannel()
+{
+  this->Close();
+  delete this->Internal;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationPoseChannel::SetNotificationCallback(const std::function<void()>& callback)
+{
+  this->Internal->NotificationCallback = callback;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationPoseChannel::Open(int port)
+{
+  this->Close();
+#ifdef _WIN32
+  WSADATA wsaData;
+  if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+  {
+    vtkGenericWarningMacro("vtkCollaborationPoseChannel: Failed to initialize the sockets");
+    return false;
+  }
+#endif
+  SocketType socketDescriptor = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (socketDescriptor == INVALID_SOCKET_VALUE)
+  {
+    vtkGenericWarningMacro("vtkCollaborationPoseChannel: Failed to create the socket");
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return false;
+  }
+  sockaddr_in localAddress;
+  memset(&localAddress, 0, sizeof(localAddress));
+  localAddress.sin_family = AF_INET;
+  localAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+  localAddress.sin_port = htons(static_cast<unsigned short>(port));
+  SocketLength localAddressLength = sizeof(localAddress);
+  if (bind(socketDescriptor, reinterpret_cast<sockaddr*>(&localAddress), sizeof(localAddress)) != 0
+    || getsockname(socketDescriptor, reinterpret_cast<sockaddr*>(&localAddress), &localAddressLength) != 0)
+  {
+    vtkGenericWarningMacro("vtkCollaborationPoseChannel: Failed to bind the socket to port " << port);
+    CloseSocket(socketDescriptor);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return false;
+  }
+#ifdef _WIN32
+  u_long nonBlocking = 1;
+  ioctlsocket(socketDescriptor, FIONBIO, &nonBlocking);
+  // the datagrams sent before the peer bound its socket would make the next reads fail
+  BOOL reportConnectionReset = FALSE;
+  DWORD bytesReturned = 0;
+  WSAIoctl(socketDescriptor, SIO_UDP_CONNRESET, &reportConnectionReset, sizeof(reportConnectionReset),
+    nullptr, 0, &bytesReturned, nullptr, nullptr);
+#else
+  fcntl(socketDescriptor, F_SETFL, fcntl(socketDescriptor, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+  std::random_device randomDevice;
+  std::mt19937_64 generator((static_cast<uint64_t>(randomDevice()) << 32) ^ randomDevice()
+    ^ static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+  do
+  {
+    this->Internal->LocalToken = generator();
+  } while (this->Internal->LocalToken == 0);
+  this->Internal->Socket = socketDescriptor;
+  this->Internal->LocalPort = ntohs(localAddress.sin_port);
+  {
+    std::lock_guard<std::mutex> lock(this->Internal->Mutex);
+    this->Internal->ResetPeer();
+    this->Internal->Reachable = false;
+  }
+  this->Internal->StopRequested = false;
+  this->Internal->Opened = true;
+  this->Internal->ReceiveThread = std::thread(&vtkInternal::ReceiveLoop, this->Internal);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationPoseChannel::Close()
+{
+  if (!this->Internal->Opened)
+  {
+    return;
+  }
+  this->Internal->StopRequested = true;
+  this->Internal->ReceiveThread.join();
+  CloseSocket(this->Internal->Socket);
+#ifdef _WIN32
+  WSACleanup();
+#endif
+  this->Internal->Socket = INVALID_SOCKET_VALUE;
+  this->Internal->LocalPort = 0;
+  {
+    std::lock_guard<std::mutex> lock(this->Internal->Mutex);
+    this->Internal->ResetPeer();
+    this->Internal->Reachable = false;
+  }
+  this->Internal->Opened = false;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationPoseChannel::IsOpen()
+{
+  return this->Internal->Opened;
+}
+
+//----------------------------------------------------------------------------
+int vtkCollaborationPoseChannel::GetLocalPort()
+{
+  return this->Internal->LocalPort;
+}
+
+//----------------------------------------------------------------------------
+uint64_t vtkCollaborationPoseChannel::GetLocalToken()
+{
+  return this->Internal->LocalToken;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationPoseChannel::SetPeer(uint64_t peerToken, const std::string& host, int port)
+{
+  sockaddr_in peerAddress;
+  memset(&peerAddress, 0, sizeof(peerAddress));
+  bool peerAddressFound = false;
+  if (!host.empty())
+  {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) == 0 && addresses)
+    {
+      memcpy(&peerAddress, addresses->ai_addr, sizeof(peerAddress));
+      peerAddressFound = true;
+    }
+    else
+    {
+      vtkGenericWarningMacro("vtkCollaborationPoseChannel: Failed to resolve the address of " << host);
+    }
+    if (addresses)
+    {
+      freeaddrinfo(addresses);
+    }
+  }
+  std::lock_guard<std::mutex> lock(this->Internal->Mutex);
+  this->Internal->ResetPeer();
+  this->Internal->PeerToken = peerToken;
+  this->Internal->PeerSet = true;
+  this->Internal->PeerAddress = peerAddress;
+  this->Internal->PeerAddressKnown = peerAddressFound;
+  this->Internal->PeerAddressFixed = !host.empty();
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationPoseChannel::ResetPeer()
+{
+  std::lock_guard<std::mutex> lock(this->Internal->Mutex);
+  this->Internal->ResetPeer();
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationPoseChannel::IsPeerReachable()
+{
+  std::lock_guard<std::mutex> lock(this->Internal->Mutex);
+  return this->Internal->Opened && this->Internal->IsPeerReachable(std::chrono::steady_clock::now());
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationPoseChannel::SendPose(const std::string& name, const double matrix[16])
+{
+  if (name.empty() || name.size() > MaximumNameLength)
+  {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(this->Internal->Mutex);
+  vtkInternal::TimePoint now = std::chrono::steady_clock::now();
+  if (!this->Internal->Opened || !this->Internal->IsPeerReachable(now))
+  {
+    return false;
+  }
+  vtkInternal::SentPose& sentPose = this->Internal->SentPoses[name];
+  sentPose.Value.Name = name;
+  memcpy(sentPose.Value.Matrix, matrix, sizeof(sentPose.Value.Matrix));
+  sentPose.Value.SequenceNumber = this->Internal->NextSequenceNumber++;
+  sentPose.SendTime = now;
+  sentPose.Repeats = 0;
+  this->Internal->SendDatagram(DatagramPose, &sentPose.Value, now);
+  this->Internal->NumberOfSentPoses++;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationPoseChannel::PopPose(Pose& pose)
+{
+  std::lock_guard<std::mutex> lock(this->Internal->Mutex);
+  if (this->Internal->ReceivedPoses.empty())
+  {
+    return false;
+  }
+  auto poseIt = this->Internal->ReceivedPoses.begin();
+  pose = poseIt->second;
+  this->Internal->ReceivedPoses.erase(poseIt);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+uint64_t vtkCollaborationPoseChannel::GetNumberOfSentPoses()
+{
+  return this->Internal->NumberOfSentPoses;
+}
+
+//----------------------------------------------------------------------------
+uint64_t vtkCollaborationPoseChannel::GetNumberOfReceivedPoses()
+{
+  return this->Internal->NumberOfReceivedPoses;
+}
+
+//----------------------------------------------------------------------------
+uint64_t vtkCollaborationPoseChannel::GetNumberOfDroppedPoses()
+{
+  return this->Internal->NumberOfDroppedPoses;
+}
+
+//----------------------------------------------------------------------------
+uint64_t vtkCollaborationPoseChannel::GetNumberOfRepeatedPoses()
+{
+  return this->Internal->NumberOfRepeatedPoses;
+}
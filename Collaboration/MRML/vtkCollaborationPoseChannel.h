@@ -0,0 +1,103 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+#ifndef __vtkCollaborationPoseChannel_h
+#define __vtkCollaborationPoseChannel_h
+
+// STD includes
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Collaboration includes
+#include "vtkSlicerCollaborationModuleMRMLExport.h"
+
+/// \brief UDP channel of the poses of a collaboration session, next to its OpenIGTLink connection.
+///
+/// A pose is the matrix of a transform, identified by the name of its node. Only its latest value matters, so a lost
+/// datagram is not sent again: the next pose replaces it, and the last pose of a transform that stops moving is
+/// repeated a few times. Each datagram has a sequence number, and the poses older than the last one received for the
+/// same name are dropped. Only the latest received pose of each name is kept until it is read.
+///
+/// The peers exchange their random tokens and the port of the server through the OpenIGTLink connection. Datagrams
+/// that do not carry the token of the receiver are ignored. The server learns the address of the client from the
+/// datagrams it receives, so the client reaches it through network address translation. Both peers send heartbeats,
+/// which tell whether the datagrams of the other peer are received: the channel is reachable while both directions
+/// work, and the caller sends the poses through OpenIGTLink otherwise.
+class VTK_SLICER_COLLABORATION_MODULE_MRML_EXPORT vtkCollaborationPoseChannel
+{
+public:
+  struct Pose
+  {
+    std::string Name;
+    /// Row-major 4x4 matrix
+    double Matrix[16];
+    uint64_t SequenceNumber{ 0 };
+  };
+
+  vtkCollaborationPoseChannel();
+  ~vtkCollaborationPoseChannel();
+
+  /// Function called from the receiving thread when a pose is received or when the reachability of the peer changes.
+  /// It must return without processing the pose. Set it before opening the channel.
+  void SetNotificationCallback(const std::function<void()>& callback);
+
+  /// Bind the socket to the port, 0 for any free port, and start the receiving thread. A new token is generated.
+  /// Return false if the socket could not be bound.
+  bool Open(int port);
+  void Close();
+  bool IsOpen();
+  /// Port the socket is bound to, 0 if the channel is not open
+  int GetLocalPort();
+  /// Token that the datagrams sent to this channel must carry
+  uint64_t GetLocalToken();
+
+  /// Set the token of the peer. If the host is empty, the address of the peer is learned from its datagrams.
+  void SetPeer(uint64_t peerToken, const std::string& host, int port);
+  /// Forget the peer and the sequence numbers of its poses
+  void ResetPeer();
+  /// Return true while the datagrams are received in both directions
+  bool IsPeerReachable();
+
+  /// Send the pose of the name. Return false if the peer is not reachable or the name is too long.
+  bool SendPose(const std::string& name, const double matrix[16]);
+  /// Get the latest received pose of one of the names. Return false if there is none.
+  bool PopPose(Pose& pose);
+
+  /// Statistics since the channel was created. The dropped poses were older than a pose already received,
+  /// the repeated poses are the deliberate repeats of a pose already received.
+  uint64_t GetNumberOfSentPoses();
+  uint64_t GetNumberOfReceivedPoses();
+  uint64_t GetNumberOfDroppedPoses();
+  uint64_t GetNumberOfRepeatedPoses();
+
+  /// Maximum length of the names, so that a pose fits in one datagram
+  static const size_t MaximumNameLength = 255;
+
+private:
+  vtkCollaborationPoseChannel(const vtkCollaborationPoseChannel&) = delete;
+  void operator=(const vtkCollaborationPoseChannel&) = delete;
+
+  class vtkInternal;
+  vtkInternal* Internal;
+};
+
+#endif
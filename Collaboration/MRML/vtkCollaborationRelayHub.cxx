@@ -0,0 +1,917 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+#include "vtkCollaborationRelayHub.h"
+#include "vtkMRMLCollaborationConnectorNode.h"
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtkXMLUtilities.h>
+
+// OpenIGTLink includes
+#include <igtlClientSocket.h>
+#include <igtlMessageHeader.h>
+#include <igtlServerSocket.h>
+#include <igtlStringMessage.h>
+
+// STD includes
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+//----------------------------------------------------------------------------
+const char* vtkCollaborationRelayHub::HubDeviceName = "CollaborationHub";
+const char* vtkCollaborationRelayHub::HubChannelSuffix = "Hub";
+
+namespace
+{
+/// Packed OpenIGTLink message, shared by the send queues of all the clients it is relayed to
+typedef std::shared_ptr<const std::string> MessageBuffer;
+
+/// Time in milliseconds after which the threads check whether the hub is stopped
+const int POLLING_TIMEOUT = 200;
+/// Time in milliseconds after which a client that stopped in the middle of a message is disconnected
+const int TRANSFER_TIMEOUT = 30000;
+/// Maximum size in bytes of the synchronization metadata replayed in one channel bundle
+const size_t MAXIMUM_REPLAYED_BUNDLE_SIZE = 1024 * 1024;
+/// Suffixes of the devices of a node besides its name, whose retained messages are forgotten with it
+const char* RETAINED_DEVICE_NAME_SUFFIXES[] = { "VolumeDelta", "ContentOffer" };
+
+//----------------------------------------------------------------------------
+MessageBuffer PackStringMessage(const std::string& deviceName, const std::string& text)
+{
+  igtl::StringMessage::Pointer stringMessage = igtl::StringMessage::New();
+  stringMessage->SetDeviceName(deviceName.c_str());
+  stringMessage->SetString(text.c_str());
+  stringMessage->Pack();
+  return std::make_shared<const std::string>(static_cast<const char*>(stringMessage->GetPackPointer()), stringMessage->GetPackSize());
+}
+
+//----------------------------------------------------------------------------
+bool UnpackStringMessage(igtl::MessageHeader* header, const std::string& message, std::string& text)
+{
+  igtl::StringMessage::Pointer stringMessage = igtl::StringMessage::New();
+  stringMessage->SetMessageHeader(header);
+  stringMessage->AllocateBuffer();
+  if (message.size() != header->GetPackSize() + stringMessage->GetPackBodySize())
+  {
+    return false;
+  }
+  memcpy(stringMessage->GetPackBodyPointer(), message.data() + header->GetPackSize(), stringMessage->GetPackBodySize());
+  if (!(stringMessage->Unpack() & igtl::MessageHeader::UNPACK_BODY))
+  {
+    return false;
+  }
+  text = stringMessage->GetString();
+  return true;
+}
+}
+
+//----------------------------------------------------------------------------
+class vtkCollaborationRelayHub::vtkInternal
+{
+public:
+  struct QueuedMessage
+  {
+    MessageBuffer Message;
+    /// Messages with the same state key replace each other in the queue, empty for the messages that are all delivered
+    std::string StateKey;
+  };
+  struct Client
+  {
+    igtl::ClientSocket::Pointer Socket;
+    std::thread ReceiveThread;
+    std::thread SendThread;
+    std::mutex QueueMutex;
+    std::condition_variable QueueCondition;
+    std::list<QueuedMessage> Queue;
+    /// Queued state messages by state key
+    std::map<std::string, std::list<QueuedMessage>::iterator> QueuedStates;
+    vtkTypeUInt64 QueueSize{ 0 };
+    std::atomic<bool> Connected{ true };
+    /// Device of the channel bundles of the client, only used by its receiving thread
+    std::string ChannelDeviceName;
+  };
+  typedef std::list<std::pair<std::string, MessageBuffer> > RetainedMessageList;
+
+  void AcceptClients();
+  void ReceiveMessages(std::shared_ptr<Client> client);
+  void SendMessages(std::shared_ptr<Client> client);
+  /// Queue a message received from a client for all the other clients
+  void RelayMessage(Client* sender, igtl::MessageHeader* header, MessageBuffer message);
+  /// Queue a message for a client. Above the maximum queue size the client is disconnected, unless limited is false.
+  void QueueMessage(Client* client, MessageBuffer message, const std::string& stateKey = std::string(), bool limited = true);
+  /// Keep the latest state of the session for the participants joining later
+  void RetainMessage(igtl::MessageHeader* header, MessageBuffer message, const std::string& stateKey);
+  /// Keep the latest synchronization metadata of a node received on a channel, by sender and state key
+  void RetainMetadata(const std::string& metadataKey, const std::string& text);
+  /// Forget the retained state and metadata of a node that a participant does not synchronize anymore
+  void ForgetNode(Client* sender, const std::string& nodeName, const std::string& nodeID);
+  /// Forget the oldest retained messages until the retained state fits in its maximum size. Called with the state mutex locked.
+  void EvictRetainedState();
+  /// Forget a retained message and the volume regions of its device. Called with the state mutex locked.
+  void EraseRetainedState(RetainedMessageList::iterator stateIt);
+  void EraseRetainedVolumeRegions(const std::string& deviceName);
+  /// Queue the retained state of the session for a new client
+  void QueueRetainedState(Client* client);
+  void Disconnect(Client* client);
+  /// Join the threads of the disconnected clients and close their sockets
+  void RemoveDisconnectedClients(bool all);
+
+  igtl::ServerSocket::Pointer ServerSocket;
+  std::thread AcceptThread;
+  std::atomic<bool> Running{ false };
+  int Port{ 0 };
+  std::atomic<vtkTypeUInt64> MaximumQueueSize{ 256 * 1024 * 1024 };
+  std::atomic<int> MaximumNumberOfClients{ 32 };
+
+  std::mutex ClientsMutex;
+  std::vector<std::shared_ptr<Client> > Clients;
+
+  std::atomic<vtkTypeUInt64> NumberOfReceivedMessages{ 0 };
+  std::atomic<vtkTypeUInt64> NumberOfReceivedBytes{ 0 };
+  std::atomic<vtkTypeUInt64> NumberOfSentMessages{ 0 };
+  std::atomic<vtkTypeUInt64> NumberOfSentBytes{ 0 };
+  std::atomic<vtkTypeUInt64> NumberOfDroppedClients{ 0 };
+  std::atomic<vtkTypeUInt64> NumberOfReplacedMessages{ 0 };
+
+  std::atomic<bool> SessionStateRetention{ false };
+  std::atomic<vtkTypeUInt64> MaximumRetainedStateSize{ 1024 * 1024 * 1024 };
+  std::atomic<vtkTypeUInt64> NumberOfEvictedStates{ 0 };
+  std::mutex StateMutex;
+  /// Latest state message of each device, by state key, in the order they were last received
+  RetainedMessageList RetainedStates;
+  std::map<std::string, RetainedMessageList::iterator> RetainedStateIndex;
+  /// Volume regions received since the last image of each volume, by device name. They are incremental, so all
+  /// of them are needed to rebuild the volume.
+  std::map<std::string, std::vector<MessageBuffer> > RetainedVolumeRegions;
+  /// Latest synchronization metadata text of each node, by channel device of the sender and state key, in the order
+  /// they were last received
+  std::list<std::pair<std::string, std::string> > RetainedMetadata;
+  std::map<std::string, std::list<std::pair<std::string, std::string> >::iterator> RetainedMetadataIndex;
+  vtkTypeUInt64 RetainedStateSize{ 0 };
+  /// Number of replays of the retained metadata, which gives each replay its own channel epoch
+  vtkTypeUInt64 NumberOfMetadataReplays{ 0 };
+};
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::vtkInternal::AcceptClients()
+{
+  while (this->Running)
+  {
+    igtl::ClientSocket::Pointer socket = this->ServerSocket->WaitForConnection(POLLING_TIMEOUT);
+    this->RemoveDisconnectedClients(false);
+    if (!socket)
+    {
+      continue;
+    }
+    socket->SetSendTimeout(TRANSFER_TIMEOUT);
+    std::shared_ptr<Client> client = std::make_shared<Client>();
+    client->Socket = socket;
+
+    // the participants already in the session send their synchronization metadata to the new one, and also
+    // their synchronized nodes if the hub does not serve them
+    std::stringstream ss;
+    {
+      std::lock_guard<std::mutex> lock(this->ClientsMutex);
+      // every client has its own threads, their number is bounded
+      if (static_cast<int>(this->Clients.size()) >= this->MaximumNumberOfClients)
+      {
+        vtkGenericWarningMacro("vtkCollaborationRelayHub: " << this->Clients.size()
+          << " participants are already connected, the new participant is disconnected");
+        socket->CloseSocket();
+        continue;
+      }
+      ss << "<" << vtkCollaborationRelayHub::HubDeviceName << " Event=\"ParticipantJoined\" NumberOfParticipants=\""
+        << this->Clients.size() + 1 << "\" StateServed=\"" << (this->SessionStateRetention ? "true" : "false") << "\" />";
+      MessageBuffer notification = PackStringMessage(vtkCollaborationRelayHub::HubDeviceName, ss.str());
+      for (const std::shared_ptr<Client>& otherClient : this->Clients)
+      {
+        this->QueueMessage(otherClient.get(), notification);
+      }
+      // the messages relayed from now on are queued after the retained state
+      this->QueueRetainedState(client.get());
+      this->Clients.push_back(client);
+    }
+    client->ReceiveThread = std::thread(&vtkInternal::ReceiveMessages, this, client);
+    client->SendThread = std::thread(&vtkInternal::SendMessages, this, client);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::vtkInternal::ReceiveMessages(std::shared_ptr<Client> client)
+{
+  while (this->Running && client->Connected)
+  {
+    igtl::MessageHeader::Pointer header = igtl::MessageHeader::New();
+    header->InitPack();
+    // waiting for the next message is interrupted regularly to check whether the hub is stopped
+    bool timeout = false;
+    client->Socket->SetReceiveTimeout(POLLING_TIMEOUT);
+    igtlUint64 receivedSize = client->Socket->Receive(header->GetPackPointer(), header->GetPackSize(), timeout);
+    if (receivedSize == 0 && timeout)
+    {
+      continue;
+    }
+    if (receivedSize != header->GetPackSize() || !(header->Unpack() & igtl::MessageHeader::UNPACK_HEADER))
+    {
+      break;
+    }
+    // the body size is declared by the client, a message that could never be queued is not allocated
+    if (header->GetBodySizeToRead() > this->MaximumQueueSize)
+    {
+      vtkGenericWarningMacro("vtkCollaborationRelayHub: Message of " << header->GetBodySizeToRead()
+        << " bytes larger than the maximum queue size, the participant is disconnected");
+      break;
+    }
+    // header and body are relayed as they were received
+    std::string message(header->GetPackSize() + header->GetBodySizeToRead(), '\0');
+    memcpy(&message[0], header->GetPackPointer(), header->GetPackSize());
+    if (header->GetBodySizeToRead() > 0)
+    {
+      client->Socket->SetReceiveTimeout(TRANSFER_TIMEOUT);
+      receivedSize = client->Socket->Receive(&message[header->GetPackSize()], header->GetBodySizeToRead(), timeout);
+      if (receivedSize != header->GetBodySizeToRead())
+      {
+        break;
+      }
+    }
+    this->NumberOfReceivedMessages++;
+    this->NumberOfReceivedBytes += message.size();
+    this->RelayMessage(client.get(), header, std::make_shared<const std::string>(std::move(message)));
+  }
+  this->Disconnect(client.get());
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::vtkInternal::SendMessages(std::shared_ptr<Client> client)
+{
+  while (true)
+  {
+    MessageBuffer message;
+    {
+      std::unique_lock<std::mutex> lock(client->QueueMutex);
+      client->QueueCondition.wait(lock, [this, &client]() { return !client->Queue.empty() || !client->Connected || !this->Running; });
+      if (!client->Connected || !this->Running)
+      {
+        break;
+      }
+      message = client->Queue.front().Message;
+      if (!client->Queue.front().StateKey.empty())
+      {
+        client->QueuedStates.erase(client->Queue.front().StateKey);
+      }
+      client->Queue.pop_front();
+      client->QueueSize -= message->size();
+    }
+    // only this client waits while its socket is busy
+    if (!client->Socket->Send(message->data(), message->size()))
+    {
+      break;
+    }
+    this->NumberOfSentMessages++;
+    this->NumberOfSentBytes += message->size();
+  }
+  this->Disconnect(client.get());
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::vtkInternal::RelayMessage(Client* sender, igtl::MessageHeader* header, MessageBuffer message)
+{
+  std::string channelPrefix = vtkMRMLCollaborationConnectorNode::ChannelDeviceNamePrefix;
+  std::string deviceType = header->GetDeviceType();
+  std::string deviceName = header->GetDeviceName();
+  bool channelMessage = (deviceType == "STRING" && deviceName.compare(0, channelPrefix.size(), channelPrefix) == 0);
+
+  // the notifications of the participants to the hub are not relayed
+  std::string text;
+  if (deviceName == vtkCollaborationRelayHub::HubDeviceName)
+  {
+    vtkSmartPointer<vtkXMLDataElement> notification = (deviceType == "STRING" && UnpackStringMessage(header, *message, text))
+      ? vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(text.c_str())) : nullptr;
+    const char* event = notification ? notification->GetAttribute("Event") : nullptr;
+    const char* nodeName = notification ? notification->GetAttribute("NodeName") : nullptr;
+    const char* nodeID = notification ? notification->GetAttribute("NodeID") : nullptr;
+    if (event && strcmp(event, "NodeRemoved") == 0 && nodeName && *nodeName && nodeID && *nodeID)
+    {
+      this->ForgetNode(sender, nodeName, nodeID);
+    }
+    return;
+  }
+
+  // messages containing the whole state of a node replace the previous state of the node still queued for a client,
+  // so that the delay of a slow client does not grow during a drag. The channel messages, such as the chat, and the
+  // volume regions are all delivered in order.
+  std::string stateKey;
+  if (!channelMessage && deviceName != vtkCollaborationRelayHub::HubDeviceName
+    && deviceName.find("VolumeDelta") == std::string::npos)
+  {
+    stateKey = deviceType + "/" + deviceName;
+  }
+
+  // the channel bundles are acknowledged by the hub, which delivers them to the connected participants
+  if (channelMessage && UnpackStringMessage(header, *message, text))
+  {
+    vtkSmartPointer<vtkXMLDataElement> bundle = vtkSmartPointer<vtkXMLDataElement>::Take(
+      vtkXMLUtilities::ReadElementFromString(text.c_str()));
+    sender->ChannelDeviceName = deviceName;
+    unsigned long lastSequence = 0;
+    for (int messageIndex = 0; bundle && messageIndex < bundle->GetNumberOfNestedElements(); messageIndex++)
+    {
+      vtkXMLDataElement* messageElement = bundle->GetNestedElement(messageIndex);
+      // the synchronization metadata carrying the whole state of a node is served with the retained nodes, the
+      // other channel messages, such as the chat and the segmentation changes, are only meaningful in order
+      const char* channel = messageElement->GetAttribute("Channel");
+      const char* stateKey = messageElement->GetAttribute("StateKey");
+      const char* metadataText = messageElement->GetAttribute("Text");
+      if (this->SessionStateRetention && channel && strcmp(channel, vtkMRMLCollaborationConnectorNode::SynchronizationChannelName) == 0
+        && stateKey && *stateKey && metadataText)
+      {
+        this->RetainMetadata(deviceName + "/" + stateKey, metadataText);
+      }
+      // the attribute is sent by the participant, an invalid value is ignored
+      const char* sequence = messageElement->GetAttribute("Sequence");
+      char* sequenceEnd = nullptr;
+      errno = 0;
+      unsigned long sequenceNumber = sequence ? strtoul(sequence, &sequenceEnd, 10) : 0;
+      if (sequence && sequenceEnd != sequence && *sequenceEnd == '\0' && errno == 0)
+      {
+        lastSequence = std::max(lastSequence, sequenceNumber);
+      }
+    }
+    if (lastSequence > 0)
+    {
+      std::stringstream ss;
+      // the epoch of the participant tells it that the acknowledgment is not for a previous run
+      const char* epoch = bundle->GetAttribute("Epoch");
+      ss << "<" << channelPrefix << " Ack=\"" << lastSequence << "\" AckEpoch=\""
+        << vtkMRMLNode::XMLAttributeEncodeString(epoch ? epoch : "") << "\" />";
+      this->QueueMessage(sender, PackStringMessage(channelPrefix + vtkCollaborationRelayHub::HubChannelSuffix, ss.str()));
+    }
+  }
+
+  if (this->SessionStateRetention && !channelMessage)
+  {
+    this->RetainMessage(header, message, stateKey);
+  }
+
+  std::lock_guard<std::mutex> lock(this->ClientsMutex);
+  for (const std::shared_ptr<Client>& client : this->Clients)
+  {
+    if (client.get() != sender)
+    {
+      this->QueueMessage(client.get(), message, stateKey);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::vtkInternal::QueueMessage(Client* client, MessageBuffer message, const std::string& stateKey, bool limited)
+{
+  {
+    std::lock_guard<std::mutex> lock(client->QueueMutex);
+    if (!client->Connected)
+    {
+      return;
+    }
+    // the queued state is dropped, the newer one is queued after the messages that were queued before it
+    auto stateIt = stateKey.empty() ? client->QueuedStates.end() : client->QueuedStates.find(stateKey);
+    if (stateIt != client->QueuedStates.end())
+    {
+      client->QueueSize -= stateIt->second->Message->size();
+      client->Queue.erase(stateIt->second);
+      client->QueuedStates.erase(stateIt);
+      this->NumberOfReplacedMessages++;
+    }
+    if (limited && !client->Queue.empty() && client->QueueSize + message->size() > this->MaximumQueueSize)
+    {
+      // the client cannot keep up, it is sent the current state again when it reconnects
+      client->Connected = false;
+      client->Queue.clear();
+      client->QueuedStates.clear();
+      client->QueueSize = 0;
+      this->NumberOfDroppedClients++;
+    }
+    else
+    {
+      QueuedMessage queuedMessage;
+      queuedMessage.Message = message;
+      queuedMessage.StateKey = stateKey;
+      client->Queue.push_back(queuedMessage);
+      client->QueueSize += message->size();
+      if (!stateKey.empty())
+      {
+        client->QueuedStates[stateKey] = std::prev(client->Queue.end());
+      }
+    }
+  }
+  client->QueueCondition.notify_one();
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::vtkInternal::RetainMessage(igtl::MessageHeader* header, MessageBuffer message, const std::string& stateKey)
+{
+  std::string deviceName = header->GetDeviceName();
+  std::lock_guard<std::mutex> lock(this->StateMutex);
+  if (stateKey.empty())
+  {
+    // volume regions, kept until the volume is sent again as a whole
+    std::string text;
+    if (strcmp(header->GetDeviceType(), "STRING") != 0 || !UnpackStringMessage(header, *message, text))
+    {
+      return;
+    }
+    std::vector<MessageBuffer>& regions = this->RetainedVolumeRegions[deviceName];
+    if (text.find("\"VolumeGeometry\"") != std::string::npos)
+    {
+      // a new stream of the volume starts from its geometry
+      for (const MessageBuffer& region : regions)
+      {
+        this->RetainedStateSize -= region->size();
+      }
+      regions.clear();
+    }
+    regions.push_back(message);
+    this->RetainedStateSize += message->size();
+    this->EvictRetainedState();
+    return;
+  }
+  // the requests of content are only meaningful for the participants present when they are sent
+  if (deviceName.find("ContentRequest") != std::string::npos)
+  {
+    return;
+  }
+  if (strcmp(header->GetDeviceType(), "IMAGE") == 0)
+  {
+    // the image replaces the regions of the volume received before it
+    this->EraseRetainedVolumeRegions(deviceName + "VolumeDelta");
+  }
+  auto stateIt = this->RetainedStateIndex.find(stateKey);
+  if (stateIt != this->RetainedStateIndex.end())
+  {
+    this->RetainedStateSize -= stateIt->second->second->size();
+    this->RetainedStates.erase(stateIt->second);
+  }
+  this->RetainedStates.push_back(std::make_pair(stateKey, message));
+  this->RetainedStateIndex[stateKey] = std::prev(this->RetainedStates.end());
+  this->RetainedStateSize += message->size();
+  this->EvictRetainedState();
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::vtkInternal::RetainMetadata(const std::string& metadataKey, const std::string& text)
+{
+  std::lock_guard<std::mutex> lock(this->StateMutex);
+  auto metadataIt = this->RetainedMetadataIndex.find(metadataKey);
+  if (metadataIt != this->RetainedMetadataIndex.end())
+  {
+    this->RetainedStateSize -= metadataIt->second->second.size();
+    this->RetainedMetadata.erase(metadataIt->second);
+  }
+  this->RetainedMetadata.push_back(std::make_pair(metadataKey, text));
+  this->RetainedMetadataIndex[metadataKey] = std::prev(this->RetainedMetadata.end());
+  this->RetainedStateSize += text.size();
+  this->EvictRetainedState();
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::vtkInternal::ForgetNode(Client* sender, const std::string& nodeName, const std::string& nodeID)
+{
+  std::lock_guard<std::mutex> lock(this->StateMutex);
+  // the messages of all the devices of the node, which are named after it
+  auto stateIt = this->RetainedStates.begin();
+  while (stateIt != this->RetainedStates.end())
+  {
+    std::string deviceName = stateIt->first.substr(stateIt->first.find('/') + 1);
+    bool nodeDevice = (deviceName == nodeName);
+    for (const char* suffix : RETAINED_DEVICE_NAME_SUFFIXES)
+    {
+      nodeDevice = nodeDevice || deviceName == nodeName + suffix;
+    }
+    if (nodeDevice)
+    {
+      this->EraseRetainedState(stateIt++);
+    }
+    else
+    {
+      ++stateIt;
+    }
+  }
+  this->EraseRetainedVolumeRegions(nodeName + "VolumeDelta");
+  // the metadata keys of the sender start with the ID of the node in its scene
+  std::string metadataPrefix = sender->ChannelDeviceName + "/" + nodeID + "/";
+  auto metadataIt = this->RetainedMetadataIndex.lower_bound(metadataPrefix);
+  while (metadataIt != this->RetainedMetadataIndex.end()
+    && metadataIt->first.compare(0, metadataPrefix.size(), metadataPrefix) == 0)
+  {
+    this->RetainedStateSize -= metadataIt->second->second.size();
+    this->RetainedMetadata.erase(metadataIt->second);
+    metadataIt = this->RetainedMetadataIndex.erase(metadataIt);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::vtkInternal::EvictRetainedState()
+{
+  // the nodes not updated for the longest time are forgotten first, then their metadata, then the volume streams
+  // that started without an image
+  while (this->RetainedStateSize > this->MaximumRetainedStateSize)
+  {
+    if (!this->RetainedStates.empty())
+    {
+      this->EraseRetainedState(this->RetainedStates.begin());
+    }
+    else if (!this->RetainedMetadata.empty())
+    {
+      this->RetainedStateSize -= this->RetainedMetadata.front().second.size();
+      this->RetainedMetadataIndex.erase(this->RetainedMetadata.front().first);
+      this->RetainedMetadata.pop_front();
+    }
+    else if (!this->RetainedVolumeRegions.empty())
+    {
+      this->EraseRetainedVolumeRegions(this->RetainedVolumeRegions.begin()->first);
+    }
+    else
+    {
+      break;
+    }
+    this->NumberOfEvictedStates++;
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::vtkInternal::EraseRetainedState(RetainedMessageList::iterator stateIt)
+{
+  // the regions of a volume cannot be applied without its image
+  if (stateIt->first.compare(0, 6, "IMAGE/") == 0)
+  {
+    this->EraseRetainedVolumeRegions(stateIt->first.substr(6) + "VolumeDelta");
+  }
+  this->RetainedStateSize -= stateIt->second->size();
+  this->RetainedStateIndex.erase(stateIt->first);
+  this->RetainedStates.erase(stateIt);
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::vtkInternal::EraseRetainedVolumeRegions(const std::string& deviceName)
+{
+  auto regionsIt = this->RetainedVolumeRegions.find(deviceName);
+  if (regionsIt == this->RetainedVolumeRegions.end())
+  {
+    return;
+  }
+  for (const MessageBuffer& region : regionsIt->second)
+  {
+    this->RetainedStateSize -= region->size();
+  }
+  this->RetainedVolumeRegions.erase(regionsIt);
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::vtkInternal::QueueRetainedState(Client* client)
+{
+  std::lock_guard<std::mutex> lock(this->StateMutex);
+  // the whole state is queued even if it is larger than the maximum queue size
+  for (const std::pair<std::string, MessageBuffer>& state : this->RetainedStates)
+  {
+    this->QueueMessage(client, state.second, state.first, false);
+  }
+  // the regions of the volumes after their image
+  for (const std::pair<const std::string, std::vector<MessageBuffer> >& regions : this->RetainedVolumeRegions)
+  {
+    for (const MessageBuffer& region : regions.second)
+    {
+      this->QueueMessage(client, region, std::string(), false);
+    }
+  }
+  if (this->RetainedMetadata.empty())
+  {
+    return;
+  }
+
+  // the metadata is replayed on the channel device of the hub, in bundles of their own epoch so that the client
+  // delivers them even if it received a previous replay
+  std::string channelDeviceName = std::string(vtkMRMLCollaborationConnectorNode::ChannelDeviceNamePrefix)
+    + vtkCollaborationRelayHub::HubChannelSuffix;
+  std::string epoch = "Hub" + std::to_string(++this->NumberOfMetadataReplays);
+  unsigned long sequence = 0;
+  auto metadataIt = this->RetainedMetadata.begin();
+  while (metadataIt != this->RetainedMetadata.end())
+  {
+    vtkNew<vtkXMLDataElement> bundle;
+    bundle->SetName(vtkMRMLCollaborationConnectorNode::ChannelDeviceNamePrefix);
+    bundle->SetAttribute("Epoch", epoch.c_str());
+    bundle->SetAttribute("Ack", "0");
+    bundle->SetAttribute("After", std::to_string(sequence).c_str());
+    size_t bundleSize = 0;
+    for (; metadataIt != this->RetainedMetadata.end(); ++metadataIt)
+    {
+      if (bundleSize > 0 && bundleSize + metadataIt->second.size() > MAXIMUM_REPLAYED_BUNDLE_SIZE)
+      {
+        break;
+      }
+      vtkNew<vtkXMLDataElement> messageElement;
+      messageElement->SetName("Message");
+      messageElement->SetAttribute("Sequence", std::to_string(++sequence).c_str());
+      messageElement->SetAttribute("Channel", vtkMRMLCollaborationConnectorNode::SynchronizationChannelName);
+      messageElement->SetAttribute("Text", metadataIt->second.c_str());
+      bundle->AddNestedElement(messageElement);
+      bundleSize += metadataIt->second.size();
+    }
+    std::stringstream ss;
+    vtkXMLUtilities::FlattenElement(bundle, ss);
+    this->QueueMessage(client, PackStringMessage(channelDeviceName, ss.str()), std::string(), false);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::vtkInternal::Disconnect(Client* client)
+{
+  {
+    std::lock_guard<std::mutex> lock(client->QueueMutex);
+    client->Connected = false;
+  }
+  client->QueueCondition.notify_one();
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::vtkInternal::RemoveDisconnectedClients(bool all)
+{
+  std::vector<std::shared_ptr<Client> > removedClients;
+  {
+    std::lock_guard<std::mutex> lock(this->ClientsMutex);
+    auto clientIt = this->Clients.begin();
+    while (clientIt != this->Clients.end())
+    {
+      if (all || !(*clientIt)->Connected)
+      {
+        removedClients.push_back(*clientIt);
+        clientIt = this->Clients.erase(clientIt);
+      }
+      else
+      {
+        ++clientIt;
+      }
+    }
+  }
+  for (const std::shared_ptr<Client>& client : removedClients)
+  {
+    this->Disconnect(client.get());
+    client->ReceiveThread.join();
+    client->SendThread.join();
+    client->Socket->CloseSocket();
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkCollaborationRelayHub);
+
+//----------------------------------------------------------------------------
+vtkCollaborationRelayHub::vtkCollaborationRelayHub()
+{
+  this->Internal = new vtkInternal;
+}
+
+//----------------------------------------------------------------------------
+vtkCollaborationRelayHub::~vtkCollaborationRelayHub()
+{
+  this->Stop();
+  delete this->Internal;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Running: " << (this->Internal->Running ? "true" : "false") << "\n";
+  os << indent << "Port: " << this->Internal->Port << "\n";
+  os << indent << "MaximumQueueSize: " << this->Internal->MaximumQueueSize << "\n";
+  os << indent << "MaximumNumberOfClients: " << this->Internal->MaximumNumberOfClients << "\n";
+  os << indent << "NumberOfClients: " << this->GetNumberOfClients() << "\n";
+  os << indent << "NumberOfReceivedMessages: " << this->Internal->NumberOfReceivedMessages << "\n";
+  os << indent << "NumberOfReceivedBytes: " << this->Internal->NumberOfReceivedBytes << "\n";
+  os << indent << "NumberOfSentMessages: " << this->Internal->NumberOfSentMessages << "\n";
+  os << indent << "NumberOfSentBytes: " << this->Internal->NumberOfSentBytes << "\n";
+  os << indent << "NumberOfDroppedClients: " << this->Internal->NumberOfDroppedClients << "\n";
+  os << indent << "NumberOfReplacedMessages: " << this->Internal->NumberOfReplacedMessages << "\n";
+  os << indent << "SessionStateRetention: " << (this->Internal->SessionStateRetention ? "true" : "false") << "\n";
+  os << indent << "MaximumRetainedStateSize: " << this->Internal->MaximumRetainedStateSize << "\n";
+  os << indent << "RetainedStateSize: " << this->GetRetainedStateSize() << "\n";
+  os << indent << "NumberOfEvictedStates: " << this->Internal->NumberOfEvictedStates << "\n";
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationRelayHub::Start(int port)
+{
+  if (this->Internal->Running)
+  {
+    vtkErrorMacro("Start: The hub is already running on port " << this->Internal->Port);
+    return false;
+  }
+  this->Internal->ServerSocket = igtl::ServerSocket::New();
+  if (this->Internal->ServerSocket->CreateServer(port) < 0)
+  {
+    vtkErrorMacro("Start: Failed to open port " << port);
+    this->Internal->ServerSocket = nullptr;
+    return false;
+  }
+  this->Internal->Port = port;
+  this->Internal->NumberOfReceivedMessages = 0;
+  this->Internal->NumberOfReceivedBytes = 0;
+  this->Internal->NumberOfSentMessages = 0;
+  this->Internal->NumberOfSentBytes = 0;
+  this->Internal->NumberOfDroppedClients = 0;
+  this->Internal->NumberOfReplacedMessages = 0;
+  this->Internal->NumberOfEvictedStates = 0;
+  this->Internal->Running = true;
+  this->Internal->AcceptThread = std::thread(&vtkInternal::AcceptClients, this->Internal);
+  this->Modified();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::Stop()
+{
+  if (!this->Internal->Running)
+  {
+    return;
+  }
+  this->Internal->Running = false;
+  this->Internal->AcceptThread.join();
+  this->Internal->RemoveDisconnectedClients(true);
+  this->ClearSessionState();
+  this->Internal->ServerSocket->CloseSocket();
+  this->Internal->ServerSocket = nullptr;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationRelayHub::IsRunning()
+{
+  return this->Internal->Running;
+}
+
+//----------------------------------------------------------------------------
+int vtkCollaborationRelayHub::GetPort()
+{
+  return this->Internal->Port;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::SetMaximumQueueSize(vtkTypeUInt64 size)
+{
+  this->Internal->MaximumQueueSize = size;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkCollaborationRelayHub::GetMaximumQueueSize()
+{
+  return this->Internal->MaximumQueueSize;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::SetMaximumNumberOfClients(int numberOfClients)
+{
+  this->Internal->MaximumNumberOfClients = std::max(numberOfClients, 1);
+}
+
+//----------------------------------------------------------------------------
+int vtkCollaborationRelayHub::GetMaximumNumberOfClients()
+{
+  return this->Internal->MaximumNumberOfClients;
+}
+
+//----------------------------------------------------------------------------
+int vtkCollaborationRelayHub::GetNumberOfClients()
+{
+  std::lock_guard<std::mutex> lock(this->Internal->ClientsMutex);
+  int numberOfClients = 0;
+  for (const std::shared_ptr<vtkInternal::Client>& client : this->Internal->Clients)
+  {
+    numberOfClients += client->Connected ? 1 : 0;
+  }
+  return numberOfClients;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkCollaborationRelayHub::GetNumberOfReceivedMessages()
+{
+  return this->Internal->NumberOfReceivedMessages;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkCollaborationRelayHub::GetNumberOfReceivedBytes()
+{
+  return this->Internal->NumberOfReceivedBytes;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkCollaborationRelayHub::GetNumberOfSentMessages()
+{
+  return this->Internal->NumberOfSentMessages;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkCollaborationRelayHub::GetNumberOfSentBytes()
+{
+  return this->Internal->NumberOfSentBytes;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkCollaborationRelayHub::GetNumberOfDroppedClients()
+{
+  return this->Internal->NumberOfDroppedClients;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkCollaborationRelayHub::GetNumberOfReplacedMessages()
+{
+  return this->Internal->NumberOfReplacedMessages;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::SetSessionStateRetention(bool retention)
+{
+  this->Internal->SessionStateRetention = retention;
+  if (!retention)
+  {
+    this->ClearSessionState();
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationRelayHub::GetSessionStateRetention()
+{
+  return this->Internal->SessionStateRetention;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::ClearSessionState()
+{
+  std::lock_guard<std::mutex> lock(this->Internal->StateMutex);
+  this->Internal->RetainedStates.clear();
+  this->Internal->RetainedStateIndex.clear();
+  this->Internal->RetainedVolumeRegions.clear();
+  this->Internal->RetainedMetadata.clear();
+  this->Internal->RetainedMetadataIndex.clear();
+  this->Internal->RetainedStateSize = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkCollaborationRelayHub::GetRetainedStateSize()
+{
+  std::lock_guard<std::mutex> lock(this->Internal->StateMutex);
+  return this->Internal->RetainedStateSize;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationRelayHub::SetMaximumRetainedStateSize(vtkTypeUInt64 size)
+{
+  this->Internal->MaximumRetainedStateSize = size;
+  std::lock_guard<std::mutex> lock(this->Internal->StateMutex);
+  this->Internal->EvictRetainedState();
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkCollaborationRelayHub::GetMaximumRetainedStateSize()
+{
+  return this->Internal->MaximumRetainedStateSize;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkCollaborationRelayHub::GetNumberOfEvictedStates()
+{
+  return this->Internal->NumberOfEvictedStates;
+}
@@ -0,0 +1,115 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+#ifndef __vtkCollaborationRelayHub_h
+#define __vtkCollaborationRelayHub_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// Collaboration includes
+#include "vtkSlicerCollaborationModuleMRMLExport.h"
+
+/// \brief Relay of the collaboration messages between any number of participants.
+///
+/// The hub accepts OpenIGTLink clients on a port and sends each message received from a client to all the other
+/// clients. The messages are not unpacked: each one is read once into a shared buffer, and the send queues of the
+/// other clients only hold a reference to it. Every client has its own send thread, so a slow client only delays
+/// its own queue, and its own receive thread: the hub runs two threads per client, plus the thread accepting them.
+/// It is meant for sessions of a few tens of participants, the clients above the maximum number of clients are
+/// refused. The messages containing the state of a node, such as transforms, meshes and node texts, replace
+/// the state of the same device still queued for the client, while the channel messages and volume regions are
+/// all delivered in order. A client whose queue still exceeds the maximum queue size is disconnected, and is sent
+/// the state of the session again by the other participants when it reconnects.
+///
+/// The hub acknowledges the channel bundles of the participants, and notifies them when a participant joins,
+/// so that they send their synchronized nodes to it.
+class VTK_SLICER_COLLABORATION_MODULE_MRML_EXPORT vtkCollaborationRelayHub : public vtkObject
+{
+public:
+  static vtkCollaborationRelayHub* New();
+  vtkTypeMacro(vtkCollaborationRelayHub, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) override;
+
+  /// Start accepting clients on the port. Return false if the port could not be opened.
+  bool Start(int port);
+  /// Disconnect all the clients and stop accepting new ones
+  void Stop();
+  bool IsRunning();
+  int GetPort();
+
+  /// Maximum size in bytes of the messages queued for a client. A client that does not receive its messages
+  /// fast enough to stay below this size is disconnected.
+  void SetMaximumQueueSize(vtkTypeUInt64 size);
+  vtkTypeUInt64 GetMaximumQueueSize();
+
+  /// Keep the latest state of the session in memory: the last message of each node, the volume regions sent
+  /// after the last image of each volume, and the synchronization metadata that describes the whole state of a node.
+  /// New clients receive it as soon as they connect, so the other participants only send them their synchronization
+  /// metadata. The state is kept after the participants disconnect. The metadata sent as changes, such as the
+  /// labelmaps of the segmentations, is not retained: a client joining while no other participant is connected
+  /// receives these nodes without it. The state of a node is forgotten when a participant stops synchronizing it,
+  /// or removes it, while connected.
+  void SetSessionStateRetention(bool retention);
+  bool GetSessionStateRetention();
+  /// Maximum size in bytes of the retained state. Above it, the nodes not updated for the longest time are
+  /// forgotten first.
+  void SetMaximumRetainedStateSize(vtkTypeUInt64 size);
+  vtkTypeUInt64 GetMaximumRetainedStateSize();
+  /// Forget the retained state of the session
+  void ClearSessionState();
+  /// Size in bytes of the retained state of the session
+  vtkTypeUInt64 GetRetainedStateSize();
+
+  /// Maximum number of clients connected at the same time. Each client uses two threads of the hub, the clients
+  /// connecting above this number are disconnected right away.
+  void SetMaximumNumberOfClients(int numberOfClients);
+  int GetMaximumNumberOfClients();
+  /// Number of connected clients
+  int GetNumberOfClients();
+
+  /// Statistics since the hub was started
+  vtkTypeUInt64 GetNumberOfReceivedMessages();
+  vtkTypeUInt64 GetNumberOfReceivedBytes();
+  vtkTypeUInt64 GetNumberOfSentMessages();
+  vtkTypeUInt64 GetNumberOfSentBytes();
+  vtkTypeUInt64 GetNumberOfDroppedClients();
+  /// Number of queued messages replaced by a newer state of the same node before being sent
+  vtkTypeUInt64 GetNumberOfReplacedMessages();
+  /// Number of retained messages forgotten to stay below the maximum retained state size
+  vtkTypeUInt64 GetNumberOfEvictedStates();
+
+  /// Device of the notifications sent by the hub to the participants, and by the participants to the hub
+  static const char* HubDeviceName;
+  /// Suffix of the channel prefix for the device of the acknowledgments sent by the hub
+  static const char* HubChannelSuffix;
+
+protected:
+  vtkCollaborationRelayHub();
+  ~vtkCollaborationRelayHub() override;
+  vtkCollaborationRelayHub(const vtkCollaborationRelayHub&);
+  void operator=(const vtkCollaborationRelayHub&);
+
+  class vtkInternal;
+  vtkInternal* Internal;
+};
+
+#endif
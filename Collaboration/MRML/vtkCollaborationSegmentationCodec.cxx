@@ -0,0 +1,688 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+#include "vtkCollaborationSegmentationCodec.h"
+#include "vtkCollaborationAttributeSchema.h"
+#include "vtkCollaborationImageDelta.h"
+#include "vtkMRMLCollaborationNode.h"
+
+// Slicer MRML includes
+#include <vtkMRMLSegmentationDisplayNode.h>
+
+// SegmentationCore includes
+#include <vtkOrientedImageData.h>
+#include <vtkSegment.h>
+#include <vtkSegmentation.h>
+#include <vtkSegmentationConverter.h>
+
+// VTK includes
+#include <vtkDiscreteFlyingEdges3D.h>
+#include <vtkImageConstantPad.h>
+#include <vtkNew.h>
+#include <vtkPolyDataNormals.h>
+#include <vtkTransform.h>
+#include <vtkTransformPolyDataFilter.h>
+#include <vtkWindowedSincPolyDataFilter.h>
+#include <vtkXMLDataElement.h>
+
+// STD includes
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+/// Received labelmaps larger than this number of voxels are rejected, so that a peer cannot make this node allocate
+/// an arbitrary amount of memory
+const long long MAXIMUM_LABELMAP_VOXELS = 1LL << 30;
+
+//----------------------------------------------------------------------------
+/// Whether the layer can be compared voxel by voxel with its snapshot
+bool HaveSameGeometry(vtkOrientedImageData* image1, vtkOrientedImageData* image2)
+{
+  if (!vtkCollaborationImageDelta::HaveSameGeometry(image1, image2))
+  {
+    return false;
+  }
+  vtkNew<vtkMatrix4x4> imageToWorld1;
+  vtkNew<vtkMatrix4x4> imageToWorld2;
+  image1->GetImageToWorldMatrix(imageToWorld1);
+  image2->GetImageToWorldMatrix(imageToWorld2);
+  for (int i = 0; i < 16; i++)
+  {
+    if (imageToWorld1->GetData()[i] != imageToWorld2->GetData()[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Lengths of the runs of voxels of the extent alternately outside and inside the segment, starting outside
+template <class T>
+void WriteRuns(vtkImageData* image, const int extent[6], double labelValue, std::vector<int32_t>& runs)
+{
+  T label = static_cast<T>(labelValue);
+  int numberOfComponents = image->GetNumberOfScalarComponents();
+  bool inside = false;
+  int32_t run = 0;
+  for (int z = extent[4]; z <= extent[5]; z++)
+  {
+    for (int y = extent[2]; y <= extent[3]; y++)
+    {
+      const T* voxel = static_cast<const T*>(image->GetScalarPointer(extent[0], y, z));
+      for (int x = extent[0]; x <= extent[1]; x++, voxel += numberOfComponents)
+      {
+        if ((*voxel == label) != inside)
+        {
+          runs.push_back(run);
+          run = 0;
+          inside = !inside;
+        }
+        run++;
+      }
+    }
+  }
+  runs.push_back(run);
+}
+
+/// Set the voxels of the extent inside the segment to the label value, and clear the others that had it
+template <class T>
+void ApplyRuns(vtkImageData* image, const int extent[6], double labelValue, const std::vector<int32_t>& runs)
+{
+  T label = static_cast<T>(labelValue);
+  int numberOfComponents = image->GetNumberOfScalarComponents();
+  size_t runIndex = 0;
+  int32_t remaining = runs.empty() ? 0 : runs[0];
+  bool inside = false;
+  for (int z = extent[4]; z <= extent[5]; z++)
+  {
+    for (int y = extent[2]; y <= extent[3]; y++)
+    {
+      T* voxel = static_cast<T*>(image->GetScalarPointer(extent[0], y, z));
+      for (int x = extent[0]; x <= extent[1]; x++, voxel += numberOfComponents)
+      {
+        while (remaining == 0 && runIndex + 1 < runs.size())
+        {
+          remaining = runs[++runIndex];
+          inside = !inside;
+        }
+        if (inside)
+        {
+          *voxel = label;
+        }
+        else if (*voxel == label)
+        {
+          *voxel = 0;
+        }
+        remaining--;
+      }
+    }
+  }
+}
+
+/// Encode the voxels of the segment in an extent of its layer. Full labelmaps also contain the geometry of the layer.
+std::string EncodeLabelmap(vtkOrientedImageData* image, const int extent[6], bool full, double labelValue)
+{
+  vtkCollaborationAttributeSchema::RecordWriter writer;
+  writer.WriteBoolean(full);
+  if (full)
+  {
+    vtkNew<vtkMatrix4x4> imageToWorld;
+    image->GetImageToWorldMatrix(imageToWorld);
+    for (int i = 0; i < 16; i++)
+    {
+      writer.WriteDouble(imageToWorld->GetData()[i]);
+    }
+  }
+  // a labelmap without voxels is sent with an empty extent
+  bool hasVoxels = vtkCollaborationImageDelta::HasVoxels(image);
+  const int emptyExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  for (int i = 0; i < 6; i++)
+  {
+    writer.WriteInteger(hasVoxels ? extent[i] : emptyExtent[i]);
+  }
+  std::vector<int32_t> runs;
+  if (hasVoxels)
+  {
+    switch (image->GetScalarType())
+    {
+      vtkTemplateMacro(WriteRuns<VTK_TT>(image, extent, labelValue, runs));
+    }
+  }
+  writer.WriteInteger(static_cast<int>(runs.size()));
+  writer.WriteIntegers(runs.data(), runs.size());
+  return vtkCollaborationAttributeSchema::EncodeRecordAsText(writer.Buffer);
+}
+}
+
+//----------------------------------------------------------------------------
+vtkCollaborationSegmentationCodec::vtkCollaborationSegmentationCodec()
+  : vtkCollaborationTypedNodeCodec<vtkMRMLSegmentationNode>("vtkMRMLSegmentationNode", "Segmentation", 0)
+{
+}
+
+//----------------------------------------------------------------------------
+std::string vtkCollaborationSegmentationCodec::SerializeNode(vtkMRMLSegmentationNode* segmentationNode,
+  vtkMRMLCollaborationNode* vtkNotUsed(collabNode), bool vtkNotUsed(binary))
+{
+  // the labelmaps are only added to the messages by ComputeDelta, the stored metadata is the segment list
+  return this->writeSegmentation(segmentationNode, std::map<std::string, std::string>());
+}
+
+//----------------------------------------------------------------------------
+std::string vtkCollaborationSegmentationCodec::writeSegmentation(vtkMRMLSegmentationNode* segmentationNode,
+  const std::map<std::string, std::string>& labelmaps)
+{
+  vtkSegmentation* segmentation = segmentationNode->GetSegmentation();
+  if (!segmentation || !segmentationNode->GetName())
+  {
+    return std::string();
+  }
+  std::stringstream ss;
+  ss << "<MRMLNode SuperclassName = \"vtkMRMLSegmentationNode\" ClassName = \"";
+  ss << segmentationNode->GetClassName();
+  ss << "\" name = \"" << vtkMRMLNode::XMLAttributeEncodeString(segmentationNode->GetName()) << "\">";
+  std::vector<std::string> segmentIDs;
+  segmentation->GetSegmentIDs(segmentIDs);
+  for (const std::string& segmentID : segmentIDs)
+  {
+    vtkSegment* segment = segmentation->GetSegment(segmentID);
+    double* color = segment->GetColor();
+    ss << "<Segment ID = \"" << vtkMRMLNode::XMLAttributeEncodeString(segmentID);
+    ss << "\" Name = \"" << vtkMRMLNode::XMLAttributeEncodeString(segment->GetName() ? segment->GetName() : "");
+    ss << "\" Color = \"" << color[0] << " " << color[1] << " " << color[2] << "\"";
+    auto labelmapIt = labelmaps.find(segmentID);
+    if (labelmapIt != labelmaps.end())
+    {
+      ss << " Labelmap = \"" << labelmapIt->second << "\"";
+    }
+    ss << " />";
+  }
+  ss << "</MRMLNode>";
+  return ss.str();
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationSegmentationCodec::ComputeDelta(vtkMRMLNode* node, vtkMRMLCollaborationNode* collabNode,
+  const std::string& previousText, const std::string& text, std::string& delta)
+{
+  vtkMRMLSegmentationNode* segmentationNode = vtkMRMLSegmentationNode::SafeDownCast(node);
+  if (!segmentationNode || !segmentationNode->GetID() || !segmentationNode->GetSegmentation() || text.empty()
+    || !collabNode || !collabNode->GetID())
+  {
+    return vtkCollaborationNodeCodec::ComputeDelta(node, collabNode, previousText, text, delta);
+  }
+  vtkSegmentation* segmentation = segmentationNode->GetSegmentation();
+  SentSegmentation& sent = this->SentSegmentations[collabNode->GetID()][segmentationNode->GetID()];
+  if (previousText.empty())
+  {
+    // the peer has nothing of the segmentation
+    sent = SentSegmentation();
+  }
+
+  // segments may share their labelmap layer, each layer is compared once
+  std::string labelmapName = vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName();
+  std::vector<std::string> segmentIDs;
+  segmentation->GetSegmentIDs(segmentIDs);
+  std::vector<std::pair<vtkOrientedImageData*, std::vector<std::string> > > layers;
+  for (const std::string& segmentID : segmentIDs)
+  {
+    vtkOrientedImageData* layer = vtkOrientedImageData::SafeDownCast(
+      segmentation->GetSegment(segmentID)->GetRepresentation(labelmapName));
+    if (!layer)
+    {
+      // only the labelmaps are synchronized
+      continue;
+    }
+    auto layerIt = std::find_if(layers.begin(), layers.end(),
+      [layer](const std::pair<vtkOrientedImageData*, std::vector<std::string> >& item) { return item.first == layer; });
+    if (layerIt == layers.end())
+    {
+      layers.push_back(std::make_pair(layer, std::vector<std::string>()));
+      layerIt = layers.end() - 1;
+    }
+    layerIt->second.push_back(segmentID);
+  }
+
+  std::map<std::string, std::string> labelmaps;
+  std::vector<LayerSnapshot> snapshots;
+  for (const std::pair<vtkOrientedImageData*, std::vector<std::string> >& layer : layers)
+  {
+    vtkOrientedImageData* image = layer.first;
+    auto snapshotIt = std::find_if(sent.Layers.begin(), sent.Layers.end(),
+      [image](const LayerSnapshot& snapshot) { return snapshot.Layer.GetPointer() == image; });
+    bool full = (snapshotIt == sent.Layers.end() || !HaveSameGeometry(snapshotIt->Image, image));
+    int* wholeExtent = image->GetExtent();
+    int modifiedExtent[6] = { 0, -1, 0, -1, 0, -1 };
+    bool modified = false;
+    if (!full && image->GetMTime() > snapshotIt->MTime)
+    {
+      modified = vtkCollaborationImageDelta::GetModifiedExtent(image, snapshotIt->Image, modifiedExtent);
+    }
+    for (const std::string& segmentID : layer.second)
+    {
+      double labelValue = segmentation->GetSegment(segmentID)->GetLabelValue();
+      if (full || sent.SegmentIDs.find(segmentID) == sent.SegmentIDs.end())
+      {
+        labelmaps[segmentID] = EncodeLabelmap(image, wholeExtent, true, labelValue);
+      }
+      else if (modified)
+      {
+        labelmaps[segmentID] = EncodeLabelmap(image, modifiedExtent, false, labelValue);
+      }
+    }
+
+    LayerSnapshot snapshot;
+    snapshot.Layer = image;
+    if (full)
+    {
+      snapshot.Image = vtkSmartPointer<vtkOrientedImageData>::New();
+      snapshot.Image->DeepCopy(image);
+    }
+    else
+    {
+      snapshot.Image = snapshotIt->Image;
+      if (modified)
+      {
+        vtkCollaborationImageDelta::CopyExtent(image, snapshot.Image, modifiedExtent);
+      }
+    }
+    snapshot.MTime = image->GetMTime();
+    snapshots.push_back(snapshot);
+  }
+  // the snapshots of the layers that are not used anymore are released
+  sent.Layers = snapshots;
+  sent.SegmentIDs = std::set<std::string>(segmentIDs.begin(), segmentIDs.end());
+
+  if (labelmaps.empty())
+  {
+    return vtkCollaborationNodeCodec::ComputeDelta(node, collabNode, previousText, text, delta);
+  }
+  delta = this->writeSegmentation(segmentationNode, labelmaps);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationSegmentationCodec::ResetNode(vtkMRMLNode* node, vtkMRMLCollaborationNode* collabNode)
+{
+  if (!node || !node->GetID() || !collabNode || !collabNode->GetID())
+  {
+    return;
+  }
+  auto collaborationIt = this->SentSegmentations.find(collabNode->GetID());
+  if (collaborationIt == this->SentSegmentations.end())
+  {
+    return;
+  }
+  collaborationIt->second.erase(node->GetID());
+  if (collaborationIt->second.empty())
+  {
+    this->SentSegmentations.erase(collaborationIt);
+  }
+}
+
+//----------------------------------------------------------------------------
+std::string vtkCollaborationSegmentationCodec::GetTargetNodeName(vtkXMLDataElement* element)
+{
+  const char* nodeName = element->GetAttribute("name");
+  if (!nodeName || !element->GetAttribute("ClassName"))
+  {
+    vtkGenericWarningMacro("vtkCollaborationSegmentationCodec: Invalid segmentation message");
+    return std::string();
+  }
+  return nodeName;
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLSegmentationNode* vtkCollaborationSegmentationCodec::GetTargetNode(vtkMRMLScene* scene,
+  vtkXMLDataElement* vtkNotUsed(element), const std::string& targetNodeName, vtkSmartPointer<vtkMRMLSegmentationNode>& vtkNotUsed(newNode))
+{
+  vtkMRMLSegmentationNode* segmentationNode = vtkMRMLSegmentationNode::SafeDownCast(
+    scene->GetFirstNode(targetNodeName.c_str(), "vtkMRMLSegmentationNode"));
+  if (segmentationNode)
+  {
+    return segmentationNode;
+  }
+  // the node is added before the message is applied, as its display node needs the scene
+  vtkSmartPointer<vtkMRMLSegmentationNode> receivedNode = vtkSmartPointer<vtkMRMLSegmentationNode>::Take(
+    vtkMRMLSegmentationNode::SafeDownCast(scene->CreateNodeByClass("vtkMRMLSegmentationNode")));
+  receivedNode->SetName(targetNodeName.c_str());
+  receivedNode->GetSegmentation()->SetSourceRepresentationName(
+    vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+  scene->AddNode(receivedNode);
+  receivedNode->CreateDefaultDisplayNodes();
+  // the closed surfaces are built from the received labelmaps in the background
+  vtkMRMLSegmentationDisplayNode* displayNode = vtkMRMLSegmentationDisplayNode::SafeDownCast(receivedNode->GetDisplayNode());
+  if (displayNode)
+  {
+    displayNode->SetPreferredDisplayRepresentationName3D(
+      vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName());
+  }
+  return receivedNode;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationSegmentationCodec::DeserializeNode(vtkMRMLSegmentationNode* segmentationNode, vtkXMLDataElement* element)
+{
+  vtkSegmentation* segmentation = segmentationNode->GetSegmentation();
+  if (!segmentation)
+  {
+    return false;
+  }
+  std::string labelmapName = vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName();
+  bool success = true;
+  std::set<std::string> receivedSegmentIDs;
+  std::vector<std::string> updatedSegmentIDs;
+  for (int elementIndex = 0; elementIndex < element->GetNumberOfNestedElements(); elementIndex++)
+  {
+    vtkXMLDataElement* segmentElement = element->GetNestedElement(elementIndex);
+    const char* segmentID = segmentElement->GetAttribute("ID");
+    if (strcmp(segmentElement->GetName(), "Segment") != 0 || !segmentID)
+    {
+      continue;
+    }
+    receivedSegmentIDs.insert(segmentID);
+    vtkSmartPointer<vtkSegment> segment = segmentation->GetSegment(segmentID);
+    bool newSegment = (segment == nullptr);
+    if (newSegment)
+    {
+      segment = vtkSmartPointer<vtkSegment>::New();
+    }
+    const char* segmentName = segmentElement->GetAttribute("Name");
+    if (segmentName)
+    {
+      segment->SetName(segmentName);
+    }
+    double color[3] = { 0.0, 0.0, 0.0 };
+    if (segmentElement->GetVectorAttribute("Color", 3, color) == 3)
+    {
+      segment->SetColor(color);
+    }
+    const char* labelmap = segmentElement->GetAttribute("Labelmap");
+    if (labelmap)
+    {
+      if (this->applyLabelmap(segmentationNode, segment, segmentID, labelmap))
+      {
+        updatedSegmentIDs.push_back(segmentID);
+      }
+      else
+      {
+        success = false;
+      }
+    }
+    // segments are only added with their labelmap
+    if (newSegment && segment->GetRepresentation(labelmapName))
+    {
+      segmentation->AddSegment(segment, segmentID);
+    }
+  }
+  // the message lists all the segments
+  std::vector<std::string> segmentIDs;
+  segmentation->GetSegmentIDs(segmentIDs);
+  for (const std::string& segmentID : segmentIDs)
+  {
+    if (receivedSegmentIDs.find(segmentID) == receivedSegmentIDs.end())
+    {
+      segmentation->RemoveSegment(segmentID);
+    }
+  }
+  for (const std::string& segmentID : updatedSegmentIDs)
+  {
+    this->updateClosedSurface(segmentationNode, segmentID);
+  }
+  return success;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationSegmentationCodec::applyLabelmap(vtkMRMLSegmentationNode* segmentationNode, vtkSegment* segment,
+  const std::string& segmentID, const std::string& encodedLabelmap)
+{
+  std::string record;
+  if (!vtkCollaborationAttributeSchema::DecodeRecordFromText(encodedLabelmap, record))
+  {
+    vtkGenericWarningMacro("vtkCollaborationSegmentationCodec: Invalid labelmap of segment " << segmentID
+      << " of " << segmentationNode->GetName());
+    return false;
+  }
+  vtkCollaborationAttributeSchema::RecordReader reader(record);
+  bool full = reader.ReadBoolean();
+  vtkNew<vtkMatrix4x4> imageToWorld;
+  if (full)
+  {
+    for (int i = 0; i < 16; i++)
+    {
+      imageToWorld->GetData()[i] = reader.ReadDouble();
+    }
+  }
+  int extent[6] = { 0, -1, 0, -1, 0, -1 };
+  for (int i = 0; i < 6; i++)
+  {
+    extent[i] = reader.ReadInteger();
+  }
+  int numberOfRuns = reader.ReadInteger();
+  // the number of runs is checked against the size of the record before they are allocated
+  if (!reader.IsValid() || numberOfRuns < 0
+    || static_cast<size_t>(numberOfRuns) > reader.GetNumberOfRemainingBytes() / sizeof(int32_t))
+  {
+    vtkGenericWarningMacro("vtkCollaborationSegmentationCodec: Invalid labelmap of segment " << segmentID
+      << " of " << segmentationNode->GetName());
+    return false;
+  }
+  std::vector<int32_t> runs(numberOfRuns);
+  if (!runs.empty())
+  {
+    reader.ReadIntegers(runs.data(), runs.size());
+  }
+  // the runs cover the extent exactly
+  bool emptyExtent = (extent[0] > extent[1] || extent[2] > extent[3] || extent[4] > extent[5]);
+  long long numberOfVoxels = emptyExtent ? 0 : 1;
+  for (int axis = 0; axis < 3 && numberOfVoxels <= MAXIMUM_LABELMAP_VOXELS; axis++)
+  {
+    numberOfVoxels *= static_cast<long long>(extent[2 * axis + 1]) - extent[2 * axis] + 1;
+  }
+  if (numberOfVoxels > MAXIMUM_LABELMAP_VOXELS)
+  {
+    vtkGenericWarningMacro("vtkCollaborationSegmentationCodec: Labelmap of segment " << segmentID
+      << " of " << segmentationNode->GetName() << " is too large");
+    return false;
+  }
+  long long runVoxels = 0;
+  for (int32_t run : runs)
+  {
+    runVoxels += (run >= 0 ? run : numberOfVoxels + 1);
+  }
+  if (!reader.IsValid() || runVoxels != numberOfVoxels)
+  {
+    vtkGenericWarningMacro("vtkCollaborationSegmentationCodec: Invalid labelmap of segment " << segmentID
+      << " of " << segmentationNode->GetName());
+    return false;
+  }
+
+  std::string labelmapName = vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName();
+  std::string closedSurfaceName = vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName();
+  vtkSmartPointer<vtkOrientedImageData> labelmap = vtkOrientedImageData::SafeDownCast(segment->GetRepresentation(labelmapName));
+  if (full)
+  {
+    // the received segment gets its own layer
+    labelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+    labelmap->SetExtent(extent);
+    labelmap->SetImageToWorldMatrix(imageToWorld);
+    if (!emptyExtent)
+    {
+      labelmap->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+      memset(labelmap->GetScalarPointer(), 0, numberOfVoxels);
+    }
+    segment->SetLabelValue(1);
+  }
+  else if (!labelmap || !vtkCollaborationImageDelta::HasVoxels(labelmap) || extent[0] < labelmap->GetExtent()[0] || extent[1] > labelmap->GetExtent()[1]
+    || extent[2] < labelmap->GetExtent()[2] || extent[3] > labelmap->GetExtent()[3]
+    || extent[4] < labelmap->GetExtent()[4] || extent[5] > labelmap->GetExtent()[5])
+  {
+    vtkGenericWarningMacro("vtkCollaborationSegmentationCodec: Labelmap update outside of the labelmap of segment " << segmentID
+      << " of " << segmentationNode->GetName());
+    return false;
+  }
+
+  // the segmentation converts its other representations again when the labelmap is modified,
+  // so the previous closed surface is set aside and kept displayed until the new one is built
+  vtkSmartPointer<vtkDataObject> closedSurface = segment->GetRepresentation(closedSurfaceName);
+  if (closedSurface)
+  {
+    segment->RemoveRepresentation(closedSurfaceName);
+  }
+  if (!emptyExtent)
+  {
+    switch (labelmap->GetScalarType())
+    {
+      vtkTemplateMacro(ApplyRuns<VTK_TT>(labelmap, extent, segment->GetLabelValue(), runs));
+    }
+  }
+  if (full)
+  {
+    segment->AddRepresentation(labelmapName, labelmap);
+  }
+  else
+  {
+    labelmap->Modified();
+  }
+  if (closedSurface)
+  {
+    segment->AddRepresentation(closedSurfaceName, closedSurface);
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationSegmentationCodec::updateClosedSurface(vtkMRMLSegmentationNode* segmentationNode, const std::string& segmentID)
+{
+  if (!segmentationNode->GetID())
+  {
+    return;
+  }
+  std::pair<std::string, std::string> key(segmentationNode->GetID(), segmentID);
+  auto updateIt = this->SurfaceUpdates.find(key);
+  if (updateIt != this->SurfaceUpdates.end())
+  {
+    // built again with the latest labelmap when the current build is done
+    updateIt->second.Outdated = true;
+    return;
+  }
+  vtkSegment* segment = segmentationNode->GetSegmentation()->GetSegment(segmentID);
+  vtkOrientedImageData* labelmap = segment ? vtkOrientedImageData::SafeDownCast(
+    segment->GetRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName())) : nullptr;
+  if (!labelmap || !vtkCollaborationImageDelta::HasVoxels(labelmap))
+  {
+    return;
+  }
+  // the background task works on a copy, as the labelmap may be modified by the next messages
+  vtkSmartPointer<vtkImageData> labelmapCopy = vtkSmartPointer<vtkImageData>::New();
+  labelmapCopy->DeepCopy(labelmap);
+  vtkSmartPointer<vtkMatrix4x4> imageToWorld = vtkSmartPointer<vtkMatrix4x4>::New();
+  labelmap->GetImageToWorldMatrix(imageToWorld);
+  SurfaceUpdate& update = this->SurfaceUpdates[key];
+  update.SegmentationNode = segmentationNode;
+  update.Surface = std::async(std::launch::async, &vtkCollaborationSegmentationCodec::buildClosedSurface,
+    labelmapCopy, imageToWorld, segment->GetLabelValue());
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> vtkCollaborationSegmentationCodec::buildClosedSurface(vtkSmartPointer<vtkImageData> labelmap,
+  vtkSmartPointer<vtkMatrix4x4> imageToWorld, double labelValue)
+{
+  // the surface is extracted in voxel coordinates, with a border so that it is closed at the edges of the labelmap
+  labelmap->SetOrigin(0.0, 0.0, 0.0);
+  labelmap->SetSpacing(1.0, 1.0, 1.0);
+  int extent[6] = { 0, -1, 0, -1, 0, -1 };
+  labelmap->GetExtent(extent);
+  vtkNew<vtkImageConstantPad> padder;
+  padder->SetInputData(labelmap);
+  padder->SetOutputWholeExtent(extent[0] - 1, extent[1] + 1, extent[2] - 1, extent[3] + 1, extent[4] - 1, extent[5] + 1);
+  padder->SetConstant(0.0);
+
+  vtkNew<vtkDiscreteFlyingEdges3D> contour;
+  contour->SetInputConnection(padder->GetOutputPort());
+  contour->SetValue(0, labelValue);
+  contour->ComputeNormalsOff();
+  contour->ComputeGradientsOff();
+  contour->ComputeScalarsOff();
+
+  // same smoothing as the default conversion of the segmentations
+  vtkNew<vtkWindowedSincPolyDataFilter> smoother;
+  smoother->SetInputConnection(contour->GetOutputPort());
+  smoother->SetNumberOfIterations(20);
+  smoother->SetPassBand(0.01);
+  smoother->BoundarySmoothingOff();
+  smoother->FeatureEdgeSmoothingOff();
+  smoother->NonManifoldSmoothingOn();
+  smoother->NormalizeCoordinatesOn();
+
+  vtkNew<vtkTransform> transform;
+  transform->SetMatrix(imageToWorld);
+  vtkNew<vtkTransformPolyDataFilter> transformer;
+  transformer->SetInputConnection(smoother->GetOutputPort());
+  transformer->SetTransform(transform);
+
+  vtkNew<vtkPolyDataNormals> normals;
+  normals->SetInputConnection(transformer->GetOutputPort());
+  normals->ConsistencyOn();
+  normals->SplittingOff();
+  normals->Update();
+
+  vtkSmartPointer<vtkPolyData> surface = vtkSmartPointer<vtkPolyData>::New();
+  surface->ShallowCopy(normals->GetOutput());
+  return surface;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationSegmentationCodec::ProcessPendingTasks()
+{
+  std::string closedSurfaceName = vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName();
+  auto updateIt = this->SurfaceUpdates.begin();
+  while (updateIt != this->SurfaceUpdates.end())
+  {
+    if (updateIt->second.Surface.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+      ++updateIt;
+      continue;
+    }
+    vtkSmartPointer<vtkPolyData> surface = updateIt->second.Surface.get();
+    vtkMRMLSegmentationNode* segmentationNode = updateIt->second.SegmentationNode;
+    bool outdated = updateIt->second.Outdated;
+    std::string segmentID = updateIt->first.second;
+    updateIt = this->SurfaceUpdates.erase(updateIt);
+
+    vtkSegment* segment = (segmentationNode && segmentationNode->GetSegmentation())
+      ? segmentationNode->GetSegmentation()->GetSegment(segmentID) : nullptr;
+    if (!segment)
+    {
+      // the segment was removed meanwhile
+      continue;
+    }
+    // the surface is derived from the labelmap, adding it does not trigger a conversion
+    segment->AddRepresentation(closedSurfaceName, surface);
+    if (outdated)
+    {
+      this->updateClosedSurface(segmentationNode, segmentID);
+    }
+  }
+}
@@ -0,0 +1,117 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+#ifndef __vtkCollaborationSegmentationCodec_h
+#define __vtkCollaborationSegmentationCodec_h
+
+// MRML includes
+#include <vtkMRMLSegmentationNode.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPolyData.h>
+#include <vtkWeakPointer.h>
+
+// STD includes
+#include <future>
+#include <map>
+#include <set>
+
+// Collaboration includes
+#include "vtkCollaborationNodeCodec.h"
+
+class vtkOrientedImageData;
+class vtkSegment;
+
+/// \brief Synchronization of segmentations by the binary labelmap of their segments.
+///
+/// The metadata lists the segments with their name and color. After a change, the labelmap of each segment is sent
+/// only in the extent that differs from the last sent labelmap, as runs of voxels alternately outside and inside
+/// the segment. The full labelmap is sent for new segments, when the geometry of the labelmap changes, and to new peers.
+///
+/// The sender compares each labelmap layer to a copy of the last sent one, so the dirty extent is found with row
+/// comparisons only when the layer was modified. The receiver applies the runs in place and rebuilds the closed
+/// surface of the modified segments in the background, keeping the previous surface displayed meanwhile.
+class VTK_SLICER_COLLABORATION_MODULE_MRML_EXPORT vtkCollaborationSegmentationCodec
+  : public vtkCollaborationTypedNodeCodec<vtkMRMLSegmentationNode>
+{
+public:
+  vtkCollaborationSegmentationCodec();
+
+  bool IsPushed() override { return false; }
+  // segment and labelmap events are not modified events
+  unsigned long GetModifiedEvent() override { return vtkCommand::AnyEvent; }
+
+  bool ComputeDelta(vtkMRMLNode* node, vtkMRMLCollaborationNode* collabNode, const std::string& previousText,
+    const std::string& text, std::string& delta) override;
+  // the labelmap regions of successive deltas are all needed
+  bool IsDeltaLatestValueWins() override { return false; }
+  void ResetNode(vtkMRMLNode* node, vtkMRMLCollaborationNode* collabNode) override;
+  void ProcessPendingTasks() override;
+  bool HasPendingTasks() override { return !this->SurfaceUpdates.empty(); }
+
+protected:
+  std::string SerializeNode(vtkMRMLSegmentationNode* segmentationNode, vtkMRMLCollaborationNode* collabNode, bool binary) override;
+  std::string GetTargetNodeName(vtkXMLDataElement* element) override;
+  vtkMRMLSegmentationNode* GetTargetNode(vtkMRMLScene* scene, vtkXMLDataElement* element, const std::string& targetNodeName,
+    vtkSmartPointer<vtkMRMLSegmentationNode>& newNode) override;
+  bool DeserializeNode(vtkMRMLSegmentationNode* segmentationNode, vtkXMLDataElement* element) override;
+
+  /// Write the segment list, with the encoded labelmap of the segments that have one
+  std::string writeSegmentation(vtkMRMLSegmentationNode* segmentationNode, const std::map<std::string, std::string>& labelmaps);
+  /// Apply an encoded labelmap to a received segment
+  bool applyLabelmap(vtkMRMLSegmentationNode* segmentationNode, vtkSegment* segment, const std::string& segmentID,
+    const std::string& encodedLabelmap);
+  /// Rebuild the closed surface of a received segment in the background
+  void updateClosedSurface(vtkMRMLSegmentationNode* segmentationNode, const std::string& segmentID);
+  static vtkSmartPointer<vtkPolyData> buildClosedSurface(vtkSmartPointer<vtkImageData> labelmap,
+    vtkSmartPointer<vtkMatrix4x4> imageToWorld, double labelValue);
+
+  /// Last sent labelmap layer of the synchronized segmentations
+  struct LayerSnapshot
+  {
+    vtkWeakPointer<vtkOrientedImageData> Layer;
+    vtkSmartPointer<vtkOrientedImageData> Image;
+    vtkMTimeType MTime{ 0 };
+  };
+  struct SentSegmentation
+  {
+    std::vector<LayerSnapshot> Layers;
+    std::set<std::string> SegmentIDs;
+  };
+  /// By collaboration node ID, then by segmentation node ID. The codec is shared by all the collaboration nodes,
+  /// and each of them sends the segmentation to its own peers.
+  std::map<std::string, std::map<std::string, SentSegmentation> > SentSegmentations;
+
+  /// Closed surface being built for a received segment
+  struct SurfaceUpdate
+  {
+    vtkWeakPointer<vtkMRMLSegmentationNode> SegmentationNode;
+    std::future<vtkSmartPointer<vtkPolyData> > Surface;
+    /// The labelmap was modified again while the surface was built
+    bool Outdated{ false };
+  };
+  /// By segmentation node ID and segment ID
+  std::map<std::pair<std::string, std::string>, SurfaceUpdate> SurfaceUpdates;
+};
+
+#endif
@@ -0,0 +1,1007 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+#include "vtkCollaborationSharedMemoryLink.h"
+
+// VTK includes
+#include <vtkSetGet.h>
+
+// STD includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+# ifndef NOMINMAX
+#  define NOMINMAX
+# endif
+# include <windows.h>
+#else
+# include <cerrno>
+# include <fcntl.h>
+# include <semaphore.h>
+# include <signal.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <time.h>
+# include <unistd.h>
+#endif
+
+namespace
+{
+const uint32_t SEGMENT_MAGIC = 0x53434c53;
+/// Incremented when the layout of the segment or of the frames changes
+const uint32_t SEGMENT_VERSION = 1;
+const uint32_t FRAME_MAGIC = 0x5343464d;
+/// Size reserved for the header at the beginning of the segment, the rings follow it
+const uint64_t HEADER_SIZE = 4096;
+/// Time in milliseconds after which the waiting threads check whether the peer is still running
+const int POLLING_TIMEOUT = 200;
+/// Time in milliseconds after which a peer that stopped reading is disconnected
+const int WRITE_TIMEOUT = 10000;
+/// Number of checks of an empty ring before waiting for the writer, so that the messages sent in a burst are read
+/// without a system call
+const int SPIN_COUNT = 2000;
+/// Number of attempts to map a segment left uninitialized by its creator before its name is removed
+const int MAXIMUM_INVALID_SEGMENT_ATTEMPTS = 25;
+
+enum SlotState : uint32_t
+{
+  SlotFree = 0,
+  SlotActive = 1
+};
+
+struct SlotHeader
+{
+  std::atomic<uint32_t> State;
+  std::atomic<uint32_t> ProcessID;
+  /// Incremented each time an instance attaches to the slot
+  std::atomic<uint32_t> Token;
+  /// The rings have been reset since the last peer of the instance left, so another instance can attach
+  std::atomic<uint32_t> Clean;
+};
+
+struct RingHeader
+{
+  /// Number of bytes written into and read from the ring since the segment was created, on separate cache lines
+  alignas(64) std::atomic<uint64_t> WriteCount;
+  alignas(64) std::atomic<uint64_t> ReadCount;
+};
+
+/// Header of the segment. The segment is zero-initialized when it is created.
+struct SegmentHeader
+{
+  std::atomic<uint32_t> Magic;
+  uint32_t Version;
+  uint64_t RingSize;
+  /// Process holding the lock of the attach and detach operations, 0 if none
+  std::atomic<uint32_t> LockOwner;
+  /// The name of the segment was removed, the instances still mapping it must open the name again
+  std::atomic<uint32_t> Removed;
+  SlotHeader Slots[2];
+  RingHeader Rings[2];
+};
+
+struct FrameHeader
+{
+  uint32_t Magic;
+  uint32_t Type;
+  uint32_t NameSize;
+  uint32_t MetaDataSize;
+  uint64_t PayloadSize;
+};
+
+static_assert(sizeof(SegmentHeader) <= HEADER_SIZE, "The segment header does not fit in its reserved size");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The rings require lock-free atomics, shared by the processes");
+
+//----------------------------------------------------------------------------
+uint32_t CurrentProcessID()
+{
+#ifdef _WIN32
+  return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+  return static_cast<uint32_t>(getpid());
+#endif
+}
+
+//----------------------------------------------------------------------------
+bool IsProcessRunning(uint32_t processID)
+{
+  if (processID == 0)
+  {
+    return false;
+  }
+  if (processID == CurrentProcessID())
+  {
+    return true;
+  }
+#ifdef _WIN32
+  HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, processID);
+  if (!process)
+  {
+    return GetLastError() == ERROR_ACCESS_DENIED;
+  }
+  bool running = (WaitForSingleObject(process, 0) == WAIT_TIMEOUT);
+  CloseHandle(process);
+  return running;
+#else
+  return kill(static_cast<pid_t>(processID), 0) == 0 || errno == EPERM;
+#endif
+}
+}
+
+//----------------------------------------------------------------------------
+class vtkCollaborationSharedMemoryLink::vtkInternal
+{
+public:
+  /// Map the segment of the name, creating it if it does not exist.
+  /// Return 1 if mapped, 0 if the segment is not ready yet, and -1 if the segment cannot be created.
+  int MapSegment();
+  void UnmapSegment();
+  /// Remove the names of the segment and its signals. The instances mapping them keep them until they unmap them.
+  void RemoveSegmentName();
+  /// Lock of the slots, shared by the processes
+  bool LockSegment();
+  void UnlockSegment();
+  char* GetRingBuffer(int ring);
+
+  /// Signals 0 and 1 tell that data was written into the ring of the same index, signals 2 and 3 that space was freed
+  void Signal(int index);
+  /// Wait for a signal for at most timeout milliseconds. Return false on timeout.
+  bool Wait(int index, int timeout);
+
+  /// Connection management, on the receiving thread
+  bool Attach();
+  void Detach();
+  bool ConnectPeer();
+  void DisconnectPeer();
+  bool IsPeerPresent(bool checkProcess);
+  /// Drop the unread content of both rings
+  void ResetRings();
+  void ReceiveLoop();
+
+  bool ReadBytes(char* data, uint64_t size);
+  bool WriteBytes(const char* data, uint64_t size);
+  bool ReadMessage(Message& message);
+  void Notify();
+
+  std::string Name;
+  uint64_t RingSize{ DefaultRingSize };
+  std::function<void()> NotificationCallback;
+  bool Opened{ false };
+
+  SegmentHeader* Header{ nullptr };
+  uint64_t MappedSize{ 0 };
+  int InvalidSegmentAttempts{ 0 };
+#ifdef _WIN32
+  HANDLE Mapping{ nullptr };
+  HANDLE Signals[4]{ nullptr, nullptr, nullptr, nullptr };
+#else
+  sem_t* Signals[4]{ SEM_FAILED, SEM_FAILED, SEM_FAILED, SEM_FAILED };
+#endif
+
+  /// Slot of this instance in the segment, -1 if not attached. The ring of the same index is written by the instance.
+  std::atomic<int> Slot{ -1 };
+  uint32_t PeerProcessID{ 0 };
+  uint32_t PeerToken{ 0 };
+  std::atomic<bool> PeerConnected{ false };
+  std::atomic<bool> StopRequested{ false };
+  /// The stream written by this instance was interrupted in the middle of a message, or the stream of the peer
+  /// is invalid: the instance leaves the segment and attaches again, so that the peer resets the rings
+  std::atomic<bool> ResetRequested{ false };
+  std::thread ReceiveThread;
+
+  /// Held while a message is written, and while the rings or the mapping change
+  std::mutex WriteMutex;
+  std::mutex ReceivedMessagesMutex;
+  std::deque<Message> ReceivedMessages;
+
+  std::atomic<uint64_t> NumberOfSentMessages{ 0 };
+  std::atomic<uint64_t> NumberOfSentBytes{ 0 };
+  std::atomic<uint64_t> NumberOfReceivedMessages{ 0 };
+  std::atomic<uint64_t> NumberOfReceivedBytes{ 0 };
+};
+
+//----------------------------------------------------------------------------
+int vtkCollaborationSharedMemoryLink::vtkInternal::MapSegment()
+{
+  uint64_t segmentSize = HEADER_SIZE + 2 * this->RingSize;
+  bool created = false;
+#ifdef _WIN32
+  std::string mappingName = "Local\\" + this->Name;
+  HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+    static_cast<DWORD>(segmentSize >> 32), static_cast<DWORD>(segmentSize & 0xffffffff), mappingName.c_str());
+  if (!mapping)
+  {
+    vtkGenericWarningMacro("vtkCollaborationSharedMemoryLink: Failed to create the shared memory " << this->Name);
+    return -1;
+  }
+  created = (GetLastError() != ERROR_ALREADY_EXISTS);
+  // the whole segment is mapped, whatever its size
+  void* address = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+  if (!address)
+  {
+    CloseHandle(mapping);
+    vtkGenericWarningMacro("vtkCollaborationSharedMemoryLink: Failed to map the shared memory " << this->Name);
+    return -1;
+  }
+  MEMORY_BASIC_INFORMATION memoryInformation;
+  VirtualQuery(address, &memoryInformation, sizeof(memoryInformation));
+  this->Mapping = mapping;
+  this->MappedSize = created ? segmentSize : memoryInformation.RegionSize;
+#else
+  std::string segmentName = "/" + this->Name;
+  int fileDescriptor = shm_open(segmentName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fileDescriptor >= 0)
+  {
+    created = true;
+    if (ftruncate(fileDescriptor, static_cast<off_t>(segmentSize)) != 0)
+    {
+      close(fileDescriptor);
+      shm_unlink(segmentName.c_str());
+      vtkGenericWarningMacro("vtkCollaborationSharedMemoryLink: Failed to allocate " << segmentSize
+        << " bytes of shared memory for " << this->Name);
+      return -1;
+    }
+  }
+  else if (errno == EEXIST)
+  {
+    fileDescriptor = shm_open(segmentName.c_str(), O_RDWR, 0600);
+    struct stat status;
+    if (fileDescriptor < 0 || fstat(fileDescriptor, &status) != 0 || static_cast<uint64_t>(status.st_size) < HEADER_SIZE)
+    {
+      // removed meanwhile, or not allocated by its creator yet
+      if (fileDescriptor >= 0)
+      {
+        close(fileDescriptor);
+      }
+      return 0;
+    }
+    segmentSize = static_cast<uint64_t>(status.st_size);
+  }
+  else
+  {
+    vtkGenericWarningMacro("vtkCollaborationSharedMemoryLink: Failed to create the shared memory " << this->Name
+      << ": " << strerror(errno));
+    return -1;
+  }
+  void* address = mmap(nullptr, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+  // the mapping stays valid after the descriptor is closed
+  close(fileDescriptor);
+  if (address == MAP_FAILED)
+  {
+    if (created)
+    {
+      shm_unlink(segmentName.c_str());
+    }
+    vtkGenericWarningMacro("vtkCollaborationSharedMemoryLink: Failed to map the shared memory " << this->Name);
+    return -1;
+  }
+  this->MappedSize = segmentSize;
+#endif
+  this->Header = static_cast<SegmentHeader*>(address);
+
+  if (created)
+  {
+    this->Header->Version = SEGMENT_VERSION;
+    this->Header->RingSize = this->RingSize;
+    this->Header->Magic.store(SEGMENT_MAGIC, std::memory_order_release);
+  }
+  else if (this->Header->Magic.load(std::memory_order_acquire) != SEGMENT_MAGIC)
+  {
+    // being initialized by its creator, or left uninitialized by a creator that exited meanwhile
+    this->UnmapSegment();
+    if (++this->InvalidSegmentAttempts > MAXIMUM_INVALID_SEGMENT_ATTEMPTS)
+    {
+      this->RemoveSegmentName();
+      this->InvalidSegmentAttempts = 0;
+    }
+    return 0;
+  }
+  else if (this->Header->Version != SEGMENT_VERSION || HEADER_SIZE + 2 * this->Header->RingSize > this->MappedSize)
+  {
+    vtkGenericWarningMacro("vtkCollaborationSharedMemoryLink: The shared memory " << this->Name
+      << " was created by an incompatible version");
+    this->UnmapSegment();
+    return -1;
+  }
+  this->InvalidSegmentAttempts = 0;
+
+  for (int signalIndex = 0; signalIndex < 4; signalIndex++)
+  {
+    std::string signalName = this->Name + (signalIndex < 2 ? "d" : "s") + std::to_string(signalIndex % 2);
+#ifdef _WIN32
+    this->Signals[signalIndex] = CreateEventA(nullptr, FALSE, FALSE, ("Local\\" + signalName).c_str());
+    bool signalCreated = (this->Signals[signalIndex] != nullptr);
+#else
+    this->Signals[signalIndex] = sem_open(("/" + signalName).c_str(), O_CREAT, 0600, 0);
+    bool signalCreated = (this->Signals[signalIndex] != SEM_FAILED);
+#endif
+    if (!signalCreated)
+    {
+      vtkGenericWarningMacro("vtkCollaborationSharedMemoryLink: Failed to create the signals of the shared memory " << this->Name);
+      this->UnmapSegment();
+      return -1;
+    }
+  }
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationSharedMemoryLink::vtkInternal::UnmapSegment()
+{
+  for (int signalIndex = 0; signalIndex < 4; signalIndex++)
+  {
+#ifdef _WIN32
+    if (this->Signals[signalIndex])
+    {
+      CloseHandle(this->Signals[signalIndex]);
+      this->Signals[signalIndex] = nullptr;
+    }
+#else
+    if (this->Signals[signalIndex] != SEM_FAILED)
+    {
+      sem_close(this->Signals[signalIndex]);
+      this->Signals[signalIndex] = SEM_FAILED;
+    }
+#endif
+  }
+  if (!this->Header)
+  {
+    return;
+  }
+#ifdef _WIN32
+  UnmapViewOfFile(this->Header);
+  CloseHandle(this->Mapping);
+  this->Mapping = nullptr;
+#else
+  munmap(this->Header, this->MappedSize);
+#endif
+  this->Header = nullptr;
+  this->MappedSize = 0;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationSharedMemoryLink::vtkInternal::RemoveSegmentName()
+{
+#ifndef _WIN32
+  // the objects of Windows are removed with their last handle
+  shm_unlink(("/" + this->Name).c_str());
+  for (int signalIndex = 0; signalIndex < 4; signalIndex++)
+  {
+    sem_unlink(("/" + this->Name + (signalIndex < 2 ? "d" : "s") + std::to_string(signalIndex % 2)).c_str());
+  }
+#endif
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationSharedMemoryLink::vtkInternal::LockSegment()
+{
+  uint32_t processID = CurrentProcessID();
+  std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  while (true)
+  {
+    uint32_t owner = 0;
+    if (this->Header->LockOwner.compare_exchange_strong(owner, processID, std::memory_order_acq_rel))
+    {
+      return true;
+    }
+    // the lock of a process that exited while holding it is taken over
+    if (!IsProcessRunning(owner) && this->Header->LockOwner.compare_exchange_strong(owner, processID, std::memory_order_acq_rel))
+    {
+      return true;
+    }
+    if (std::chrono::steady_clock::now() - startTime > std::chrono::milliseconds(WRITE_TIMEOUT))
+    {
+      vtkGenericWarningMacro("vtkCollaborationSharedMemoryLink: Timeout waiting for the lock of the shared memory " << this->Name);
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationSharedMemoryLink::vtkInternal::UnlockSegment()
+{
+  this->Header->LockOwner.store(0, std::memory_order_release);
+}
+
+//----------------------------------------------------------------------------
+char* vtkCollaborationSharedMemoryLink::vtkInternal::GetRingBuffer(int ring)
+{
+  return reinterpret_cast<char*>(this->Header) + HEADER_SIZE + ring * this->Header->RingSize;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationSharedMemoryLink::vtkInternal::Signal(int index)
+{
+#ifdef _WIN32
+  SetEvent(this->Signals[index]);
+#else
+  sem_post(this->Signals[index]);
+#endif
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationSharedMemoryLink::vtkInternal::Wait(int index, int timeout)
+{
+#ifdef _WIN32
+  // the events reset when a waiting thread is released, the signals sent meanwhile are merged
+  return WaitForSingleObject(this->Signals[index], timeout) == WAIT_OBJECT_0;
+#else
+  sem_t* semaphore = this->Signals[index];
+  bool signaled = false;
+# ifdef __APPLE__
+  // macOS has no timed wait on the named semaphores, they are polled
+  for (int elapsedTime = 0; elapsedTime < timeout && !signaled; elapsedTime++)
+  {
+    signaled = (sem_trywait(semaphore) == 0);
+    if (!signaled)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+# else
+  timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += timeout / 1000;
+  deadline.tv_nsec += (timeout % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L)
+  {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+  int result = 0;
+  do
+  {
+    result = sem_timedwait(semaphore, &deadline);
+  } while (result != 0 && errno == EINTR);
+  signaled = (result == 0);
+# endif
+  // the signals sent while the thread was busy are merged into this one
+  while (signaled && sem_trywait(semaphore) == 0)
+  {
+  }
+  return signaled;
+#endif
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationSharedMemoryLink::vtkInternal::Notify()
+{
+  if (this->NotificationCallback)
+  {
+    this->NotificationCallback();
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationSharedMemoryLink::vtkInternal::ResetRings()
+{
+  for (RingHeader& ring : this->Header->Rings)
+  {
+    ring.ReadCount.store(ring.WriteCount.load(std::memory_order_acquire), std::memory_order_release);
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationSharedMemoryLink::vtkInternal::Attach()
+{
+  if (!this->Header && this->MapSegment() <= 0)
+  {
+    return false;
+  }
+  if (!this->LockSegment())
+  {
+    return false;
+  }
+  if (this->Header->Removed.load(std::memory_order_acquire))
+  {
+    // the last instance left the segment after it was mapped, the name is used by a new segment
+    this->UnlockSegment();
+    std::lock_guard<std::mutex> writeLock(this->WriteMutex);
+    this->UnmapSegment();
+    return false;
+  }
+  // the slots of the instances that exited without leaving the segment are freed
+  for (SlotHeader& slot : this->Header->Slots)
+  {
+    if (slot.State.load(std::memory_order_acquire) == SlotActive && !IsProcessRunning(slot.ProcessID.load()))
+    {
+      slot.ProcessID.store(0);
+      slot.State.store(SlotFree, std::memory_order_release);
+    }
+  }
+  int slotIndex = -1;
+  if (this->Header->Slots[0].State.load(std::memory_order_acquire) == SlotFree)
+  {
+    slotIndex = 0;
+  }
+  else if (this->Header->Slots[1].State.load(std::memory_order_acquire) == SlotFree)
+  {
+    slotIndex = 1;
+  }
+  SlotHeader* otherSlot = (slotIndex >= 0) ? &this->Header->Slots[1 - slotIndex] : nullptr;
+  if (!otherSlot || (otherSlot->State.load(std::memory_order_acquire) == SlotActive && !otherSlot->Clean.load(std::memory_order_acquire)))
+  {
+    // two instances are already connected, or the other instance has not reset the rings of its previous peer yet
+    this->UnlockSegment();
+    return false;
+  }
+  if (otherSlot->State.load(std::memory_order_acquire) == SlotFree)
+  {
+    // first instance, the rings may still contain the end of a previous session
+    this->ResetRings();
+  }
+  SlotHeader& slot = this->Header->Slots[slotIndex];
+  slot.ProcessID.store(CurrentProcessID());
+  slot.Token.fetch_add(1);
+  slot.Clean.store(1);
+  slot.State.store(SlotActive, std::memory_order_release);
+  this->UnlockSegment();
+  this->Slot = slotIndex;
+  // wake the other instance, which waits for its peer on the data signal of this slot
+  this->Signal(slotIndex);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationSharedMemoryLink::vtkInternal::Detach()
+{
+  // the writer returns as soon as it sees the disconnection
+  std::lock_guard<std::mutex> writeLock(this->WriteMutex);
+  int slotIndex = this->Slot;
+  if (slotIndex < 0 || !this->Header)
+  {
+    return;
+  }
+  // the slot is freed even if the lock cannot be taken, the other instance would not see this one leave otherwise
+  bool locked = this->LockSegment();
+  SlotHeader& slot = this->Header->Slots[slotIndex];
+  slot.ProcessID.store(0);
+  slot.Clean.store(0);
+  slot.State.store(SlotFree, std::memory_order_release);
+  bool removed = false;
+#ifndef _WIN32
+  SlotHeader& otherSlot = this->Header->Slots[1 - slotIndex];
+  if (otherSlot.State.load(std::memory_order_acquire) == SlotFree || !IsProcessRunning(otherSlot.ProcessID.load()))
+  {
+    // last instance: the segment is removed, instead of keeping the memory of the rings until the next session
+    this->Header->Removed.store(1, std::memory_order_release);
+    this->RemoveSegmentName();
+    removed = true;
+  }
+#endif
+  if (locked)
+  {
+    this->UnlockSegment();
+  }
+  this->Slot = -1;
+  // wake the reader and the writer of the peer
+  this->Signal(slotIndex);
+  this->Signal(2 + (1 - slotIndex));
+  if (removed)
+  {
+    this->UnmapSegment();
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationSharedMemoryLink::vtkInternal::ConnectPeer()
+{
+  SlotHeader& peerSlot = this->Header->Slots[1 - this->Slot];
+  if (peerSlot.State.load(std::memory_order_acquire) != SlotActive || !this->LockSegment())
+  {
+    return false;
+  }
+  bool connected = false;
+  if (peerSlot.State.load(std::memory_order_acquire) == SlotActive)
+  {
+    if (IsProcessRunning(peerSlot.ProcessID.load()))
+    {
+      this->PeerProcessID = peerSlot.ProcessID.load();
+      this->PeerToken = peerSlot.Token.load();
+      // the next peer can only attach after the rings of this one are reset
+      this->Header->Slots[this->Slot].Clean.store(0, std::memory_order_release);
+      connected = true;
+    }
+    else
+    {
+      // the peer exited right after attaching, possibly in the middle of a message
+      peerSlot.ProcessID.store(0);
+      peerSlot.State.store(SlotFree, std::memory_order_release);
+      std::lock_guard<std::mutex> writeLock(this->WriteMutex);
+      this->ResetRings();
+    }
+  }
+  this->UnlockSegment();
+  if (connected)
+  {
+    this->PeerConnected = true;
+    this->Notify();
+  }
+  return connected;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationSharedMemoryLink::vtkInternal::DisconnectPeer()
+{
+  this->PeerConnected = false;
+  {
+    // the writer returns as soon as it sees the disconnection, then the rings can be reset
+    std::lock_guard<std::mutex> writeLock(this->WriteMutex);
+    if (this->LockSegment())
+    {
+      SlotHeader& peerSlot = this->Header->Slots[1 - this->Slot];
+      if (peerSlot.State.load(std::memory_order_acquire) == SlotActive && peerSlot.Token.load() == this->PeerToken
+        && !IsProcessRunning(peerSlot.ProcessID.load()))
+      {
+        peerSlot.ProcessID.store(0);
+        peerSlot.State.store(SlotFree, std::memory_order_release);
+      }
+      this->ResetRings();
+      this->Header->Slots[this->Slot].Clean.store(1, std::memory_order_release);
+      this->UnlockSegment();
+    }
+  }
+  this->Notify();
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationSharedMemoryLink::vtkInternal::IsPeerPresent(bool checkProcess)
+{
+  SlotHeader& peerSlot = this->Header->Slots[1 - this->Slot];
+  return peerSlot.State.load(std::memory_order_acquire) == SlotActive && peerSlot.Token.load() == this->PeerToken
+    && (!checkProcess || IsProcessRunning(this->PeerProcessID));
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationSharedMemoryLink::vtkInternal::ReceiveLoop()
+{
+  while (!this->StopRequested)
+  {
+    if (this->ResetRequested)
+    {
+      if (this->PeerConnected)
+      {
+        this->PeerConnected = false;
+        this->Notify();
+      }
+      this->Detach();
+      this->ResetRequested = false;
+    }
+    if (this->Slot < 0)
+    {
+      if (!this->Attach())
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(POLLING_TIMEOUT));
+      }
+      continue;
+    }
+    if (!this->PeerConnected)
+    {
+      if (!this->ConnectPeer())
+      {
+        this->Wait(1 - this->Slot, POLLING_TIMEOUT);
+      }
+      continue;
+    }
+    Message message;
+    if (this->ReadMessage(message))
+    {
+      this->NumberOfReceivedMessages++;
+      this->NumberOfReceivedBytes += sizeof(FrameHeader) + message.Name.size() + message.MetaData.size() + message.PayloadSize;
+      {
+        std::lock_guard<std::mutex> lock(this->ReceivedMessagesMutex);
+        this->ReceivedMessages.push_back(std::move(message));
+      }
+      this->Notify();
+    }
+    else if (!this->StopRequested && !this->ResetRequested)
+    {
+      this->DisconnectPeer();
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationSharedMemoryLink::vtkInternal::ReadBytes(char* data, uint64_t size)
+{
+  int ring = 1 - this->Slot;
+  RingHeader& ringHeader = this->Header->Rings[ring];
+  char* buffer = this->GetRingBuffer(ring);
+  uint64_t ringSize = this->Header->RingSize;
+  int spinCount = 0;
+  while (size > 0)
+  {
+    if (this->StopRequested || this->ResetRequested)
+    {
+      return false;
+    }
+    uint64_t readCount = ringHeader.ReadCount.load(std::memory_order_relaxed);
+    uint64_t availableSize = ringHeader.WriteCount.load(std::memory_order_acquire) - readCount;
+    if (availableSize == 0)
+    {
+      // the data written before the peer left is still read
+      if (spinCount++ < SPIN_COUNT)
+      {
+        continue;
+      }
+      if (!this->IsPeerPresent(false) || (!this->Wait(ring, POLLING_TIMEOUT) && !this->IsPeerPresent(true)))
+      {
+        return false;
+      }
+      spinCount = 0;
+      continue;
+    }
+    uint64_t count = std::min(availableSize, size);
+    uint64_t offset = readCount % ringSize;
+    uint64_t firstCount = std::min(count, ringSize - offset);
+    memcpy(data, buffer + offset, firstCount);
+    memcpy(data + firstCount, buffer, count - firstCount);
+    ringHeader.ReadCount.store(readCount + count, std::memory_order_release);
+    this->Signal(2 + ring);
+    data += count;
+    size -= count;
+    spinCount = 0;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationSharedMemoryLink::vtkInternal::WriteBytes(const char* data, uint64_t size)
+{
+  int ring = this->Slot;
+  RingHeader& ringHeader = this->Header->Rings[ring];
+  char* buffer = this->GetRingBuffer(ring);
+  uint64_t ringSize = this->Header->RingSize;
+  std::chrono::steady_clock::time_point waitStartTime = std::chrono::steady_clock::now();
+  while (size > 0)
+  {
+    if (this->StopRequested || !this->PeerConnected)
+    {
+      return false;
+    }
+    uint64_t writeCount = ringHeader.WriteCount.load(std::memory_order_relaxed);
+    uint64_t freeSize = ringSize - (writeCount - ringHeader.ReadCount.load(std::memory_order_acquire));
+    if (freeSize == 0)
+    {
+      if (!this->Wait(2 + ring, POLLING_TIMEOUT)
+        && std::chrono::steady_clock::now() - waitStartTime > std::chrono::milliseconds(WRITE_TIMEOUT))
+      {
+        vtkGenericWarningMacro("vtkCollaborationSharedMemoryLink: The peer of " << this->Name << " stopped reading");
+        return false;
+      }
+      continue;
+    }
+    uint64_t count = std::min(freeSize, size);
+    uint64_t offset = writeCount % ringSize;
+    uint64_t firstCount = std::min(count, ringSize - offset);
+    memcpy(buffer + offset, data, firstCount);
+    memcpy(buffer, data + firstCount, count - firstCount);
+    ringHeader.WriteCount.store(writeCount + count, std::memory_order_release);
+    this->Signal(ring);
+    data += count;
+    size -= count;
+    waitStartTime = std::chrono::steady_clock::now();
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationSharedMemoryLink::vtkInternal::ReadMessage(Message& message)
+{
+  FrameHeader frame;
+  if (!this->ReadBytes(reinterpret_cast<char*>(&frame), sizeof(frame)))
+  {
+    return false;
+  }
+  if (frame.Magic != FRAME_MAGIC)
+  {
+    vtkGenericWarningMacro("vtkCollaborationSharedMemoryLink: Invalid message received through " << this->Name);
+    this->ResetRequested = true;
+    return false;
+  }
+  message.Type = static_cast<int>(frame.Type);
+  message.Name.resize(frame.NameSize);
+  message.MetaData.resize(frame.MetaDataSize);
+  if (!this->ReadBytes(&message.Name[0], frame.NameSize) || !this->ReadBytes(&message.MetaData[0], frame.MetaDataSize))
+  {
+    return false;
+  }
+  // the payload is read directly into the buffer handed over to the caller
+  message.PayloadSize = static_cast<size_t>(frame.PayloadSize);
+  message.Payload.reset(frame.PayloadSize > 0 ? static_cast<char*>(malloc(message.PayloadSize)) : nullptr);
+  if (frame.PayloadSize > 0 && !message.Payload)
+  {
+    vtkGenericWarningMacro("vtkCollaborationSharedMemoryLink: Failed to allocate " << frame.PayloadSize
+      << " bytes for the message " << message.Name);
+    this->ResetRequested = true;
+    return false;
+  }
+  return this->ReadBytes(message.Payload.get(), frame.PayloadSize);
+}
+
+//----------------------------------------------------------------------------
+vtkCollaborationSharedMemoryLink::vtkCollaborationSharedMemoryLink()
+{
+  this->Internal = new vtkInternal;
+}
+
+//----------------------------------------------------------------------------
+vtkCollaborationSharedMemoryLink::~vtkCollaborationSharedMemoryLink()
+{
+  this->Close();
+  delete this->Internal;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationSharedMemoryLink::SetRingSize(uint64_t size)
+{
+  this->Internal->RingSize = std::max<uint64_t>(size, 65536);
+}
+
+//----------------------------------------------------------------------------
+uint64_t vtkCollaborationSharedMemoryLink::GetRingSize()
+{
+  return this->Internal->RingSize;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationSharedMemoryLink::SetNotificationCallback(const std::function<void()>& callback)
+{
+  this->Internal->NotificationCallback = callback;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationSharedMemoryLink::Open(const std::string& name)
+{
+  this->Close();
+  if (name.empty())
+  {
+    return false;
+  }
+  this->Internal->Name = name;
+  this->Internal->StopRequested = false;
+  this->Internal->ResetRequested = false;
+  // mapped now so that the failures are reported, the slot is taken by the receiving thread
+  if (this->Internal->MapSegment() < 0)
+  {
+    return false;
+  }
+  this->Internal->Opened = true;
+  this->Internal->ReceiveThread = std::thread(&vtkInternal::ReceiveLoop, this->Internal);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkCollaborationSharedMemoryLink::Close()
+{
+  if (!this->Internal->Opened)
+  {
+    return;
+  }
+  this->Internal->StopRequested = true;
+  int slotIndex = this->Internal->Slot;
+  if (this->Internal->Header && slotIndex >= 0)
+  {
+    // wake the receiving thread
+    this->Internal->Signal(1 - slotIndex);
+  }
+  this->Internal->ReceiveThread.join();
+  this->Internal->PeerConnected = false;
+  this->Internal->Detach();
+  {
+    std::lock_guard<std::mutex> writeLock(this->Internal->WriteMutex);
+    this->Internal->UnmapSegment();
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->Internal->ReceivedMessagesMutex);
+    this->Internal->ReceivedMessages.clear();
+  }
+  this->Internal->Opened = false;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationSharedMemoryLink::IsOpen()
+{
+  return this->Internal->Opened;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationSharedMemoryLink::IsPeerConnected()
+{
+  return this->Internal->PeerConnected;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationSharedMemoryLink::WriteMessage(int type, const std::string& name, const std::string& metaData,
+  const char* payload, size_t payloadSize)
+{
+  std::lock_guard<std::mutex> writeLock(this->Internal->WriteMutex);
+  if (!this->Internal->Header || this->Internal->Slot < 0 || !this->Internal->PeerConnected || this->Internal->ResetRequested)
+  {
+    return false;
+  }
+  FrameHeader frame;
+  frame.Magic = FRAME_MAGIC;
+  frame.Type = static_cast<uint32_t>(type);
+  frame.NameSize = static_cast<uint32_t>(name.size());
+  frame.MetaDataSize = static_cast<uint32_t>(metaData.size());
+  frame.PayloadSize = payload ? payloadSize : 0;
+  if (!this->Internal->WriteBytes(reinterpret_cast<const char*>(&frame), sizeof(frame))
+    || !this->Internal->WriteBytes(name.data(), name.size())
+    || !this->Internal->WriteBytes(metaData.data(), metaData.size())
+    || !this->Internal->WriteBytes(payload, frame.PayloadSize))
+  {
+    if (this->Internal->PeerConnected && !this->Internal->StopRequested)
+    {
+      // the peer would read the rest of this message as the beginning of the next one
+      this->Internal->ResetRequested = true;
+      this->Internal->Signal(1 - this->Internal->Slot);
+    }
+    return false;
+  }
+  this->Internal->NumberOfSentMessages++;
+  this->Internal->NumberOfSentBytes += sizeof(frame) + name.size() + metaData.size() + frame.PayloadSize;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCollaborationSharedMemoryLink::PopMessage(Message& message)
+{
+  std::lock_guard<std::mutex> lock(this->Internal->ReceivedMessagesMutex);
+  if (this->Internal->ReceivedMessages.empty())
+  {
+    return false;
+  }
+  message = std::move(this->Internal->ReceivedMessages.front());
+  this->Internal->ReceivedMessages.pop_front();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+uint64_t vtkCollaborationSharedMemoryLink::GetNumberOfSentMessages()
+{
+  return this->Internal->NumberOfSentMessages;
+}
+
+//----------------------------------------------------------------------------
+uint64_t vtkCollaborationSharedMemoryLink::GetNumberOfSentBytes()
+{
+  return this->Internal->NumberOfSentBytes;
+}
+
+//----------------------------------------------------------------------------
+uint64_t vtkCollaborationSharedMemoryLink::GetNumberOfReceivedMessages()
+{
+  return this->Internal->NumberOfReceivedMessages;
+}
+
+//----------------------------------------------------------------------------
+uint64_t vtkCollaborationSharedMemoryLink::GetNumberOfReceivedBytes()
+{
+  return this->Internal->NumberOfReceivedBytes;
+}
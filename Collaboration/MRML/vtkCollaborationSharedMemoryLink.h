@@ -0,0 +1,120 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+#ifndef __vtkCollaborationSharedMemoryLink_h
+#define __vtkCollaborationSharedMemoryLink_h
+
+// STD includes
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+
+// Collaboration includes
+#include "vtkSlicerCollaborationModuleMRMLExport.h"
+
+/// \brief Link between two collaboration connectors running on the same host, through a named shared memory segment.
+///
+/// The segment contains two ring buffers, one written by each instance. The first instance opening a name creates
+/// the segment, the second one attaches to it, and the link is connected while both are attached. A message is
+/// written into the ring with one copy of its payload, and read by a thread of the receiving instance into a buffer
+/// handed over to the caller, so that large meshes and images are not serialized as OpenIGTLink messages. The reader
+/// is woken by a named semaphore (an event on Windows) after each write.
+///
+/// An instance leaving the segment, or exiting without closing it, is detected by its peer, which resets the rings
+/// so that another instance can attach to the same name.
+class VTK_SLICER_COLLABORATION_MODULE_MRML_EXPORT vtkCollaborationSharedMemoryLink
+{
+public:
+  enum MessageType
+  {
+    /// Text of a node or a message of the connector, with the encoding in the metadata
+    MessageText = 1,
+    /// Matrix to parent of a linear transform, 16 doubles
+    MessageTransform,
+    /// Mesh of a model, as VTK XML polydata with raw appended arrays
+    MessagePolyData,
+    /// Voxels of an image, with its extent and scalar type in the metadata
+    MessageImage
+  };
+
+  struct PayloadDeleter
+  {
+    void operator()(char* payload) const { free(payload); }
+  };
+  /// Payload allocated with malloc, so that the arrays of VTK can take it over
+  typedef std::unique_ptr<char, PayloadDeleter> PayloadPointer;
+
+  struct Message
+  {
+    int Type{ 0 };
+    std::string Name;
+    std::string MetaData;
+    PayloadPointer Payload;
+    size_t PayloadSize{ 0 };
+  };
+
+  vtkCollaborationSharedMemoryLink();
+  ~vtkCollaborationSharedMemoryLink();
+
+  /// Size in bytes of each ring buffer of the segment, used if the segment is created by this instance.
+  /// Messages larger than the ring are streamed through it while the peer reads them.
+  void SetRingSize(uint64_t size);
+  uint64_t GetRingSize();
+
+  /// Function called from the receiving thread when a message is received or when the peer connects or disconnects.
+  /// It must return without processing the message. Set it before opening the link.
+  void SetNotificationCallback(const std::function<void()>& callback);
+
+  /// Create or attach to the segment of the given name, and start the receiving thread. If two instances are already
+  /// attached to the segment, or if the previous peer has not left it yet, attaching is retried until the link is
+  /// closed. Return false if the segment could not be created.
+  bool Open(const std::string& name);
+  /// Leave the segment and stop the receiving thread. The segment is removed when both instances have left it.
+  void Close();
+  bool IsOpen();
+  /// Return true while both instances are attached to the segment
+  bool IsPeerConnected();
+
+  /// Write a message into the ring of this instance. The call blocks while the ring is full.
+  /// Return false if the peer is not connected, or if it stopped reading for longer than the write timeout.
+  bool WriteMessage(int type, const std::string& name, const std::string& metaData, const char* payload, size_t payloadSize);
+  /// Get the next received message. Return false if there is none.
+  bool PopMessage(Message& message);
+
+  /// Statistics since the link was created
+  uint64_t GetNumberOfSentMessages();
+  uint64_t GetNumberOfSentBytes();
+  uint64_t GetNumberOfReceivedMessages();
+  uint64_t GetNumberOfReceivedBytes();
+
+  static const uint64_t DefaultRingSize = 64 * 1024 * 1024;
+
+private:
+  vtkCollaborationSharedMemoryLink(const vtkCollaborationSharedMemoryLink&) = delete;
+  void operator=(const vtkCollaborationSharedMemoryLink&) = delete;
+
+  class vtkInternal;
+  vtkInternal* Internal;
+};
+
+#endif
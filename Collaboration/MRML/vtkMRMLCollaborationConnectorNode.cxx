@@ -20,57 +20,411 @@
 ==============================================================================*/
 
 #include "vtkMRMLCollaborationConnectorNode.h"
+#include "vtkCollaborationAttributeSchema.h"
+#include "vtkCollaborationContentCache.h"
+#include "vtkCollaborationImageDelta.h"
+#include "vtkCollaborationMessageCompression.h"
+#include "vtkCollaborationNodeCodec.h"
+#include "vtkCollaborationPoseChannel.h"
+#include "vtkCollaborationRelayHub.h"
+#include "vtkCollaborationSharedMemoryLink.h"
 
 // Slicer MRML includes
 #include "vtkMRMLScene.h"
 #include "vtkMRMLModelNode.h"
 #include "vtkMRMLModelDisplayNode.h"
+#include "vtkMRMLScalarVolumeNode.h"
 #include "vtkMRMLTextNode.h"
-#include <vtkMRMLMarkupsLineNode.h>
-#include <vtkMRMLMarkupsPlaneNode.h>
-#include <vtkMRMLMarkupsAngleNode.h>
-#include <vtkMRMLMarkupsCurveNode.h>
-#include <vtkMRMLMarkupsClosedCurveNode.h>
-#include <vtkMRMLMarkupsROINode.h>
-#include <vtkMRMLMarkupsFiducialNode.h>
+#include <vtkMRMLMarkupsNode.h>
+#include <vtkMRMLMeasurement.h>
 #include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLSliceNode.h>
 
 // VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
+#include <vtkPointData.h>
 #include <vtkXMLUtilities.h>
 #include <vtkXMLDataElement.h>
 #include <vtkPolyData.h>
+#include <vtkQuadricDecimation.h>
+#include <vtkSmartPointer.h>
+#include <vtkStringArray.h>
+#include <vtkTriangleFilter.h>
+#include <vtkXMLPolyDataReader.h>
+#include <vtkXMLPolyDataWriter.h>
 
 // STD includes
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <future>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
 #include <sstream>
 #include <vtkXMLDataElement.h>
 #include <strstream>
 
 // OpenIGTLinkIO include
+#include <igtlioImageDevice.h>
 #include <igtlioPolyDataDevice.h>
+#include <igtlioStringDevice.h>
+
+//----------------------------------------------------------------------------
+const char* vtkMRMLCollaborationConnectorNode::LevelOfDetailMetaDataKey = "CollaborationLevelOfDetail";
+const char* vtkMRMLCollaborationConnectorNode::LevelOfDetailProxy = "Proxy";
+const char* vtkMRMLCollaborationConnectorNode::LevelOfDetailFull = "Full";
+const char* vtkMRMLCollaborationConnectorNode::LevelOfDetailAttributeName = "Collaboration.LevelOfDetail";
+const char* vtkMRMLCollaborationConnectorNode::OfferOnConnectAttributeName = "Collaboration.offerOnConnect";
+const char* vtkMRMLCollaborationConnectorNode::LocalPoseNamePrefix = "VirtualReality.";
+const char* vtkMRMLCollaborationConnectorNode::ParticipantPoseNamePrefix = "Participant";
+const char* vtkMRMLCollaborationConnectorNode::ParticipantPoseAttributeName = "Collaboration.ParticipantPose";
+const char* vtkMRMLCollaborationConnectorNode::ContentHashMetaDataKey = "CollaborationContentHash";
+const char* vtkMRMLCollaborationConnectorNode::CompressionMetaDataKey = "CollaborationCompression";
+const char* vtkMRMLCollaborationConnectorNode::ChannelDeviceNamePrefix = "CollaborationChannel";
+const char* vtkMRMLCollaborationConnectorNode::SynchronizationChannelName = "Synchronization";
+const char* vtkMRMLCollaborationConnectorNode::BundleDeviceName = "CollaborationBundle";
+const char* vtkMRMLCollaborationConnectorNode::CapabilitiesDeviceName = "CollaborationCapabilities";
+const char* vtkMRMLCollaborationConnectorNode::BinaryAttributeEncodingFeature = "BinaryAttributeEncoding";
+const char* vtkMRMLCollaborationConnectorNode::VolumeDeltaFeature = "VolumeDeltas";
+const char* vtkMRMLCollaborationConnectorNode::ProgressiveVolumeFeature = "ProgressiveVolumes";
+const char* vtkMRMLCollaborationConnectorNode::MessageBundlingFeature = "MessageBundling";
+const char* vtkMRMLCollaborationConnectorNode::PoseDatagramFeature = "PoseDatagrams";
+
+namespace
+{
+/// Messages larger than this are sent on their own
+const size_t MAXIMUM_BUNDLED_MESSAGE_SIZE = 16384;
+/// A bundle is sent when it would exceed this size, to stay below the maximum length of a string message
+const size_t MAXIMUM_BUNDLE_SIZE = 49152;
+/// The channel messages not acknowledged within this time, in seconds, are sent again
+const double CHANNEL_ACKNOWLEDGMENT_TIMEOUT = 1.0;
+/// The oldest channel messages are dropped when the messages not acknowledged yet exceed this size, such as when
+/// the peer stops acknowledging them
+const size_t MAXIMUM_CHANNEL_BACKLOG_SIZE = 64 * 1024 * 1024;
+/// Prefix of the names of the shared memory of the same host sessions, followed by the server port
+const char* SHARED_MEMORY_NAME_PREFIX = "SlicerCollaboration";
+/// Interval of the periodic processing, in seconds, while data is exchanged or work is in progress
+const double MINIMUM_PROCESSING_INTERVAL = 0.005;
+/// Interval of the periodic processing, in seconds, reached after one second without data exchanged
+const double MAXIMUM_PROCESSING_INTERVAL = 0.1;
+
+//----------------------------------------------------------------------------
+/// Metadata of the shared memory messages, one key=value per line
+std::string EncodeMetaData(const std::map<std::string, std::string>& metaData)
+{
+  std::string text;
+  for (const std::pair<const std::string, std::string>& item : metaData)
+  {
+    text += item.first + "=" + item.second + "\n";
+  }
+  return text;
+}
+
+//----------------------------------------------------------------------------
+std::map<std::string, std::string> DecodeMetaData(const std::string& text)
+{
+  std::map<std::string, std::string> metaData;
+  std::stringstream lines(text);
+  std::string line;
+  while (std::getline(lines, line))
+  {
+    size_t separator = line.find('=');
+    if (separator != std::string::npos)
+    {
+      metaData[line.substr(0, separator)] = line.substr(separator + 1);
+    }
+  }
+  return metaData;
+}
+
+//----------------------------------------------------------------------------
+/// Parse a sequence number sent by the peer. Return false if the text is not a number.
+bool ParseSequenceNumber(const char* text, unsigned long& sequenceNumber)
+{
+  if (!text)
+  {
+    return false;
+  }
+  char* textEnd = nullptr;
+  errno = 0;
+  sequenceNumber = strtoul(text, &textEnd, 10);
+  return textEnd != text && *textEnd == '\0' && errno == 0;
+}
+
+//----------------------------------------------------------------------------
+/// Read count values separated by spaces. Return false if there are fewer values.
+template <typename T>
+bool DecodeValues(const std::string& text, int count, T* values)
+{
+  std::stringstream ss(text);
+  for (int index = 0; index < count; index++)
+  {
+    if (!(ss >> values[index]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+}
+
+//----------------------------------------------------------------------------
+/// Progressive delivery of an outgoing volume
+struct vtkMRMLCollaborationConnectorNode::VolumeStream
+{
+  /// Image read by the stream, sharing the arrays of the volume
+  vtkSmartPointer<vtkImageData> Image;
+  /// One voxel out of Step is sent along each axis at the current level
+  int Step{ 1 };
+  /// Extents of the bricks of the current level that are not sent yet
+  std::vector<std::array<int, 6> > Bricks;
+  /// The volume was modified during the stream
+  bool Outdated{ false };
+};
+
+//----------------------------------------------------------------------------
+class vtkMRMLCollaborationConnectorNode::vtkCollaborationInternal
+{
+public:
+  /// Wake-up of the main thread. Declared first, so that it is destroyed after the workers that may call it.
+  std::mutex WakeUpMutex;
+  WakeUpCallbackType WakeUpCallback{ nullptr };
+  void* WakeUpClientData{ nullptr };
+  /// A wake-up has been requested since the last call of ProcessPendingTasks
+  std::atomic<bool> ProcessingRequested{ false };
+
+  /// Proxies being built on a worker thread, by model node ID
+  std::map<std::string, std::future<vtkSmartPointer<vtkPolyData> > > PendingProxies;
+  /// Proxy to put in the outgoing device instead of the model mesh, by model node ID
+  std::map<std::string, vtkSmartPointer<vtkPolyData> > OutgoingProxies;
+
+  /// Content hash of the outgoing nodes, with the modification time of the content it was computed from
+  std::map<std::string, std::pair<vtkMTimeType, std::string> > ContentHashes;
+  /// Received payloads being written to the content cache on a worker thread
+  std::vector<std::future<bool> > PendingCacheWrites;
+  vtkSmartPointer<vtkCollaborationContentCache> ContentCache;
+  vtkSmartPointer<vtkCallbackCommand> ConnectedCallback;
+
+  struct ChannelMessage
+  {
+    unsigned long Sequence;
+    std::string Channel;
+    std::string Text;
+    /// Empty if the message is not replaced by newer ones
+    std::string StateKey;
+  };
+  /// Channel messages not acknowledged by the peer yet
+  std::deque<ChannelMessage> OutgoingChannelMessages;
+  /// Total size of the texts of the outgoing channel messages
+  size_t OutgoingChannelSize{ 0 };
+  unsigned long NextChannelSequence{ 1 };
+  /// Sequence number of the last channel message sent, and of the last one acknowledged by the peer. The messages
+  /// after the last sent one are sent in the next bundle.
+  unsigned long LastSentChannelSequence{ 0 };
+  unsigned long LastAcknowledgedChannelSequence{ 0 };
+  /// Last time the peer acknowledged channel messages, or the messages were sent again
+  std::chrono::steady_clock::time_point LastChannelProgressTime;
+  /// The messages not acknowledged yet are sent again in the next bundle
+  bool ChannelResendRequested{ false };
+  /// A bundle of the peer was lost, the next bundle asks the peer to send its messages again
+  bool ChannelGapDetected{ false };
+  /// Sequence number of the last channel message received from each channel device. The one of the peer is sent back
+  /// as acknowledgment, the participants of a relay hub are acknowledged by the hub.
+  std::map<std::string, unsigned long> LastReceivedChannelSequences;
+  /// Epoch of the last bundle received from each channel device. A peer that restarts numbers its messages from 1
+  /// again in a new epoch, the participant ID of its connector.
+  std::map<std::string, std::string> ReceivedChannelEpochs;
+  /// The channel bundle needs to be sent in the next ProcessPendingTasks
+  bool ChannelModified{ false };
+
+  /// Metadata received before the node it applies to, by target node name
+  std::map<std::string, std::string> DeferredMetadata;
+  /// Latest metadata applied again when nodes are added, such as the transformed nodes of each received transform,
+  /// by target node name
+  std::map<std::string, vtkSmartPointer<vtkXMLDataElement> > KeptMetadata;
+
+  /// Copy of the last image pushed for each outgoing volume, by volume node ID
+  std::map<std::string, vtkSmartPointer<vtkImageData> > SentVolumeImages;
+  /// Outgoing volumes modified since their first push. Only these keep a copy of their pushed image.
+  std::set<std::string> EditedVolumeIDs;
+  /// Volumes being streamed, by volume node ID
+  std::map<std::string, VolumeStream> VolumeStreams;
+  std::chrono::steady_clock::time_point LastVolumeBrickTime;
+
+  /// Text messages to send in the next bundle, as device name and text
+  std::vector<std::pair<std::string, std::string> > BundledMessages;
+  size_t BundleSize{ 0 };
+
+  /// Capabilities of the peer: protocol version, features it can receive, and codecs it can decompress
+  int PeerProtocolVersion{ 0 };
+  std::set<std::string> PeerFeatures;
+  std::vector<std::string> PeerCompressionCodecs;
+  vtkTypeUInt64 NumberOfCompressedMessages{ 0 };
+  vtkTypeUInt64 CompressionInputSize{ 0 };
+  vtkTypeUInt64 CompressionOutputSize{ 0 };
+  double CompressionTime{ 0.0 };
+  vtkTypeUInt64 NumberOfDecompressedMessages{ 0 };
+  double DecompressionTime{ 0.0 };
+  /// IDs of the text nodes whose text is compressed, marked in the meta data of their messages
+  std::set<std::string> CompressedTextNodeIDs;
+
+  /// Events of the outgoing nodes to push in the next ProcessPendingTasks, by node ID
+  std::map<std::string, std::set<unsigned long> > PendingPushEvents;
+
+  /// Relay hub started by the node, and port it was started on
+  vtkSmartPointer<vtkCollaborationRelayHub> RelayHub;
+  int RelayHubPort{ 0 };
+  /// Identifies the channel device of the node among the participants of a relay hub
+  std::string ParticipantID;
+
+  /// Received markups whose measurements have not been computed since their last update, by node ID, with the
+  /// names of the measurements disabled until then
+  std::map<std::string, std::vector<std::string> > StaleMeasurements;
+  std::chrono::steady_clock::time_point LastMeasurementUpdateTime;
+
+  /// Shared memory of the same host session, open while the session is started
+  std::unique_ptr<vtkCollaborationSharedMemoryLink> SharedMemoryLink;
+  /// Connection state of the link as last notified by the node
+  bool SharedMemoryConnected{ false };
+  /// Set while the messages received outside of OpenIGTLink are applied, so that the received state is not sent back
+  bool ApplyingDirectMessages{ false };
+
+  /// UDP channel of the poses, open while the session is started if the pose datagrams are enabled
+  std::unique_ptr<vtkCollaborationPoseChannel> PoseChannel;
+  /// Reachability of the peer at the previous call of ProcessPendingTasks
+  bool PoseChannelReachable{ false };
+
+  /// Last time data was sent or received, the periodic processing slows down while the connection is idle
+  std::chrono::steady_clock::time_point LastTrafficTime;
+  /// Transforms sent as datagrams while the peer was reachable, by node ID
+  std::set<std::string> PoseDatagramNodeIDs;
+};
 
 //----------------------------------------------------------------------------
 vtkMRMLNodeNewMacro(vtkMRMLCollaborationConnectorNode);
 
 //----------------------------------------------------------------------------
 vtkMRMLCollaborationConnectorNode::vtkMRMLCollaborationConnectorNode()
+  : ProgressiveModelDelivery(false)
+  , ProxyTargetReduction(0.97)
+  , ProxyMinimumNumberOfCells(50000)
+  , ContentCacheEnabled(false)
+  , ContentCacheMaximumSize(2048)
+  , MeasurementUpdateInterval(0.1)
+  , BinaryAttributeEncoding(false)
+  , VolumeDeltaDelivery(true)
+  , VolumeDeltaCompression(false)
+  , ProgressiveVolumeDelivery(false)
+  , ProgressiveVolumeMinimumNumberOfVoxels(1000000)
+  , ProgressiveVolumeBandwidth(100.0)
+  , RelayHub(false)
+  , StateUpdateCoalescing(true)
+  , MessageBundling(true)
+  , MessageCompression(false)
+  , MessageCompressionThreshold(256)
+  , SameHostTransport(false)
+  , PoseDatagramDelivery(false)
 {
+  this->CollaborationInternal = new vtkCollaborationInternal;
+  this->CollaborationInternal->ContentCache = vtkSmartPointer<vtkCollaborationContentCache>::New();
+  this->CollaborationInternal->RelayHub = vtkSmartPointer<vtkCollaborationRelayHub>::New();
+  std::random_device randomDevice;
+  std::stringstream participantID;
+  participantID << std::hex << randomDevice() << randomDevice();
+  this->CollaborationInternal->ParticipantID = participantID.str();
+
+  // offer the content of the synchronized nodes when the connection is established
+  this->CollaborationInternal->ConnectedCallback = vtkSmartPointer<vtkCallbackCommand>::New();
+  this->CollaborationInternal->ConnectedCallback->SetClientData(this);
+  this->CollaborationInternal->ConnectedCallback->SetCallback(vtkMRMLCollaborationConnectorNode::onConnected);
+  this->AddObserver(vtkMRMLIGTLConnectorNode::ConnectedEvent, this->CollaborationInternal->ConnectedCallback);
+  this->AddObserver(vtkMRMLIGTLConnectorNode::DisconnectedEvent, this->CollaborationInternal->ConnectedCallback);
 }
 
 //----------------------------------------------------------------------------
-vtkMRMLCollaborationConnectorNode::~vtkMRMLCollaborationConnectorNode() = default;
+vtkMRMLCollaborationConnectorNode::~vtkMRMLCollaborationConnectorNode()
+{
+  this->RemoveObserver(this->CollaborationInternal->ConnectedCallback);
+  this->SetWakeUpCallback(nullptr, nullptr);
+  // stops the thread of the link, which requests processing
+  this->CollaborationInternal->SharedMemoryLink.reset();
+  this->CollaborationInternal->PoseChannel.reset();
+  // Waits for the proxies and cache writes still in progress
+  delete this->CollaborationInternal;
+}
 
 //----------------------------------------------------------------------------
 void vtkMRMLCollaborationConnectorNode::WriteXML(ostream & of, int nIndent)
 {
   Superclass::WriteXML(of, nIndent);
+
+  vtkMRMLWriteXMLBeginMacro(of);
+  vtkMRMLWriteXMLBooleanMacro(progressiveModelDelivery, ProgressiveModelDelivery);
+  vtkMRMLWriteXMLFloatMacro(proxyTargetReduction, ProxyTargetReduction);
+  vtkMRMLWriteXMLIntMacro(proxyMinimumNumberOfCells, ProxyMinimumNumberOfCells);
+  vtkMRMLWriteXMLBooleanMacro(contentCacheEnabled, ContentCacheEnabled);
+  vtkMRMLWriteXMLStdStringMacro(contentCacheDirectory, ContentCacheDirectory);
+  vtkMRMLWriteXMLIntMacro(contentCacheMaximumSize, ContentCacheMaximumSize);
+  vtkMRMLWriteXMLFloatMacro(measurementUpdateInterval, MeasurementUpdateInterval);
+  vtkMRMLWriteXMLBooleanMacro(binaryAttributeEncoding, BinaryAttributeEncoding);
+  vtkMRMLWriteXMLBooleanMacro(volumeDeltaDelivery, VolumeDeltaDelivery);
+  vtkMRMLWriteXMLBooleanMacro(volumeDeltaCompression, VolumeDeltaCompression);
+  vtkMRMLWriteXMLBooleanMacro(progressiveVolumeDelivery, ProgressiveVolumeDelivery);
+  vtkMRMLWriteXMLIntMacro(progressiveVolumeMinimumNumberOfVoxels, ProgressiveVolumeMinimumNumberOfVoxels);
+  vtkMRMLWriteXMLFloatMacro(progressiveVolumeBandwidth, ProgressiveVolumeBandwidth);
+  vtkMRMLWriteXMLBooleanMacro(relayHub, RelayHub);
+  vtkMRMLWriteXMLBooleanMacro(stateUpdateCoalescing, StateUpdateCoalescing);
+  vtkMRMLWriteXMLBooleanMacro(messageBundling, MessageBundling);
+  vtkMRMLWriteXMLBooleanMacro(messageCompression, MessageCompression);
+  vtkMRMLWriteXMLIntMacro(messageCompressionThreshold, MessageCompressionThreshold);
+  vtkMRMLWriteXMLBooleanMacro(sameHostTransport, SameHostTransport);
+  vtkMRMLWriteXMLBooleanMacro(poseDatagramDelivery, PoseDatagramDelivery);
+  vtkMRMLWriteXMLEndMacro();
 }
 
 //----------------------------------------------------------------------------
 void vtkMRMLCollaborationConnectorNode::ReadXMLAttributes(const char** atts)
 {
+  MRMLNodeModifyBlocker blocker(this);
   Superclass::ReadXMLAttributes(atts);
+
+  vtkMRMLReadXMLBeginMacro(atts);
+  vtkMRMLReadXMLBooleanMacro(progressiveModelDelivery, ProgressiveModelDelivery);
+  vtkMRMLReadXMLFloatMacro(proxyTargetReduction, ProxyTargetReduction);
+  vtkMRMLReadXMLIntMacro(proxyMinimumNumberOfCells, ProxyMinimumNumberOfCells);
+  vtkMRMLReadXMLBooleanMacro(contentCacheEnabled, ContentCacheEnabled);
+  vtkMRMLReadXMLStdStringMacro(contentCacheDirectory, ContentCacheDirectory);
+  vtkMRMLReadXMLIntMacro(contentCacheMaximumSize, ContentCacheMaximumSize);
+  vtkMRMLReadXMLFloatMacro(measurementUpdateInterval, MeasurementUpdateInterval);
+  vtkMRMLReadXMLBooleanMacro(binaryAttributeEncoding, BinaryAttributeEncoding);
+  vtkMRMLReadXMLBooleanMacro(volumeDeltaDelivery, VolumeDeltaDelivery);
+  vtkMRMLReadXMLBooleanMacro(volumeDeltaCompression, VolumeDeltaCompression);
+  vtkMRMLReadXMLBooleanMacro(progressiveVolumeDelivery, ProgressiveVolumeDelivery);
+  vtkMRMLReadXMLIntMacro(progressiveVolumeMinimumNumberOfVoxels, ProgressiveVolumeMinimumNumberOfVoxels);
+  vtkMRMLReadXMLFloatMacro(progressiveVolumeBandwidth, ProgressiveVolumeBandwidth);
+  vtkMRMLReadXMLBooleanMacro(relayHub, RelayHub);
+  vtkMRMLReadXMLBooleanMacro(stateUpdateCoalescing, StateUpdateCoalescing);
+  vtkMRMLReadXMLBooleanMacro(messageBundling, MessageBundling);
+  vtkMRMLReadXMLBooleanMacro(messageCompression, MessageCompression);
+  vtkMRMLReadXMLIntMacro(messageCompressionThreshold, MessageCompressionThreshold);
+  vtkMRMLReadXMLBooleanMacro(sameHostTransport, SameHostTransport);
+  vtkMRMLReadXMLBooleanMacro(poseDatagramDelivery, PoseDatagramDelivery);
+  vtkMRMLReadXMLEndMacro();
 }
 
 //----------------------------------------------------------------------------
@@ -78,18 +432,2136 @@ void vtkMRMLCollaborationConnectorNode::CopyContent(vtkMRMLNode * anode, bool de
 {
   MRMLNodeModifyBlocker blocker(this);
   Superclass::CopyContent(anode, deepCopy);
+
+  vtkMRMLCopyBeginMacro(anode);
+  vtkMRMLCopyBooleanMacro(ProgressiveModelDelivery);
+  vtkMRMLCopyFloatMacro(ProxyTargetReduction);
+  vtkMRMLCopyIntMacro(ProxyMinimumNumberOfCells);
+  vtkMRMLCopyBooleanMacro(ContentCacheEnabled);
+  vtkMRMLCopyStdStringMacro(ContentCacheDirectory);
+  vtkMRMLCopyIntMacro(ContentCacheMaximumSize);
+  vtkMRMLCopyFloatMacro(MeasurementUpdateInterval);
+  vtkMRMLCopyBooleanMacro(BinaryAttributeEncoding);
+  vtkMRMLCopyBooleanMacro(VolumeDeltaDelivery);
+  vtkMRMLCopyBooleanMacro(VolumeDeltaCompression);
+  vtkMRMLCopyBooleanMacro(ProgressiveVolumeDelivery);
+  vtkMRMLCopyIntMacro(ProgressiveVolumeMinimumNumberOfVoxels);
+  vtkMRMLCopyFloatMacro(ProgressiveVolumeBandwidth);
+  vtkMRMLCopyBooleanMacro(RelayHub);
+  vtkMRMLCopyBooleanMacro(StateUpdateCoalescing);
+  vtkMRMLCopyBooleanMacro(MessageBundling);
+  vtkMRMLCopyBooleanMacro(MessageCompression);
+  vtkMRMLCopyIntMacro(MessageCompressionThreshold);
+  vtkMRMLCopyBooleanMacro(SameHostTransport);
+  vtkMRMLCopyBooleanMacro(PoseDatagramDelivery);
+  vtkMRMLCopyEndMacro();
 }
 
 //----------------------------------------------------------------------------
 void vtkMRMLCollaborationConnectorNode::PrintSelf(ostream & os, vtkIndent indent)
 {
   Superclass::PrintSelf(os, indent);
+
+  vtkMRMLPrintBeginMacro(os, indent);
+  vtkMRMLPrintBooleanMacro(ProgressiveModelDelivery);
+  vtkMRMLPrintFloatMacro(ProxyTargetReduction);
+  vtkMRMLPrintIntMacro(ProxyMinimumNumberOfCells);
+  vtkMRMLPrintBooleanMacro(ContentCacheEnabled);
+  vtkMRMLPrintStdStringMacro(ContentCacheDirectory);
+  vtkMRMLPrintIntMacro(ContentCacheMaximumSize);
+  vtkMRMLPrintFloatMacro(MeasurementUpdateInterval);
+  vtkMRMLPrintBooleanMacro(BinaryAttributeEncoding);
+  vtkMRMLPrintBooleanMacro(VolumeDeltaDelivery);
+  vtkMRMLPrintBooleanMacro(VolumeDeltaCompression);
+  vtkMRMLPrintBooleanMacro(ProgressiveVolumeDelivery);
+  vtkMRMLPrintIntMacro(ProgressiveVolumeMinimumNumberOfVoxels);
+  vtkMRMLPrintFloatMacro(ProgressiveVolumeBandwidth);
+  vtkMRMLPrintBooleanMacro(RelayHub);
+  vtkMRMLPrintBooleanMacro(StateUpdateCoalescing);
+  vtkMRMLPrintBooleanMacro(MessageBundling);
+  vtkMRMLPrintBooleanMacro(MessageCompression);
+  vtkMRMLPrintIntMacro(MessageCompressionThreshold);
+  vtkMRMLPrintBooleanMacro(SameHostTransport);
+  vtkMRMLPrintBooleanMacro(PoseDatagramDelivery);
+  vtkMRMLPrintEndMacro();
+  os << indent << "PeerProtocolVersion: " << this->CollaborationInternal->PeerProtocolVersion << "\n";
+  os << indent << "PeerFeatures:";
+  for (const std::string& feature : this->CollaborationInternal->PeerFeatures)
+  {
+    os << " " << feature;
+  }
+  os << "\n";
+  os << indent << "PeerCompressionCodecs: " << this->GetPeerCompressionCodecs() << "\n";
+  os << indent << "NumberOfCompressedMessages: " << this->CollaborationInternal->NumberOfCompressedMessages << "\n";
+  os << indent << "CompressionRatio: " << this->GetCompressionRatio() << "\n";
+  os << indent << "CompressionTime: " << this->CollaborationInternal->CompressionTime << " s\n";
+  os << indent << "NumberOfDecompressedMessages: " << this->CollaborationInternal->NumberOfDecompressedMessages << "\n";
+  os << indent << "DecompressionTime: " << this->CollaborationInternal->DecompressionTime << " s\n";
+  vtkCollaborationSharedMemoryLink* link = this->CollaborationInternal->SharedMemoryLink.get();
+  if (link)
+  {
+    os << indent << "SharedMemoryName: " << this->getSharedMemoryName() << "\n";
+    os << indent << "SharedMemoryPeerConnected: " << (link->IsPeerConnected() ? "true" : "false") << "\n";
+    os << indent << "SharedMemorySentMessages: " << link->GetNumberOfSentMessages()
+      << " (" << link->GetNumberOfSentBytes() << " bytes)\n";
+    os << indent << "SharedMemoryReceivedMessages: " << link->GetNumberOfReceivedMessages()
+      << " (" << link->GetNumberOfReceivedBytes() << " bytes)\n";
+  }
+  vtkCollaborationPoseChannel* poseChannel = this->CollaborationInternal->PoseChannel.get();
+  if (poseChannel)
+  {
+    os << indent << "PoseDatagramPort: " << poseChannel->GetLocalPort() << "\n";
+    os << indent << "PoseDatagramPeerReachable: " << (poseChannel->IsPeerReachable() ? "true" : "false") << "\n";
+    os << indent << "SentPoseDatagrams: " << poseChannel->GetNumberOfSentPoses() << "\n";
+    os << indent << "ReceivedPoseDatagrams: " << poseChannel->GetNumberOfReceivedPoses()
+      << " (" << poseChannel->GetNumberOfDroppedPoses() << " dropped, " << poseChannel->GetNumberOfRepeatedPoses() << " repeated)\n";
+  }
+}
+
+//----------------------------------------------------------------------------
+unsigned int vtkMRMLCollaborationConnectorNode::AssignOutGoingNodeToDevice(vtkMRMLNode * node, igtlioDevicePointer device)
+{
+  unsigned int result = Superclass::AssignOutGoingNodeToDevice(node, device);
+  this->CollaborationInternal->LastTrafficTime = std::chrono::steady_clock::now();
+
+  igtlioPolyDataDevice* polyDevice = igtlioPolyDataDevice::SafeDownCast(device);
+  if (polyDevice && node && node->GetID())
+  {
+    // replace the mesh by its proxy if the proxy is being pushed
+    auto proxyIt = this->CollaborationInternal->OutgoingProxies.find(node->GetID());
+    if (proxyIt != this->CollaborationInternal->OutgoingProxies.end())
+    {
+      igtlioPolyDataConverter::ContentData content = polyDevice->GetContent();
+      content.polydata = proxyIt->second;
+      polyDevice->SetContent(content);
+      polyDevice->SetMetaDataElement(LevelOfDetailMetaDataKey, IANA_TYPE_US_ASCII, LevelOfDetailProxy);
+    }
+    else
+    {
+      polyDevice->SetMetaDataElement(LevelOfDetailMetaDataKey, IANA_TYPE_US_ASCII, LevelOfDetailFull);
+      if (this->ContentCacheEnabled)
+      {
+        polyDevice->SetMetaDataElement(ContentHashMetaDataKey, IANA_TYPE_US_ASCII, this->getContentHash(node));
+      }
+    }
+  }
+  // the compression is marked out of band, so that any text sent by the peer is received as it is
+  igtlioStringDevice* stringDevice = igtlioStringDevice::SafeDownCast(device);
+  if (stringDevice && node && node->GetID())
+  {
+    bool compressed = this->CollaborationInternal->CompressedTextNodeIDs.count(node->GetID()) > 0;
+    stringDevice->SetMetaDataElement(CompressionMetaDataKey, IANA_TYPE_US_ASCII, compressed ? "true" : "false");
+  }
+  igtlioImageDevice* imageDevice = igtlioImageDevice::SafeDownCast(device);
+  if (imageDevice && node && this->ContentCacheEnabled)
+  {
+    imageDevice->SetMetaDataElement(ContentHashMetaDataKey, IANA_TYPE_US_ASCII, this->getContentHash(node));
+  }
+  // the next modifications of the volume are sent relative to the pushed image, if it was already edited once
+  vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(node);
+  if (imageDevice && volumeNode && volumeNode->GetID() && this->IsVolumeDeltaDeliveryUsed()
+    && this->CollaborationInternal->EditedVolumeIDs.count(volumeNode->GetID()))
+  {
+    if (vtkCollaborationImageDelta::HasVoxels(volumeNode->GetImageData()))
+    {
+      vtkSmartPointer<vtkImageData> sentImage = vtkSmartPointer<vtkImageData>::New();
+      sentImage->DeepCopy(volumeNode->GetImageData());
+      this->CollaborationInternal->SentVolumeImages[volumeNode->GetID()] = sentImage;
+    }
+    else
+    {
+      this->CollaborationInternal->SentVolumeImages.erase(volumeNode->GetID());
+    }
+  }
+  return result;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::ProcessMRMLEvents(vtkObject* caller, unsigned long event, void* callData)
+{
+  vtkMRMLNode* node = vtkMRMLNode::SafeDownCast(caller);
+  // the state received through the shared memory is not sent back to the peer
+  if (this->CollaborationInternal->ApplyingDirectMessages && node && this->isOutgoingNode(node))
+  {
+    return;
+  }
+  // the local VR transforms are sent by the pose nodes of the participant, which are pushed when their matrix is copied
+  if (event == vtkMRMLTransformableNode::TransformModifiedEvent && IsLocalPoseNode(node) && this->isOutgoingNode(node))
+  {
+    this->getParticipantPoseNode(node);
+    return;
+  }
+  vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(caller);
+  if (event == vtkMRMLVolumeNode::ImageDataModifiedEvent && volumeNode && volumeNode->GetID())
+  {
+    // the volumes that are never edited do not keep a copy of their image
+    if (this->IsVolumeDeltaDeliveryUsed() && this->isOutgoingNode(volumeNode))
+    {
+      this->CollaborationInternal->EditedVolumeIDs.insert(volumeNode->GetID());
+    }
+    // a volume being streamed sends its full resolution again at the end of the stream
+    auto streamIt = this->CollaborationInternal->VolumeStreams.find(volumeNode->GetID());
+    if (streamIt != this->CollaborationInternal->VolumeStreams.end())
+    {
+      if (vtkCollaborationImageDelta::HaveSameGeometry(volumeNode->GetImageData(), streamIt->second.Image))
+      {
+        streamIt->second.Image->ShallowCopy(volumeNode->GetImageData());
+        streamIt->second.Outdated = true;
+      }
+      else
+      {
+        this->startVolumeStream(volumeNode);
+      }
+      return;
+    }
+    // the outgoing volumes send the modified region instead of being pushed again
+    if (this->IsVolumeDeltaDeliveryUsed() && this->PushVolumeDelta(volumeNode))
+    {
+      return;
+    }
+    if (this->IsVolumeStreamed(volumeNode) && this->isOutgoingNode(volumeNode) && this->IsSessionConnected())
+    {
+      this->startVolumeStream(volumeNode);
+      return;
+    }
+  }
+  // the state of the modified outgoing nodes is pushed once per tick, the intermediate states are skipped
+  if (this->StateUpdateCoalescing && node && node->GetID()
+    && (event == vtkCommand::ModifiedEvent || event == vtkMRMLTransformableNode::TransformModifiedEvent
+      || event == vtkMRMLModelNode::MeshModifiedEvent || event == vtkMRMLMarkupsNode::PointModifiedEvent)
+    && this->isOutgoingNode(node))
+  {
+    this->CollaborationInternal->PendingPushEvents[node->GetID()].insert(event);
+    this->RequestProcessing();
+    return;
+  }
+  if (node && this->isOutgoingNode(node) && this->sendPoseDatagram(node, event))
+  {
+    return;
+  }
+  if (this->isSameHostSession() && node && this->isOutgoingNode(node))
+  {
+    this->pushNodeEvent(node, event);
+    return;
+  }
+  Superclass::ProcessMRMLEvents(caller, event, callData);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::pushNodeEvent(vtkMRMLNode* node, unsigned long event)
+{
+  if (!this->isSameHostSession())
+  {
+    if (!this->sendPoseDatagram(node, event))
+    {
+      Superclass::ProcessMRMLEvents(node, event, nullptr);
+    }
+    return;
+  }
+  // the events pushing the nodes through OpenIGTLink
+  if ((node->IsA("vtkMRMLLinearTransformNode") && event == vtkMRMLTransformableNode::TransformModifiedEvent)
+    || (node->IsA("vtkMRMLModelNode") && event == vtkMRMLModelNode::MeshModifiedEvent)
+    || (node->IsA("vtkMRMLScalarVolumeNode") && event == vtkMRMLVolumeNode::ImageDataModifiedEvent)
+    || (node->IsA("vtkMRMLTextNode") && event == vtkMRMLTextNode::TextModifiedEvent))
+  {
+    this->sendSharedMemoryNode(node);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::pushModifiedNodes()
+{
+  std::map<std::string, std::set<unsigned long> > pendingPushEvents;
+  pendingPushEvents.swap(this->CollaborationInternal->PendingPushEvents);
+  if (!this->GetScene())
+  {
+    return;
+  }
+  for (const std::pair<const std::string, std::set<unsigned long> >& pendingPush : pendingPushEvents)
+  {
+    // the node may have been removed meanwhile
+    vtkMRMLNode* node = this->GetScene()->GetNodeByID(pendingPush.first);
+    for (unsigned long event : pendingPush.second)
+    {
+      if (node)
+      {
+        this->pushNodeEvent(node, event);
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::isOutgoingNode(vtkMRMLNode* node)
+{
+  int numberOfOutgoingNodes = this->GetNumberOfOutgoingMRMLNodes();
+  for (int nodeIndex = 0; nodeIndex < numberOfOutgoingNodes; nodeIndex++)
+  {
+    if (this->GetOutgoingMRMLNode(nodeIndex) == node)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkMRMLCollaborationConnectorNode::getVolumeDeltaMessage(vtkMRMLScalarVolumeNode* volumeNode, vtkImageData* image,
+  const int extent[6], int step)
+{
+  std::stringstream ss;
+  ss << "<MRMLNode SuperclassName = \"vtkMRMLCollaborationContent\" ClassName = \"VolumeDelta\" NodeName = \"";
+  ss << vtkMRMLNode::XMLAttributeEncodeString(volumeNode->GetName());
+  ss << "\" Extent = \"";
+  for (int i = 0; i < 6; i++)
+  {
+    ss << extent[i] << (i < 5 ? " " : "");
+  }
+  ss << "\" Step = \"" << step;
+  ss << "\" ScalarType = \"" << image->GetScalarType();
+  ss << "\" NumberOfComponents = \"" << image->GetNumberOfScalarComponents();
+  ss << "\" Compressed = \"" << (this->VolumeDeltaCompression ? "true" : "false");
+  ss << "\" Data = \"" << vtkCollaborationAttributeSchema::EncodeRecordAsText(
+    vtkCollaborationImageDelta::EncodeExtent(image, extent, this->VolumeDeltaCompression, step));
+  ss << "\" />";
+  return ss.str();
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::IsVolumeStreamed(vtkMRMLNode* node)
+{
+  vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(node);
+  vtkImageData* image = volumeNode ? volumeNode->GetImageData() : nullptr;
+  return this->IsProgressiveVolumeDeliveryUsed() && vtkCollaborationImageDelta::HasVoxels(image)
+    && image->GetNumberOfPoints() >= this->ProgressiveVolumeMinimumNumberOfVoxels;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::startVolumeStream(vtkMRMLScalarVolumeNode* volumeNode)
+{
+  if (!volumeNode->GetID() || !volumeNode->GetName())
+  {
+    return;
+  }
+  if (!vtkCollaborationImageDelta::HasVoxels(volumeNode->GetImageData()))
+  {
+    this->CollaborationInternal->VolumeStreams.erase(volumeNode->GetID());
+    return;
+  }
+  // the receiver allocates the full resolution image, which is then filled by the bricks
+  vtkImageData* image = volumeNode->GetImageData();
+  int* extent = image->GetExtent();
+  vtkNew<vtkMatrix4x4> ijkToRAS;
+  volumeNode->GetIJKToRASMatrix(ijkToRAS);
+  std::stringstream ss;
+  ss << "<MRMLNode SuperclassName = \"vtkMRMLCollaborationContent\" ClassName = \"VolumeGeometry\" NodeName = \"";
+  ss << vtkMRMLNode::XMLAttributeEncodeString(volumeNode->GetName());
+  ss << "\" Extent = \"";
+  for (int i = 0; i < 6; i++)
+  {
+    ss << extent[i] << (i < 5 ? " " : "");
+  }
+  ss << "\" ScalarType = \"" << image->GetScalarType();
+  ss << "\" NumberOfComponents = \"" << image->GetNumberOfScalarComponents();
+  ss << "\" IJKToRAS = \"";
+  for (int i = 0; i < 4; i++)
+  {
+    for (int j = 0; j < 4; j++)
+    {
+      ss << ijkToRAS->GetElement(i, j) << ((i == 3 && j == 3) ? "" : " ");
+    }
+  }
+  ss << "\" />";
+  this->sendTextMessage(std::string(volumeNode->GetName()) + "VolumeDelta", ss.str());
+
+  VolumeStream& stream = this->CollaborationInternal->VolumeStreams[volumeNode->GetID()];
+  // the stream reads the current arrays of the volume, a new image replaces them
+  stream.Image = vtkSmartPointer<vtkImageData>::New();
+  stream.Image->ShallowCopy(image);
+  stream.Step = VolumeStreamCoarsestStep;
+  stream.Outdated = false;
+  this->addVolumeStreamBricks(stream);
+  this->CollaborationInternal->SentVolumeImages.erase(volumeNode->GetID());
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::addVolumeStreamBricks(VolumeStream& stream)
+{
+  // bricks of about 32 kB of encoded voxels, so that each fits in a string message
+  const int maximumBrickSize = 32768;
+  int* extent = stream.Image->GetExtent();
+  int voxelSize = stream.Image->GetScalarSize() * stream.Image->GetNumberOfScalarComponents();
+  int dimensions[3] = { 0, 0, 0 };
+  vtkCollaborationImageDelta::GetSampleDimensions(extent, stream.Step, dimensions);
+  int brickDimensions[3] = { std::min(dimensions[0], 32), std::min(dimensions[1], 32), 1 };
+  brickDimensions[2] = std::max(1, std::min(dimensions[2], maximumBrickSize / (voxelSize * brickDimensions[0] * brickDimensions[1])));
+  stream.Bricks.clear();
+  for (int k = 0; k < dimensions[2]; k += brickDimensions[2])
+  {
+    for (int j = 0; j < dimensions[1]; j += brickDimensions[1])
+    {
+      for (int i = 0; i < dimensions[0]; i += brickDimensions[0])
+      {
+        std::array<int, 6> brick = {
+          extent[0] + i * stream.Step, std::min(extent[0] + (i + brickDimensions[0]) * stream.Step - 1, extent[1]),
+          extent[2] + j * stream.Step, std::min(extent[2] + (j + brickDimensions[1]) * stream.Step - 1, extent[3]),
+          extent[4] + k * stream.Step, std::min(extent[4] + (k + brickDimensions[2]) * stream.Step - 1, extent[5]) };
+        stream.Bricks.push_back(brick);
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::sendVolumeBricks()
+{
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  double elapsedTime = std::chrono::duration<double>(now - this->CollaborationInternal->LastVolumeBrickTime).count();
+  this->CollaborationInternal->LastVolumeBrickTime = now;
+  if (this->CollaborationInternal->VolumeStreams.empty() || !this->GetScene())
+  {
+    return;
+  }
+  if (!this->IsSessionConnected())
+  {
+    // streamed again when the connection is established
+    this->CollaborationInternal->VolumeStreams.clear();
+    return;
+  }
+  // the bricks are paced to the bandwidth, so that the other messages are not delayed behind them
+  double budget = std::min(elapsedTime, 0.1) * this->ProgressiveVolumeBandwidth * 1.0e6 / 8.0;
+
+  // the bricks closest to the slices displayed by the sender are sent first
+  std::vector<vtkMRMLNode*> sliceNodes;
+  this->GetScene()->GetNodesByClass("vtkMRMLSliceNode", sliceNodes);
+  auto streamIt = this->CollaborationInternal->VolumeStreams.begin();
+  while (streamIt != this->CollaborationInternal->VolumeStreams.end() && budget > 0.0)
+  {
+    vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(this->GetScene()->GetNodeByID(streamIt->first));
+    if (!volumeNode || !volumeNode->GetName())
+    {
+      streamIt = this->CollaborationInternal->VolumeStreams.erase(streamIt);
+      continue;
+    }
+    VolumeStream& stream = streamIt->second;
+    vtkNew<vtkMatrix4x4> ijkToRAS;
+    volumeNode->GetIJKToRASMatrix(ijkToRAS);
+    std::vector<std::pair<double, size_t> > brickOrder;
+    for (size_t brickIndex = 0; brickIndex < stream.Bricks.size(); brickIndex++)
+    {
+      const std::array<int, 6>& brick = stream.Bricks[brickIndex];
+      double center[4] = { 0.5 * (brick[0] + brick[1]), 0.5 * (brick[2] + brick[3]), 0.5 * (brick[4] + brick[5]), 1.0 };
+      ijkToRAS->MultiplyPoint(center, center);
+      double distance = 0.0;
+      for (size_t sliceIndex = 0; sliceIndex < sliceNodes.size(); sliceIndex++)
+      {
+        vtkMatrix4x4* sliceToRAS = vtkMRMLSliceNode::SafeDownCast(sliceNodes[sliceIndex])->GetSliceToRAS();
+        double normal[3] = { sliceToRAS->GetElement(0, 2), sliceToRAS->GetElement(1, 2), sliceToRAS->GetElement(2, 2) };
+        double sliceDistance = std::abs(normal[0] * (center[0] - sliceToRAS->GetElement(0, 3))
+          + normal[1] * (center[1] - sliceToRAS->GetElement(1, 3))
+          + normal[2] * (center[2] - sliceToRAS->GetElement(2, 3))) / std::max(vtkMath::Norm(normal), 1.0e-6);
+        distance = (sliceIndex == 0) ? sliceDistance : std::min(distance, sliceDistance);
+      }
+      brickOrder.push_back(std::make_pair(distance, brickIndex));
+    }
+    std::sort(brickOrder.begin(), brickOrder.end());
+
+    std::set<size_t> sentBricks;
+    for (const std::pair<double, size_t>& brickItem : brickOrder)
+    {
+      if (budget <= 0.0)
+      {
+        break;
+      }
+      const std::array<int, 6>& brick = stream.Bricks[brickItem.second];
+      std::string message = this->getVolumeDeltaMessage(volumeNode, stream.Image, brick.data(), stream.Step);
+      this->sendTextMessage(std::string(volumeNode->GetName()) + "VolumeDelta", message);
+      budget -= message.size();
+      sentBricks.insert(brickItem.second);
+    }
+    std::vector<std::array<int, 6> > remainingBricks;
+    for (size_t brickIndex = 0; brickIndex < stream.Bricks.size(); brickIndex++)
+    {
+      if (sentBricks.find(brickIndex) == sentBricks.end())
+      {
+        remainingBricks.push_back(stream.Bricks[brickIndex]);
+      }
+    }
+    stream.Bricks.swap(remainingBricks);
+    if (!stream.Bricks.empty())
+    {
+      ++streamIt;
+      continue;
+    }
+
+    // refine level by level, and send the full resolution again if the volume was modified during the stream
+    if (stream.Step > 1 || stream.Outdated)
+    {
+      stream.Step = std::max(stream.Step / 2, 1);
+      stream.Outdated = false;
+      this->addVolumeStreamBricks(stream);
+      ++streamIt;
+      continue;
+    }
+    // the next modifications are sent as deltas of the streamed image, if it was already edited once
+    if (this->IsVolumeDeltaDeliveryUsed() && this->CollaborationInternal->EditedVolumeIDs.count(streamIt->first))
+    {
+      vtkSmartPointer<vtkImageData> sentImage = vtkSmartPointer<vtkImageData>::New();
+      sentImage->DeepCopy(stream.Image);
+      this->CollaborationInternal->SentVolumeImages[streamIt->first] = sentImage;
+    }
+    streamIt = this->CollaborationInternal->VolumeStreams.erase(streamIt);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::handleVolumeGeometry(vtkXMLDataElement* res)
+{
+  const char* nodeName = res->GetAttribute("NodeName");
+  int extent[6] = { 0, -1, 0, -1, 0, -1 };
+  double ijkToRASElements[16] = { 0.0 };
+  int scalarType = 0;
+  int numberOfComponents = 0;
+  if (!nodeName || res->GetVectorAttribute("Extent", 6, extent) != 6 || res->GetVectorAttribute("IJKToRAS", 16, ijkToRASElements) != 16
+    || !res->GetScalarAttribute("ScalarType", scalarType) || !res->GetScalarAttribute("NumberOfComponents", numberOfComponents))
+  {
+    vtkErrorMacro("handleVolumeGeometry: Invalid volume geometry message");
+    return;
+  }
+  vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(
+    this->GetScene()->GetFirstNode(nodeName, "vtkMRMLScalarVolumeNode"));
+  vtkSmartPointer<vtkMRMLScalarVolumeNode> newNode;
+  if (!volumeNode)
+  {
+    newNode = vtkSmartPointer<vtkMRMLScalarVolumeNode>::Take(
+      vtkMRMLScalarVolumeNode::SafeDownCast(this->GetScene()->CreateNodeByClass("vtkMRMLScalarVolumeNode")));
+    newNode->SetName(nodeName);
+    // mark it as received so that it is added to the synchronized nodes
+    newNode->SetDescription("Received by OpenIGTLink");
+    volumeNode = newNode;
+  }
+  // the image is reused if it already has the geometry, for example when the stream is sent again
+  vtkImageData* image = volumeNode->GetImageData();
+  int* imageExtent = image ? image->GetExtent() : nullptr;
+  if (!image || !std::equal(extent, extent + 6, imageExtent) || image->GetScalarType() != scalarType
+    || image->GetNumberOfScalarComponents() != numberOfComponents || !vtkCollaborationImageDelta::HasVoxels(image))
+  {
+    vtkNew<vtkImageData> newImage;
+    newImage->SetExtent(extent);
+    newImage->AllocateScalars(scalarType, numberOfComponents);
+    if (vtkCollaborationImageDelta::HasVoxels(newImage))
+    {
+      memset(newImage->GetScalarPointer(), 0, vtkCollaborationImageDelta::GetExtentSize(newImage, extent));
+    }
+    volumeNode->SetAndObserveImageData(newImage);
+  }
+  vtkNew<vtkMatrix4x4> ijkToRAS;
+  ijkToRAS->DeepCopy(ijkToRASElements);
+  volumeNode->SetIJKToRASMatrix(ijkToRAS);
+  if (newNode)
+  {
+    this->GetScene()->AddNode(newNode);
+    newNode->CreateDefaultDisplayNodes();
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::PushVolumeDelta(vtkMRMLScalarVolumeNode* volumeNode)
+{
+  if (!volumeNode || !volumeNode->GetID() || !volumeNode->GetName() || !this->IsSessionConnected())
+  {
+    return false;
+  }
+  // only the volumes whose full image was pushed have a reference
+  auto sentImageIt = this->CollaborationInternal->SentVolumeImages.find(volumeNode->GetID());
+  if (sentImageIt == this->CollaborationInternal->SentVolumeImages.end())
+  {
+    return false;
+  }
+  vtkImageData* image = volumeNode->GetImageData();
+  vtkImageData* sentImage = sentImageIt->second;
+  if (!vtkCollaborationImageDelta::HasVoxels(image) || !vtkCollaborationImageDelta::HaveSameGeometry(image, sentImage))
+  {
+    return false;
+  }
+  int modifiedExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  if (!vtkCollaborationImageDelta::GetModifiedExtent(image, sentImage, modifiedExtent))
+  {
+    // for example a modified event without change of the voxels
+    return true;
+  }
+  // pushing the whole image is simpler when most of it changed
+  if (vtkCollaborationImageDelta::GetExtentSize(image, modifiedExtent) * 2 > vtkCollaborationImageDelta::GetExtentSize(image, image->GetExtent()))
+  {
+    return false;
+  }
+
+  // the region is split in blocks of rows of a single slice, each sent in a string message
+  const size_t maximumBlockSize = 32768;
+  const size_t maximumMessageSize = 65000;
+  size_t rowSize = vtkCollaborationImageDelta::GetExtentSize(image, modifiedExtent)
+    / ((modifiedExtent[3] - modifiedExtent[2] + 1) * (modifiedExtent[5] - modifiedExtent[4] + 1));
+  int rowsPerBlock = std::max(1, static_cast<int>(maximumBlockSize / rowSize));
+  std::vector<std::string> messages;
+  for (int z = modifiedExtent[4]; z <= modifiedExtent[5]; z++)
+  {
+    for (int y = modifiedExtent[2]; y <= modifiedExtent[3]; y += rowsPerBlock)
+    {
+      int blockExtent[6] = { modifiedExtent[0], modifiedExtent[1], y, std::min(y + rowsPerBlock - 1, modifiedExtent[3]), z, z };
+      std::string message = this->getVolumeDeltaMessage(volumeNode, image, blockExtent, 1);
+      if (message.size() > maximumMessageSize)
+      {
+        // rows too large for the string messages
+        return false;
+      }
+      messages.push_back(message);
+    }
+  }
+  for (const std::string& message : messages)
+  {
+    this->sendTextMessage(std::string(volumeNode->GetName()) + "VolumeDelta", message);
+  }
+  vtkCollaborationImageDelta::CopyExtent(image, sentImage, modifiedExtent);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+namespace
+{
+/// Build a decimated proxy of a mesh. Runs on a worker thread, the input must not be modified during the call.
+vtkSmartPointer<vtkPolyData> BuildModelProxy(vtkPolyData* input, double targetReduction)
+{
+  // quadric decimation only accepts triangles
+  vtkNew<vtkTriangleFilter> triangleFilter;
+  triangleFilter->SetInputData(input);
+  triangleFilter->PassVertsOff();
+  triangleFilter->PassLinesOff();
+
+  vtkNew<vtkQuadricDecimation> decimation;
+  decimation->SetInputConnection(triangleFilter->GetOutputPort());
+  decimation->SetTargetReduction(targetReduction);
+  decimation->VolumePreservationOn();
+  decimation->Update();
+
+  vtkSmartPointer<vtkPolyData> proxy = decimation->GetOutput();
+  return proxy;
+}
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLCollaborationConnectorNode::PushNodeProgressive(vtkMRMLNode* node)
+{
+  // large volumes are streamed from a coarse level to the full resolution
+  vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(node);
+  if (volumeNode && this->IsVolumeStreamed(volumeNode) && this->IsSessionConnected())
+  {
+    this->startVolumeStream(volumeNode);
+    return 1;
+  }
+
+  // the full mesh crosses the shared memory faster than its proxy is built
+  vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(node);
+  if (!this->ProgressiveModelDelivery || this->isSameHostSession() || !modelNode || !modelNode->GetID()
+    || !modelNode->GetPolyData() || modelNode->GetPolyData()->GetNumberOfCells() < this->ProxyMinimumNumberOfCells)
+  {
+    return this->SendNode(node);
+  }
+
+  // if a proxy is already being built, the full mesh pushed after it will contain the latest changes
+  std::string nodeID = modelNode->GetID();
+  if (this->CollaborationInternal->PendingProxies.count(nodeID))
+  {
+    return 1;
+  }
+
+  // the worker gets its own deep copy, as the arrays of the model may be modified in place meanwhile
+  vtkSmartPointer<vtkPolyData> input = vtkSmartPointer<vtkPolyData>::New();
+  input->DeepCopy(modelNode->GetPolyData());
+  double targetReduction = this->ProxyTargetReduction;
+  this->CollaborationInternal->PendingProxies[nodeID] = std::async(std::launch::async,
+    [this, input, targetReduction]()
+    {
+      vtkSmartPointer<vtkPolyData> proxy = BuildModelProxy(input, targetReduction);
+      // push the proxy without waiting for the next periodic call
+      this->RequestProcessing();
+      return proxy;
+    });
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::ProcessPendingTasks()
+{
+  // the requests made from now on need another call
+  this->CollaborationInternal->ProcessingRequested = false;
+
+  // import the data received since the previous call, instead of waiting for the OpenIGTLinkIF timer
+  this->PeriodicProcess();
+  this->processSharedMemoryLink();
+  this->processPoseDatagrams();
+
+  // forget the cache writes that are done
+  std::vector<std::future<bool> >& cacheWrites = this->CollaborationInternal->PendingCacheWrites;
+  cacheWrites.erase(std::remove_if(cacheWrites.begin(), cacheWrites.end(),
+    [](std::future<bool>& cacheWrite) { return cacheWrite.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }),
+    cacheWrites.end());
+
+  // latest state of the nodes modified since the previous call
+  this->pushModifiedNodes();
+
+  // push the proxies that are ready, each followed by the full resolution mesh
+  auto pendingIt = this->CollaborationInternal->PendingProxies.begin();
+  while (pendingIt != this->CollaborationInternal->PendingProxies.end())
+  {
+    if (pendingIt->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+      ++pendingIt;
+      continue;
+    }
+    std::string nodeID = pendingIt->first;
+    vtkSmartPointer<vtkPolyData> proxy = pendingIt->second.get();
+    pendingIt = this->CollaborationInternal->PendingProxies.erase(pendingIt);
+
+    vtkMRMLNode* node = this->GetScene() ? this->GetScene()->GetNodeByID(nodeID) : nullptr;
+    if (!node)
+    {
+      // node has been removed while its proxy was built
+      continue;
+    }
+    if (proxy && proxy->GetNumberOfCells() > 0)
+    {
+      this->CollaborationInternal->OutgoingProxies[nodeID] = proxy;
+      this->SendNode(node);
+      this->CollaborationInternal->OutgoingProxies.erase(nodeID);
+    }
+    this->SendNode(node);
+  }
+
+  // measurements of the markups updated by the peer are computed at most once per interval
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (!this->CollaborationInternal->StaleMeasurements.empty()
+    && std::chrono::duration<double>(now - this->CollaborationInternal->LastMeasurementUpdateTime).count() >= this->MeasurementUpdateInterval)
+  {
+    this->UpdateReceivedMeasurements();
+  }
+
+  // the next bricks of the volume streams, within the bandwidth given to them
+  this->sendVolumeBricks();
+
+  // results of the codecs computed in the background, such as the surfaces of received segmentations
+  vtkCollaborationNodeCodec::ProcessPendingCodecTasks();
+
+  // channel messages go last, after the node updates of this tick
+  this->flushChannel();
+
+  // one message for all the text messages of this tick
+  this->flushBundle();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::SetWakeUpCallback(WakeUpCallbackType callback, void* clientData)
+{
+  std::lock_guard<std::mutex> lock(this->CollaborationInternal->WakeUpMutex);
+  this->CollaborationInternal->WakeUpCallback = callback;
+  this->CollaborationInternal->WakeUpClientData = clientData;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::RequestProcessing()
+{
+  if (this->CollaborationInternal->ProcessingRequested.exchange(true))
+  {
+    // already requested, the pending call will process this request too
+    return;
+  }
+  std::lock_guard<std::mutex> lock(this->CollaborationInternal->WakeUpMutex);
+  if (this->CollaborationInternal->WakeUpCallback)
+  {
+    this->CollaborationInternal->WakeUpCallback(this->CollaborationInternal->WakeUpClientData);
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::IsProcessingNeeded()
+{
+  return this->GetState() == StateConnected || this->hasPendingTasks();
+}
+
+//----------------------------------------------------------------------------
+double vtkMRMLCollaborationConnectorNode::GetProcessingInterval()
+{
+  if (this->hasPendingTasks())
+  {
+    return MINIMUM_PROCESSING_INTERVAL;
+  }
+  // the idle connection is polled less and less often, the first message after a pause waits at most the maximum
+  double idleTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->CollaborationInternal->LastTrafficTime).count();
+  return std::min(std::max(idleTime * MAXIMUM_PROCESSING_INTERVAL, MINIMUM_PROCESSING_INTERVAL), MAXIMUM_PROCESSING_INTERVAL);
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::hasPendingTasks()
+{
+  return this->CollaborationInternal->ProcessingRequested
+    || !this->CollaborationInternal->PendingProxies.empty()
+    || !this->CollaborationInternal->PendingCacheWrites.empty()
+    || !this->CollaborationInternal->PendingPushEvents.empty()
+    || !this->CollaborationInternal->VolumeStreams.empty()
+    || !this->CollaborationInternal->StaleMeasurements.empty()
+    || this->CollaborationInternal->ChannelModified
+    || this->CollaborationInternal->ChannelResendRequested
+    || vtkCollaborationNodeCodec::HasPendingCodecTasks();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::UpdateReceivedMeasurements()
+{
+  std::map<std::string, std::vector<std::string> > staleMeasurements;
+  staleMeasurements.swap(this->CollaborationInternal->StaleMeasurements);
+  this->CollaborationInternal->LastMeasurementUpdateTime = std::chrono::steady_clock::now();
+  if (!this->GetScene())
+  {
+    return;
+  }
+  for (const std::pair<const std::string, std::vector<std::string> >& stale : staleMeasurements)
+  {
+    vtkMRMLMarkupsNode* markupsNode = vtkMRMLMarkupsNode::SafeDownCast(this->GetScene()->GetNodeByID(stale.first));
+    if (!markupsNode)
+    {
+      continue;
+    }
+    MRMLNodeModifyBlocker blocker(markupsNode);
+    for (const std::string& measurementName : stale.second)
+    {
+      vtkMRMLMeasurement* measurement = markupsNode->GetMeasurement(measurementName.c_str());
+      if (measurement)
+      {
+        measurement->SetEnabled(true);
+      }
+    }
+    markupsNode->UpdateAllMeasurements();
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::deferMeasurements(vtkMRMLNode* node)
+{
+  vtkMRMLMarkupsNode* markupsNode = vtkMRMLMarkupsNode::SafeDownCast(node);
+  if (!markupsNode || !markupsNode->GetID())
+  {
+    return;
+  }
+  // the markups node computes its enabled measurements on each change of its control points
+  std::vector<std::string>& disabledNames = this->CollaborationInternal->StaleMeasurements[markupsNode->GetID()];
+  for (int measurementIndex = 0; measurementIndex < markupsNode->GetNumberOfMeasurements(); measurementIndex++)
+  {
+    vtkMRMLMeasurement* measurement = markupsNode->GetNthMeasurement(measurementIndex);
+    if (measurement && measurement->GetEnabled() && measurement->GetName())
+    {
+      measurement->SetEnabled(false);
+      disabledNames.push_back(measurement->GetName());
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::IsReceivedMeasurementStale(vtkMRMLNode* node)
+{
+  return node && node->GetID()
+    && this->CollaborationInternal->StaleMeasurements.find(node->GetID()) != this->CollaborationInternal->StaleMeasurements.end();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::SendChannelMessage(const char* channelName, const char* message, const char* stateKey)
+{
+  if (!channelName || !message)
+  {
+    vtkErrorMacro("SendChannelMessage: Invalid channel name or message");
+    return;
+  }
+  std::deque<vtkCollaborationInternal::ChannelMessage>& outgoing = this->CollaborationInternal->OutgoingChannelMessages;
+  size_t& outgoingSize = this->CollaborationInternal->OutgoingChannelSize;
+  if (stateKey && *stateKey)
+  {
+    // the previous state is not delivered if the peer has not acknowledged it yet, so the backlog does not grow
+    // with the updates of a node on a slow link
+    outgoing.erase(std::remove_if(outgoing.begin(), outgoing.end(),
+      [channelName, stateKey, &outgoingSize](const vtkCollaborationInternal::ChannelMessage& pendingMessage)
+      {
+        if (pendingMessage.StateKey != stateKey || pendingMessage.Channel != channelName)
+        {
+          return false;
+        }
+        outgoingSize -= pendingMessage.Text.size();
+        return true;
+      }),
+      outgoing.end());
+  }
+  vtkCollaborationInternal::ChannelMessage channelMessage;
+  channelMessage.Sequence = this->CollaborationInternal->NextChannelSequence++;
+  channelMessage.Channel = channelName;
+  channelMessage.Text = message;
+  channelMessage.StateKey = stateKey ? stateKey : "";
+  outgoing.push_back(channelMessage);
+  outgoingSize += channelMessage.Text.size();
+  if (outgoingSize > MAXIMUM_CHANNEL_BACKLOG_SIZE)
+  {
+    vtkWarningMacro("SendChannelMessage: The peer does not acknowledge the channel messages, the oldest ones are dropped");
+    while (outgoing.size() > 1 && outgoingSize > MAXIMUM_CHANNEL_BACKLOG_SIZE)
+    {
+      outgoingSize -= outgoing.front().Text.size();
+      outgoing.pop_front();
+    }
+  }
+  this->CollaborationInternal->ChannelModified = true;
+  this->RequestProcessing();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::NotifyNodeRemoved(vtkMRMLNode* node)
+{
+  // the pose node of the participant stops mirroring the local transform
+  if (IsLocalPoseNode(node) && node->GetName() && this->GetScene())
+  {
+    std::string poseNodeName = std::string(ParticipantPoseNamePrefix) + this->CollaborationInternal->ParticipantID
+      + "." + (node->GetName() + strlen(LocalPoseNamePrefix));
+    vtkMRMLNode* poseNode = this->GetScene()->GetFirstNode(poseNodeName.c_str(), "vtkMRMLLinearTransformNode");
+    if (poseNode && poseNode->GetAttribute(ParticipantPoseAttributeName))
+    {
+      this->UnregisterOutgoingMRMLNode(poseNode);
+      this->NotifyNodeRemoved(poseNode);
+      this->GetScene()->RemoveNode(poseNode);
+    }
+    return;
+  }
+  // the copies of the pushed image are only needed while the volume is synchronized
+  if (node && node->GetID())
+  {
+    this->CollaborationInternal->SentVolumeImages.erase(node->GetID());
+    this->CollaborationInternal->EditedVolumeIDs.erase(node->GetID());
+  }
+  if (!node || !node->GetID() || !node->GetName() || !this->RelayHub || !this->IsSessionConnected())
+  {
+    return;
+  }
+  std::stringstream ss;
+  ss << "<" << vtkCollaborationRelayHub::HubDeviceName << " Event=\"NodeRemoved\" NodeName=\""
+    << vtkMRMLNode::XMLAttributeEncodeString(node->GetName()) << "\" NodeID=\""
+    << vtkMRMLNode::XMLAttributeEncodeString(node->GetID()) << "\" />";
+  this->sendTextMessage(vtkCollaborationRelayHub::HubDeviceName, ss.str());
+}
+
+//----------------------------------------------------------------------------
+std::string vtkMRMLCollaborationConnectorNode::getChannelDeviceName(bool outgoing)
+{
+  // the participants of a relay hub each send on their own device, and are acknowledged by the hub
+  if (this->RelayHub)
+  {
+    return std::string(ChannelDeviceNamePrefix)
+      + (outgoing ? "Participant" + this->CollaborationInternal->ParticipantID : vtkCollaborationRelayHub::HubChannelSuffix);
+  }
+  // the peers send on different devices, so that the outgoing carrier is not overwritten by the incoming messages
+  bool server = (this->GetType() == vtkMRMLIGTLConnectorNode::TypeServer);
+  return std::string(ChannelDeviceNamePrefix) + ((server == outgoing) ? "Server" : "Client");
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::isIncomingChannelDevice(const std::string& deviceName)
+{
+  if (!this->RelayHub)
+  {
+    return deviceName == this->getChannelDeviceName(false);
+  }
+  return deviceName.compare(0, strlen(ChannelDeviceNamePrefix), ChannelDeviceNamePrefix) == 0
+    && deviceName != this->getChannelDeviceName(true);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::flushChannel()
+{
+  vtkCollaborationInternal* internal = this->CollaborationInternal;
+  if (!this->IsSessionConnected())
+  {
+    return;
+  }
+  std::deque<vtkCollaborationInternal::ChannelMessage>& outgoing = internal->OutgoingChannelMessages;
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  bool unacknowledged = !outgoing.empty() && outgoing.front().Sequence <= internal->LastSentChannelSequence;
+  if (unacknowledged
+    && std::chrono::duration<double>(now - internal->LastChannelProgressTime).count() >= CHANNEL_ACKNOWLEDGMENT_TIMEOUT)
+  {
+    // the bundle or its acknowledgment was lost
+    internal->ChannelResendRequested = true;
+  }
+  if (internal->ChannelResendRequested)
+  {
+    internal->LastSentChannelSequence = internal->LastAcknowledgedChannelSequence;
+    internal->LastChannelProgressTime = now;
+    internal->ChannelResendRequested = false;
+    internal->ChannelModified = true;
+  }
+  else if (!unacknowledged)
+  {
+    // the acknowledgment timeout starts with the first message sent
+    internal->LastChannelProgressTime = now;
+  }
+  if (!internal->ChannelModified)
+  {
+    return;
+  }
+
+  // a bundle contains the messages sent after the previous bundle, and acknowledges the messages received from
+  // the peer. The sequence number of the last message sent before tells the peer whether a bundle was lost.
+  vtkNew<vtkXMLDataElement> bundle;
+  bundle->SetName(ChannelDeviceNamePrefix);
+  // the participants of a relay hub do not acknowledge each other
+  unsigned long ack = this->RelayHub ? 0 : internal->LastReceivedChannelSequences[this->getChannelDeviceName(false)];
+  bundle->SetAttribute("Epoch", internal->ParticipantID.c_str());
+  bundle->SetAttribute("Ack", std::to_string(ack).c_str());
+  bundle->SetAttribute("After", std::to_string(internal->LastSentChannelSequence).c_str());
+  if (!this->RelayHub)
+  {
+    bundle->SetAttribute("AckEpoch", internal->ReceivedChannelEpochs[this->getChannelDeviceName(false)].c_str());
+  }
+  if (internal->ChannelGapDetected)
+  {
+    bundle->SetAttribute("Resend", "1");
+    internal->ChannelGapDetected = false;
+  }
+  size_t bundleSize = 0;
+  bool complete = true;
+  for (const vtkCollaborationInternal::ChannelMessage& channelMessage : outgoing)
+  {
+    if (channelMessage.Sequence <= internal->LastSentChannelSequence)
+    {
+      continue;
+    }
+    // the remaining messages are sent in the next bundles
+    if (bundleSize > 0 && bundleSize + channelMessage.Text.size() > MAXIMUM_BUNDLE_SIZE)
+    {
+      complete = false;
+      break;
+    }
+    vtkNew<vtkXMLDataElement> messageElement;
+    messageElement->SetName("Message");
+    messageElement->SetAttribute("Sequence", std::to_string(channelMessage.Sequence).c_str());
+    messageElement->SetAttribute("Channel", channelMessage.Channel.c_str());
+    messageElement->SetAttribute("Text", channelMessage.Text.c_str());
+    // the relay hub retains the latest message of each state key for the participants joining later
+    if (!channelMessage.StateKey.empty())
+    {
+      messageElement->SetAttribute("StateKey", channelMessage.StateKey.c_str());
+    }
+    bundle->AddNestedElement(messageElement);
+    bundleSize += channelMessage.Text.size();
+    internal->LastSentChannelSequence = channelMessage.Sequence;
+  }
+  std::stringstream ss;
+  vtkXMLUtilities::FlattenElement(bundle, ss);
+  this->sendTextMessage(this->getChannelDeviceName(true), ss.str());
+  internal->ChannelModified = !complete;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::handleChannelBundle(const std::string& text, const std::string& deviceName)
+{
+  vtkSmartPointer<vtkXMLDataElement> bundle = vtkSmartPointer<vtkXMLDataElement>::Take(
+    vtkXMLUtilities::ReadElementFromString(text.c_str()));
+  unsigned long ack = 0;
+  if (!bundle || !ParseSequenceNumber(bundle->GetAttribute("Ack"), ack))
+  {
+    vtkErrorMacro("handleChannelBundle: Invalid channel message");
+    return;
+  }
+
+  // the sequence numbers restart when the sender restarts
+  const char* epoch = bundle->GetAttribute("Epoch") ? bundle->GetAttribute("Epoch") : "";
+  std::string& receivedEpoch = this->CollaborationInternal->ReceivedChannelEpochs[deviceName];
+  if (receivedEpoch != epoch)
+  {
+    receivedEpoch = epoch;
+    this->CollaborationInternal->LastReceivedChannelSequences[deviceName] = 0;
+    if (!this->RelayHub)
+    {
+      // the restarted peer has received none of the messages
+      this->CollaborationInternal->LastAcknowledgedChannelSequence = 0;
+      this->CollaborationInternal->ChannelResendRequested = true;
+    }
+  }
+
+  // forget the messages acknowledged by the peer, or by the relay hub, in the current epoch of this node
+  const char* ackEpoch = bundle->GetAttribute("AckEpoch");
+  if ((!this->RelayHub || deviceName == this->getChannelDeviceName(false))
+    && ackEpoch && this->CollaborationInternal->ParticipantID == ackEpoch)
+  {
+    std::deque<vtkCollaborationInternal::ChannelMessage>& outgoing = this->CollaborationInternal->OutgoingChannelMessages;
+    if (ack > this->CollaborationInternal->LastAcknowledgedChannelSequence)
+    {
+      this->CollaborationInternal->LastAcknowledgedChannelSequence = ack;
+      this->CollaborationInternal->LastChannelProgressTime = std::chrono::steady_clock::now();
+    }
+    while (!outgoing.empty() && outgoing.front().Sequence <= ack)
+    {
+      this->CollaborationInternal->OutgoingChannelSize -= outgoing.front().Text.size();
+      outgoing.pop_front();
+    }
+    // the peer lost one of the bundles
+    const char* resend = bundle->GetAttribute("Resend");
+    if (resend && strcmp(resend, "1") == 0)
+    {
+      this->CollaborationInternal->ChannelResendRequested = true;
+    }
+  }
+
+  // the messages of a bundle sent after a lost one are not delivered, the peer sends them again from the last
+  // acknowledged message. The participants of a relay hub cannot ask each other, the hub acknowledges their messages.
+  unsigned long after = 0;
+  if (!this->RelayHub && ParseSequenceNumber(bundle->GetAttribute("After"), after)
+    && after > this->CollaborationInternal->LastReceivedChannelSequences[deviceName])
+  {
+    this->CollaborationInternal->ChannelGapDetected = true;
+    this->CollaborationInternal->ChannelModified = true;
+    return;
+  }
+
+  // deliver the messages not received yet from this device, in order
+  unsigned long& lastReceivedSequence = this->CollaborationInternal->LastReceivedChannelSequences[deviceName];
+  bool received = false;
+  for (int messageIndex = 0; messageIndex < bundle->GetNumberOfNestedElements(); messageIndex++)
+  {
+    vtkXMLDataElement* messageElement = bundle->GetNestedElement(messageIndex);
+    const char* sequence = messageElement->GetAttribute("Sequence");
+    const char* channel = messageElement->GetAttribute("Channel");
+    const char* message = messageElement->GetAttribute("Text");
+    unsigned long sequenceNumber = 0;
+    if (!ParseSequenceNumber(sequence, sequenceNumber) || !channel || !message)
+    {
+      vtkErrorMacro("handleChannelBundle: Invalid channel message");
+      continue;
+    }
+    if (sequenceNumber <= lastReceivedSequence)
+    {
+      // already delivered from a previous bundle
+      continue;
+    }
+    lastReceivedSequence = sequenceNumber;
+    received = true;
+    if (strcmp(channel, SynchronizationChannelName) == 0)
+    {
+      if (!this->handleSynchronizationText(message))
+      {
+        vtkErrorMacro("handleChannelBundle: Invalid synchronization message");
+      }
+      continue;
+    }
+    vtkNew<vtkStringArray> channelMessage;
+    channelMessage->InsertNextValue(channel);
+    channelMessage->InsertNextValue(message);
+    this->InvokeEvent(ChannelMessageReceivedEvent, channelMessage.GetPointer());
+  }
+  if (received && !this->RelayHub)
+  {
+    // acknowledge the received messages
+    this->CollaborationInternal->ChannelModified = true;
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::handleHubMessage(const std::string& text)
+{
+  vtkSmartPointer<vtkXMLDataElement> notification = vtkSmartPointer<vtkXMLDataElement>::Take(
+    vtkXMLUtilities::ReadElementFromString(text.c_str()));
+  const char* event = notification ? notification->GetAttribute("Event") : nullptr;
+  if (!event)
+  {
+    vtkErrorMacro("handleHubMessage: Invalid relay hub message");
+    return;
+  }
+  if (strcmp(event, "ParticipantJoined") == 0)
+  {
+    // the new participant has none of the synchronized nodes, send them as on connection unless the hub keeps them
+    const char* stateServed = notification->GetAttribute("StateServed");
+    if (!stateServed || strcmp(stateServed, "true") != 0)
+    {
+      this->PushOnConnect();
+      this->offerNodesOnConnect();
+    }
+    this->InvokeEvent(ParticipantJoinedEvent);
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLCollaborationConnectorNode::StartSession()
+{
+  if (this->SameHostTransport)
+  {
+    if (this->RelayHub)
+    {
+      vtkErrorMacro("StartSession: The same host transport cannot be used with a relay hub");
+      return 0;
+    }
+    std::unique_ptr<vtkCollaborationSharedMemoryLink> link(new vtkCollaborationSharedMemoryLink);
+    // the received messages and the connection changes are processed on the main thread
+    link->SetNotificationCallback([this]() { this->RequestProcessing(); });
+    if (!link->Open(this->getSharedMemoryName()))
+    {
+      vtkErrorMacro("StartSession: Failed to open the shared memory " << this->getSharedMemoryName());
+      return 0;
+    }
+    this->CollaborationInternal->SharedMemoryLink = std::move(link);
+    return 1;
+  }
+  if (this->PoseDatagramDelivery && !this->RelayHub)
+  {
+    std::unique_ptr<vtkCollaborationPoseChannel> poseChannel(new vtkCollaborationPoseChannel);
+    poseChannel->SetNotificationCallback([this]() { this->RequestProcessing(); });
+    // the client sends from any port, the server learns it from the received datagrams
+    int port = (this->GetType() == vtkMRMLIGTLConnectorNode::TypeServer) ? this->GetServerPort() : 0;
+    if (poseChannel->Open(port))
+    {
+      this->CollaborationInternal->PoseChannel = std::move(poseChannel);
+    }
+    else
+    {
+      vtkWarningMacro("StartSession: Failed to open the pose datagram channel on port " << port
+        << ", the poses are pushed through OpenIGTLink");
+    }
+  }
+  if (this->RelayHub && this->GetType() == vtkMRMLIGTLConnectorNode::TypeServer)
+  {
+    int port = this->GetServerPort();
+    if (!this->CollaborationInternal->RelayHub->Start(port))
+    {
+      vtkErrorMacro("StartSession: Failed to start the relay hub on port " << port);
+      return 0;
+    }
+    // the hub takes the port of the server, the node joins it as one of the participants
+    this->CollaborationInternal->RelayHubPort = port;
+    this->SetTypeClient("localhost", port);
+  }
+  return this->Start();
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLCollaborationConnectorNode::StopSession()
+{
+  if (this->CollaborationInternal->SharedMemoryLink)
+  {
+    this->CollaborationInternal->SharedMemoryLink.reset();
+    if (this->CollaborationInternal->SharedMemoryConnected)
+    {
+      this->CollaborationInternal->SharedMemoryConnected = false;
+      this->InvokeEvent(vtkMRMLIGTLConnectorNode::DisconnectedEvent);
+    }
+    return 1;
+  }
+  this->CollaborationInternal->PoseChannel.reset();
+  this->CollaborationInternal->PoseChannelReachable = false;
+  this->CollaborationInternal->PoseDatagramNodeIDs.clear();
+  int result = this->Stop();
+  if (this->CollaborationInternal->RelayHubPort > 0)
+  {
+    this->CollaborationInternal->RelayHub->Stop();
+    this->SetTypeServer(this->CollaborationInternal->RelayHubPort);
+    this->CollaborationInternal->RelayHubPort = 0;
+  }
+  return result;
+}
+
+//----------------------------------------------------------------------------
+vtkCollaborationRelayHub* vtkMRMLCollaborationConnectorNode::GetRelayHub()
+{
+  return this->CollaborationInternal->RelayHub;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::IsSessionConnected()
+{
+  if (this->isSameHostSession())
+  {
+    return this->CollaborationInternal->SharedMemoryConnected;
+  }
+  return this->GetState() == vtkMRMLIGTLConnectorNode::StateConnected;
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLCollaborationConnectorNode::SendNode(vtkMRMLNode* node)
+{
+  node = this->getParticipantPoseNode(node);
+  if (this->isSameHostSession())
+  {
+    return this->sendSharedMemoryNode(node) ? 1 : 0;
+  }
+  return this->PushNode(node);
+}
+
+//----------------------------------------------------------------------------
+vtkCollaborationContentCache* vtkMRMLCollaborationConnectorNode::GetContentCache()
+{
+  this->CollaborationInternal->ContentCache->SetCacheDirectory(this->ContentCacheDirectory);
+  this->CollaborationInternal->ContentCache->SetMaximumCacheSize(this->ContentCacheMaximumSize);
+  return this->CollaborationInternal->ContentCache;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::IsNodeContentOffered(vtkMRMLNode* node)
+{
+  // the content crosses the shared memory faster than it is hashed
+  if (!this->ContentCacheEnabled || this->SameHostTransport || !node)
+  {
+    return false;
+  }
+  return (node->IsA("vtkMRMLModelNode") && vtkMRMLModelNode::SafeDownCast(node)->GetPolyData())
+    || (node->IsA("vtkMRMLScalarVolumeNode") && vtkMRMLScalarVolumeNode::SafeDownCast(node)->GetImageData());
+}
+
+//----------------------------------------------------------------------------
+std::string vtkMRMLCollaborationConnectorNode::getContentHash(vtkMRMLNode* node)
+{
+  vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(node);
+  vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(node);
+  vtkDataObject* content = nullptr;
+  if (modelNode)
+  {
+    content = modelNode->GetPolyData();
+  }
+  else if (volumeNode)
+  {
+    content = volumeNode->GetImageData();
+  }
+  if (!content || !node->GetID())
+  {
+    return "";
+  }
+
+  // hashing is only repeated if the content has changed since the last offer or push
+  std::pair<vtkMTimeType, std::string>& contentHash = this->CollaborationInternal->ContentHashes[node->GetID()];
+  if (contentHash.second.empty() || contentHash.first != content->GetMTime())
+  {
+    contentHash.first = content->GetMTime();
+    contentHash.second = modelNode ? vtkCollaborationContentCache::ComputePolyDataHash(modelNode->GetPolyData())
+      : vtkCollaborationContentCache::ComputeImageDataHash(volumeNode->GetImageData());
+  }
+  return contentHash.second;
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLCollaborationConnectorNode::OfferNode(vtkMRMLNode* node)
+{
+  node = this->getParticipantPoseNode(node);
+  if (!this->IsNodeContentOffered(node))
+  {
+    return this->PushNodeProgressive(node);
+  }
+
+  // write an XML text with the node identification and the hash of its content
+  std::stringstream ss;
+  ss << "<MRMLNode SuperclassName = \"vtkMRMLCollaborationContent\" ClassName = \"ContentOffer\" NodeName = \"";
+  ss << vtkMRMLNode::XMLAttributeEncodeString(node->GetName());
+  ss << "\" NodeClassName = \"";
+  ss << node->GetClassName();
+  ss << "\" ContentHash = \"";
+  ss << this->getContentHash(node);
+  ss << "\"";
+  vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(node);
+  if (volumeNode)
+  {
+    // the geometry of the volume is not part of the cached image
+    vtkNew<vtkMatrix4x4> ijkToRAS;
+    volumeNode->GetIJKToRASMatrix(ijkToRAS);
+    ss << " IJKToRAS = \"";
+    for (int i = 0; i < 4; i++)
+    {
+      for (int j = 0; j < 4; j++)
+      {
+        ss << ijkToRAS->GetElement(i, j) << ((i == 3 && j == 3) ? "" : " ");
+      }
+    }
+    ss << "\"";
+  }
+  ss << " />";
+  this->sendTextMessage(std::string(node->GetName()) + "ContentOffer", ss.str());
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::sendTextMessage(const std::string& deviceName, const std::string& text)
+{
+  // the volume regions are not bundled, so that they stay in order with the pushed images
+  const std::string volumeDeltaSuffix = "VolumeDelta";
+  bool volumeDelta = deviceName.size() >= volumeDeltaSuffix.size()
+    && deviceName.compare(deviceName.size() - volumeDeltaSuffix.size(), volumeDeltaSuffix.size(), volumeDeltaSuffix) == 0;
+  if (!this->IsMessageBundlingUsed() || volumeDelta || text.size() > MAXIMUM_BUNDLED_MESSAGE_SIZE)
+  {
+    // the messages bundled before are sent first
+    this->flushBundle();
+    this->pushTextMessage(deviceName, text);
+    return;
+  }
+  size_t messageSize = deviceName.size() + text.size() + 24;
+  if (this->CollaborationInternal->BundleSize + messageSize > MAXIMUM_BUNDLE_SIZE)
+  {
+    this->flushBundle();
+  }
+  this->CollaborationInternal->BundledMessages.push_back(std::make_pair(deviceName, text));
+  this->CollaborationInternal->BundleSize += messageSize;
+  this->RequestProcessing();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::flushBundle()
+{
+  std::vector<std::pair<std::string, std::string> > messages;
+  messages.swap(this->CollaborationInternal->BundledMessages);
+  this->CollaborationInternal->BundleSize = 0;
+  if (messages.empty() || !this->IsSessionConnected())
+  {
+    // the offers and the unacknowledged channel messages are sent again when the connection is established
+    return;
+  }
+  if (messages.size() == 1)
+  {
+    this->pushTextMessage(messages[0].first, messages[0].second);
+    return;
+  }
+  // each message is framed by the lengths of its device name and text
+  std::string bundle;
+  bundle.reserve(MAXIMUM_BUNDLE_SIZE);
+  for (const std::pair<std::string, std::string>& message : messages)
+  {
+    bundle += std::to_string(message.first.size()) + " " + std::to_string(message.second.size()) + "\n";
+    bundle += message.first;
+    bundle += message.second;
+  }
+  this->pushTextMessage(BundleDeviceName, bundle);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::handleBundle(const std::string& text, int encoding)
+{
+  size_t position = 0;
+  while (position < text.size())
+  {
+    size_t lineEnd = text.find('\n', position);
+    size_t nameSize = 0;
+    size_t textSize = 0;
+    std::istringstream frame(lineEnd != std::string::npos ? text.substr(position, lineEnd - position) : std::string());
+    if (!(frame >> nameSize >> textSize) || nameSize + textSize > text.size() - lineEnd - 1)
+    {
+      vtkErrorMacro("handleBundle: Invalid message bundle");
+      return;
+    }
+    std::string deviceName = text.substr(lineEnd + 1, nameSize);
+    std::string messageText = text.substr(lineEnd + 1 + nameSize, textSize);
+    position = lineEnd + 1 + nameSize + textSize;
+
+    if (this->isIncomingChannelDevice(deviceName))
+    {
+      this->handleChannelBundle(messageText, deviceName);
+    }
+    else if (!this->handleTextMessage(messageText, encoding))
+    {
+      vtkWarningMacro("handleBundle: Ignored message of device " << deviceName);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::handleTextMessage(const std::string& text, int encoding)
+{
+  std::stringstream ss;
+  ss << text;
+  vtkSmartPointer<vtkXMLDataElement> res = vtkSmartPointer<vtkXMLDataElement>::Take(
+    vtkXMLUtilities::ReadElementFromStream(ss, encoding));
+  if (!res)
+  {
+    return false;
+  }
+  // if it is a content offer or request
+  if (res->GetAttribute("SuperclassName") && strcmp(res->GetAttribute("SuperclassName"), "vtkMRMLCollaborationContent") == 0)
+  {
+    this->handleContentMessage(res);
+  }
+  else
+  {
+    // synchronization metadata sent in text nodes by peers not using the synchronization channel
+    this->handleSynchronizationMessage(res);
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::pushTextMessage(const std::string& deviceName, const std::string& text)
+{
+  if (this->isSameHostSession())
+  {
+    // no text node nor compression, the text is copied as it is
+    this->sendSharedMemoryText(deviceName, text, VTK_ENCODING_US_ASCII);
+    return;
+  }
+  vtkMRMLScene* scene = this->GetScene();
+  if (!scene)
+  {
+    return;
+  }
+  vtkMRMLTextNode* textNode = vtkMRMLTextNode::SafeDownCast(scene->GetFirstNode(deviceName.c_str(), "vtkMRMLTextNode"));
+  if (!textNode)
+  {
+    vtkSmartPointer<vtkMRMLTextNode> newTextNode = vtkSmartPointer<vtkMRMLTextNode>::Take(
+      vtkMRMLTextNode::SafeDownCast(scene->CreateNodeByClass("vtkMRMLTextNode")));
+    newTextNode->SetName(deviceName.c_str());
+    // the message is only meaningful during the session
+    newTextNode->SetHideFromEditors(1);
+    newTextNode->SetSaveWithScene(false);
+    scene->AddNode(newTextNode);
+    this->RegisterOutgoingMRMLNode(newTextNode);
+    textNode = newTextNode;
+  }
+  // the capabilities are always readable, they tell the peer which codecs it can use
+  std::string compressedText;
+  if (this->MessageCompression && !this->RelayHub && deviceName != CapabilitiesDeviceName
+    && text.size() >= static_cast<size_t>(std::max(this->MessageCompressionThreshold, 1))
+    && !this->CollaborationInternal->PeerCompressionCodecs.empty())
+  {
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    bool compressed = vtkCollaborationMessageCompression::Compress(text, this->CollaborationInternal->PeerCompressionCodecs,
+      compressedText);
+    this->CollaborationInternal->CompressionTime +=
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (compressed)
+    {
+      this->CollaborationInternal->NumberOfCompressedMessages++;
+      this->CollaborationInternal->CompressionInputSize += text.size();
+      this->CollaborationInternal->CompressionOutputSize += compressedText.size();
+    }
+    else
+    {
+      compressedText.clear();
+    }
+  }
+  if (compressedText.empty())
+  {
+    this->CollaborationInternal->CompressedTextNodeIDs.erase(textNode->GetID());
+  }
+  else
+  {
+    this->CollaborationInternal->CompressedTextNodeIDs.insert(textNode->GetID());
+  }
+  textNode->SetText(compressedText.empty() ? text.c_str() : compressedText.c_str());
+  this->PushNode(textNode);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::onConnected(vtkObject* vtkNotUsed(caller), unsigned long event, void* clientData, void* vtkNotUsed(callData))
+{
+  vtkMRMLCollaborationConnectorNode* self = reinterpret_cast<vtkMRMLCollaborationConnectorNode*>(clientData);
+  if (self && event == vtkMRMLIGTLConnectorNode::DisconnectedEvent)
+  {
+    // the next peer may be another application, or an older version of the module
+    self->CollaborationInternal->PeerProtocolVersion = 0;
+    self->CollaborationInternal->PeerFeatures.clear();
+    self->CollaborationInternal->PeerCompressionCodecs.clear();
+    if (self->CollaborationInternal->PoseChannel)
+    {
+      self->CollaborationInternal->PoseChannel->ResetPeer();
+    }
+  }
+  else if (self)
+  {
+    self->sendCapabilities();
+    self->offerNodesOnConnect();
+    // resend the channel messages that were not acknowledged before the connection was lost
+    self->CollaborationInternal->ChannelResendRequested = !self->CollaborationInternal->OutgoingChannelMessages.empty();
+    // the received data is imported periodically while connected
+    self->RequestProcessing();
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::sendCapabilities()
+{
+  if (this->RelayHub)
+  {
+    // the participants of a relay hub do not negotiate with each other
+    return;
+  }
+  // the features this node can receive, whatever it sends itself
+  std::string codecs;
+  for (const std::string& codec : vtkCollaborationMessageCompression::GetSupportedCodecs())
+  {
+    codecs += (codecs.empty() ? "" : ",") + codec;
+  }
+  std::stringstream ss;
+  ss << "<" << CapabilitiesDeviceName << " ProtocolVersion=\"" << ProtocolVersion << "\"";
+  ss << " Features=\"" << BinaryAttributeEncodingFeature << "," << VolumeDeltaFeature << "," << ProgressiveVolumeFeature
+    << "," << MessageBundlingFeature;
+  vtkCollaborationPoseChannel* poseChannel = this->CollaborationInternal->PoseChannel.get();
+  if (poseChannel)
+  {
+    ss << "," << PoseDatagramFeature;
+  }
+  ss << "\"";
+  ss << " Compression=\"" << codecs << "\"";
+  if (poseChannel)
+  {
+    // the peer sends its datagrams to this port with this token
+    ss << " PoseDatagramPort=\"" << poseChannel->GetLocalPort() << "\"";
+    ss << " PoseDatagramToken=\"" << poseChannel->GetLocalToken() << "\"";
+  }
+  ss << " />";
+  this->pushTextMessage(CapabilitiesDeviceName, ss.str());
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::handleCapabilities(const std::string& text)
+{
+  vtkSmartPointer<vtkXMLDataElement> capabilities = vtkSmartPointer<vtkXMLDataElement>::Take(
+    vtkXMLUtilities::ReadElementFromString(text.c_str()));
+  if (!capabilities)
+  {
+    vtkErrorMacro("handleCapabilities: Invalid capabilities message");
+    return;
+  }
+  int peerProtocolVersion = 0;
+  if (!capabilities->GetScalarAttribute("ProtocolVersion", peerProtocolVersion) || peerProtocolVersion < 1)
+  {
+    vtkErrorMacro("handleCapabilities: Invalid protocol version");
+    return;
+  }
+  this->CollaborationInternal->PeerProtocolVersion = peerProtocolVersion;
+  this->CollaborationInternal->PeerFeatures.clear();
+  std::stringstream featureList(capabilities->GetAttribute("Features") ? capabilities->GetAttribute("Features") : "");
+  std::string feature;
+  while (std::getline(featureList, feature, ','))
+  {
+    this->CollaborationInternal->PeerFeatures.insert(feature);
+  }
+
+  // the codecs of the peer that this node supports too, in the order of preference of this node
+  std::set<std::string> peerCodecs;
+  std::stringstream codecList(capabilities->GetAttribute("Compression") ? capabilities->GetAttribute("Compression") : "");
+  std::string codec;
+  while (std::getline(codecList, codec, ','))
+  {
+    peerCodecs.insert(codec);
+  }
+  this->CollaborationInternal->PeerCompressionCodecs.clear();
+  for (const std::string& supportedCodec : vtkCollaborationMessageCompression::GetSupportedCodecs())
+  {
+    if (peerCodecs.count(supportedCodec))
+    {
+      this->CollaborationInternal->PeerCompressionCodecs.push_back(supportedCodec);
+    }
+  }
+
+  // the client sends its datagrams to the host of the server, the server replies to the address they come from
+  vtkCollaborationPoseChannel* poseChannel = this->CollaborationInternal->PoseChannel.get();
+  const char* peerPoseDatagramToken = capabilities->GetAttribute("PoseDatagramToken");
+  int peerPoseDatagramPort = 0;
+  if (poseChannel && this->isFeatureSupportedByPeer(PoseDatagramFeature) && peerPoseDatagramToken
+    && capabilities->GetScalarAttribute("PoseDatagramPort", peerPoseDatagramPort))
+  {
+    uint64_t peerToken = 0;
+    std::stringstream tokenStream(peerPoseDatagramToken);
+    tokenStream >> peerToken;
+    const char* serverHostname = this->GetServerHostname();
+    bool isServer = (this->GetType() == vtkMRMLIGTLConnectorNode::TypeServer);
+    poseChannel->SetPeer(peerToken, (isServer || !serverHostname) ? "" : serverHostname, peerPoseDatagramPort);
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::isFeatureSupportedByPeer(const char* feature)
+{
+  return this->RelayHub || this->CollaborationInternal->PeerFeatures.count(feature) > 0;
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLCollaborationConnectorNode::GetPeerProtocolVersion()
+{
+  return this->CollaborationInternal->PeerProtocolVersion;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::IsBinaryAttributeEncodingUsed()
+{
+  return this->BinaryAttributeEncoding && this->isFeatureSupportedByPeer(BinaryAttributeEncodingFeature);
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::IsVolumeDeltaDeliveryUsed()
+{
+  // the shared memory copies the whole image faster than the modified region is found and encoded
+  return this->VolumeDeltaDelivery && !this->SameHostTransport && this->isFeatureSupportedByPeer(VolumeDeltaFeature);
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::IsProgressiveVolumeDeliveryUsed()
+{
+  return this->ProgressiveVolumeDelivery && !this->SameHostTransport && this->isFeatureSupportedByPeer(ProgressiveVolumeFeature);
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::IsMessageBundlingUsed()
+{
+  // the relay hub routes and coalesces the messages by device, and a message costs a copy through the shared memory
+  return this->MessageBundling && !this->RelayHub && !this->SameHostTransport
+    && this->isFeatureSupportedByPeer(MessageBundlingFeature);
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::IsPoseDatagramDeliveryUsed()
+{
+  // the channel is only open if the option is enabled, outside of relay hubs and same host sessions
+  return this->PoseDatagramDelivery && this->CollaborationInternal->PoseChannel
+    && this->isFeatureSupportedByPeer(PoseDatagramFeature) && this->CollaborationInternal->PoseChannel->IsPeerReachable();
+}
+
+//----------------------------------------------------------------------------
+std::string vtkMRMLCollaborationConnectorNode::GetPeerCompressionCodecs()
+{
+  std::string codecs;
+  for (const std::string& codec : this->CollaborationInternal->PeerCompressionCodecs)
+  {
+    codecs += (codecs.empty() ? "" : ",") + codec;
+  }
+  return codecs;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkMRMLCollaborationConnectorNode::GetNumberOfCompressedMessages()
+{
+  return this->CollaborationInternal->NumberOfCompressedMessages;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkMRMLCollaborationConnectorNode::GetCompressionInputSize()
+{
+  return this->CollaborationInternal->CompressionInputSize;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkMRMLCollaborationConnectorNode::GetCompressionOutputSize()
+{
+  return this->CollaborationInternal->CompressionOutputSize;
+}
+
+//----------------------------------------------------------------------------
+double vtkMRMLCollaborationConnectorNode::GetCompressionTime()
+{
+  return this->CollaborationInternal->CompressionTime;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkMRMLCollaborationConnectorNode::GetNumberOfDecompressedMessages()
+{
+  return this->CollaborationInternal->NumberOfDecompressedMessages;
+}
+
+//----------------------------------------------------------------------------
+double vtkMRMLCollaborationConnectorNode::GetDecompressionTime()
+{
+  return this->CollaborationInternal->DecompressionTime;
+}
+
+//----------------------------------------------------------------------------
+double vtkMRMLCollaborationConnectorNode::GetCompressionRatio()
+{
+  if (this->CollaborationInternal->CompressionOutputSize == 0)
+  {
+    return 1.0;
+  }
+  return static_cast<double>(this->CollaborationInternal->CompressionInputSize)
+    / static_cast<double>(this->CollaborationInternal->CompressionOutputSize);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::offerNodesOnConnect()
+{
+  int numberOfOutgoingNodes = this->GetNumberOfOutgoingMRMLNodes();
+  for (int nodeIndex = 0; nodeIndex < numberOfOutgoingNodes; nodeIndex++)
+  {
+    vtkMRMLNode* node = this->GetOutgoingMRMLNode(nodeIndex);
+    const char* offerOnConnect = node ? node->GetAttribute(OfferOnConnectAttributeName) : nullptr;
+    if (offerOnConnect && strcmp(offerOnConnect, "true") == 0)
+    {
+      this->OfferNode(node);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::IsLocalPoseNode(vtkMRMLNode* node)
+{
+  if (!node || !node->GetName() || !node->IsA("vtkMRMLLinearTransformNode"))
+  {
+    return false;
+  }
+  std::string name = node->GetName();
+  for (const char* suffix : { "HMD", "LeftController", "RightController" })
+  {
+    if (name == std::string(LocalPoseNamePrefix) + suffix)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkMRMLCollaborationConnectorNode::GetParticipantID()
+{
+  return this->CollaborationInternal->ParticipantID;
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLNode* vtkMRMLCollaborationConnectorNode::getParticipantPoseNode(vtkMRMLNode* node)
+{
+  vtkMRMLScene* scene = this->GetScene();
+  if (!IsLocalPoseNode(node) || !node->GetID() || !scene)
+  {
+    return node;
+  }
+  std::string poseNodeName = std::string(ParticipantPoseNamePrefix) + this->CollaborationInternal->ParticipantID
+    + "." + (node->GetName() + strlen(LocalPoseNamePrefix));
+  vtkMRMLLinearTransformNode* poseNode = vtkMRMLLinearTransformNode::SafeDownCast(
+    scene->GetFirstNode(poseNodeName.c_str(), "vtkMRMLLinearTransformNode"));
+  if (!poseNode)
+  {
+    vtkSmartPointer<vtkMRMLLinearTransformNode> newPoseNode = vtkSmartPointer<vtkMRMLLinearTransformNode>::Take(
+      vtkMRMLLinearTransformNode::SafeDownCast(scene->CreateNodeByClass("vtkMRMLLinearTransformNode")));
+    newPoseNode->SetName(poseNodeName.c_str());
+    // the pose is only meaningful during the session
+    newPoseNode->SetHideFromEditors(1);
+    newPoseNode->SetSaveWithScene(false);
+    newPoseNode->SetAttribute(ParticipantPoseAttributeName, node->GetID());
+    scene->AddNode(newPoseNode);
+    poseNode = newPoseNode;
+  }
+  if (!this->isOutgoingNode(poseNode))
+  {
+    this->RegisterOutgoingMRMLNode(poseNode);
+  }
+  vtkNew<vtkMatrix4x4> matrix;
+  vtkMRMLLinearTransformNode::SafeDownCast(node)->GetMatrixTransformToParent(matrix);
+  poseNode->SetMatrixTransformToParent(matrix);
+  return poseNode;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::handleContentMessage(vtkXMLDataElement* res)
+{
+  const char* messageType = res->GetAttribute("ClassName");
+  if (messageType && strcmp(messageType, "VolumeDelta") == 0)
+  {
+    this->handleVolumeDelta(res);
+    return;
+  }
+  if (messageType && strcmp(messageType, "VolumeGeometry") == 0)
+  {
+    this->handleVolumeGeometry(res);
+    return;
+  }
+  const char* nodeName = res->GetAttribute("NodeName");
+  const char* contentHash = res->GetAttribute("ContentHash");
+  if (!messageType || !nodeName || !contentHash || !vtkCollaborationContentCache::IsValidHash(contentHash))
+  {
+    vtkErrorMacro("handleContentMessage: Invalid content message");
+    return;
+  }
+
+  // the peer does not have the content of one of our nodes in its cache
+  if (strcmp(messageType, "ContentRequest") == 0)
+  {
+    vtkMRMLNode* node = this->GetScene()->GetFirstNodeByName(nodeName);
+    if (node)
+    {
+      this->PushNodeProgressive(node);
+    }
+    return;
+  }
+  if (strcmp(messageType, "ContentOffer") != 0)
+  {
+    return;
+  }
+
+  // the peer offers content, apply it from the cache if possible
+  const char* nodeClassName = res->GetAttribute("NodeClassName");
+  vtkCollaborationContentCache* cache = this->GetContentCache();
+  bool appliedFromCache = false;
+  if (this->ContentCacheEnabled && nodeClassName && cache->HasContent(contentHash))
+  {
+    vtkMRMLNode* node = this->GetScene()->GetFirstNode(nodeName, nodeClassName);
+    vtkSmartPointer<vtkMRMLNode> newNode;
+    if (!node)
+    {
+      newNode = vtkSmartPointer<vtkMRMLNode>::Take(this->GetScene()->CreateNodeByClass(nodeClassName));
+      node = newNode;
+    }
+    vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(node);
+    vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(node);
+    if (modelNode)
+    {
+      vtkNew<vtkPolyData> polyData;
+      if (cache->ReadPolyData(contentHash, polyData))
+      {
+        modelNode->SetAndObservePolyData(polyData);
+        appliedFromCache = true;
+      }
+    }
+    else if (volumeNode)
+    {
+      vtkNew<vtkImageData> imageData;
+      if (cache->ReadImageData(contentHash, imageData))
+      {
+        volumeNode->SetAndObserveImageData(imageData);
+        const char* ijkToRASStr = res->GetAttribute("IJKToRAS");
+        if (ijkToRASStr)
+        {
+          vtkNew<vtkMatrix4x4> ijkToRAS;
+          std::stringstream ss(ijkToRASStr);
+          for (int i = 0; i < 4; i++)
+          {
+            for (int j = 0; j < 4; j++)
+            {
+              double element = (i == j) ? 1.0 : 0.0;
+              ss >> element;
+              ijkToRAS->SetElement(i, j, element);
+            }
+          }
+          volumeNode->SetIJKToRASMatrix(ijkToRAS);
+        }
+        appliedFromCache = true;
+      }
+    }
+    if (appliedFromCache && newNode)
+    {
+      newNode->SetName(nodeName);
+      // mark it as received so that it is added to the synchronized nodes
+      newNode->SetDescription("Received by OpenIGTLink");
+      this->GetScene()->AddNode(newNode);
+      vtkMRMLDisplayableNode::SafeDownCast(newNode)->CreateDefaultDisplayNodes();
+    }
+    if (appliedFromCache && modelNode)
+    {
+      this->updateModelDisplayNode(modelNode);
+    }
+  }
+  if (appliedFromCache)
+  {
+    return;
+  }
+
+  // request the content
+  std::stringstream ss;
+  ss << "<MRMLNode SuperclassName = \"vtkMRMLCollaborationContent\" ClassName = \"ContentRequest\" NodeName = \"";
+  ss << vtkMRMLNode::XMLAttributeEncodeString(nodeName);
+  ss << "\" ContentHash = \"";
+  ss << contentHash;
+  ss << "\" />";
+  this->sendTextMessage(std::string(nodeName) + "ContentRequest", ss.str());
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::handleVolumeDelta(vtkXMLDataElement* res)
+{
+  const char* nodeName = res->GetAttribute("NodeName");
+  const char* data = res->GetAttribute("Data");
+  int extent[6] = { 0, -1, 0, -1, 0, -1 };
+  int scalarType = 0;
+  int numberOfComponents = 0;
+  // coarse bricks of the progressive volume streams have a step larger than 1
+  int step = 1;
+  res->GetScalarAttribute("Step", step);
+  if (!nodeName || !data || res->GetVectorAttribute("Extent", 6, extent) != 6
+    || !res->GetScalarAttribute("ScalarType", scalarType) || !res->GetScalarAttribute("NumberOfComponents", numberOfComponents))
+  {
+    vtkErrorMacro("handleVolumeDelta: Invalid volume delta message");
+    return;
+  }
+  vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(
+    this->GetScene()->GetFirstNode(nodeName, "vtkMRMLScalarVolumeNode"));
+  vtkImageData* image = volumeNode ? volumeNode->GetImageData() : nullptr;
+  if (!image || image->GetScalarType() != scalarType || image->GetNumberOfScalarComponents() != numberOfComponents)
+  {
+    // the full image is pushed before its deltas, it may have been replaced by a newer one meanwhile
+    vtkWarningMacro("handleVolumeDelta: Volume delta does not match the image of volume " << nodeName);
+    return;
+  }
+  const char* compressed = res->GetAttribute("Compressed");
+  std::string voxels;
+  if (!vtkCollaborationAttributeSchema::DecodeRecordFromText(data, voxels)
+    || !vtkCollaborationImageDelta::DecodeExtent(voxels, compressed && strcmp(compressed, "true") == 0, image, extent, step))
+  {
+    vtkWarningMacro("handleVolumeDelta: Volume delta does not match the image of volume " << nodeName);
+    return;
+  }
+  image->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::updateModelDisplayNode(vtkMRMLModelNode* modelNode)
+{
+  // see if the display node was already defined
+  if (modelNode && modelNode->GetName())
+  {
+    this->applyDeferredMetadata(modelNode->GetName());
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::applyDeferredMetadata(const std::string& nodeName)
+{
+  auto metadataIt = this->CollaborationInternal->DeferredMetadata.find(nodeName);
+  if (metadataIt == this->CollaborationInternal->DeferredMetadata.end())
+  {
+    return;
+  }
+  // kept again if the display node still does not exist
+  std::string text = metadataIt->second;
+  this->CollaborationInternal->DeferredMetadata.erase(metadataIt);
+  this->handleSynchronizationText(text);
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::handleSynchronizationText(const std::string& text)
+{
+  if (text.empty())
+  {
+    return false;
+  }
+  if (text[0] != '<')
+  {
+    return this->handleSynchronizationRecord(text);
+  }
+  vtkSmartPointer<vtkXMLDataElement> res = vtkSmartPointer<vtkXMLDataElement>::Take(
+    vtkXMLUtilities::ReadElementFromString(text.c_str()));
+  return res && this->handleSynchronizationMessage(res);
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::handleSynchronizationRecord(const std::string& text)
+{
+  std::string record;
+  if (!vtkCollaborationAttributeSchema::DecodeRecordFromText(text, record))
+  {
+    return false;
+  }
+  vtkCollaborationAttributeSchema::RecordReader reader(record);
+  std::string nodeName;
+  vtkCollaborationAttributeSchema* schema = vtkCollaborationAttributeSchema::ReadRecordHeader(reader, nodeName);
+  if (!schema || !this->GetScene())
+  {
+    return false;
+  }
+
+  // display records are applied to the display node of the named displayable node
+  if (schema->GetDisplayableClassName())
+  {
+    vtkMRMLDisplayableNode* displayableNode = vtkMRMLDisplayableNode::SafeDownCast(
+      this->GetScene()->GetFirstNode(nodeName.c_str(), schema->GetDisplayableClassName()));
+    vtkMRMLDisplayNode* displayNode = displayableNode ? displayableNode->GetDisplayNode() : nullptr;
+    if (!displayNode || !displayNode->IsA(schema->GetClassName()))
+    {
+      // the displayable node has not arrived yet, the display is applied when it does
+      this->CollaborationInternal->DeferredMetadata[nodeName] = text;
+      return true;
+    }
+    MRMLNodeModifyBlocker blocker(displayNode);
+    return schema->ReadFields(displayNode, reader);
+  }
+
+  vtkMRMLNode* node = this->GetScene()->GetFirstNodeByName(nodeName.c_str());
+  vtkSmartPointer<vtkMRMLNode> newNode;
+  if (!node || strcmp(node->GetClassName(), schema->GetClassName()) != 0)
+  {
+    newNode = vtkSmartPointer<vtkMRMLNode>::Take(this->GetScene()->CreateNodeByClass(schema->GetClassName()));
+    if (!newNode)
+    {
+      return false;
+    }
+    newNode->SetName(nodeName.c_str());
+    node = newNode;
+  }
+  // the measurements of the markups are computed later, not on each streamed update
+  this->deferMeasurements(node);
+  bool success = false;
+  {
+    // all the fields are applied in a single update
+    MRMLNodeModifyBlocker blocker(node);
+    success = schema->ReadFields(node, reader);
+  }
+  if (newNode)
+  {
+    this->GetScene()->AddNode(newNode);
+  }
+  if (node->IsA("vtkMRMLMarkupsNode"))
+  {
+    this->deferMeasurements(node);
+    this->applyDeferredMetadata(nodeName);
+  }
+  return success;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::handleSynchronizationMessage(vtkXMLDataElement* res)
+{
+  if (!this->GetScene() || !res->GetAttribute("SuperclassName"))
+  {
+    return false;
+  }
+  // the codec of the node class applies the message
+  vtkCollaborationNodeCodec* codec = vtkCollaborationNodeCodec::GetCodecOfClass(res->GetAttribute("ClassName"), this->GetScene());
+  if (!codec)
+  {
+    return false;
+  }
+  // the next update may arrive before anyone reads the measurements of the markups, they are computed later
+  if (strcmp(res->GetAttribute("SuperclassName"), "vtkMRMLMarkupsNode") == 0 && res->GetAttribute("name"))
+  {
+    this->deferMeasurements(this->GetScene()->GetFirstNodeByName(res->GetAttribute("name")));
+  }
+  std::string targetNodeName;
+  vtkMRMLNode* updatedNode = nullptr;
+  switch (codec->Deserialize(this->GetScene(), res, targetNodeName, updatedNode))
+  {
+    case vtkCollaborationNodeCodec::DeserializeApplied:
+    {
+      // a created markups node computed its measurements when it was added
+      this->deferMeasurements(updatedNode);
+      this->applyDeferredMetadata(targetNodeName);
+      return true;
+    }
+    case vtkCollaborationNodeCodec::DeserializeDeferred:
+    {
+      // the target node has not arrived yet, the message is applied when it does
+      std::stringstream ss;
+      vtkXMLUtilities::FlattenElement(res, ss);
+      this->CollaborationInternal->DeferredMetadata[targetNodeName] = ss.str();
+      return true;
+    }
+    case vtkCollaborationNodeCodec::DeserializeKept:
+      // kept to apply it to the nodes received later
+      this->CollaborationInternal->KeptMetadata[targetNodeName] = res;
+      return true;
+    default:
+      return false;
+  }
 }
 
 //----------------------------------------------------------------------------
-unsigned int vtkMRMLCollaborationConnectorNode::AssignOutGoingNodeToDevice(vtkMRMLNode * node, igtlioDevicePointer device)
+void vtkMRMLCollaborationConnectorNode::UpdateReceivedTransforms()
 {
-  return Superclass::AssignOutGoingNodeToDevice(node, device);
+  if (!this->GetScene())
+  {
+    return;
+  }
+  // the messages are stored again, iterate on a copy
+  std::map<std::string, vtkSmartPointer<vtkXMLDataElement> > keptMetadata = this->CollaborationInternal->KeptMetadata;
+  for (const auto& metadata : keptMetadata)
+  {
+    this->handleSynchronizationMessage(metadata.second);
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -123,19 +2595,103 @@ vtkMRMLNode* vtkMRMLCollaborationConnectorNode::CreateNewMRMLNodeForDevice(igtli
     textNode->SetEncoding(modifiedDevice->GetContent().encoding);
     textNode->SetText(modifiedDevice->GetContent().string_msg.c_str());
     textNode->SetName(deviceName.c_str());
-    textNode->SetDescription("Received by OpenIGTLink");
+    // content offers and requests are not synchronized nodes
+    if (deviceName.find("ContentOffer") == std::string::npos && deviceName.find("ContentRequest") == std::string::npos
+      && deviceName.find("VolumeDelta") == std::string::npos)
+    {
+      textNode->SetDescription("Received by OpenIGTLink");
+    }
+    else
+    {
+      textNode->SetSaveWithScene(false);
+    }
     // hide in case it contains the display node attributes
     textNode->SetHideFromEditors(1);
     this->GetScene()->AddNode(textNode);
     this->RegisterIncomingMRMLNode(textNode, device);
     return textNode;
   }
+  // reuse the node if its content was already applied from the cache
+  const char* cachedNodeClassName = nullptr;
+  if (deviceType == "POLYDATA")
+  {
+    cachedNodeClassName = "vtkMRMLModelNode";
+  }
+  else if (deviceType == "IMAGE")
+  {
+    cachedNodeClassName = "vtkMRMLScalarVolumeNode";
+  }
+  if (cachedNodeClassName && this->ContentCacheEnabled)
+  {
+    vtkMRMLNode* cachedNode = this->GetScene()->GetFirstNode(deviceName.c_str(), cachedNodeClassName);
+    if (cachedNode)
+    {
+      this->RegisterIncomingMRMLNode(cachedNode, device);
+      return cachedNode;
+    }
+  }
   return Superclass::CreateNewMRMLNodeForDevice(device);
 }
 
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::handleConnectorMessage(const std::string& deviceName, const std::string& text, int encoding)
+{
+  if (this->isIncomingChannelDevice(deviceName))
+  {
+    this->handleChannelBundle(text, deviceName);
+    return true;
+  }
+  if (deviceName == vtkCollaborationRelayHub::HubDeviceName)
+  {
+    this->handleHubMessage(text);
+    return true;
+  }
+  if (deviceName == BundleDeviceName)
+  {
+    this->handleBundle(text, encoding);
+    return true;
+  }
+  if (deviceName == CapabilitiesDeviceName)
+  {
+    this->handleCapabilities(text);
+    return true;
+  }
+  return false;
+}
+
 //----------------------------------------------------------------------------
 void vtkMRMLCollaborationConnectorNode::ProcessIncomingDeviceModifiedEvent(vtkObject * caller, unsigned long event, igtlioDevice * modifiedDevice)
 {
+  this->CollaborationInternal->LastTrafficTime = std::chrono::steady_clock::now();
+  // text of the string messages, decompressed if the peer marked it as compressed
+  std::string text;
+  if (modifiedDevice->GetDeviceType() == "STRING")
+  {
+    text = reinterpret_cast<igtlioStringDevice*>(modifiedDevice)->GetContent().string_msg;
+    std::string compression;
+    if (modifiedDevice->GetMetaDataElement(CompressionMetaDataKey, compression) && compression == "true")
+    {
+      std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+      std::string compressedText;
+      compressedText.swap(text);
+      if (!vtkCollaborationMessageCompression::Decompress(compressedText, text))
+      {
+        vtkErrorMacro("ProcessIncomingDeviceModifiedEvent: Failed to decompress the message of device " << modifiedDevice->GetDeviceName());
+        return;
+      }
+      this->CollaborationInternal->NumberOfDecompressedMessages++;
+      this->CollaborationInternal->DecompressionTime +=
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    }
+  }
+
+  // channel messages, bundles, capabilities and notifications of the relay hub are not stored in the scene
+  if (modifiedDevice->GetDeviceType() == "STRING" && this->handleConnectorMessage(modifiedDevice->GetDeviceName(), text,
+    reinterpret_cast<igtlioStringDevice*>(modifiedDevice)->GetContent().encoding))
+  {
+    return;
+  }
+
   vtkMRMLNode* modifiedNode = this->GetMRMLNodeForDevice(modifiedDevice);
   bool isNewNodeCreated = false;
   if (!modifiedNode)
@@ -166,55 +2722,11 @@ void vtkMRMLCollaborationConnectorNode::ProcessIncomingDeviceModifiedEvent(vtkOb
     {
       igtlioStringDevice* stringDevice = reinterpret_cast<igtlioStringDevice*>(modifiedDevice);
       // read text to see if it is the XML of a display node
-      std::string text = stringDevice->GetContent().string_msg;
-      std::stringstream ss;
-      ss << text;
-      vtkXMLDataElement* res =
-        vtkXMLUtilities::ReadElementFromStream(ss, stringDevice->GetContent().encoding);
-      if (res)
-      {
-        int numberOfAttributes = res->GetNumberOfAttributes();
-        // if it is a ModelDisplayNode
-        if (strcmp(res->GetAttribute("SuperclassName"), "vtkMRMLDisplayNode") == 0)
-        {
-          addDisplayNode(res);
-        }
-        // if it is a markups (non fiducial) node
-        else if (strcmp(res->GetAttribute("SuperclassName"), "vtkMRMLMarkupsNode") == 0)
-        {
-          addMarkupsNode(res);
-        }
-        else if (strcmp(res->GetAttribute("SuperclassName"), "vtkMRMLTransformNode") == 0)
-        {
-          orderTransforms(res);
-          vtkMRMLTextNode* textNode = vtkMRMLTextNode::SafeDownCast(modifiedNode);
-          textNode->SetEncoding(stringDevice->GetContent().encoding);
-          textNode->SetText(stringDevice->GetContent().string_msg.c_str());
-          // set name
-          const char* transformNodeName = res->GetAttribute("TransformName");
-          char textName[] = "Text";
-          char* transformTextNodeName = new char[std::strlen(transformNodeName) + std::strlen(textName) + 1];
-          std::strcpy(transformTextNodeName, transformNodeName);
-          std::strcat(transformTextNodeName, textName);
-          textNode->SetName(transformTextNodeName);
-          // make it visible as it does not contain the display node attributes
-          textNode->SetHideFromEditors(0);
-          textNode->Modified();
-          // if transform already arrived, add reference
-          vtkMRMLLinearTransformNode* transformNode = vtkMRMLLinearTransformNode::SafeDownCast(this->GetScene()->GetFirstNodeByName(transformNodeName));
-          if (transformNode)
-          {
-            // add node reference to the markups node
-            transformNode->AddNodeReferenceRole("TextNode");
-            transformNode->AddNodeReferenceID("TextNode", textNode->GetID());
-          }
-        }
-      }
-      else
+      if (!this->handleTextMessage(text, stringDevice->GetContent().encoding))
       {
         vtkMRMLTextNode* textNode = vtkMRMLTextNode::SafeDownCast(modifiedNode);
         textNode->SetEncoding(stringDevice->GetContent().encoding);
-        textNode->SetText(stringDevice->GetContent().string_msg.c_str());
+        textNode->SetText(text.c_str());
         // make it visible as it does not contain the display node attributes
         textNode->SetHideFromEditors(0);
         textNode->Modified();
@@ -224,42 +2736,53 @@ void vtkMRMLCollaborationConnectorNode::ProcessIncomingDeviceModifiedEvent(vtkOb
     {
       igtlioPolyDataDevice* polyDevice = reinterpret_cast<igtlioPolyDataDevice*>(modifiedDevice);
       vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(modifiedNode);
+      // the full mesh replaces the proxy in a single step, on the same model node
       modelNode->SetAndObservePolyData(polyDevice->GetContent().polydata);
-      // see if the display node was already defined
-      char* modelNodeName = modelNode->GetName();
-      char displayName[] = "DisplayNode";
-      char* displayNodeName = new char[std::strlen(modelNodeName) + std::strlen(displayName) + 1];
-      std::strcpy(displayNodeName, modelNodeName);
-      std::strcat(displayNodeName, displayName);
-      vtkMRMLModelDisplayNode* displayNode = vtkMRMLModelDisplayNode::SafeDownCast(this->GetScene()->GetFirstNodeByName(displayNodeName));
-      if (displayNode)
+      std::string levelOfDetail;
+      if (polyDevice->GetMetaDataElement(LevelOfDetailMetaDataKey, levelOfDetail))
+      {
+        modelNode->SetAttribute(LevelOfDetailAttributeName, levelOfDetail.c_str());
+      }
+      // keep the full mesh in the cache for the next sessions
+      std::string contentHash;
+      if (this->ContentCacheEnabled && levelOfDetail != LevelOfDetailProxy
+        && polyDevice->GetMetaDataElement(ContentHashMetaDataKey, contentHash) && polyDevice->GetContent().polydata
+        && vtkCollaborationContentCache::IsValidHash(contentHash))
       {
-        vtkMRMLModelDisplayNode* currentDisplayNode = vtkMRMLModelDisplayNode::SafeDownCast(modelNode->GetDisplayNode());
-        currentDisplayNode->Copy(displayNode);
-        displayNode->Modified();
+        vtkSmartPointer<vtkPolyData> polyDataCopy = vtkSmartPointer<vtkPolyData>::New();
+        polyDataCopy->DeepCopy(polyDevice->GetContent().polydata);
+        vtkSmartPointer<vtkCollaborationContentCache> cache = this->GetContentCache();
+        this->CollaborationInternal->PendingCacheWrites.push_back(std::async(std::launch::async,
+          [cache, contentHash, polyDataCopy]() { return cache->StorePolyData(contentHash, polyDataCopy); }));
       }
+      // see if the display node was already defined
+      this->updateModelDisplayNode(modelNode);
       modelNode->Modified();
     }
+    else if (strcmp(deviceType.c_str(), "IMAGE") == 0)
+    {
+      // keep the image in the cache for the next sessions
+      igtlioImageDevice* imageDevice = reinterpret_cast<igtlioImageDevice*>(modifiedDevice);
+      std::string contentHash;
+      if (this->ContentCacheEnabled && imageDevice->GetMetaDataElement(ContentHashMetaDataKey, contentHash)
+        && imageDevice->GetContent().image && vtkCollaborationContentCache::IsValidHash(contentHash))
+      {
+        vtkSmartPointer<vtkImageData> imageDataCopy = vtkSmartPointer<vtkImageData>::New();
+        imageDataCopy->DeepCopy(imageDevice->GetContent().image);
+        vtkSmartPointer<vtkCollaborationContentCache> cache = this->GetContentCache();
+        this->CollaborationInternal->PendingCacheWrites.push_back(std::async(std::launch::async,
+          [cache, contentHash, imageDataCopy]() { return cache->StoreImageData(contentHash, imageDataCopy); }));
+      }
+    }
     else if (strcmp(deviceType.c_str(), "TRANSFORM") == 0)
     {
-      vtkMRMLLinearTransformNode* transformNode = vtkMRMLLinearTransformNode::SafeDownCast(modifiedNode);
-      // see if the text node was already defined and if so, apply it
-      char* transformNodeName = transformNode->GetName();
-      char textName[] = "Text";
-      char* transformTextNodeName = new char[std::strlen(transformNodeName) + std::strlen(textName) + 1];
-      std::strcpy(transformTextNodeName, transformNodeName);
-      std::strcat(transformTextNodeName, textName);
-      vtkMRMLTextNode* transformTextNode = vtkMRMLTextNode::SafeDownCast(this->GetScene()->GetFirstNodeByName(transformTextNodeName));
-      if (transformTextNode)
+      // see if the transformed nodes metadata was already received and if so, apply it
+      auto metadataIt = modifiedNode->GetName() ?
+        this->CollaborationInternal->KeptMetadata.find(modifiedNode->GetName()) : this->CollaborationInternal->KeptMetadata.end();
+      if (metadataIt != this->CollaborationInternal->KeptMetadata.end())
       {
-        std::stringstream ss;
-        ss << transformTextNode->GetText();
-        vtkXMLDataElement* res =
-          vtkXMLUtilities::ReadElementFromStream(ss);
-        orderTransforms(res);
-        // if text node already arrived, add node reference
-        transformNode->AddNodeReferenceRole("TextNode");
-        transformNode->AddNodeReferenceID("TextNode", transformTextNode->GetID());
+        vtkSmartPointer<vtkXMLDataElement> metadata = metadataIt->second;
+        this->handleSynchronizationMessage(metadata);
       }
     }
   }
@@ -267,405 +2790,473 @@ void vtkMRMLCollaborationConnectorNode::ProcessIncomingDeviceModifiedEvent(vtkOb
 }
 
 //----------------------------------------------------------------------------
-void vtkMRMLCollaborationConnectorNode::orderTransforms(vtkXMLDataElement * res)
+bool vtkMRMLCollaborationConnectorNode::isSameHostSession()
 {
-  // read attributes
-  int numberOfAttributes = res->GetNumberOfAttributes();
-  std::vector<const char*> atts_v;
-  for (int attributeIndex = 0; attributeIndex < numberOfAttributes; attributeIndex++)
-  {
-    const char* attName = res->GetAttributeName(attributeIndex);
-    const char* attValue = res->GetAttribute(attName);
-    atts_v.push_back(attName);
-    atts_v.push_back(attValue);
-  }
-  atts_v.push_back(nullptr);
-  const char** atts = (atts_v.data());
-
-  // get transform node
-  std::string transformName = res->GetAttribute("TransformName");
-  vtkMRMLLinearTransformNode* transformNode = vtkMRMLLinearTransformNode::SafeDownCast(this->GetScene()->GetFirstNodeByName(transformName.c_str()));
+  return this->CollaborationInternal->SharedMemoryLink != nullptr;
+}
 
-  // get transformed nodes attribute
-  std::string transformedNodesStr = res->GetAttribute("TransformedNodes");
+//----------------------------------------------------------------------------
+std::string vtkMRMLCollaborationConnectorNode::getSharedMemoryName()
+{
+  // both instances of a session use the same port
+  return SHARED_MEMORY_NAME_PREFIX + std::to_string(this->GetServerPort());
+}
 
-  // get every transformed node
-  std::stringstream ss(transformedNodesStr);
-  std::vector<std::string> vect;
-  while (ss.good())
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::processSharedMemoryLink()
+{
+  vtkCollaborationSharedMemoryLink* link = this->CollaborationInternal->SharedMemoryLink.get();
+  if (!link)
+  {
+    return;
+  }
+  bool peerConnected = link->IsPeerConnected();
+  if (peerConnected && !this->CollaborationInternal->SharedMemoryConnected)
   {
-    std::string substr;
-    getline(ss, substr, ',');
-    vect.push_back(substr);
+    // same notifications as an OpenIGTLink connection, so that the capabilities and the metadata are sent
+    this->CollaborationInternal->SharedMemoryConnected = true;
+    this->InvokeEvent(vtkMRMLIGTLConnectorNode::ConnectedEvent);
+    this->pushNodesOnConnect();
   }
-  int numberOfTransformedNodes = vect.size();
-  for (int i = 0; i < numberOfTransformedNodes; i++)
+
+  vtkCollaborationSharedMemoryLink::Message message;
+  while (link->PopMessage(message))
   {
-    vtkMRMLTransformableNode* node = vtkMRMLTransformableNode::SafeDownCast(this->GetScene()->GetFirstNodeByName(vect[i].c_str()));
-    if (node && transformNode)
+    this->CollaborationInternal->LastTrafficTime = std::chrono::steady_clock::now();
+    std::map<std::string, std::string> metaData = DecodeMetaData(message.MetaData);
+    const std::string& className = metaData["ClassName"];
+    this->CollaborationInternal->ApplyingDirectMessages = true;
+    switch (message.Type)
     {
-      node->SetAndObserveTransformNodeID(transformNode->GetID());
+      case vtkCollaborationSharedMemoryLink::MessageText:
+      {
+        std::string text = message.Payload ? std::string(message.Payload.get(), message.PayloadSize) : std::string();
+        int encoding = metaData.count("Encoding") ? atoi(metaData["Encoding"].c_str()) : VTK_ENCODING_US_ASCII;
+        this->applyReceivedText(message.Name, text, encoding);
+        break;
+      }
+      case vtkCollaborationSharedMemoryLink::MessageTransform:
+      {
+        if (message.PayloadSize != 16 * sizeof(double))
+        {
+          vtkErrorMacro("processSharedMemoryLink: Invalid transform " << message.Name);
+          break;
+        }
+        vtkNew<vtkMatrix4x4> matrix;
+        matrix->DeepCopy(reinterpret_cast<const double*>(message.Payload.get()));
+        this->applyReceivedTransform(message.Name, className, matrix);
+        break;
+      }
+      case vtkCollaborationSharedMemoryLink::MessagePolyData:
+      {
+        vtkNew<vtkXMLPolyDataReader> reader;
+        reader->ReadFromInputStringOn();
+        reader->SetInputString(message.Payload.get(), static_cast<int>(message.PayloadSize));
+        reader->Update();
+        if (reader->GetErrorCode() != 0 || !reader->GetOutput())
+        {
+          vtkErrorMacro("processSharedMemoryLink: Failed to read the mesh of " << message.Name);
+          break;
+        }
+        vtkSmartPointer<vtkPolyData> polyData = reader->GetOutput();
+        this->applyReceivedPolyData(message.Name, className, polyData, metaData[LevelOfDetailMetaDataKey]);
+        break;
+      }
+      case vtkCollaborationSharedMemoryLink::MessageImage:
+      {
+        int dimensions[3] = { 0, 0, 0 };
+        int scalarType = 0;
+        int numberOfComponents = 0;
+        double elements[16] = { 0.0 };
+        if (!DecodeValues(metaData["Dimensions"], 3, dimensions) || !DecodeValues(metaData["ScalarType"], 1, &scalarType)
+          || !DecodeValues(metaData["NumberOfComponents"], 1, &numberOfComponents)
+          || !DecodeValues(metaData["IJKToRAS"], 16, elements))
+        {
+          vtkErrorMacro("processSharedMemoryLink: Invalid image " << message.Name);
+          break;
+        }
+        vtkSmartPointer<vtkDataArray> scalars = vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(scalarType));
+        vtkIdType numberOfValues = static_cast<vtkIdType>(dimensions[0]) * dimensions[1] * dimensions[2] * numberOfComponents;
+        if (!scalars || numberOfComponents < 1
+          || message.PayloadSize != static_cast<size_t>(numberOfValues) * scalars->GetDataTypeSize())
+        {
+          vtkErrorMacro("processSharedMemoryLink: Invalid voxels of image " << message.Name);
+          break;
+        }
+        // the array takes over the buffer read from the shared memory, the voxels are not copied again
+        scalars->SetNumberOfComponents(numberOfComponents);
+        scalars->SetVoidArray(message.Payload.release(), numberOfValues, 0, vtkAbstractArray::VTK_DATA_ARRAY_FREE);
+        vtkNew<vtkImageData> image;
+        image->SetDimensions(dimensions);
+        image->GetPointData()->SetScalars(scalars);
+        vtkNew<vtkMatrix4x4> ijkToRAS;
+        ijkToRAS->DeepCopy(elements);
+        this->applyReceivedImage(message.Name, className, image, ijkToRAS);
+        break;
+      }
+      default:
+        vtkWarningMacro("processSharedMemoryLink: Unknown message type " << message.Type);
     }
+    this->CollaborationInternal->ApplyingDirectMessages = false;
+  }
+
+  if (!peerConnected && this->CollaborationInternal->SharedMemoryConnected)
+  {
+    this->CollaborationInternal->SharedMemoryConnected = false;
+    this->InvokeEvent(vtkMRMLIGTLConnectorNode::DisconnectedEvent);
   }
 }
 
 //----------------------------------------------------------------------------
-void vtkMRMLCollaborationConnectorNode::addMarkupsNode(vtkXMLDataElement * res)
+void vtkMRMLCollaborationConnectorNode::pushNodesOnConnect()
 {
-  // read attributes
-  int numberOfAttributes = res->GetNumberOfAttributes();
-  std::vector<const char*> atts_v;
-  for (int attributeIndex = 0; attributeIndex < numberOfAttributes; attributeIndex++)
+  // done by OpenIGTLinkIF for the OpenIGTLink connections
+  int numberOfOutgoingNodes = this->GetNumberOfOutgoingMRMLNodes();
+  for (int nodeIndex = 0; nodeIndex < numberOfOutgoingNodes; nodeIndex++)
   {
-    const char* attName = res->GetAttributeName(attributeIndex);
-    const char* attValue = res->GetAttribute(attName);
-    atts_v.push_back(attName);
-    atts_v.push_back(attValue);
+    vtkMRMLNode* node = this->GetOutgoingMRMLNode(nodeIndex);
+    const char* pushOnConnect = node ? node->GetAttribute("OpenIGTLinkIF.pushOnConnect") : nullptr;
+    if (pushOnConnect && strcmp(pushOnConnect, "true") == 0)
+    {
+      this->SendNode(node);
+    }
   }
-  atts_v.push_back(nullptr);
-  const char** atts = (atts_v.data());
-
-  // get control points attribute
-  std::string controlPointsStr = res->GetAttribute("ControlPoints");
+}
 
-  // get every control point, separated by ;
-  std::vector<std::string> vectControlPoints;
-  std::stringstream ss2(controlPointsStr);
-  while (ss2.good())
-  {
-    std::string substr;
-    getline(ss2, substr, ';');
-    vectControlPoints.push_back(substr);
-  }
-  std::vector<vtkMRMLMarkupsNode::ControlPoint*> ControlPointsList;
-  for (int controlPointIndex = 0; controlPointIndex < vectControlPoints.size(); controlPointIndex++)
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::sendSharedMemoryNode(vtkMRMLNode* node)
+{
+  vtkCollaborationSharedMemoryLink* link = this->CollaborationInternal->SharedMemoryLink.get();
+  if (!link || !node || !node->GetName() || !this->CollaborationInternal->SharedMemoryConnected)
   {
-    // get string of control point
-    std::string token = vectControlPoints[controlPointIndex];
-    // remove brackets
-    std::string brackets = "[]";
-    for (char c : brackets)
-    {
-      token.erase(std::remove(token.begin(), token.end(), c), token.end());
-    }
-    // get every coordinate
-    std::stringstream ss(token);
-    std::vector<std::string> vect;
-    while (ss.good())
-    {
-      std::string substr;
-      getline(ss, substr, ',');
-      vect.push_back(substr);
-    }
-    // add control point to list
-    vtkMRMLMarkupsNode::ControlPoint* newControlPoint = new vtkMRMLMarkupsNode::ControlPoint;
-    newControlPoint->Position[0] = atof(vect[0].c_str());
-    newControlPoint->Position[1] = atof(vect[1].c_str());
-    newControlPoint->Position[2] = atof(vect[2].c_str());
-    newControlPoint->PositionStatus = true;
-    ControlPointsList.push_back(newControlPoint);
+    return false;
   }
-  // see if node exists
-  const char* nodeName = res->GetAttribute("name");
-  std::string className = res->GetAttribute("ClassName");
-  vtkMRMLNode* exisitingNode = vtkMRMLNode::SafeDownCast(this->GetScene()->GetFirstNodeByName(nodeName));
-  std::string existingNodeClassName = "";
-  bool nodeExists = false;
-  if (exisitingNode)
+  std::map<std::string, std::string> metaData;
+  metaData["ClassName"] = node->GetClassName();
+  bool sent = false;
+  if (vtkMRMLTextNode* textNode = vtkMRMLTextNode::SafeDownCast(node))
   {
-    existingNodeClassName = exisitingNode->GetClassName();
+    std::string text = textNode->GetText() ? textNode->GetText() : "";
+    metaData["Encoding"] = std::to_string(textNode->GetEncoding());
+    sent = link->WriteMessage(vtkCollaborationSharedMemoryLink::MessageText, node->GetName(), EncodeMetaData(metaData),
+      text.c_str(), text.size());
   }
-  if (strcmp(className.c_str(), existingNodeClassName.c_str()) == 0)
+  else if (vtkMRMLLinearTransformNode* transformNode = vtkMRMLLinearTransformNode::SafeDownCast(node))
   {
-    nodeExists = true;
+    vtkNew<vtkMatrix4x4> matrix;
+    transformNode->GetMatrixTransformToParent(matrix);
+    sent = link->WriteMessage(vtkCollaborationSharedMemoryLink::MessageTransform, node->GetName(), EncodeMetaData(metaData),
+      reinterpret_cast<const char*>(matrix->GetData()), 16 * sizeof(double));
   }
-  if (className == "vtkMRMLMarkupsFiducialNode")
+  else if (vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(node))
   {
-    vtkMRMLMarkupsFiducialNode* markupsNodeFinal;
-    if (nodeExists)
-    {
-      markupsNodeFinal = vtkMRMLMarkupsFiducialNode::SafeDownCast(this->GetScene()->GetFirstNodeByName(nodeName));
-    }
-    else
+    if (!modelNode->GetPolyData())
     {
-      markupsNodeFinal = vtkMRMLMarkupsFiducialNode::New();
+      return false;
     }
-    // apply attributes
-    markupsNodeFinal->ReadXMLAttributes(atts);
-    // apply control points
-    int numberOfControlPoints = ControlPointsList.size();
-    markupsNodeFinal->RemoveAllControlPoints();
-    for (int cp = 0; cp < numberOfControlPoints; cp++)
+    // raw arrays appended to a short XML header, read back without decoding
+    vtkNew<vtkXMLPolyDataWriter> writer;
+    writer->SetInputData(modelNode->GetPolyData());
+    writer->SetDataModeToAppended();
+    writer->EncodeAppendedDataOff();
+    writer->SetCompressorTypeToNone();
+    writer->WriteToOutputStringOn();
+    if (!writer->Write())
     {
-      markupsNodeFinal->AddControlPoint(ControlPointsList[cp], true);
+      vtkErrorMacro("sendSharedMemoryNode: Failed to write the mesh of " << node->GetName());
+      return false;
     }
-    this->GetScene()->AddNode(markupsNodeFinal);
-    markupsNodeFinal->UpdateAllMeasurements();
+    metaData[LevelOfDetailMetaDataKey] = LevelOfDetailFull;
+    const std::string& meshData = writer->GetOutputString();
+    sent = link->WriteMessage(vtkCollaborationSharedMemoryLink::MessagePolyData, node->GetName(), EncodeMetaData(metaData),
+      meshData.data(), meshData.size());
   }
-  else if (className == "vtkMRMLMarkupsLineNode")
+  else if (vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(node))
   {
-    vtkMRMLMarkupsLineNode* markupsNodeFinal;
-    if (nodeExists)
-    {
-      markupsNodeFinal = vtkMRMLMarkupsLineNode::SafeDownCast(this->GetScene()->GetFirstNodeByName(nodeName));
-    }
-    else
+    vtkImageData* image = volumeNode->GetImageData();
+    if (!vtkCollaborationImageDelta::HasVoxels(image))
     {
-      markupsNodeFinal = vtkMRMLMarkupsLineNode::New();
+      return false;
     }
-    // apply attributes
-    markupsNodeFinal->ReadXMLAttributes(atts);
-    // apply control points
-    int numberOfControlPoints = ControlPointsList.size();
-    markupsNodeFinal->RemoveAllControlPoints();
-    for (int cp = 0; cp < numberOfControlPoints; cp++)
+    int* dimensions = image->GetDimensions();
+    vtkNew<vtkMatrix4x4> ijkToRAS;
+    volumeNode->GetIJKToRASMatrix(ijkToRAS);
+    std::stringstream ss;
+    ss << std::setprecision(17);
+    for (int i = 0; i < 4; i++)
     {
-      markupsNodeFinal->AddControlPoint(ControlPointsList[cp], true);
+      for (int j = 0; j < 4; j++)
+      {
+        ss << ijkToRAS->GetElement(i, j) << ((i == 3 && j == 3) ? "" : " ");
+      }
     }
-    this->GetScene()->AddNode(markupsNodeFinal);
-    markupsNodeFinal->UpdateAllMeasurements();
+    metaData["IJKToRAS"] = ss.str();
+    metaData["Dimensions"] = std::to_string(dimensions[0]) + " " + std::to_string(dimensions[1]) + " " + std::to_string(dimensions[2]);
+    metaData["ScalarType"] = std::to_string(image->GetScalarType());
+    metaData["NumberOfComponents"] = std::to_string(image->GetNumberOfScalarComponents());
+    // the voxels are copied from the image into the ring
+    size_t imageSize = static_cast<size_t>(image->GetNumberOfPoints()) * image->GetNumberOfScalarComponents() * image->GetScalarSize();
+    sent = link->WriteMessage(vtkCollaborationSharedMemoryLink::MessageImage, node->GetName(), EncodeMetaData(metaData),
+      static_cast<const char*>(image->GetScalarPointer()), imageSize);
   }
-  else if (className == "vtkMRMLMarkupsPlaneNode")
+  else
   {
-    vtkMRMLMarkupsPlaneNode* markupsNodeFinal;
-    if (nodeExists)
-    {
-      markupsNodeFinal = vtkMRMLMarkupsPlaneNode::SafeDownCast(this->GetScene()->GetFirstNodeByName(nodeName));
-    }
-    else
-    {
-      markupsNodeFinal = vtkMRMLMarkupsPlaneNode::New();
-    }
-    // apply attributes
-    markupsNodeFinal->ReadXMLAttributes(atts);
-    // apply control points
-    int numberOfControlPoints = ControlPointsList.size();
-    markupsNodeFinal->RemoveAllControlPoints();
-    for (int cp = 0; cp < numberOfControlPoints; cp++)
-    {
-      markupsNodeFinal->AddControlPoint(ControlPointsList[cp], true);
-    }
-    this->GetScene()->AddNode(markupsNodeFinal);
-    markupsNodeFinal->UpdateAllMeasurements();
+    vtkWarningMacro("sendSharedMemoryNode: Nodes of class " << node->GetClassName() << " are not sent through the shared memory");
+    return false;
   }
-  else if (className == "vtkMRMLMarkupsAngleNode")
+  if (!sent)
   {
-    vtkMRMLMarkupsAngleNode* markupsNodeFinal;
-    if (nodeExists)
-    {
-      markupsNodeFinal = vtkMRMLMarkupsAngleNode::SafeDownCast(this->GetScene()->GetFirstNodeByName(nodeName));
-    }
-    else
-    {
-      markupsNodeFinal = vtkMRMLMarkupsAngleNode::New();
-    }
-    // apply attributes
-    markupsNodeFinal->ReadXMLAttributes(atts);
-    // apply control points
-    int numberOfControlPoints = ControlPointsList.size();
-    markupsNodeFinal->RemoveAllControlPoints();
-    for (int cp = 0; cp < numberOfControlPoints; cp++)
-    {
-      markupsNodeFinal->AddControlPoint(ControlPointsList[cp], true);
-    }
-    this->GetScene()->AddNode(markupsNodeFinal);
-    markupsNodeFinal->UpdateAllMeasurements();
+    vtkErrorMacro("sendSharedMemoryNode: Failed to send " << node->GetName() << " through the shared memory");
   }
-  else if (className == "vtkMRMLMarkupsCurveNode")
+  return sent;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::sendSharedMemoryText(const std::string& deviceName, const std::string& text, int encoding)
+{
+  vtkCollaborationSharedMemoryLink* link = this->CollaborationInternal->SharedMemoryLink.get();
+  if (!link || !this->CollaborationInternal->SharedMemoryConnected)
   {
-    vtkMRMLMarkupsCurveNode* markupsNodeFinal;
-    if (nodeExists)
-    {
-      markupsNodeFinal = vtkMRMLMarkupsCurveNode::SafeDownCast(this->GetScene()->GetFirstNodeByName(nodeName));
-    }
-    else
-    {
-      markupsNodeFinal = vtkMRMLMarkupsCurveNode::New();
-    }
-    // apply attributes
-    markupsNodeFinal->ReadXMLAttributes(atts);
-    // apply control points
-    int numberOfControlPoints = ControlPointsList.size();
-    markupsNodeFinal->RemoveAllControlPoints();
-    for (int cp = 0; cp < numberOfControlPoints; cp++)
-    {
-      markupsNodeFinal->AddControlPoint(ControlPointsList[cp], true);
-    }
-    this->GetScene()->AddNode(markupsNodeFinal);
-    markupsNodeFinal->UpdateAllMeasurements();
+    return false;
   }
-  else if (className == "vtkMRMLMarkupsClosedCurveNode")
+  std::map<std::string, std::string> metaData;
+  metaData["Encoding"] = std::to_string(encoding);
+  if (!link->WriteMessage(vtkCollaborationSharedMemoryLink::MessageText, deviceName, EncodeMetaData(metaData),
+    text.c_str(), text.size()))
   {
-    vtkMRMLMarkupsClosedCurveNode* markupsNodeFinal;
-    if (nodeExists)
-    {
-      markupsNodeFinal = vtkMRMLMarkupsClosedCurveNode::SafeDownCast(this->GetScene()->GetFirstNodeByName(nodeName));
-    }
-    else
-    {
-      markupsNodeFinal = vtkMRMLMarkupsClosedCurveNode::New();
-    }
-    // apply attributes
-    markupsNodeFinal->ReadXMLAttributes(atts);
-    // apply control points
-    int numberOfControlPoints = ControlPointsList.size();
-    markupsNodeFinal->RemoveAllControlPoints();
-    for (int cp = 0; cp < numberOfControlPoints; cp++)
-    {
-      markupsNodeFinal->AddControlPoint(ControlPointsList[cp], true);
-    }
-    this->GetScene()->AddNode(markupsNodeFinal);
-    markupsNodeFinal->UpdateAllMeasurements();
+    vtkErrorMacro("sendSharedMemoryText: Failed to send " << deviceName << " through the shared memory");
+    return false;
   }
-  else if (className == "vtkMRMLMarkupsROINode")
+  return true;
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLNode* vtkMRMLCollaborationConnectorNode::getReceivedNode(const std::string& nodeName, const std::string& className,
+  const char* baseClassName, vtkSmartPointer<vtkMRMLNode>& newNode)
+{
+  vtkMRMLScene* scene = this->GetScene();
+  if (!scene || nodeName.empty())
   {
-    vtkMRMLMarkupsROINode* markupsNodeFinal;
-    if (nodeExists)
-    {
-      markupsNodeFinal = vtkMRMLMarkupsROINode::SafeDownCast(this->GetScene()->GetFirstNodeByName(nodeName));
-    }
-    else
-    {
-      markupsNodeFinal = vtkMRMLMarkupsROINode::New();
-    }
+    return nullptr;
+  }
+  vtkMRMLNode* node = scene->GetFirstNode(nodeName.c_str(), baseClassName);
+  if (node)
+  {
+    return node;
+  }
+  newNode = vtkSmartPointer<vtkMRMLNode>::Take(scene->CreateNodeByClass(className.empty() ? baseClassName : className.c_str()));
+  if (!newNode || !newNode->IsA(baseClassName))
+  {
+    vtkErrorMacro("getReceivedNode: Invalid class " << className << " of the received node " << nodeName);
+    newNode = nullptr;
+    return nullptr;
+  }
+  newNode->SetName(nodeName.c_str());
+  // mark it as received so that it is added to the synchronized nodes
+  newNode->SetDescription("Received by OpenIGTLink");
+  return newNode;
+}
 
-    // get ROI radius attribute
-    std::string ROIRadiusStr = res->GetAttribute("ROIRadius");
-    // remove brackets
-    std::string brackets = "[]";
-    for (char c : brackets)
-    {
-      ROIRadiusStr.erase(std::remove(ROIRadiusStr.begin(), ROIRadiusStr.end(), c), ROIRadiusStr.end());
-    }
-    // get every coordinate
-    std::stringstream ss(ROIRadiusStr);
-    std::vector<std::string> vect;
-    while (ss.good())
-    {
-      std::string substr;
-      getline(ss, substr, ',');
-      vect.push_back(substr);
-    }
-    // apply attributes
-    markupsNodeFinal->ReadXMLAttributes(atts);
-    // apply control points
-    int numberOfControlPoints = ControlPointsList.size();
-    markupsNodeFinal->RemoveAllControlPoints();
-    for (int cp = 0; cp < numberOfControlPoints; cp++)
-    {
-      markupsNodeFinal->AddControlPoint(ControlPointsList[cp], true);
-    }
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::addReceivedNode(vtkMRMLNode* node)
+{
+  // added with its content, so that the synchronized node is complete when it is registered
+  this->GetScene()->AddNode(node);
+  vtkMRMLDisplayableNode* displayableNode = vtkMRMLDisplayableNode::SafeDownCast(node);
+  if (displayableNode)
+  {
+    displayableNode->CreateDefaultDisplayNodes();
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::applyReceivedText(const std::string& deviceName, const std::string& text, int encoding)
+{
+  // same handling as the string messages
+  if (this->handleConnectorMessage(deviceName, text, encoding) || this->handleTextMessage(text, encoding))
+  {
+    return;
+  }
+  vtkSmartPointer<vtkMRMLNode> newNode;
+  vtkMRMLTextNode* textNode = vtkMRMLTextNode::SafeDownCast(
+    this->getReceivedNode(deviceName, "vtkMRMLTextNode", "vtkMRMLTextNode", newNode));
+  if (!textNode)
+  {
+    return;
+  }
+  textNode->SetEncoding(encoding);
+  textNode->SetText(text.c_str());
+  if (newNode)
+  {
+    this->addReceivedNode(newNode);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::applyReceivedTransform(const std::string& nodeName, const std::string& className,
+  vtkMatrix4x4* matrix)
+{
+  vtkSmartPointer<vtkMRMLNode> newNode;
+  vtkMRMLLinearTransformNode* transformNode = vtkMRMLLinearTransformNode::SafeDownCast(
+    this->getReceivedNode(nodeName, className, "vtkMRMLLinearTransformNode", newNode));
+  if (!transformNode)
+  {
+    return;
+  }
+  transformNode->SetMatrixTransformToParent(matrix);
+  if (newNode)
+  {
+    this->addReceivedNode(newNode);
+  }
+  // see if the transformed nodes metadata was already received and if so, apply it
+  auto metadataIt = this->CollaborationInternal->KeptMetadata.find(nodeName);
+  if (metadataIt != this->CollaborationInternal->KeptMetadata.end())
+  {
+    vtkSmartPointer<vtkXMLDataElement> metadata = metadataIt->second;
+    this->handleSynchronizationMessage(metadata);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::applyReceivedPolyData(const std::string& nodeName, const std::string& className,
+  vtkPolyData* polyData, const std::string& levelOfDetail)
+{
+  vtkSmartPointer<vtkMRMLNode> newNode;
+  vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(
+    this->getReceivedNode(nodeName, className, "vtkMRMLModelNode", newNode));
+  if (!modelNode)
+  {
+    return;
+  }
+  modelNode->SetAndObservePolyData(polyData);
+  if (!levelOfDetail.empty())
+  {
+    modelNode->SetAttribute(LevelOfDetailAttributeName, levelOfDetail.c_str());
+  }
+  if (newNode)
+  {
+    this->addReceivedNode(newNode);
+  }
+  // see if the display node was already defined
+  this->updateModelDisplayNode(modelNode);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLCollaborationConnectorNode::applyReceivedImage(const std::string& nodeName, const std::string& className,
+  vtkImageData* image, vtkMatrix4x4* ijkToRAS)
+{
+  vtkSmartPointer<vtkMRMLNode> newNode;
+  vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(
+    this->getReceivedNode(nodeName, className, "vtkMRMLScalarVolumeNode", newNode));
+  if (!volumeNode)
+  {
+    return;
+  }
+  int wasModifying = volumeNode->StartModify();
+  volumeNode->SetIJKToRASMatrix(ijkToRAS);
+  volumeNode->SetAndObserveImageData(image);
+  volumeNode->EndModify(wasModifying);
+  if (newNode)
+  {
+    this->addReceivedNode(newNode);
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkMRMLCollaborationConnectorNode::GetNumberOfSentPoseDatagrams()
+{
+  vtkCollaborationPoseChannel* poseChannel = this->CollaborationInternal->PoseChannel.get();
+  return poseChannel ? poseChannel->GetNumberOfSentPoses() : 0;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkMRMLCollaborationConnectorNode::GetNumberOfReceivedPoseDatagrams()
+{
+  vtkCollaborationPoseChannel* poseChannel = this->CollaborationInternal->PoseChannel.get();
+  return poseChannel ? poseChannel->GetNumberOfReceivedPoses() : 0;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkMRMLCollaborationConnectorNode::GetNumberOfDroppedPoseDatagrams()
+{
+  vtkCollaborationPoseChannel* poseChannel = this->CollaborationInternal->PoseChannel.get();
+  return poseChannel ? poseChannel->GetNumberOfDroppedPoses() : 0;
+}
 
-    // apply ROI radius
-    double ROIrad[3] = { 0.0 };
-    ROIrad[0] = std::stod(vect[0].c_str());
-    ROIrad[1] = std::stod(vect[1].c_str());
-    ROIrad[2] = std::stod(vect[2].c_str());
-    markupsNodeFinal->SetRadiusXYZ(ROIrad);
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkMRMLCollaborationConnectorNode::GetNumberOfRepeatedPoseDatagrams()
+{
+  vtkCollaborationPoseChannel* poseChannel = this->CollaborationInternal->PoseChannel.get();
+  return poseChannel ? poseChannel->GetNumberOfRepeatedPoses() : 0;
+}
 
-    this->GetScene()->AddNode(markupsNodeFinal);
-    markupsNodeFinal->UpdateAllMeasurements();
+//----------------------------------------------------------------------------
+bool vtkMRMLCollaborationConnectorNode::sendPoseDatagram(vtkMRMLNode* node, unsigned long event)
+{
+  vtkMRMLLinearTransformNode* transformNode = vtkMRMLLinearTransformNode::SafeDownCast(node);
+  if (event != vtkMRMLTransformableNode::TransformModifiedEvent || !transformNode || !transformNode->GetID()
+    || !transformNode->GetName() || this->GetState() != vtkMRMLIGTLConnectorNode::StateConnected
+    || !this->IsPoseDatagramDeliveryUsed())
+  {
+    return false;
   }
+  vtkNew<vtkMatrix4x4> matrix;
+  transformNode->GetMatrixTransformToParent(matrix);
+  if (!this->CollaborationInternal->PoseChannel->SendPose(transformNode->GetName(), &matrix->Element[0][0]))
+  {
+    return false;
+  }
+  this->CollaborationInternal->PoseDatagramNodeIDs.insert(transformNode->GetID());
+  return true;
 }
 
 //----------------------------------------------------------------------------
-void vtkMRMLCollaborationConnectorNode::addDisplayNode(vtkXMLDataElement * res)
+void vtkMRMLCollaborationConnectorNode::processPoseDatagrams()
 {
-  std::vector<const char*> atts_v;
-  int numberOfAttributes = res->GetNumberOfAttributes();
-  for (int attributeIndex = 0; attributeIndex < numberOfAttributes; attributeIndex++)
+  vtkCollaborationPoseChannel* poseChannel = this->CollaborationInternal->PoseChannel.get();
+  if (!poseChannel || !this->GetScene())
   {
-    const char* attName = res->GetAttributeName(attributeIndex);
-    const char* attValue = res->GetAttribute(attName);
-    atts_v.push_back(attName);
-    atts_v.push_back(attValue);
+    return;
   }
-  atts_v.push_back(nullptr);
-  const char** atts = (atts_v.data());
-  // get the display node from the corresponding model
-  const char* nodeName = res->GetAttribute("NodeName");
-  // get node type
-  const char* className = res->GetAttribute("ClassName");
-  if (strcmp(className, "vtkMRMLModelDisplayNode") == 0)
+  bool reachable = poseChannel->IsPeerReachable();
+  if (!reachable && this->CollaborationInternal->PoseChannelReachable)
   {
-    vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(this->GetScene()->GetFirstNodeByName(nodeName));
-    // if the model already exists in the scene, apply the display node
-    if (modelNode)
+    // the last poses sent before the channel was found blocked may be lost, send them reliably
+    vtkWarningMacro("processPoseDatagrams: The pose datagrams do not reach the peer, the poses are pushed through OpenIGTLink");
+    std::set<std::string> nodeIDs;
+    nodeIDs.swap(this->CollaborationInternal->PoseDatagramNodeIDs);
+    for (const std::string& nodeID : nodeIDs)
     {
-      vtkMRMLModelDisplayNode* currentDisplayNode = modelNode->GetModelDisplayNode();
-      if (currentDisplayNode)
+      vtkMRMLNode* node = this->GetScene()->GetNodeByID(nodeID);
+      if (node && this->isOutgoingNode(node) && this->GetState() == vtkMRMLIGTLConnectorNode::StateConnected)
       {
-        // create display node and apply attributes
-        vtkMRMLModelDisplayNode* newDisplayNode = vtkMRMLModelDisplayNode::New();
-        newDisplayNode->ReadXMLAttributes(atts);
-        // copy display node attributes to the current display node
-        currentDisplayNode->Copy(newDisplayNode);
-        // set name
-        char displayName[] = "DisplayNode";
-        char* displayNodeName = new char[std::strlen(nodeName) + std::strlen(displayName) + 1];
-        std::strcpy(displayNodeName, nodeName);
-        std::strcat(displayNodeName, displayName);
-        currentDisplayNode->SetName(displayNodeName);
-        currentDisplayNode->Modified();
-        modelNode->Modified();
+        this->PushNode(node);
       }
     }
-    else
-    {
-      vtkMRMLModelDisplayNode* displayNode = vtkMRMLModelDisplayNode::New();
-      // apply attributes
-      displayNode->ReadXMLAttributes(atts);
-      // set name
-      char displayName[] = "DisplayNode";
-      char* displayNodeName = new char[std::strlen(nodeName) + std::strlen(displayName) + 1];
-      std::strcpy(displayNodeName, nodeName);
-      std::strcat(displayNodeName, displayName);
-      displayNode->SetName(displayNodeName);
-      // add display node to scene
-      this->GetScene()->AddNode(displayNode);
-      displayNode->Modified();
-    }
   }
-  if (strcmp(className, "vtkMRMLMarkupsDisplayNode") == 0)
+  else if (reachable && !this->CollaborationInternal->PoseChannelReachable)
   {
-    vtkMRMLMarkupsNode* markupsNode = vtkMRMLMarkupsNode::SafeDownCast(this->GetScene()->GetFirstNodeByName(nodeName));
-    // if the model already exists in the scene, apply the display node
-    if (markupsNode)
-    {
-      vtkMRMLMarkupsDisplayNode* currentDisplayNode = markupsNode->GetMarkupsDisplayNode();
-      if (currentDisplayNode)
-      {
-        // create display node and apply attributes
-        vtkMRMLMarkupsDisplayNode* newDisplayNode = vtkMRMLMarkupsDisplayNode::New();
-        newDisplayNode->ReadXMLAttributes(atts);
-        // copy display node attributes to the current display node
-        currentDisplayNode->Copy(newDisplayNode);
-        // set name
-        char displayName[] = "DisplayNode";
-        char* displayNodeName = new char[std::strlen(nodeName) + std::strlen(displayName) + 1];
-        std::strcpy(displayNodeName, nodeName);
-        std::strcat(displayNodeName, displayName);
-        currentDisplayNode->SetName(displayNodeName);
-        currentDisplayNode->Modified();
-        markupsNode->Modified();
-      }
-    }
-    else
+    vtkDebugMacro("processPoseDatagrams: The poses are sent as datagrams");
+  }
+  this->CollaborationInternal->PoseChannelReachable = reachable;
+  if (!reachable)
+  {
+    this->CollaborationInternal->PoseDatagramNodeIDs.clear();
+  }
+
+  vtkCollaborationPoseChannel::Pose pose;
+  while (poseChannel->PopPose(pose))
+  {
+    this->CollaborationInternal->LastTrafficTime = std::chrono::steady_clock::now();
+    // the transform is created by its first push through OpenIGTLink, the poses only update it
+    if (!this->GetScene()->GetFirstNode(pose.Name.c_str(), "vtkMRMLLinearTransformNode"))
     {
-      vtkMRMLMarkupsDisplayNode* displayNode = vtkMRMLMarkupsDisplayNode::New();
-      // apply attributes
-      displayNode->ReadXMLAttributes(atts);
-      // set name
-      char displayName[] = "DisplayNode";
-      char* displayNodeName = new char[std::strlen(nodeName) + std::strlen(displayName) + 1];
-      std::strcpy(displayNodeName, nodeName);
-      std::strcat(displayNodeName, displayName);
-      displayNode->SetName(displayNodeName);
-      // add display node to scene
-      this->GetScene()->AddNode(displayNode);
-      displayNode->Modified();
+      continue;
     }
+    vtkNew<vtkMatrix4x4> matrix;
+    matrix->DeepCopy(pose.Matrix);
+    this->CollaborationInternal->ApplyingDirectMessages = true;
+    this->applyReceivedTransform(pose.Name, "vtkMRMLLinearTransformNode", matrix);
+    this->CollaborationInternal->ApplyingDirectMessages = false;
   }
 }
-
-
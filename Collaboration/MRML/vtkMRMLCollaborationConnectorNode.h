@@ -26,11 +26,20 @@
 #include "vtkMRMLIGTLConnectorNode.h"
 
 // VTK includes
+#include <vtkSmartPointer.h>
 #include <vtkXMLDataElement.h>
 
 // Collaboration includes
 #include "vtkSlicerCollaborationModuleMRMLExport.h"
 
+class vtkCollaborationContentCache;
+class vtkCollaborationRelayHub;
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkMRMLModelNode;
+class vtkMRMLScalarVolumeNode;
+class vtkPolyData;
+
 class VTK_SLICER_COLLABORATION_MODULE_MRML_EXPORT vtkMRMLCollaborationConnectorNode : public vtkMRMLIGTLConnectorNode
 {
 public:
@@ -53,19 +62,419 @@ public:
   /// \sa vtkMRMLNode::CopyContent
   vtkMRMLCopyContentMacro(vtkMRMLCollaborationConnectorNode);
 
+  /// Send a decimated proxy of model nodes before their full resolution mesh
+  vtkGetMacro(ProgressiveModelDelivery, bool);
+  vtkSetMacro(ProgressiveModelDelivery, bool);
+  vtkBooleanMacro(ProgressiveModelDelivery, bool);
+
+  /// Fraction of the triangles removed when building a model proxy (0.97 keeps 3% of the triangles)
+  vtkGetMacro(ProxyTargetReduction, double);
+  vtkSetClampMacro(ProxyTargetReduction, double, 0.0, 0.999);
+
+  /// Models with fewer cells than this are always pushed at full resolution
+  vtkGetMacro(ProxyMinimumNumberOfCells, int);
+  vtkSetMacro(ProxyMinimumNumberOfCells, int);
+
+  /// Push a node to the connection. If progressive model delivery is enabled, the proxy of a model node
+  /// is built on a worker thread and pushed from ProcessPendingTasks, followed by the full resolution mesh.
+  /// If progressive volume delivery is enabled, large volumes are streamed from ProcessPendingTasks.
+  int PushNodeProgressive(vtkMRMLNode* node);
+
+  /// Perform the deferred work of the connector, such as pushing the model proxies that are ready.
+  /// The data received since the previous call is imported first. Called by the collaboration logic when the node
+  /// requests it, and periodically while IsProcessingNeeded returns true.
+  void ProcessPendingTasks();
+
+  /// Function scheduling a call of ProcessPendingTasks on the main thread, for example by posting an event.
+  /// It may be called from any thread, and must return without processing anything.
+  typedef void (*WakeUpCallbackType)(void* clientData);
+  /// Set the function called when the node has work to do. Set by the collaboration logic.
+  void SetWakeUpCallback(WakeUpCallbackType callback, void* clientData);
+  /// Request a call of ProcessPendingTasks as soon as possible. Thread safe: the worker threads call it when their
+  /// result is ready. The requests made before the call are merged into one wake-up.
+  void RequestProcessing();
+  /// Return true while ProcessPendingTasks needs to be called periodically: the connection is established, so that
+  /// the received data is imported, or some work is still in progress.
+  bool IsProcessingNeeded();
+  /// Return the interval of the periodic calls of ProcessPendingTasks, in seconds: 5 ms while work is in progress
+  /// or data is exchanged, growing up to 100 ms while the connection is idle.
+  double GetProcessingInterval();
+
+  /// Cache the received meshes and images on disk, keyed by the hash of their content.
+  /// Model and volume nodes are then offered by hash, and their content is only sent if the peer does not have it.
+  vtkGetMacro(ContentCacheEnabled, bool);
+  vtkSetMacro(ContentCacheEnabled, bool);
+  vtkBooleanMacro(ContentCacheEnabled, bool);
+
+  /// Directory of the content cache
+  vtkSetStdStringFromCharMacro(ContentCacheDirectory);
+  vtkGetCharFromStdStringMacro(ContentCacheDirectory);
+
+  /// Maximum size of the content cache in megabytes. The least recently used content is removed above this size.
+  vtkGetMacro(ContentCacheMaximumSize, int);
+  vtkSetMacro(ContentCacheMaximumSize, int);
+
+  /// Get the content cache, configured with the cache settings of the node
+  vtkCollaborationContentCache* GetContentCache();
+
+  /// Offer the content of a model or volume node by its hash. The peer requests the content if it is not in its cache.
+  /// Other nodes, and all nodes if the content cache is disabled, are pushed directly.
+  int OfferNode(vtkMRMLNode* node);
+
+  /// Return true if the node is sent through a content offer
+  bool IsNodeContentOffered(vtkMRMLNode* node);
+
+  /// Return true if the node is a head or hand transform of the local VR hardware, named "VirtualReality.HMD",
+  /// "VirtualReality.LeftController" or "VirtualReality.RightController". All the participants have the same names,
+  /// so these transforms are sent as the pose nodes of the participant, named after its participant ID, such as
+  /// "Participant1a2b3c.HMD". The pose nodes are offered on connect, when the participant joins a session.
+  static bool IsLocalPoseNode(vtkMRMLNode* node);
+  /// Identifier of the participant in the session, which qualifies the names of its pose nodes
+  std::string GetParticipantID();
+
+  /// Attribute marking the outgoing nodes that are offered when the connection is established
+  static const char* OfferOnConnectAttributeName;
+  /// Prefix of the names of the transforms of the local VR hardware
+  static const char* LocalPoseNamePrefix;
+  /// Prefix of the participant ID in the names of the pose nodes sent to the peers
+  static const char* ParticipantPoseNamePrefix;
+  /// Attribute of the local pose nodes, containing the ID of the transform they mirror. They are not avatars of peers.
+  static const char* ParticipantPoseAttributeName;
+  /// Meta data key of the outgoing polydata and image messages containing the hash of their content
+  static const char* ContentHashMetaDataKey;
+  /// Meta data key of the outgoing string messages telling whether their text is compressed
+  static const char* CompressionMetaDataKey;
+
+  /// Send a message on a named channel of the collaboration connection, such as the chat.
+  /// Channel messages are delivered reliably and in order, also across reconnections. They are sent from
+  /// ProcessPendingTasks after the node updates, so they never delay the transforms pushed by the connector.
+  /// Each message is sent once, and again only if the peer reports a lost bundle or does not acknowledge it in time.
+  /// A message with a state key carries the latest state of something, such as the metadata of a node: it replaces
+  /// the message of the same channel and key that the peer has not acknowledged yet, and is delivered after the
+  /// messages sent before it. Messages without state key, such as the chat, are all delivered.
+  void SendChannelMessage(const char* channelName, const char* message, const char* stateKey = nullptr);
+
+  /// Forget the copy of the pushed image of a volume that is not synchronized anymore, and tell the relay hub, so
+  /// that it stops serving its retained state to the participants joining later. Nothing is sent without relay
+  /// hub or while disconnected.
+  void NotifyNodeRemoved(vtkMRMLNode* node);
+
+  enum
+  {
+    /// Invoked when a channel message is received. The call data is a vtkStringArray with the channel name and the message.
+    ChannelMessageReceivedEvent = 119044,
+    /// Invoked when a participant joins the session of a relay hub. The synchronized nodes are sent again for it.
+    ParticipantJoinedEvent
+  };
+
+  /// Prefix of the devices carrying the channel messages, followed by the type of the sending connector
+  static const char* ChannelDeviceNamePrefix;
+  /// Channel carrying the synchronization metadata of the nodes (display properties, markups control points
+  /// and transformed nodes). Its messages are applied by the connector and kept in memory, not in the scene.
+  static const char* SynchronizationChannelName;
+
+  /// Minimum time in seconds between two computations of the measurements of the markups updated by the peer.
+  /// The enabled measurements of a received markups node are disabled while its updates are streamed, so that they
+  /// are not computed on each update, and enabled again when they are computed at the next interval.
+  vtkGetMacro(MeasurementUpdateInterval, double);
+  vtkSetClampMacro(MeasurementUpdateInterval, double, 0.0, 60.0);
+
+  /// Enable and compute now the stale measurements of the received markups, for example before reading them
+  void UpdateReceivedMeasurements();
+  /// Return true if the measurements of a received markups node have not been computed since its last update.
+  /// They are disabled until then, and have no value.
+  bool IsReceivedMeasurementStale(vtkMRMLNode* node);
+
+  /// Send the synchronization metadata of the node classes that have an attribute schema as binary records
+  /// instead of XML, if the peer supports them. Off by default: the records only carry the attributes of their schema.
+  /// \sa vtkCollaborationAttributeSchema
+  vtkGetMacro(BinaryAttributeEncoding, bool);
+  vtkSetMacro(BinaryAttributeEncoding, bool);
+  vtkBooleanMacro(BinaryAttributeEncoding, bool);
+
+  /// Send only the modified region of outgoing scalar volumes after their image data is modified, instead of
+  /// pushing the whole image again. The full image is pushed first, and again when its geometry changes or when
+  /// most of it is modified. A copy of the last sent image is kept for the comparison from the first modification
+  /// of the volume, which is pushed whole. Only used if the peer supports the volume regions.
+  vtkGetMacro(VolumeDeltaDelivery, bool);
+  vtkSetMacro(VolumeDeltaDelivery, bool);
+  vtkBooleanMacro(VolumeDeltaDelivery, bool);
+
+  /// Compress the modified regions of the volumes with zlib (lossless)
+  vtkGetMacro(VolumeDeltaCompression, bool);
+  vtkSetMacro(VolumeDeltaCompression, bool);
+  vtkBooleanMacro(VolumeDeltaCompression, bool);
+
+  /// Stream large scalar volumes from a coarse level to the full resolution instead of pushing them at once.
+  /// The first level contains one voxel out of 8 along each axis, each next level doubles the resolution.
+  /// The bricks of each level are sent by distance to the slices displayed by the sender.
+  /// Only used if the peer supports the volume streams.
+  vtkGetMacro(ProgressiveVolumeDelivery, bool);
+  vtkSetMacro(ProgressiveVolumeDelivery, bool);
+  vtkBooleanMacro(ProgressiveVolumeDelivery, bool);
+
+  /// Volumes with fewer voxels than this are pushed at once
+  vtkGetMacro(ProgressiveVolumeMinimumNumberOfVoxels, int);
+  vtkSetMacro(ProgressiveVolumeMinimumNumberOfVoxels, int);
+
+  /// Bandwidth in megabits per second used by the volume streams
+  vtkGetMacro(ProgressiveVolumeBandwidth, double);
+  vtkSetClampMacro(ProgressiveVolumeBandwidth, double, 0.1, 100000.0);
+
+  /// Return true if the node is a volume delivered by a progressive stream
+  bool IsVolumeStreamed(vtkMRMLNode* node);
+
+  /// Send the modified region of an outgoing scalar volume since its last push.
+  /// Return false if the whole image needs to be pushed instead.
+  bool PushVolumeDelta(vtkMRMLScalarVolumeNode* volumeNode);
+
+  void ProcessMRMLEvents(vtkObject* caller, unsigned long event, void* callData) override;
+
+  /// Push the outgoing nodes once per call of ProcessPendingTasks with their latest state, instead of after each
+  /// of their modifications. The updates of a node dragged over a slow link do not queue up behind each other.
+  vtkGetMacro(StateUpdateCoalescing, bool);
+  vtkSetMacro(StateUpdateCoalescing, bool);
+  vtkBooleanMacro(StateUpdateCoalescing, bool);
+
+  /// Pack the small text messages sent during a call of ProcessPendingTasks, such as the content offers and the
+  /// channel bundle, into one message of the BundleDeviceName device, unpacked in order by the peer. The volume
+  /// regions and the node pushes are sent on their own. Only used if the peer supports the bundles. It is ignored by
+  /// the participants of a relay hub, which routes the messages by device.
+  vtkGetMacro(MessageBundling, bool);
+  vtkSetMacro(MessageBundling, bool);
+  vtkBooleanMacro(MessageBundling, bool);
+  /// Device of the message bundles
+  static const char* BundleDeviceName;
+
+  /// Compress the text messages larger than the compression threshold, with a codec that the peer supports.
+  /// The connectors tell each other the codecs they can decompress when the connection is established: messages to
+  /// peers that do not send their capabilities are never compressed. Ignored by the participants of a relay hub.
+  /// \sa vtkCollaborationMessageCompression
+  vtkGetMacro(MessageCompression, bool);
+  vtkSetMacro(MessageCompression, bool);
+  vtkBooleanMacro(MessageCompression, bool);
+
+  /// Size in bytes above which the text messages are compressed
+  vtkGetMacro(MessageCompressionThreshold, int);
+  vtkSetMacro(MessageCompressionThreshold, int);
+
+  /// Codecs that the peer can decompress, separated by commas. Empty if the peer has not sent its capabilities.
+  std::string GetPeerCompressionCodecs();
+
+  /// Compression statistics since the node was created: number of compressed messages, their size in bytes before
+  /// and after compression, and the time spent compressing and decompressing in seconds
+  vtkTypeUInt64 GetNumberOfCompressedMessages();
+  vtkTypeUInt64 GetCompressionInputSize();
+  vtkTypeUInt64 GetCompressionOutputSize();
+  double GetCompressionTime();
+  vtkTypeUInt64 GetNumberOfDecompressedMessages();
+  double GetDecompressionTime();
+  /// Size of the compressed messages before compression divided by their size after compression
+  double GetCompressionRatio();
+
+  /// Send the poses of the outgoing linear transforms, such as the avatars and the tracked tools, as UDP datagrams
+  /// next to the OpenIGTLink connection. A lost datagram does not delay the next poses, the older poses are dropped by
+  /// their sequence number. The server receives the datagrams on its port. The poses are pushed through OpenIGTLink
+  /// while the datagrams do not reach the peer, for example if UDP is blocked by a firewall. Only used if the peer
+  /// supports it, and ignored by the participants of a relay hub and by the same host sessions.
+  /// \sa vtkCollaborationPoseChannel
+  vtkGetMacro(PoseDatagramDelivery, bool);
+  vtkSetMacro(PoseDatagramDelivery, bool);
+  vtkBooleanMacro(PoseDatagramDelivery, bool);
+
+  /// Pose datagram statistics since the session started: poses sent and received through UDP, received poses
+  /// dropped because a newer pose of the same transform had already arrived, and repeats of received poses
+  vtkTypeUInt64 GetNumberOfSentPoseDatagrams();
+  vtkTypeUInt64 GetNumberOfReceivedPoseDatagrams();
+  vtkTypeUInt64 GetNumberOfDroppedPoseDatagrams();
+  vtkTypeUInt64 GetNumberOfRepeatedPoseDatagrams();
+
+  /// Device of the capabilities sent when the connection is established
+  static const char* CapabilitiesDeviceName;
+
+  /// Version of the collaboration protocol, sent with the capabilities. The connectors tell each other the features
+  /// they can receive, and each one sends with the enabled options that the peer supports. Peers that send no
+  /// capabilities are assumed to use version 0, the text protocol: XML metadata and whole nodes only.
+  static const int ProtocolVersion = 1;
+  /// Protocol version of the peer, 0 if it has not sent its capabilities
+  int GetPeerProtocolVersion();
+
+  /// Whether an option is used for the messages sent to the peer: it is enabled and the peer supports it.
+  /// The participants of a relay hub do not negotiate with each other, they use the options as they are enabled.
+  bool IsBinaryAttributeEncodingUsed();
+  bool IsVolumeDeltaDeliveryUsed();
+  bool IsProgressiveVolumeDeliveryUsed();
+  bool IsMessageBundlingUsed();
+  /// Also requires the datagrams to reach the peer
+  bool IsPoseDatagramDeliveryUsed();
+
+  /// Names of the features sent in the capabilities
+  static const char* BinaryAttributeEncodingFeature;
+  static const char* VolumeDeltaFeature;
+  static const char* ProgressiveVolumeFeature;
+  static const char* MessageBundlingFeature;
+  static const char* PoseDatagramFeature;
+
+  /// Collaborate with any number of participants through a relay hub instead of a single peer.
+  /// A server node starts the hub on its port when the session starts, and joins it as one of the participants.
+  /// Client nodes connect to the hub as usual, and must enable this option too: each participant then sends its
+  /// channel messages on its own device, acknowledged by the hub.
+  /// \sa vtkCollaborationRelayHub
+  vtkGetMacro(RelayHub, bool);
+  vtkSetMacro(RelayHub, bool);
+  vtkBooleanMacro(RelayHub, bool);
+
+  /// Collaborate with another application running on the same host through shared memory instead of OpenIGTLink,
+  /// whatever the type of the node. Both applications enable this option with the same server port, which names the
+  /// shared memory of the session. The meshes and images are copied into shared memory without being serialized as
+  /// OpenIGTLink messages. Cannot be combined with a relay hub.
+  /// \sa vtkCollaborationSharedMemoryLink
+  vtkGetMacro(SameHostTransport, bool);
+  vtkSetMacro(SameHostTransport, bool);
+  vtkBooleanMacro(SameHostTransport, bool);
+
+  /// Start the connection of the session, starting the relay hub first if the node is a server of a relay hub
+  int StartSession();
+  /// Stop the connection of the session and the relay hub started by the node
+  int StopSession();
+  /// Relay hub started by the node
+  vtkCollaborationRelayHub* GetRelayHub();
+  /// Return true if the peer is connected, through OpenIGTLink or through the shared memory of a same host session
+  bool IsSessionConnected();
+  /// Push a node through the transport of the session: the shared memory of a same host session, OpenIGTLink otherwise
+  int SendNode(vtkMRMLNode* node);
+
+  /// Apply the received metadata that may refer to new nodes again, such as the transformed nodes of the received
+  /// transforms. Called when new nodes have been received.
+  void UpdateReceivedTransforms();
+
+  /// Meta data key of the outgoing polydata messages, set to LevelOfDetailProxy or LevelOfDetailFull
+  static const char* LevelOfDetailMetaDataKey;
+  static const char* LevelOfDetailProxy;
+  static const char* LevelOfDetailFull;
+  /// Attribute set on received model nodes to indicate whether they contain the proxy or the full mesh
+  static const char* LevelOfDetailAttributeName;
+
 protected:
   unsigned int AssignOutGoingNodeToDevice(vtkMRMLNode* node, igtlioDevicePointer device) override;
   vtkMRMLNode* CreateNewMRMLNodeForDevice(igtlioDevice* device) override;
   void ProcessIncomingDeviceModifiedEvent(vtkObject* caller, unsigned long event, igtlioDevice* modifiedDevice) override;
-  void addMarkupsNode(vtkXMLDataElement* res);
-  void addDisplayNode(vtkXMLDataElement* res);
-  void orderTransforms(vtkXMLDataElement* res);
+  /// Apply the synchronization metadata of a node. Return false if the element is not synchronization metadata.
+  bool handleSynchronizationMessage(vtkXMLDataElement* res);
+  /// Apply synchronization metadata received as XML or as a binary attribute record
+  bool handleSynchronizationText(const std::string& text);
+  bool handleSynchronizationRecord(const std::string& text);
+  /// Apply the metadata received before the node with the given name
+  void applyDeferredMetadata(const std::string& nodeName);
+  /// Disable the enabled measurements of a markups node updated by the peer, until UpdateReceivedMeasurements
+  void deferMeasurements(vtkMRMLNode* node);
+  void handleContentMessage(vtkXMLDataElement* res);
+  /// Write a received region into the image of the volume
+  void handleVolumeDelta(vtkXMLDataElement* res);
+  /// Allocate the image of a streamed volume
+  void handleVolumeGeometry(vtkXMLDataElement* res);
+  bool isOutgoingNode(vtkMRMLNode* node);
+  /// Message with the voxels of an extent of the volume, one voxel out of step along each axis
+  std::string getVolumeDeltaMessage(vtkMRMLScalarVolumeNode* volumeNode, vtkImageData* image, const int extent[6], int step);
+  struct VolumeStream;
+  /// Coarsest level of the volume streams, as the number of voxels represented by one voxel along each axis
+  static const int VolumeStreamCoarsestStep = 8;
+  void startVolumeStream(vtkMRMLScalarVolumeNode* volumeNode);
+  void addVolumeStreamBricks(VolumeStream& stream);
+  /// Send the next bricks of the volume streams. Called from ProcessPendingTasks.
+  void sendVolumeBricks();
+  void updateModelDisplayNode(vtkMRMLModelNode* modelNode);
+  /// Send a text message, in the bundle of the current call of ProcessPendingTasks if message bundling is enabled
+  void sendTextMessage(const std::string& deviceName, const std::string& text);
+  /// Push a text message on its own device
+  void pushTextMessage(const std::string& deviceName, const std::string& text);
+  /// Send the bundled messages
+  void flushBundle();
+  /// Return true if work other than importing the received data is in progress
+  bool hasPendingTasks();
+  void handleBundle(const std::string& text, int encoding);
+  /// Apply a received content message or synchronization metadata. Return false if the text is not XML.
+  bool handleTextMessage(const std::string& text, int encoding);
+  /// Tell the peer the capabilities of the connector
+  void sendCapabilities();
+  void handleCapabilities(const std::string& text);
+  /// Return true if the peer sent the feature in its capabilities, or if the node is a participant of a relay hub
+  bool isFeatureSupportedByPeer(const char* feature);
+  std::string getContentHash(vtkMRMLNode* node);
+  void offerNodesOnConnect();
+  /// Pose node of the participant mirroring a local pose node, created and registered as outgoing node if needed,
+  /// with the current matrix of the local pose node. Return the node itself if it is not a local pose node.
+  vtkMRMLNode* getParticipantPoseNode(vtkMRMLNode* node);
+  /// Push the outgoing nodes modified since the previous call
+  void pushModifiedNodes();
+  static void onConnected(vtkObject* caller, unsigned long event, void* clientData, void* callData);
+  std::string getChannelDeviceName(bool outgoing);
+  /// Return true if the device carries the channel messages of a peer, or the acknowledgments of the relay hub
+  bool isIncomingChannelDevice(const std::string& deviceName);
+  void flushChannel();
+  void handleChannelBundle(const std::string& text, const std::string& deviceName);
+  /// Apply a notification of the relay hub
+  void handleHubMessage(const std::string& text);
+  /// Apply a message of the connector itself, such as a channel bundle. Return false if the device carries node data.
+  bool handleConnectorMessage(const std::string& deviceName, const std::string& text, int encoding);
+
+  /// Return true if the session goes through shared memory
+  bool isSameHostSession();
+  std::string getSharedMemoryName();
+  /// Follow the connection of the shared memory link and apply the messages it received
+  void processSharedMemoryLink();
+  /// Send the push events of the outgoing nodes through the transport of the session
+  void pushNodeEvent(vtkMRMLNode* node, unsigned long event);
+  void pushNodesOnConnect();
+  bool sendSharedMemoryNode(vtkMRMLNode* node);
+  bool sendSharedMemoryText(const std::string& deviceName, const std::string& text, int encoding);
+  /// Find the received node of the name and class, or create it in newNode without adding it to the scene.
+  /// The class sent by the peer is only used if it is derived from the base class.
+  vtkMRMLNode* getReceivedNode(const std::string& nodeName, const std::string& className, const char* baseClassName,
+    vtkSmartPointer<vtkMRMLNode>& newNode);
+  void addReceivedNode(vtkMRMLNode* newNode);
+  void applyReceivedText(const std::string& deviceName, const std::string& text, int encoding);
+  void applyReceivedTransform(const std::string& nodeName, const std::string& className, vtkMatrix4x4* matrixToParent);
+  void applyReceivedPolyData(const std::string& nodeName, const std::string& className, vtkPolyData* polyData,
+    const std::string& levelOfDetail);
+  void applyReceivedImage(const std::string& nodeName, const std::string& className, vtkImageData* image,
+    vtkMatrix4x4* ijkToRAS);
+
+  /// Send a transform modification as a pose datagram. Return false if it is pushed through OpenIGTLink instead.
+  bool sendPoseDatagram(vtkMRMLNode* node, unsigned long event);
+  /// Apply the received poses, and push again through OpenIGTLink the poses sent since the peer became unreachable
+  void processPoseDatagrams();
 
 protected:
   vtkMRMLCollaborationConnectorNode();
   ~vtkMRMLCollaborationConnectorNode() override;
   vtkMRMLCollaborationConnectorNode(const vtkMRMLCollaborationConnectorNode&);
   void operator=(const vtkMRMLCollaborationConnectorNode&);
+
+protected:
+  bool ProgressiveModelDelivery;
+  double ProxyTargetReduction;
+  int ProxyMinimumNumberOfCells;
+  bool ContentCacheEnabled;
+  std::string ContentCacheDirectory;
+  int ContentCacheMaximumSize;
+  double MeasurementUpdateInterval;
+  bool BinaryAttributeEncoding;
+  bool VolumeDeltaDelivery;
+  bool VolumeDeltaCompression;
+  bool ProgressiveVolumeDelivery;
+  int ProgressiveVolumeMinimumNumberOfVoxels;
+  double ProgressiveVolumeBandwidth;
+  bool RelayHub;
+  bool StateUpdateCoalescing;
+  bool MessageBundling;
+  bool MessageCompression;
+  int MessageCompressionThreshold;
+  bool SameHostTransport;
+  bool PoseDatagramDelivery;
+
+  class vtkCollaborationInternal;
+  vtkCollaborationInternal* CollaborationInternal;
 };
 
 #endif
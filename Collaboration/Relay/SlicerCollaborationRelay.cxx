@@ -0,0 +1,176 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+// Headless relay hub of the collaboration sessions. The participants connect to it as clients, with the relay hub
+// option of their collaboration connector enabled. The state of the session is kept in memory, so that the
+// participants joining later receive it from the relay. Each participant uses two threads of the relay, which
+// is meant for sessions of a few tens of participants.
+
+// Collaboration includes
+#include "vtkCollaborationRelayHub.h"
+
+// VTK includes
+#include <vtkNew.h>
+
+// STD includes
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace
+{
+std::atomic<bool> StopRequested(false);
+
+//----------------------------------------------------------------------------
+void RequestStop(int)
+{
+  StopRequested = true;
+}
+
+//----------------------------------------------------------------------------
+void PrintUsage(const char* executableName)
+{
+  std::cout << "Usage: " << executableName << " [options]\n"
+    << "  --port <port>                 Port accepting the participants (default: 18944)\n"
+    << "  --max-queue-size <megabytes>  Messages queued for a participant before it is disconnected (default: 256)\n"
+    << "  --max-participants <number>   Participants connected at the same time, each one uses two threads of the\n"
+    << "                                relay, so it is meant for a few tens of participants (default: 32)\n"
+    << "  --stats-interval <seconds>    Interval between the statistics, 0 to disable them (default: 10)\n"
+    << "  --no-session-state            Do not keep the state of the session for the participants joining later\n"
+    << "  --help                        Print this help\n";
+}
+
+//----------------------------------------------------------------------------
+void PrintStatistics(vtkCollaborationRelayHub* hub, double elapsedTime,
+  vtkTypeUInt64 receivedMessages, vtkTypeUInt64 receivedBytes, vtkTypeUInt64 sentMessages, vtkTypeUInt64 sentBytes)
+{
+  const double megabyte = 1024.0 * 1024.0;
+  std::cout << std::fixed << std::setprecision(1)
+    << "participants: " << hub->GetNumberOfClients()
+    << " | received: " << receivedMessages / elapsedTime << " msg/s, " << receivedBytes / megabyte / elapsedTime << " MB/s"
+    << " | sent: " << sentMessages / elapsedTime << " msg/s, " << sentBytes / megabyte / elapsedTime << " MB/s"
+    << " | replaced: " << hub->GetNumberOfReplacedMessages()
+    << " | dropped participants: " << hub->GetNumberOfDroppedClients()
+    << " | session state: " << hub->GetRetainedStateSize() / megabyte << " MB" << std::endl;
+}
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  int port = 18944;
+  double maximumQueueSize = 256.0;
+  int maximumNumberOfParticipants = 32;
+  double statisticsInterval = 10.0;
+  bool sessionStateRetention = true;
+  for (int argIndex = 1; argIndex < argc; argIndex++)
+  {
+    std::string arg = argv[argIndex];
+    bool hasValue = (argIndex + 1 < argc);
+    if (arg == "--port" && hasValue)
+    {
+      port = atoi(argv[++argIndex]);
+    }
+    else if (arg == "--max-queue-size" && hasValue)
+    {
+      maximumQueueSize = atof(argv[++argIndex]);
+    }
+    else if (arg == "--max-participants" && hasValue)
+    {
+      maximumNumberOfParticipants = atoi(argv[++argIndex]);
+    }
+    else if (arg == "--stats-interval" && hasValue)
+    {
+      statisticsInterval = atof(argv[++argIndex]);
+    }
+    else if (arg == "--no-session-state")
+    {
+      sessionStateRetention = false;
+    }
+    else if (arg == "--help")
+    {
+      PrintUsage(argv[0]);
+      return EXIT_SUCCESS;
+    }
+    else
+    {
+      std::cerr << "Invalid argument: " << arg << std::endl;
+      PrintUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (port <= 0 || port > 65535 || maximumQueueSize <= 0.0 || maximumNumberOfParticipants <= 0)
+  {
+    std::cerr << "Invalid port, maximum queue size or maximum number of participants" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  vtkNew<vtkCollaborationRelayHub> hub;
+  hub->SetMaximumQueueSize(static_cast<vtkTypeUInt64>(maximumQueueSize * 1024.0 * 1024.0));
+  hub->SetMaximumNumberOfClients(maximumNumberOfParticipants);
+  hub->SetSessionStateRetention(sessionStateRetention);
+  if (!hub->Start(port))
+  {
+    std::cerr << "Failed to start the relay on port " << port << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "Collaboration relay listening on port " << port << std::endl;
+
+  signal(SIGINT, RequestStop);
+  signal(SIGTERM, RequestStop);
+
+  // the hub threads do the relaying, the main thread only reports the throughput
+  std::chrono::steady_clock::time_point lastStatisticsTime = std::chrono::steady_clock::now();
+  vtkTypeUInt64 lastReceivedMessages = 0;
+  vtkTypeUInt64 lastReceivedBytes = 0;
+  vtkTypeUInt64 lastSentMessages = 0;
+  vtkTypeUInt64 lastSentBytes = 0;
+  while (!StopRequested)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double elapsedTime = std::chrono::duration<double>(now - lastStatisticsTime).count();
+    if (statisticsInterval <= 0.0 || elapsedTime < statisticsInterval)
+    {
+      continue;
+    }
+    vtkTypeUInt64 receivedMessages = hub->GetNumberOfReceivedMessages();
+    vtkTypeUInt64 receivedBytes = hub->GetNumberOfReceivedBytes();
+    vtkTypeUInt64 sentMessages = hub->GetNumberOfSentMessages();
+    vtkTypeUInt64 sentBytes = hub->GetNumberOfSentBytes();
+    PrintStatistics(hub, elapsedTime, receivedMessages - lastReceivedMessages, receivedBytes - lastReceivedBytes,
+      sentMessages - lastSentMessages, sentBytes - lastSentBytes);
+    lastReceivedMessages = receivedMessages;
+    lastReceivedBytes = receivedBytes;
+    lastSentMessages = sentMessages;
+    lastSentBytes = sentBytes;
+    lastStatisticsTime = now;
+  }
+
+  std::cout << "Stopping the collaboration relay" << std::endl;
+  hub->Stop();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,128 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+// Collaboration includes
+#include "vtkCollaborationAttributeSchema.h"
+#include "vtkCollaborationNodeCodec.h"
+
+// MRML includes
+#include <vtkMRMLModelDisplayNode.h>
+#include <vtkMRMLModelNode.h>
+#include <vtkMRMLScene.h>
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtkXMLUtilities.h>
+
+// STD includes
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+//----------------------------------------------------------------------------
+/// Measure the encoding and decoding time of the synchronization metadata of a model display node, with the XML text
+/// and with the binary record of its attribute schema. Prints the sizes and the average times per iteration.
+/// Usage: vtkCollaborationAttributeEncodingBenchmark [numberOfIterations]
+int vtkCollaborationAttributeEncodingBenchmark(int argc, char* argv[])
+{
+  int numberOfIterations = (argc > 1) ? atoi(argv[1]) : 1000;
+  if (numberOfIterations < 1)
+  {
+    std::cerr << "Invalid number of iterations" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  vtkNew<vtkMRMLScene> scene;
+  vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(scene->AddNewNodeByClass("vtkMRMLModelNode", "Model"));
+  modelNode->CreateDefaultDisplayNodes();
+  vtkMRMLModelDisplayNode* displayNode = vtkMRMLModelDisplayNode::SafeDownCast(modelNode->GetDisplayNode());
+  displayNode->SetColor(0.2, 0.4, 0.6);
+  displayNode->SetOpacity(0.5);
+
+  vtkCollaborationNodeCodec* codec = vtkCollaborationNodeCodec::GetCodecOfNode(displayNode);
+  vtkCollaborationAttributeSchema* schema = vtkCollaborationAttributeSchema::GetSchemaOfNode(displayNode);
+  if (!codec || !codec->GetMetadataType() || !schema)
+  {
+    std::cerr << "The display node must have synchronization metadata and an attribute schema" << std::endl;
+    return EXIT_FAILURE;
+  }
+  vtkNew<vtkMRMLModelDisplayNode> decodedNode;
+
+  typedef std::chrono::steady_clock Clock;
+  std::string xmlText;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < numberOfIterations; i++)
+  {
+    xmlText = codec->Serialize(displayNode, nullptr, false);
+  }
+  Clock::time_point xmlEncoded = Clock::now();
+  for (int i = 0; i < numberOfIterations; i++)
+  {
+    // same steps as the receiver: parse the text and apply the attributes
+    vtkSmartPointer<vtkXMLDataElement> element = vtkSmartPointer<vtkXMLDataElement>::Take(
+      vtkXMLUtilities::ReadElementFromString(xmlText.c_str()));
+    if (!element)
+    {
+      continue;
+    }
+    std::vector<const char*> atts;
+    for (int a = 0; a < element->GetNumberOfAttributes(); a++)
+    {
+      atts.push_back(element->GetAttributeName(a));
+      atts.push_back(element->GetAttributeValue(a));
+    }
+    atts.push_back(nullptr);
+    decodedNode->ReadXMLAttributes(atts.data());
+  }
+  Clock::time_point xmlDecoded = Clock::now();
+
+  std::string record;
+  for (int i = 0; i < numberOfIterations; i++)
+  {
+    record = schema->WriteRecord(displayNode, modelNode->GetName());
+  }
+  Clock::time_point binaryEncoded = Clock::now();
+  for (int i = 0; i < numberOfIterations; i++)
+  {
+    vtkCollaborationAttributeSchema::RecordReader reader(record);
+    std::string recordNodeName;
+    vtkCollaborationAttributeSchema* recordSchema = vtkCollaborationAttributeSchema::ReadRecordHeader(reader, recordNodeName);
+    if (!recordSchema || !recordSchema->ReadFields(decodedNode, reader))
+    {
+      std::cerr << "Failed to decode the binary record" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  Clock::time_point binaryDecoded = Clock::now();
+
+  auto microsecondsPerIteration = [numberOfIterations](Clock::time_point from, Clock::time_point to)
+    { return std::chrono::duration<double, std::micro>(to - from).count() / numberOfIterations; };
+  std::cout << displayNode->GetClassName() << ", " << numberOfIterations << " iterations" << std::endl;
+  std::cout << "XML: " << xmlText.size() << " bytes, encode " << microsecondsPerIteration(start, xmlEncoded)
+    << " us, decode " << microsecondsPerIteration(xmlEncoded, xmlDecoded) << " us" << std::endl;
+  std::cout << "Binary: " << record.size() << " bytes (" << vtkCollaborationAttributeSchema::EncodeRecordAsText(record).size()
+    << " as text), encode " << microsecondsPerIteration(xmlDecoded, binaryEncoded)
+    << " us, decode " << microsecondsPerIteration(binaryEncoded, binaryDecoded) << " us" << std::endl;
+  return EXIT_SUCCESS;
+}
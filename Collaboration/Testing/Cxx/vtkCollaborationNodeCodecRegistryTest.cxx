@@ -0,0 +1,65 @@
+/*==============================================================================
+
+  Copyright (c) EBATINCA, S.L.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  This file was originally developed by Csaba Pinter, EBATINCA, S.L., and
+  development was supported by "ICEX Espana Exportacion e Inversiones" under
+  the program "Inversiones de Empresas Extranjeras en Actividades de I+D
+  (Fondo Tecnologico)- Convocatoria 2021", cofunded by the European Regional
+  Development Fund (ERDF).
+
+==============================================================================*/
+
+// Collaboration includes
+#include "vtkCollaborationNodeCodec.h"
+
+// MRML includes
+#include <vtkMRMLCoreTestingMacros.h>
+#include <vtkMRMLMarkupsFiducialNode.h>
+#include <vtkMRMLMarkupsLineNode.h>
+
+// VTK includes
+#include <vtkNew.h>
+
+// STD includes
+#include <cstring>
+#include <memory>
+
+//----------------------------------------------------------------------------
+/// A codec registered for a superclass after the default codecs must not replace the codecs of its subclasses
+int vtkCollaborationNodeCodecRegistryTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkNew<vtkMRMLMarkupsFiducialNode> fiducialNode;
+  vtkNew<vtkMRMLMarkupsLineNode> lineNode;
+
+  // default codecs
+  vtkCollaborationNodeCodec* fiducialCodec = vtkCollaborationNodeCodec::GetCodecOfNode(fiducialNode);
+  CHECK_NOT_NULL(fiducialCodec);
+  CHECK_STRING(fiducialCodec->GetNodeClassName(), "vtkMRMLMarkupsFiducialNode");
+  vtkCollaborationNodeCodec* lineCodec = vtkCollaborationNodeCodec::GetCodecOfNode(lineNode);
+  CHECK_NOT_NULL(lineCodec);
+  CHECK_STRING(lineCodec->GetNodeClassName(), "vtkMRMLMarkupsNode");
+
+  // custom codec of the superclass, registered last
+  std::shared_ptr<vtkCollaborationNodeCodec> markupsCodec = std::make_shared<vtkCollaborationNodeCodec>("vtkMRMLMarkupsNode", "Markups", 5);
+  vtkCollaborationNodeCodec::RegisterCodec(markupsCodec);
+  CHECK_POINTER(vtkCollaborationNodeCodec::GetCodecOfNode(lineNode), markupsCodec.get());
+  CHECK_POINTER(vtkCollaborationNodeCodec::GetCodecOfNode(fiducialNode), fiducialCodec);
+
+  // replacing the codec of the subclass keeps it specific
+  std::shared_ptr<vtkCollaborationNodeCodec> newFiducialCodec = std::make_shared<vtkCollaborationNodeCodec>("vtkMRMLMarkupsFiducialNode");
+  vtkCollaborationNodeCodec::RegisterCodec(newFiducialCodec);
+  CHECK_POINTER(vtkCollaborationNodeCodec::GetCodecOfNode(fiducialNode), newFiducialCodec.get());
+  CHECK_POINTER(vtkCollaborationNodeCodec::GetCodecOfNode(lineNode), markupsCodec.get());
+
+  return EXIT_SUCCESS;
+}
@@ -26,12 +26,32 @@
 #include "qSlicerCollaborationModule.h"
 #include "qSlicerCollaborationModuleWidget.h"
 
+// Slicer includes
+#include <qSlicerCoreApplication.h>
+
+// Qt includes
+#include <QDir>
+#include <QMetaObject>
+#include <QTimer>
+
+namespace
+{
+//-----------------------------------------------------------------------------
+/// Called by the connector nodes from any thread: the tasks are processed by the event loop of the main thread
+void wakeUpConnectorTasks(void* clientData)
+{
+  QMetaObject::invokeMethod(reinterpret_cast<QObject*>(clientData), "processConnectorTasks", Qt::QueuedConnection);
+}
+}
+
 //-----------------------------------------------------------------------------
 /// \ingroup Slicer_QtModules_ExtensionTemplate
 class qSlicerCollaborationModulePrivate
 {
 public:
   qSlicerCollaborationModulePrivate();
+
+  QTimer* ConnectorTasksTimer;
 };
 
 //-----------------------------------------------------------------------------
@@ -39,6 +59,7 @@ public:
 
 //-----------------------------------------------------------------------------
 qSlicerCollaborationModulePrivate::qSlicerCollaborationModulePrivate()
+  : ConnectorTasksTimer(nullptr)
 {
 }
 
@@ -55,6 +76,11 @@ qSlicerCollaborationModule::qSlicerCollaborationModule(QObject* _parent)
 //-----------------------------------------------------------------------------
 qSlicerCollaborationModule::~qSlicerCollaborationModule()
 {
+  vtkSlicerCollaborationLogic* collaborationLogic = vtkSlicerCollaborationLogic::SafeDownCast(this->logic());
+  if (collaborationLogic)
+  {
+    collaborationLogic->SetConnectorWakeUpCallback(nullptr, nullptr);
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -98,7 +124,47 @@ QStringList qSlicerCollaborationModule::dependencies() const
 //-----------------------------------------------------------------------------
 void qSlicerCollaborationModule::setup()
 {
+  Q_D(qSlicerCollaborationModule);
   this->Superclass::setup();
+
+  // The connector nodes wake the module up when they have work to do. The timer only runs while a connection is
+  // established or work is in progress, with the interval the OpenIGTLinkIF module uses to import incoming data
+  // while data is exchanged, and a longer one while the connection is idle.
+  d->ConnectorTasksTimer = new QTimer(this);
+  d->ConnectorTasksTimer->setInterval(5);
+  connect(d->ConnectorTasksTimer, SIGNAL(timeout()), this, SLOT(processConnectorTasks()));
+
+  // Received content is cached with the other application data
+  vtkSlicerCollaborationLogic* collaborationLogic = vtkSlicerCollaborationLogic::SafeDownCast(this->logic());
+  if (collaborationLogic)
+  {
+    collaborationLogic->SetConnectorWakeUpCallback(wakeUpConnectorTasks, this);
+    QString cacheDirectory = QDir(qSlicerCoreApplication::application()->cachePath()).filePath("Collaboration");
+    collaborationLogic->SetDefaultContentCacheDirectory(cacheDirectory.toUtf8().constData());
+  }
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerCollaborationModule::processConnectorTasks()
+{
+  Q_D(qSlicerCollaborationModule);
+  vtkSlicerCollaborationLogic* collaborationLogic = vtkSlicerCollaborationLogic::SafeDownCast(this->logic());
+  if (!collaborationLogic)
+  {
+    return;
+  }
+  collaborationLogic->CallConnectorTimerHandler();
+  // nothing wakes the application up while no session is active
+  if (!collaborationLogic->IsConnectorProcessingNeeded())
+  {
+    d->ConnectorTasksTimer->stop();
+    return;
+  }
+  int interval = static_cast<int>(collaborationLogic->GetConnectorProcessingInterval() * 1000.0 + 0.5);
+  if (!d->ConnectorTasksTimer->isActive() || d->ConnectorTasksTimer->interval() != interval)
+  {
+    d->ConnectorTasksTimer->start(interval);
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -55,6 +55,10 @@ public:
   virtual QStringList categories()const;
   virtual QStringList dependencies() const;
 
+protected slots:
+  /// Let the logic process the pending tasks of the collaboration connectors
+  void processConnectorTasks();
+
 protected:
 
   /// Initialize the module. Register the volumes reader/writer
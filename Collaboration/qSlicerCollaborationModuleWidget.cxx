@@ -36,28 +36,18 @@
 #include <qSlicerModuleManager.h>
 
 // MRML includes
-#include <vtkMRMLLinearTransformNode.h>
-#include <vtkMRMLMarkupsAngleNode.h>
-#include <vtkMRMLMarkupsClosedCurveNode.h>
-#include <vtkMRMLMarkupsCurveNode.h>
-#include <vtkMRMLMarkupsFiducialNode.h>
-#include <vtkMRMLMarkupsLineNode.h>
-#include <vtkMRMLMarkupsPlaneNode.h>
-#include <vtkMRMLMarkupsROINode.h>
-#include <vtkMRMLModelDisplayNode.h>
-#include <vtkMRMLModelNode.h>
 #include <vtkMRMLSubjectHierarchyNode.h>
-#include <vtkMRMLTextNode.h>
 
 // VTK includes
-#include <vtkCollection.h>
-#include <vtkXMLUtilities.h>
+#include <vtkNew.h>
+#include <vtkStringArray.h>
 
 // CTK includes
 #include <ctkCheckBox.h>
 
 // Qt includes
 #include <QDebug>
+#include <QProgressDialog>
 
 //-----------------------------------------------------------------------------
 /// \ingroup Slicer_QtModules_ExtensionTemplate
@@ -65,6 +55,8 @@ class qSlicerCollaborationModuleWidgetPrivate: public Ui_qSlicerCollaborationMod
 {
 public:
   qSlicerCollaborationModuleWidgetPrivate();
+
+  QProgressDialog* SynchronizationProgressDialog;
 };
 
 //-----------------------------------------------------------------------------
@@ -72,6 +64,7 @@ public:
 
 //-----------------------------------------------------------------------------
 qSlicerCollaborationModuleWidgetPrivate::qSlicerCollaborationModuleWidgetPrivate()
+  : SynchronizationProgressDialog(nullptr)
 {
 }
 
@@ -84,7 +77,6 @@ qSlicerCollaborationModuleWidget::qSlicerCollaborationModuleWidget(QWidget* _par
   , d_ptr( new qSlicerCollaborationModuleWidgetPrivate )
 {
   this->SelectedCollaborationNode = "None";
-  this->UpdateTextCallback = nullptr;
 }
 
 //-----------------------------------------------------------------------------
@@ -113,8 +105,12 @@ void qSlicerCollaborationModuleWidget::setup()
   // Update connector node values when parameter values are modified in the GUI
   connect(d->serverModeRadioButton, SIGNAL(clicked()), this, SLOT(updateConnectorNodeFromGUI()));
   connect(d->clientModeRadioButton, SIGNAL(clicked()), this, SLOT(updateConnectorNodeFromGUI()));
+  connect(d->sameHostModeRadioButton, SIGNAL(clicked()), this, SLOT(updateConnectorNodeFromGUI()));
   connect(d->portLineEdit, SIGNAL(editingFinished()), this, SLOT(updateConnectorNodeFromGUI()));
   connect(d->hostNameLineEdit, SIGNAL(editingFinished()), this, SLOT(onHostNameChanged()));
+  connect(d->progressiveDeliveryCheckBox, SIGNAL(toggled(bool)), this, SLOT(onProgressiveDeliveryToggled(bool)));
+  connect(d->contentCacheCheckBox, SIGNAL(toggled(bool)), this, SLOT(onContentCacheToggled(bool)));
+  connect(d->contentCacheSizeSpinBox, SIGNAL(valueChanged(int)), this, SLOT(onContentCacheSizeChanged(int)));
   // Synchronize nodes
     // Transform nodes connection
   connect(d->SynchronizeToolButton, SIGNAL(clicked()), SLOT(synchronizeSelectedNodes()));
@@ -122,17 +118,26 @@ void qSlicerCollaborationModuleWidget::setup()
   // Send nodes selected for synchronization
   connect(d->sendButton, SIGNAL(clicked()), this, SLOT(sendNodesForSynchronization()));
 
+  // the nodes that can be synchronized are those of the classes with a codec
+  vtkSlicerCollaborationLogic* collaborationLogic = vtkSlicerCollaborationLogic::SafeDownCast(this->logic());
+  if (collaborationLogic)
+  {
+    QStringList nodeTypes;
+    for (const std::string& className : collaborationLogic->GetSynchronizableNodeClassNames())
+    {
+      nodeTypes << QString::fromStdString(className);
+    }
+    d->AvailableNodesTreeView->setNodeTypes(nodeTypes);
+    d->SynchronizedTreeView->setNodeTypes(nodeTypes);
+  }
+  // rows are filtered again individually when their item is modified,
+  // so that only the items whose synchronization changed are filtered again
+  d->SynchronizedTreeView->model()->setDynamicSortFilter(true);
+  d->AvailableNodesTreeView->model()->setDynamicSortFilter(true);
   // add the nodes selected for synchronization
   d->SynchronizedTreeView->addNodeAttributeFilter(SelectedCollaborationNode);
-  d->SynchronizedTreeView->model()->invalidateFilter();
   // exclude the nodes selected for synchronization
   d->AvailableNodesTreeView->addNodeAttributeFilter(SelectedCollaborationNode, "true", false);
-  d->AvailableNodesTreeView->model()->invalidateFilter();
-
-  // create callback to update text nodes when markups or display nodes are updated
-  this->UpdateTextCallback = vtkCallbackCommand::New();
-  this->UpdateTextCallback->SetClientData(reinterpret_cast<void*>(this));
-  this->UpdateTextCallback->SetCallback(qSlicerCollaborationModuleWidget::nodeUpdated);
 }
 
 //-----------------------------------------------------------------------------
@@ -157,9 +162,15 @@ void qSlicerCollaborationModuleWidget::setCollaborationNode(vtkMRMLNode* node)
 
   // Each time the node is modified, the qt widgets are updated
   qvtkReconnect(collabNode, vtkCommand::ModifiedEvent, this, SLOT(updateWidgetFromMRML()));
-  // remove the current attribute filter for the tree view
-  d->SynchronizedTreeView->removeNodeAttributeFilter(SelectedCollaborationNode, true);
-  d->AvailableNodesTreeView->removeNodeAttributeFilter(SelectedCollaborationNode, false);
+  // the tree views only need to be filtered again if the filter attribute changes
+  const char* newSelectedCollaborationNode = collabNode ? collabNode->GetID() : "None";
+  bool filterChanged = (strcmp(newSelectedCollaborationNode, SelectedCollaborationNode) != 0);
+  if (filterChanged)
+  {
+    // remove the current attribute filter for the tree view
+    d->SynchronizedTreeView->removeNodeAttributeFilter(SelectedCollaborationNode, true);
+    d->AvailableNodesTreeView->removeNodeAttributeFilter(SelectedCollaborationNode, false);
+  }
   if (collabNode)
   {
     // Get the connector node associated to the collaboration node
@@ -186,12 +197,13 @@ void qSlicerCollaborationModuleWidget::setCollaborationNode(vtkMRMLNode* node)
     // set the filter attributed to None
     SelectedCollaborationNode = "None";
   }
-  // add an attribute filter to the tree view for the selected collaboration node
-  d->SynchronizedTreeView->addNodeAttributeFilter(SelectedCollaborationNode);
-  d->SynchronizedTreeView->model()->invalidateFilter();
-  // add an attribute filter to exclude the nodes selected for synchronization
-  d->AvailableNodesTreeView->addNodeAttributeFilter(SelectedCollaborationNode, "true", false);
-  d->AvailableNodesTreeView->model()->invalidateFilter();
+  if (filterChanged)
+  {
+    // add an attribute filter to the tree view for the selected collaboration node
+    d->SynchronizedTreeView->addNodeAttributeFilter(SelectedCollaborationNode);
+    // add an attribute filter to exclude the nodes selected for synchronization
+    d->AvailableNodesTreeView->addNodeAttributeFilter(SelectedCollaborationNode, "true", false);
+  }
 
   this->updateWidgetFromMRML();
 }
@@ -216,8 +228,15 @@ void qSlicerCollaborationModuleWidget::updateWidgetFromMRML()
       int serverPort = connectorNode->GetServerPort();
       d->portLineEdit->setText(QVariant(serverPort).toString());
       const char* hostname = connectorNode->GetServerHostname();
+      // Same host, through shared memory
+      if (connectorNode->GetSameHostTransport())
+      {
+        d->sameHostModeRadioButton->setChecked(true);
+        d->hostNameLineEdit->setText("NA");
+        d->hostNameLineEdit->setDisabled(true);
+      }
       // Type Server
-      if (connectorType == 1)
+      else if (connectorType == 1)
       {
         d->serverModeRadioButton->setChecked(true);
         d->hostNameLineEdit->setText("NA");
@@ -230,11 +249,17 @@ void qSlicerCollaborationModuleWidget::updateWidgetFromMRML()
         d->hostNameLineEdit->setText(hostname);
         d->hostNameLineEdit->setEnabled(true);
       }
+      bool wasBlocked = d->progressiveDeliveryCheckBox->blockSignals(true);
+      d->progressiveDeliveryCheckBox->setChecked(connectorNode->GetProgressiveModelDelivery());
+      d->progressiveDeliveryCheckBox->blockSignals(wasBlocked);
+      wasBlocked = d->contentCacheCheckBox->blockSignals(true);
+      d->contentCacheCheckBox->setChecked(connectorNode->GetContentCacheEnabled());
+      d->contentCacheCheckBox->blockSignals(wasBlocked);
+      wasBlocked = d->contentCacheSizeSpinBox->blockSignals(true);
+      d->contentCacheSizeSpinBox->setValue(connectorNode->GetContentCacheMaximumSize());
+      d->contentCacheSizeSpinBox->blockSignals(wasBlocked);
     }
   }
-  // update tree visibility
-  d->SynchronizedTreeView->model()->invalidateFilter();
-  d->AvailableNodesTreeView->model()->invalidateFilter();
 }
 
 //-----------------------------------------------------------------------------
@@ -257,7 +282,7 @@ void qSlicerCollaborationModuleWidget::onConnectButtonClicked()
       {
         // send synchronized nodes on connect
         connectorNode->PushOnConnect();
-        connectorNode->Start();
+        connectorNode->StartSession();
         d->connectButton->setText("Disconnect");
         // enable send button
         d->sendButton->setEnabled(true);
@@ -265,13 +290,14 @@ void qSlicerCollaborationModuleWidget::onConnectButtonClicked()
         d->MRMLNodeComboBox->setEnabled(false);
         d->serverModeRadioButton->setEnabled(false);
         d->clientModeRadioButton->setEnabled(false);
+        d->sameHostModeRadioButton->setEnabled(false);
         d->hostNameLineEdit->setEnabled(false);
         d->portLineEdit->setEnabled(false);
       }
       // Stop the connection
       else
       {
-        connectorNode->Stop();
+        connectorNode->StopSession();
         d->connectButton->setText("Connect");
         // disable send button
         d->sendButton->setEnabled(false);
@@ -279,8 +305,9 @@ void qSlicerCollaborationModuleWidget::onConnectButtonClicked()
         d->MRMLNodeComboBox->setEnabled(true);
         d->serverModeRadioButton->setEnabled(true);
         d->clientModeRadioButton->setEnabled(true);
+        d->sameHostModeRadioButton->setEnabled(true);
         d->portLineEdit->setEnabled(true);
-        if (connectorNode->GetType() == 2)
+        if (connectorNode->GetType() == 2 && !connectorNode->GetSameHostTransport())
         {
           d->hostNameLineEdit->setEnabled(true);
         }
@@ -312,7 +339,14 @@ void qSlicerCollaborationModuleWidget::updateConnectorNodeFromGUI()
   int disabledModify = connectorNode->StartModify();
 
   // Update connector properties
-  if (d->serverModeRadioButton->isChecked())
+  connectorNode->SetSameHostTransport(d->sameHostModeRadioButton->isChecked());
+  if (d->sameHostModeRadioButton->isChecked())
+  {
+    d->hostNameLineEdit->setText("NA");
+    d->hostNameLineEdit->setDisabled(true);
+    d->portLineEdit->setEnabled(true);
+  }
+  else if (d->serverModeRadioButton->isChecked())
   {
     connectorNode->SetType(1);
     d->hostNameLineEdit->setText("NA");
@@ -354,712 +388,202 @@ void qSlicerCollaborationModuleWidget::onHostNameChanged()
   connectorNode->SetServerHostname(d->hostNameLineEdit->text().toStdString());
 }
 
-//-----------------------------------------------------------------------------
-void qSlicerCollaborationModuleWidget::synchronizeSelectedNodes()
+//------------------------------------------------------------------------------
+void qSlicerCollaborationModuleWidget::onProgressiveDeliveryToggled(bool enabled)
 {
   Q_D(qSlicerCollaborationModuleWidget);
+
   // Get the selected collaboration node
   vtkMRMLCollaborationNode* collabNode = vtkMRMLCollaborationNode::SafeDownCast(d->MRMLNodeComboBox->currentNode());
-  if (collabNode)
+  if (!collabNode)
   {
-    // Get the connector node associated to the collaboration node
-    vtkMRMLCollaborationConnectorNode* connectorNode = collabNode->GetCollaborationConnectorNode();
-    if (connectorNode)
-    {
-      //Get the selected nodes to synchronize
-      vtkMRMLSubjectHierarchyNode* shNode = d->AvailableNodesTreeView->subjectHierarchyNode();
-      QList<vtkIdType> currentItemIDs = d->AvailableNodesTreeView->currentItems();
-      int numberOfItems = currentItemIDs.size();
-      if (numberOfItems > 0)
-      {
-        vtkMRMLNode* selectedNode = nullptr;
-        for (int nodeIndex = numberOfItems - 1; nodeIndex >= 0; nodeIndex--)
-        {
-          selectedNode = shNode->GetItemDataNode(currentItemIDs[nodeIndex]);
-          // set attribute of the collaboration node to the selected node
-          selectedNode->SetAttribute(SelectedCollaborationNode, "true");
-          // add node reference to the collaboration node
-          collabNode->AddCollaborationSynchronizedNodeID(selectedNode->GetID());
-          selectedNode->SetAttribute("OpenIGTLinkIF.pushOnConnect", "true");
-          if (!selectedNode->IsA("vtkMRMLMarkupsNode") || selectedNode->IsA("vtkMRMLMarkupsFiducialNode"))
-          {
-            // add as output node of the connector node
-            connectorNode->RegisterOutgoingMRMLNode(selectedNode);
-            connectorNode->PushNode(selectedNode);
-          }
-          // check if it observes a transform node and update it
-          vtkMRMLNode* transformNode = vtkMRMLNode::SafeDownCast(selectedNode->GetNodeReference("transform"));
-          if (transformNode)
-          {
-            updateTransformNodeText(transformNode);
-            selectedNode->AddObserver(vtkMRMLTransformableNode::TransformModifiedEvent, UpdateTextCallback);
-          }
-
-          // check if it is a model node
-          if (selectedNode->IsA("vtkMRMLModelNode"))
-          {
-            vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(selectedNode);
-            vtkMRMLDisplayNode* displayNode = vtkMRMLDisplayNode::SafeDownCast(modelNode->GetDisplayNode());
-            // create a text node with the display information
-            vtkMRMLTextNode* textNode = createTextOfDisplayNode(displayNode, modelNode->GetName(), "vtkMRMLModelDisplayNode");
-
-            // set attribute of the collaboration node to the selected node
-            textNode->SetAttribute(SelectedCollaborationNode, "true");
-            // add node reference to the collaboration node
-            collabNode->AddCollaborationSynchronizedNodeID(textNode->GetID());
-            // add as output node of the connector node
-            textNode->SetAttribute("OpenIGTLinkIF.pushOnConnect", "true");
-            connectorNode->RegisterOutgoingMRMLNode(textNode);
-            // send if the connection is active
-            connectorNode->PushNode(textNode);
-            // add node reference to the display model node
-            displayNode->AddNodeReferenceRole("TextNode");
-            displayNode->AddNodeReferenceID("TextNode", textNode->GetID());
-            // add observer to the display node to update the text node
-            displayNode->AddObserver(vtkCommand::AnyEvent, UpdateTextCallback);
-            //modelNode->AddObserver(vtkMRMLTransformableNode::TransformModifiedEvent, updateTextCallback);
-          }
-          else if (selectedNode->IsA("vtkMRMLMarkupsFiducialNode"))
-          {
-            vtkMRMLMarkupsFiducialNode* markupsNode = vtkMRMLMarkupsFiducialNode::SafeDownCast(selectedNode);
-            // get the display node
-            vtkMRMLDisplayNode* displayNode = vtkMRMLDisplayNode::SafeDownCast(markupsNode->GetDisplayNode());
-            char* displayClassName = "vtkMRMLMarkupsDisplayNode";
-            // create a text node with the display information
-            vtkMRMLTextNode* textNodeDisplay = createTextOfDisplayNode(displayNode, markupsNode->GetName(), displayClassName);
-            // set attribute of the collaboration node to the selected node
-            textNodeDisplay->SetAttribute(SelectedCollaborationNode, "true");
-            // add node reference to the collaboration node
-            collabNode->AddCollaborationSynchronizedNodeID(textNodeDisplay->GetID());
-            // add as output node of the connector node
-            textNodeDisplay->SetAttribute("OpenIGTLinkIF.pushOnConnect", "true");
-            connectorNode->RegisterOutgoingMRMLNode(textNodeDisplay);
-            // add node reference to the display markups node
-            displayNode->AddNodeReferenceRole("TextNode");
-            displayNode->AddNodeReferenceID("TextNode", textNodeDisplay->GetID());
-            // add observer to the markups node to update the text node
-            displayNode->AddObserver(vtkCommand::ModifiedEvent, UpdateTextCallback);
-            // send node
-            connectorNode->PushNode(textNodeDisplay);
-            // check if it observes a synched transform node and update it
-            vtkMRMLNode* transformNode = vtkMRMLNode::SafeDownCast(markupsNode->GetNodeReference("transform"));
-          }
-          // check if it is a line markups (non fiducial) node
-          else if (selectedNode->IsA("vtkMRMLMarkupsNode") && !selectedNode->IsA("vtkMRMLMarkupsFiducialNode"))
-          {
-            vtkMRMLMarkupsNode* markupsNode = vtkMRMLMarkupsNode::SafeDownCast(selectedNode);
-            std::string className = selectedNode->GetClassName();
-            // get control points
-            vtkNew<vtkPoints> controlPoints;
-            markupsNode->GetControlPointPositionsWorld(controlPoints);
-            int numberOfPoints = markupsNode->GetNumberOfControlPoints();
-            std::string controlPointsText = " ControlPoints = \"";
-            for (int p = 0; p < numberOfPoints; p++)
-            {
-              double point[3] = {0.0};
-              controlPoints->GetPoint(p, point);
-              controlPointsText.append("[");
-              controlPointsText.append(std::to_string(point[0]));
-              controlPointsText.append(",");
-              controlPointsText.append(std::to_string(point[1]));
-              controlPointsText.append(",");
-              controlPointsText.append(std::to_string(point[2]));
-              controlPointsText.append("]");
-              if (p < (numberOfPoints - 1))
-              {
-                controlPointsText.append(";");
-              }
-            }
-            controlPointsText.append("\"");
-
-            // create a text node
-            vtkMRMLTextNode* textNode = vtkMRMLTextNode::SafeDownCast(this->mrmlScene()->CreateNodeByClass("vtkMRMLTextNode"));
-            // hide from Data module
-            textNode->SetHideFromEditors(1);
-            this->mrmlScene()->AddNode(textNode);
-            // write an XML text with the display node attributes
-            std::stringstream ss;
-            ss << "<MRMLNode SuperclassName = \"vtkMRMLMarkupsNode\" ClassName = \"";
-            ss << className;
-            ss << "\" ";
-            ss << controlPointsText;
-
-            // check if it is a ROI markups node to get ROI radius
-            if (selectedNode->IsA("vtkMRMLMarkupsROINode"))
-            {
-              vtkMRMLMarkupsROINode* markupsROINode = vtkMRMLMarkupsROINode::SafeDownCast(selectedNode);
-              double rad[3] = {0.0};
-              markupsROINode->GetRadiusXYZ(rad);
-              std::string ROIradiusText = " ROIRadius = \"";
-              ROIradiusText.append("[");
-              ROIradiusText.append(std::to_string(rad[0]));
-              ROIradiusText.append(",");
-              ROIradiusText.append(std::to_string(rad[1]));
-              ROIradiusText.append(",");
-              ROIradiusText.append(std::to_string(rad[2]));
-              ROIradiusText.append("]");
-              ROIradiusText.append("\"");
-              ss << ROIradiusText;
-            }
-
-            markupsNode->WriteXML(ss, 0);
-            ss << " />";
-            // add the XML to the text node
-            textNode->SetText(ss.str());
-            // Set the same name as the model node + Text
-            char* markupsNodeName = markupsNode->GetName();
-            char textName[] = "Text";
-            char* textNodeName = new char[std::strlen(markupsNodeName) + std::strlen(textName) + 1];
-            std::strcpy(textNodeName, markupsNodeName);
-            std::strcat(textNodeName, textName);
-            textNode->SetName(textNodeName);
-            // set attribute of the collaboration node to the selected node
-            textNode->SetAttribute(SelectedCollaborationNode, "true");
-            // add node reference to the collaboration node
-            collabNode->AddCollaborationSynchronizedNodeID(textNode->GetID());
-            // add as output node of the connector node
-            textNode->SetAttribute("OpenIGTLinkIF.pushOnConnect", "true");
-            connectorNode->RegisterOutgoingMRMLNode(textNode);
-            // add node reference to the markups node
-            markupsNode->AddNodeReferenceRole("TextNode");
-            markupsNode->AddNodeReferenceID("TextNode", textNode->GetID());
-            // add observer to the markups node to update the text node
-            markupsNode->AddObserver(vtkCommand::AnyEvent, UpdateTextCallback);
-
-            // get the display node
-            vtkMRMLDisplayNode* displayNode = vtkMRMLDisplayNode::SafeDownCast(markupsNode->GetDisplayNode());
-            char* displayClassName = "vtkMRMLMarkupsDisplayNode";
-            // create a text node with the display information
-            vtkMRMLTextNode* textNodeDisplay = createTextOfDisplayNode(displayNode, markupsNode->GetName(), displayClassName);
-            // set attribute of the collaboration node to the selected node
-            textNodeDisplay->SetAttribute(SelectedCollaborationNode, "true");
-            // add node reference to the collaboration node
-            collabNode->AddCollaborationSynchronizedNodeID(textNodeDisplay->GetID());
-            // add as output node of the connector node
-            textNodeDisplay->SetAttribute("OpenIGTLinkIF.pushOnConnect", "true");
-            connectorNode->RegisterOutgoingMRMLNode(textNodeDisplay);
-            // add node reference to the display markups node
-            displayNode->AddNodeReferenceRole("TextNode");
-            displayNode->AddNodeReferenceID("TextNode", textNodeDisplay->GetID());
-            // add observer to the markups node to update the text node
-            displayNode->AddObserver(vtkCommand::ModifiedEvent, UpdateTextCallback);
-            // send node
-            connectorNode->PushNode(textNode);
-            connectorNode->PushNode(textNodeDisplay);
-          }
-          else if (selectedNode->IsA("vtkMRMLLinearTransformNode"))
-          {
-            vtkMRMLLinearTransformNode* transformNode = vtkMRMLLinearTransformNode::SafeDownCast(selectedNode);
-            std::string transformNodeID = transformNode->GetID();
-            // create a text node to send the observing and observed nodes
-            vtkMRMLTextNode* transformTextNode = vtkMRMLTextNode::SafeDownCast(this->mrmlScene()->CreateNodeByClass("vtkMRMLTextNode"));
-            // set attribute of the collaboration node to the selected node
-            transformTextNode->SetAttribute(SelectedCollaborationNode, "true");
-            // hide from Data module
-            transformTextNode->SetHideFromEditors(1);
-            this->mrmlScene()->AddNode(transformTextNode);
-            // get transformed nodes
-            vtkStringArray* synchronizedNodeIDsCollection = collabNode->GetCollaborationSynchronizedNodeIDs();
-            std::string transformedNodesText = "";
-            for (int i = 0; i < synchronizedNodeIDsCollection->GetNumberOfTuples(); i++)
-            {
-              std::string currentSynchronizedNodeID = synchronizedNodeIDsCollection->GetValue(i);
-              vtkMRMLNode* node = vtkMRMLNode::SafeDownCast(this->mrmlScene()->GetNodeByID(currentSynchronizedNodeID));
-              vtkMRMLNode* transformNode = vtkMRMLNode::SafeDownCast(node->GetNodeReference("transform"));
-              if (transformNode)
-              {
-                std::string nodeTranformID = transformNode->GetID();
-                if (transformNodeID == nodeTranformID)
-                {
-                  transformedNodesText.append(node->GetName());
-                  transformedNodesText.append(",");
-                }
-              }
-            }
-            // remove the last comma
-            if (transformedNodesText != "")
-            {
-              transformedNodesText.pop_back();
-            }
-            // write an XML text with the transform node attributes
-            std::stringstream ss;
-            ss << "<MRMLNode SuperclassName = \"vtkMRMLTransformNode\" ClassName = \"vtkMRMLLinearTransformNode\" TransformName = \"";
-            ss << transformNode->GetName();
-            ss << "\" TransformedNodes = \"";
-            ss << transformedNodesText;
-            ss << "\"";
-            ss << " />";
-            // add the XML to the text node
-            transformTextNode->SetText(ss.str());
-            // Set the same name as the model node + Text
-            char* markupsNodeName = transformNode->GetName();
-            char textName[] = "Text";
-            char* textNodeName = new char[std::strlen(markupsNodeName) + std::strlen(textName) + 1];
-            std::strcpy(textNodeName, markupsNodeName);
-            std::strcat(textNodeName, textName);
-            transformTextNode->SetName(textNodeName);
-            // set attribute of the collaboration node to the selected node
-            transformNode->SetAttribute(SelectedCollaborationNode, "true");
-            // add node reference to the collaboration node
-            collabNode->AddCollaborationSynchronizedNodeID(transformTextNode->GetID());
-            // add as output node of the connector node
-            transformTextNode->SetAttribute("OpenIGTLinkIF.pushOnConnect", "true");
-            connectorNode->RegisterOutgoingMRMLNode(transformTextNode);
-            // add node reference to the markups node
-            transformNode->AddNodeReferenceRole("TextNode");
-            transformNode->AddNodeReferenceID("TextNode", transformTextNode->GetID());
-            // send node
-            connectorNode->PushNode(transformTextNode);
-          }
-          // update tree visibility
-          d->SynchronizedTreeView->model()->invalidateFilter();
-          d->AvailableNodesTreeView->model()->invalidateFilter();
-        }
-      }
-    }
+    return;
+  }
+
+  // Get the connector node associated to the collaboration node
+  vtkMRMLCollaborationConnectorNode* connectorNode = collabNode->GetCollaborationConnectorNode();
+  if (!connectorNode)
+  {
+    qCritical() << Q_FUNC_INFO << ": Failed to find connector node for collaboration node " << collabNode->GetName();
+    return;
+  }
+
+  connectorNode->SetProgressiveModelDelivery(enabled);
+}
+
+//------------------------------------------------------------------------------
+void qSlicerCollaborationModuleWidget::onContentCacheToggled(bool enabled)
+{
+  Q_D(qSlicerCollaborationModuleWidget);
+
+  // Get the selected collaboration node
+  vtkMRMLCollaborationNode* collabNode = vtkMRMLCollaborationNode::SafeDownCast(d->MRMLNodeComboBox->currentNode());
+  if (!collabNode)
+  {
+    return;
+  }
+
+  // Get the connector node associated to the collaboration node
+  vtkMRMLCollaborationConnectorNode* connectorNode = collabNode->GetCollaborationConnectorNode();
+  if (!connectorNode)
+  {
+    qCritical() << Q_FUNC_INFO << ": Failed to find connector node for collaboration node " << collabNode->GetName();
+    return;
   }
+
+  connectorNode->SetContentCacheEnabled(enabled);
+}
+
+//------------------------------------------------------------------------------
+void qSlicerCollaborationModuleWidget::onContentCacheSizeChanged(int megabytes)
+{
+  Q_D(qSlicerCollaborationModuleWidget);
+
+  // Get the selected collaboration node
+  vtkMRMLCollaborationNode* collabNode = vtkMRMLCollaborationNode::SafeDownCast(d->MRMLNodeComboBox->currentNode());
+  if (!collabNode)
+  {
+    return;
+  }
+
+  // Get the connector node associated to the collaboration node
+  vtkMRMLCollaborationConnectorNode* connectorNode = collabNode->GetCollaborationConnectorNode();
+  if (!connectorNode)
+  {
+    qCritical() << Q_FUNC_INFO << ": Failed to find connector node for collaboration node " << collabNode->GetName();
+    return;
+  }
+
+  connectorNode->SetContentCacheMaximumSize(megabytes);
 }
 
 //-----------------------------------------------------------------------------
-void qSlicerCollaborationModuleWidget::unsynchronizeSelectedNodes()
+void qSlicerCollaborationModuleWidget::synchronizeSelectedNodes()
 {
   Q_D(qSlicerCollaborationModuleWidget);
   // Get the selected collaboration node
   vtkMRMLCollaborationNode* collabNode = vtkMRMLCollaborationNode::SafeDownCast(d->MRMLNodeComboBox->currentNode());
-  if (collabNode)
+  vtkSlicerCollaborationLogic* collaborationLogic = vtkSlicerCollaborationLogic::SafeDownCast(this->logic());
+  if (!collabNode || !collaborationLogic)
   {
-    // Get the connector node associated to the collaboration node
-    vtkMRMLCollaborationConnectorNode* connectorNode = collabNode->GetCollaborationConnectorNode();
-    if (connectorNode)
+    return;
+  }
+  //Get the selected nodes to synchronize
+  vtkMRMLSubjectHierarchyNode* shNode = d->AvailableNodesTreeView->subjectHierarchyNode();
+  QList<vtkIdType> currentItemIDs = d->AvailableNodesTreeView->currentItems();
+  vtkNew<vtkStringArray> nodeIDs;
+  for (int nodeIndex = currentItemIDs.size() - 1; nodeIndex >= 0; nodeIndex--)
+  {
+    vtkMRMLNode* selectedNode = shNode->GetItemDataNode(currentItemIDs[nodeIndex]);
+    if (selectedNode)
     {
-      // Get the selected nodes to unsynchronize
-      vtkMRMLSubjectHierarchyNode* shNode = d->SynchronizedTreeView->subjectHierarchyNode();
-      QList<vtkIdType> currentItemIDs = d->SynchronizedTreeView->currentItems();
-      int numberOfItems = currentItemIDs.size();
-      if (numberOfItems > 0)
-      {
-        vtkMRMLNode* selectedNode = nullptr;
-        for (int nodeIndex = numberOfItems - 1; nodeIndex >= 0; nodeIndex--)
-        {
-          selectedNode = shNode->GetItemDataNode(currentItemIDs[nodeIndex]);
-          // remove the attribute of the collaboration node from the selected node
-          selectedNode->RemoveAttribute(SelectedCollaborationNode);
-          // remove node reference from the collaboration node
-          collabNode->RemoveCollaborationSynchronizedNodeID(selectedNode->GetID());
-          // remove as output node of the connector node
-          connectorNode->UnregisterOutgoingMRMLNode(selectedNode);
-          // remove observer to transforms
-          selectedNode->RemoveObserver(UpdateTextCallback);
-          const char* att_push = selectedNode->GetAttribute("OpenIGTLinkIF.pushOnConnect");
-          if (att_push)
-          {
-            selectedNode->RemoveAttribute("OpenIGTLinkIF.pushOnConnect");
-          }
-          // check if it observes a synched transform node and update it
-          vtkMRMLNode* transformNode = vtkMRMLNode::SafeDownCast(selectedNode->GetNodeReference("transform"));
-          if (transformNode && transformNode->GetAttribute(SelectedCollaborationNode))
-          {
-            updateTransformNodeText(transformNode);
-          }
-          // check if it is a model node, to remove the corresponding text node
-          if (selectedNode->IsA("vtkMRMLModelNode"))
-          {
-            vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(selectedNode);
-            // Get the text node
-            const char* textNodeID = modelNode->GetDisplayNode()->GetNthNodeReferenceID("TextNode", 0);
-            vtkSmartPointer<vtkMRMLTextNode> textNode = vtkMRMLTextNode::SafeDownCast(this->mrmlScene()->GetNodeByID(textNodeID));
-            if (textNode)
-            {
-              // remove the attribute of the collaboration node from the selected node
-              textNode->RemoveAttribute(SelectedCollaborationNode);
-              // remove node reference from the collaboration node
-              collabNode->RemoveCollaborationSynchronizedNodeID(textNode->GetID());
-              // remove as output node of the connector node
-              const char* att_push_text = selectedNode->GetAttribute("OpenIGTLinkIF.pushOnConnect");
-              if (att_push_text)
-              {
-                textNode->RemoveAttribute("OpenIGTLinkIF.pushOnConnect");
-              }
-              connectorNode->UnregisterOutgoingMRMLNode(textNode);
-              // remove from scene
-              textNode->RemoveAllObservers();
-              this->mrmlScene()->RemoveNode(textNode);
-            }
-          }
-          // check if it is a markups node, to remove the corresponding text nodes
-          if (selectedNode->IsA("vtkMRMLMarkupsNode"))
-          {
-            vtkMRMLMarkupsNode* markupsNode = vtkMRMLMarkupsNode::SafeDownCast(selectedNode);
-            // Get the corresponding text node
-            const char* textNodeID = markupsNode->GetNthNodeReferenceID("TextNode", 0);
-            vtkSmartPointer<vtkMRMLTextNode> textNode =
-              vtkMRMLTextNode::SafeDownCast(this->mrmlScene()->GetNodeByID(textNodeID));
-            if (textNode)
-            {
-              // remove the attribute of the collaboration node from the selected node
-              textNode->RemoveAttribute(SelectedCollaborationNode);
-              // remove node reference from the collaboration node
-              collabNode->RemoveCollaborationSynchronizedNodeID(textNode->GetID());
-              // remove as output node of the connector node
-              const char* att_push_text = selectedNode->GetAttribute("OpenIGTLinkIF.pushOnConnect");
-              if (att_push_text)
-              {
-                textNode->RemoveAttribute("OpenIGTLinkIF.pushOnConnect");
-              }
-              connectorNode->UnregisterOutgoingMRMLNode(textNode);
-              // remove from scene
-              textNode->RemoveAllObservers();
-              this->mrmlScene()->RemoveNode(textNode);
-            }
-            // get the display node and its corresponding text node
-            const char* displayTextNodeID = markupsNode->GetDisplayNode()->GetNthNodeReferenceID("TextNode", 0);
-            vtkSmartPointer<vtkMRMLTextNode> displayTextNode = vtkMRMLTextNode::SafeDownCast(this->mrmlScene()->GetNodeByID(displayTextNodeID));
-            if (displayTextNode)
-            {
-              // remove the attribute of the collaboration node from the selected node
-              displayTextNode->RemoveAttribute(SelectedCollaborationNode);
-              // remove node reference from the collaboration node
-              collabNode->RemoveCollaborationSynchronizedNodeID(displayTextNode->GetID());
-              // remove as output node of the connector node
-              const char* att_push_text = selectedNode->GetAttribute("OpenIGTLinkIF.pushOnConnect");
-              if (att_push_text)
-              {
-                displayTextNode->RemoveAttribute("OpenIGTLinkIF.pushOnConnect");
-              }
-              connectorNode->UnregisterOutgoingMRMLNode(displayTextNode);
-              // remove from scene
-              displayTextNode->RemoveAllObservers();
-              this->mrmlScene()->RemoveNode(displayTextNode);
-            }
-          }
-          if (selectedNode->IsA("vtkMRMLLinearTransformNode"))
-          {
-            vtkMRMLLinearTransformNode* transformNode = vtkMRMLLinearTransformNode::SafeDownCast(selectedNode);
-            // Get the corresponding text node
-            const char* textNodeID = transformNode->GetNthNodeReferenceID("TextNode", 0);
-            vtkSmartPointer<vtkMRMLTextNode> textNode =
-              vtkMRMLTextNode::SafeDownCast(this->mrmlScene()->GetNodeByID(textNodeID));
-            if (textNode)
-            {
-              // remove the attribute of the collaboration node from the selected node
-              textNode->RemoveAttribute(SelectedCollaborationNode);
-              // remove node reference from the collaboration node
-              collabNode->RemoveCollaborationSynchronizedNodeID(textNode->GetID());
-              // remove as output node of the connector node
-              const char* att_push_text = selectedNode->GetAttribute("OpenIGTLinkIF.pushOnConnect");
-              if (att_push_text)
-              {
-                textNode->RemoveAttribute("OpenIGTLinkIF.pushOnConnect");
-              }
-              connectorNode->UnregisterOutgoingMRMLNode(textNode);
-              // remove from scene
-              textNode->RemoveAllObservers();
-              this->mrmlScene()->RemoveNode(textNode);
-            }
-          }
-          // update tree visibility
-          d->SynchronizedTreeView->model()->invalidateFilter();
-          d->AvailableNodesTreeView->model()->invalidateFilter();
-        }
-      }
+      nodeIDs->InsertNextValue(selectedNode->GetID());
     }
   }
+  this->runBulkSynchronization(collabNode, nodeIDs, true);
+  // update tree visibility of the moved items only
+  this->updateSynchronizedItems(shNode, currentItemIDs);
 }
 
 //-----------------------------------------------------------------------------
-void qSlicerCollaborationModuleWidget::sendNodesForSynchronization()
+void qSlicerCollaborationModuleWidget::unsynchronizeSelectedNodes()
 {
   Q_D(qSlicerCollaborationModuleWidget);
-
   // Get the selected collaboration node
   vtkMRMLCollaborationNode* collabNode = vtkMRMLCollaborationNode::SafeDownCast(d->MRMLNodeComboBox->currentNode());
-
-  if (collabNode)
+  vtkSlicerCollaborationLogic* collaborationLogic = vtkSlicerCollaborationLogic::SafeDownCast(this->logic());
+  if (!collabNode || !collaborationLogic)
   {
-    // Get the connector node associated to the collaboration node
-    vtkMRMLCollaborationConnectorNode* connectorNode = collabNode->GetCollaborationConnectorNode();
-
-    if (connectorNode)
+    return;
+  }
+  // Get the selected nodes to unsynchronize
+  vtkMRMLSubjectHierarchyNode* shNode = d->SynchronizedTreeView->subjectHierarchyNode();
+  QList<vtkIdType> currentItemIDs = d->SynchronizedTreeView->currentItems();
+  vtkNew<vtkStringArray> nodeIDs;
+  for (int nodeIndex = currentItemIDs.size() - 1; nodeIndex >= 0; nodeIndex--)
+  {
+    vtkMRMLNode* selectedNode = shNode->GetItemDataNode(currentItemIDs[nodeIndex]);
+    if (selectedNode)
     {
-      // Start the connection
-      if (d->connectButton->text() == "Disconnect")
-      {
-        // send synchronized nodes
-        vtkCollection* syncNodes = collabNode->GetCollaborationSynchronizedNodes();
-        int numNodes = syncNodes->GetNumberOfItems();
-        for (int nodeIndex = numNodes - 1; nodeIndex >= 0; nodeIndex--)
-        {
-          vtkMRMLNode* syncNode = vtkMRMLNode::SafeDownCast(syncNodes->GetItemAsObject(nodeIndex));
-          connectorNode->PushNode(syncNode);
-        }
-      }
+      nodeIDs->InsertNextValue(selectedNode->GetID());
     }
   }
+  this->runBulkSynchronization(collabNode, nodeIDs, false);
+  // update tree visibility of the moved items only
+  this->updateSynchronizedItems(shNode, currentItemIDs);
 }
 
 //-----------------------------------------------------------------------------
-vtkMRMLTextNode* qSlicerCollaborationModuleWidget::createTextOfDisplayNode(vtkMRMLNode* displayNode, char* nodeName, char* className)
+void qSlicerCollaborationModuleWidget::updateSynchronizedItems(vtkMRMLSubjectHierarchyNode* shNode, const QList<vtkIdType>& itemIDs)
 {
-  // create a text node
-  vtkMRMLTextNode* textNode = vtkMRMLTextNode::SafeDownCast(this->mrmlScene()->CreateNodeByClass("vtkMRMLTextNode"));
-  // hide from Data module
-  textNode->SetHideFromEditors(1);
-  this->mrmlScene()->AddNode(textNode);
-  // write an XML text with the display node attributes
-  std::stringstream ss;
-  ss << "<MRMLNode SuperclassName = \"vtkMRMLDisplayNode\" ClassName = \"";
-  ss << className;
-  ss << "\" NodeName = \"";
-  ss << nodeName;
-  ss << "\"";
-  displayNode->WriteXML(ss, 0);
-  ss << " />";
-  // add the XML to the text node
-  textNode->SetText(ss.str());
-  // Set the same name as the model node + Text
-  char textName[] = "DisplayText";
-  char* textNodeName = new char[std::strlen(nodeName) + std::strlen(textName) + 1];
-  std::strcpy(textNodeName, nodeName);
-  std::strcat(textNodeName, textName);
-  textNode->SetName(textNodeName);
-  return textNode;
+  // the scene was batch processed for large selections, the tree views have been rebuilt already
+  if (!shNode || itemIDs.size() >= vtkSlicerCollaborationLogic::BatchProcessMinimumNumberOfNodes)
+  {
+    return;
+  }
+  // filters the modified items again through the dynamic sort filter of the tree views
+  foreach (vtkIdType itemID, itemIDs)
+  {
+    shNode->ItemModified(itemID);
+  }
 }
 
 //-----------------------------------------------------------------------------
-void qSlicerCollaborationModuleWidget::nodeUpdated(vtkObject* caller, unsigned long event, void* clientData, void* callData)
+void qSlicerCollaborationModuleWidget::runBulkSynchronization(vtkMRMLCollaborationNode* collabNode, vtkStringArray* nodeIDs, bool synchronize)
 {
-  qSlicerCollaborationModuleWidget* self = reinterpret_cast<qSlicerCollaborationModuleWidget*>(clientData);
+  Q_D(qSlicerCollaborationModuleWidget);
+  vtkSlicerCollaborationLogic* collaborationLogic = vtkSlicerCollaborationLogic::SafeDownCast(this->logic());
 
-  // Get the selected collaboration node
-  if (self->logic() == nullptr)
+  // show the progress of large selections
+  if (nodeIDs->GetNumberOfValues() >= vtkSlicerCollaborationLogic::BatchProcessMinimumNumberOfNodes)
   {
-    return;
+    d->SynchronizationProgressDialog = new QProgressDialog(
+      synchronize ? tr("Synchronizing nodes...") : tr("Unsynchronizing nodes..."), QString(), 0, 100, this);
+    d->SynchronizationProgressDialog->setWindowModality(Qt::WindowModal);
+    d->SynchronizationProgressDialog->setMinimumDuration(0);
+    qvtkConnect(collaborationLogic, vtkCommand::ProgressEvent, this, SLOT(onSynchronizationProgress(vtkObject*, void*)));
   }
-  vtkSlicerCollaborationLogic* collaborationLogic = vtkSlicerCollaborationLogic::SafeDownCast(self->logic());
-  if (collaborationLogic)
+
+  if (synchronize)
   {
-    vtkMRMLCollaborationNode* collabNode = vtkMRMLCollaborationNode::SafeDownCast(collaborationLogic->collaborationNodeSelected);
-    if (collabNode)
-    {
-      // Get the connector node associated to the collaboration node
-      vtkMRMLCollaborationConnectorNode* connectorNode = vtkMRMLCollaborationConnectorNode::SafeDownCast(self->mrmlScene()->GetNodeByID(collabNode->GetCollaborationConnectorNodeID()));
-      if (connectorNode)
-      {
-        if (caller->IsA("vtkMRMLNode"))
-        {
-          vtkMRMLNode* updatedNode = vtkMRMLNode::SafeDownCast(caller);
-          // update all transform texts
-          // get transformed nodes
-          vtkStringArray* collection = collabNode->GetCollaborationSynchronizedNodeIDs();
-          std::string transformedNodesText = "";
-          for (int i = 0; i < collection->GetNumberOfTuples(); i++)
-          {
-            std::string ID = collection->GetValue(i);
-            vtkMRMLNode* node = vtkMRMLNode::SafeDownCast(self->mrmlScene()->GetNodeByID(ID));
-            if (node->IsA("vtkMRMLLinearTransformNode"))
-            {
-              self->updateTransformNodeText(node);
-            }
-          }
-        }
+    collaborationLogic->SynchronizeNodes(collabNode, nodeIDs);
+  }
+  else
+  {
+    collaborationLogic->UnsynchronizeNodes(collabNode, nodeIDs);
+  }
 
-        if (caller->IsA("vtkMRMLDisplayNode"))
-        {
-          vtkMRMLDisplayNode* displayNode = vtkMRMLDisplayNode::SafeDownCast(caller);
-          // get the corresponding text node
-          const char* textNodeID = displayNode->GetNthNodeReferenceID("TextNode", 0);
-          vtkMRMLTextNode* displayTextNode = vtkMRMLTextNode::SafeDownCast(self->mrmlScene()->GetNodeByID(textNodeID));
-          if (displayTextNode)
-          {
-            // if it is a model display node
-            if (displayNode->IsA("vtkMRMLModelDisplayNode"))
-            {
-              // create a text node with the display information
-              vtkMRMLTextNode* textNode = self->createTextOfDisplayNode(displayNode, displayNode->GetDisplayableNode()->GetName(), "vtkMRMLModelDisplayNode");
-              // set text
-              displayTextNode->SetText(textNode->GetText());
-              displayTextNode->Modified();
-              connectorNode->PushNode(displayTextNode);
-            }
-            // if it is a markups display node
-            else if (displayNode->IsA("vtkMRMLMarkupsDisplayNode"))
-            {
-              // create a text node with the display information
-              vtkMRMLTextNode* textNode = self->createTextOfDisplayNode(displayNode, displayNode->GetDisplayableNode()->GetName(), "vtkMRMLMarkupsDisplayNode");
-              // set text
-              displayTextNode->SetText(textNode->GetText());
-              displayTextNode->Modified();
-              connectorNode->PushNode(displayTextNode);
-
-              // update also the markups node text
-              // get markups node
-              vtkMRMLMarkupsNode* markupsNode = vtkMRMLMarkupsNode::SafeDownCast(displayNode->GetDisplayableNode());
-              std::string className = markupsNode->GetClassName();
-              // get control points
-              vtkNew<vtkPoints> controlPoints;
-              markupsNode->GetControlPointPositionsWorld(controlPoints);
-              int numberOfPoints = markupsNode->GetNumberOfControlPoints();
-              std::string controlPointsText = " ControlPoints = \"";
-              for (int p = 0; p < numberOfPoints; p++)
-              {
-                double point[3] = {0.0};
-                controlPoints->GetPoint(p, point);
-                controlPointsText.append("[");
-                controlPointsText.append(std::to_string(point[0]));
-                controlPointsText.append(",");
-                controlPointsText.append(std::to_string(point[1]));
-                controlPointsText.append(",");
-                controlPointsText.append(std::to_string(point[2]));
-                controlPointsText.append("]");
-                if (p < (numberOfPoints - 1))
-                {
-                  controlPointsText.append(";");
-                }
-              }
-              controlPointsText.append("\"");
-              // get the text node
-              const char* textNodeID = markupsNode->GetNthNodeReferenceID("TextNode", 0);
-              vtkMRMLTextNode* textNode2 = vtkMRMLTextNode::SafeDownCast(self->mrmlScene()->GetNodeByID(textNodeID));
-              if (textNode2)
-              {
-                // write an XML text with the display node attributes
-                std::stringstream ss;
-                ss << "<MRMLNode SuperclassName = \"vtkMRMLMarkupsNode\" ClassName = \"";
-                ss << className;
-                ss << "\" ";
-                ss << controlPointsText;
-                markupsNode->WriteXML(ss, 0);
-                ss << " />";
-                // add the XML to the text node
-                textNode2->SetText(ss.str());
-                textNode2->Modified();
-                connectorNode->PushNode(textNode2);
-              }
-            }
-          }
-        }
-        else if (caller->IsA("vtkMRMLMarkupsNode"))
-        {
-          vtkMRMLMarkupsNode* markupsNode = vtkMRMLMarkupsNode::SafeDownCast(caller);
-          std::string className = markupsNode->GetClassName();
-          // get control points
-          vtkNew<vtkPoints> controlPoints;
-          markupsNode->GetControlPointPositionsWorld(controlPoints);
-          int numberOfPoints = markupsNode->GetNumberOfControlPoints();
-          std::string controlPointsText = " ControlPoints = \"";
-          for (int p = 0; p < numberOfPoints; p++)
-          {
-            double point[3];
-            controlPoints->GetPoint(p, point);
-            controlPointsText.append("[");
-            controlPointsText.append(std::to_string(point[0]));
-            controlPointsText.append(",");
-            controlPointsText.append(std::to_string(point[1]));
-            controlPointsText.append(",");
-            controlPointsText.append(std::to_string(point[2]));
-            controlPointsText.append("]");
-            if (p < (numberOfPoints - 1))
-            {
-              controlPointsText.append(";");
-            }
-          }
-          controlPointsText.append("\"");
-          // get the text node
-          const char* textNodeID = markupsNode->GetNthNodeReferenceID("TextNode", 0);
-          vtkMRMLTextNode* textNode2 = vtkMRMLTextNode::SafeDownCast(self->mrmlScene()->GetNodeByID(textNodeID));
-          if (textNode2)
-          {
-            // write an XML text with the display node attributes
-            std::stringstream ss;
-            ss << "<MRMLNode SuperclassName = \"vtkMRMLMarkupsNode\" ClassName = \"";
-            ss << className;
-            ss << "\" ";
-            ss << controlPointsText;
-            // check if it is a ROI markups node to get ROI radius
-            if (markupsNode->IsA("vtkMRMLMarkupsROINode"))
-            {
-              vtkMRMLMarkupsROINode* markupsROINode = vtkMRMLMarkupsROINode::SafeDownCast(markupsNode);
-              double rad[3] = {0.0};
-              markupsROINode->GetRadiusXYZ(rad);
-              std::string roiRadiusText = " ROIRadius = \"";
-              roiRadiusText.append("[");
-              roiRadiusText.append(std::to_string(rad[0]));
-              roiRadiusText.append(",");
-              roiRadiusText.append(std::to_string(rad[1]));
-              roiRadiusText.append(",");
-              roiRadiusText.append(std::to_string(rad[2]));
-              roiRadiusText.append("]");
-              roiRadiusText.append("\"");
-              ss << roiRadiusText;
-            }
-            markupsNode->WriteXML(ss, 0);
-            ss << " />";
-            // add the XML to the text node
-            textNode2->SetText(ss.str());
-            textNode2->Modified();
-            connectorNode->PushNode(textNode2);
-          }
-        }
-      }
-    }
+  if (d->SynchronizationProgressDialog)
+  {
+    qvtkDisconnect(collaborationLogic, vtkCommand::ProgressEvent, this, SLOT(onSynchronizationProgress(vtkObject*, void*)));
+    delete d->SynchronizationProgressDialog;
+    d->SynchronizationProgressDialog = nullptr;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerCollaborationModuleWidget::onSynchronizationProgress(vtkObject* vtkNotUsed(caller), void* callData)
+{
+  Q_D(qSlicerCollaborationModuleWidget);
+  double* progress = reinterpret_cast<double*>(callData);
+  if (d->SynchronizationProgressDialog && progress)
+  {
+    d->SynchronizationProgressDialog->setValue(static_cast<int>(*progress * 100.0));
   }
 }
 
 //-----------------------------------------------------------------------------
-void qSlicerCollaborationModuleWidget::updateTransformNodeText(vtkMRMLNode* node)
+void qSlicerCollaborationModuleWidget::sendNodesForSynchronization()
 {
   Q_D(qSlicerCollaborationModuleWidget);
 
-  vtkMRMLLinearTransformNode* transformNode = vtkMRMLLinearTransformNode::SafeDownCast(node);
-  std::string transformNodeID = transformNode->GetID();
-  // get the corresponding text node
-  const char* textNodeID = transformNode->GetNthNodeReferenceID("TextNode", 0);
-  vtkMRMLTextNode* transformTextNode = vtkMRMLTextNode::SafeDownCast(this->mrmlScene()->GetNodeByID(textNodeID));
-  if (transformTextNode)
+  // Get the selected collaboration node
+  vtkMRMLCollaborationNode* collabNode = vtkMRMLCollaborationNode::SafeDownCast(d->MRMLNodeComboBox->currentNode());
+  vtkSlicerCollaborationLogic* collaborationLogic = vtkSlicerCollaborationLogic::SafeDownCast(this->logic());
+  // send synchronized nodes if the connection is started
+  if (collabNode && collaborationLogic && d->connectButton->text() == "Disconnect")
   {
-    vtkMRMLCollaborationNode* collabNode = vtkMRMLCollaborationNode::SafeDownCast(d->MRMLNodeComboBox->currentNode());
-    if (collabNode)
-    {
-      // Get the connector node associated to the collaboration node
-      vtkMRMLCollaborationConnectorNode* connectorNode = collabNode->GetCollaborationConnectorNode();
-      if (connectorNode)
-      {
-        // get transformed nodes
-        vtkStringArray* collection = collabNode->GetCollaborationSynchronizedNodeIDs();
-        std::string transformedNodesText = "";
-        for (int i = 0; i < collection->GetNumberOfTuples(); i++)
-        {
-          std::string ID = collection->GetValue(i);
-          vtkMRMLNode* node = vtkMRMLNode::SafeDownCast(this->mrmlScene()->GetNodeByID(ID));
-          vtkMRMLNode* transformNode = vtkMRMLNode::SafeDownCast(node->GetNodeReference("transform"));
-          if (transformNode)
-          {
-            std::string nodeTranformID = transformNode->GetID();
-            if (transformNodeID == nodeTranformID)
-            {
-              transformedNodesText.append(node->GetName());
-              transformedNodesText.append(",");
-            }
-          }
-        }
-        // remove the last comma
-        if (transformedNodesText != "")
-        {
-          transformedNodesText.pop_back();
-        }
-        // write an XML text with the transform node attributes
-        std::stringstream ss;
-        ss << "<MRMLNode SuperclassName = \"vtkMRMLTransformNode\" ClassName = \"vtkMRMLLinearTransformNode\" TransformName = \"";
-        ss << transformNode->GetName();
-        ss << "\" TransformedNodes = \"";
-        ss << transformedNodesText;
-        ss << "\"";
-        ss << " />";
-        // add the XML to the text node
-        transformTextNode->SetText(ss.str());
-        connectorNode->PushNode(transformTextNode);
-      }
-    }
+    collaborationLogic->SendSynchronizedNodes(collabNode);
   }
 }
 
@@ -25,13 +25,20 @@
 // Slicer includes
 #include "qSlicerAbstractModuleWidget.h"
 
-// MRML includes
-#include "vtkMRMLTextNode.h"
+// Qt includes
+#include <QList>
+
+// VTK includes
+#include <vtkType.h>
 
 #include "qSlicerCollaborationModuleExport.h"
 
 class qSlicerCollaborationModuleWidgetPrivate;
+class vtkMRMLCollaborationNode;
 class vtkMRMLNode;
+class vtkMRMLSubjectHierarchyNode;
+class vtkObject;
+class vtkStringArray;
 
 /// \ingroup Slicer_QtModules_ExtensionTemplate
 class Q_SLICER_QTMODULES_COLLABORATION_EXPORT qSlicerCollaborationModuleWidget :
@@ -58,22 +65,28 @@ protected slots:
   /// Handle server/client setting changes to update the CollaborationConnector node
   void updateConnectorNodeFromGUI();
   void onHostNameChanged();
+  /// Enable sending a decimated proxy of the models before their full resolution mesh
+  void onProgressiveDeliveryToggled(bool);
+  void onContentCacheToggled(bool);
+  void onContentCacheSizeChanged(int);
 
   void synchronizeSelectedNodes();
   void unsynchronizeSelectedNodes();
   void sendNodesForSynchronization();
-  vtkMRMLTextNode* createTextOfDisplayNode(vtkMRMLNode* displayNode,char* nodeName, char* className);
-  void updateTransformNodeText(vtkMRMLNode* transformNode);
+  void onSynchronizationProgress(vtkObject* caller, void* callData);
 
 protected:
   QScopedPointer<qSlicerCollaborationModuleWidgetPrivate> d_ptr;
-  static void nodeUpdated(vtkObject* caller, unsigned long event, void* clientData, void* callData);
 
   virtual void setup();
 
+  /// Synchronize or unsynchronize the nodes in one transaction, showing its progress for large selections
+  void runBulkSynchronization(vtkMRMLCollaborationNode* collabNode, vtkStringArray* nodeIDs, bool synchronize);
+  /// Filter again the subject hierarchy items whose synchronization changed
+  void updateSynchronizedItems(vtkMRMLSubjectHierarchyNode* shNode, const QList<vtkIdType>& itemIDs);
+
 private:
   const char* SelectedCollaborationNode; //TODO: Change type to QString and review usage
-  vtkCallbackCommand* UpdateTextCallback;
 
 private:
   Q_DECLARE_PRIVATE(qSlicerCollaborationModuleWidget);